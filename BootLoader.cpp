@@ -0,0 +1,478 @@
+/*
+ * BootLoader.cpp
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * Two stage boot loader. Loading an image with writeByteToRAM() costs 13 hand made
+ * clock pulses (and many digitalWrite() calls) for each byte. Here only a small
+ * receive loop (the "loader stub") is injected that way; then the Z80 runs it with
+ * the Timer2 clock and reads the whole image with INIR through the BOOTLOAD opcode.
+ */
+
+#include <avr/pgmspace.h>                 // Needed for PROGMEM
+#include "Wire.h"                         // Needed for I2C bus
+#include <EEPROM.h>                       // Needed for internal EEPROM R/W
+#include "PetitFS.h"                      // Light handler for FAT16 and FAT32 filesystem on SD
+#include "DefinitionsFile.h"
+#include "Monitor.h"
+#include "FastPin.h"                      // Compile time pin access (fastWrite(), fastRead())
+#include "SDCardFunctions.h"
+#include "BootLoader.h"
+#include "FlashImages.h"                  // Boot programs embedded in the flash (made by tools/bin2lz)
+
+// ------------------------------------------------------------------------------
+// Loader stub (Z80 code). The load address and the image size are patched at
+// STUB_ADDR_OFS and STUB_SIZE_OFS before the injection.
+// ------------------------------------------------------------------------------
+const byte  loaderStub[] PROGMEM = {
+    0x21, 0x00, 0x00,                     // 00 LD   HL,loadAddr   Where to load the image
+    0x0E, 0x00,                           // 03 LD   C,0x00        EXECUTE READ OPCODE port
+    0x3E, BOOTLOAD_OPCODE,                // 05 LD   A,BOOTLOAD
+    0xD3, 0x01,                           // 07 OUT  (0x01),A      STORE OPCODE
+    0x11, 0x00, 0x00,                     // 09 LD   DE,imageSize  D = 256 bytes blocks, E = remaining bytes
+    0x06, 0x00,                           // 0C LD   B,0x00
+    0x14,                                 // 0E INC  D
+    0x18, 0x02,                           // 0F JR   0x13
+    0xED, 0xB2,                           // 11 INIR               Read a 256 bytes block
+    0x15,                                 // 13 DEC  D
+    0x20, 0xFB,                           // 14 JR   NZ,0x11
+    0x7B,                                 // 16 LD   A,E
+    0xB7,                                 // 17 OR   A
+    0x28, 0x03,                           // 18 JR   Z,0x1D
+    0x43,                                 // 1A LD   B,E
+    0xED, 0xB2,                           // 1B INIR               Read the remaining bytes
+    0x76                                  // 1D HALT
+};
+
+// ------------------------------------------------------------------------------
+// INIR benchmark stub (Z80 code): reads BENCH_BLOCKS blocks of 256 bytes at 0x8000
+// ------------------------------------------------------------------------------
+#define BENCH_BLOCKS    64                // 16KB
+#define BENCH_STUBADDR  0x0000
+
+const byte  benchStub[] PROGMEM = {
+    0x16, BENCH_BLOCKS,                   // 00 LD   D,BENCH_BLOCKS
+    0x3E, BOOTLOAD_OPCODE,                // 02 LD   A,BOOTLOAD
+    0xD3, 0x01,                           // 04 OUT  (0x01),A      STORE OPCODE
+    0x21, 0x00, 0x80,                     // 06 LD   HL,0x8000
+    0x01, 0x00, 0x00,                     // 09 LD   BC,0x0000     B = 256 bytes, C = EXECUTE READ OPCODE port
+    0xED, 0xB2,                           // 0C INIR
+    0x15,                                 // 0E DEC  D
+    0x20, 0xF5,                           // 0F JR   NZ,0x06
+    0x76                                  // 11 HALT
+};
+
+#define STUB_ADDR_OFS   1                 // Offset of loadAddr inside the stub
+#define STUB_SIZE_OFS   10                // Offset of imageSize inside the stub
+#define STUB_LOW_ADDR   0x0003            // Stub position below the image (after the JP injected @ 0x0000)
+
+#if WARMBOOT_CACHE
+byte    warmImage[WARMBOOT_CACHE];        // Copy of the last boot program streamed from SD (warm boot)
+#endif
+word    warmImageSize;                    // Size of the copy in warmImage (0 = no copy)
+
+// Unpacking state of a flash image (see BootLoader.h for the format)
+struct LzState
+{
+    const byte  *src;                     // Next packed byte (PROGMEM)
+    byte        *window;                  // Last LZ_WINDOW unpacked bytes
+    word        pos;                      // Unpacked bytes so far
+    word        matchDist;                // Distance of the current match
+    byte        matchLen;                 // Bytes of the current match still to copy
+    byte        flags;                    // Flags of the current group (shifted out LSB first)
+    byte        flagCnt;                  // Items of the current group still to read
+};
+
+
+// ------------------------------------------------------------------------------
+// Start unpacking "image" using "window" (LZ_WINDOW bytes) as history
+// ------------------------------------------------------------------------------
+static void openLz(LzState *lz, const byte *image, byte *window)
+{
+    lz->src = image;
+    lz->window = window;
+    lz->pos = 0;
+    lz->matchLen = 0;
+    lz->flagCnt = 0;
+}
+
+// ------------------------------------------------------------------------------
+// Return the next unpacked byte
+// ------------------------------------------------------------------------------
+static byte nextLz(LzState *lz)
+{
+    byte  value;
+    byte  item;
+
+    if (!lz->matchLen)
+    {
+        if (!lz->flagCnt)
+        {
+            lz->flags = pgm_read_byte(lz->src++);
+            lz->flagCnt = 8;
+        }
+        lz->flagCnt--;
+        if (!(lz->flags & 0x01))
+        {
+            // A match: copy from the history
+            item = pgm_read_byte(lz->src++);
+            lz->matchDist = item + 1;
+            item = pgm_read_byte(lz->src++);
+            lz->matchDist += (item & 0x01) << 8;
+            lz->matchLen = (item >> 1) + LZ_MINMATCH;
+        }
+        lz->flags >>= 1;
+    }
+    if (lz->matchLen)
+    {
+        value = lz->window[(lz->pos - lz->matchDist) & (LZ_WINDOW - 1)];
+        lz->matchLen--;
+    }
+    else
+    {
+        value = pgm_read_byte(lz->src++);     // A literal
+    }
+    lz->window[lz->pos++ & (LZ_WINDOW - 1)] = value;
+    return value;
+}
+
+
+// ------------------------------------------------------------------------------
+// Wait an I/O request from the Z80 (WAIT_ active).
+// Returns 1 if it arrived, 0 after BOOTLOAD_TIMEOUT ms
+// ------------------------------------------------------------------------------
+byte waitIoZ80(void)
+{
+    unsigned long startTime = millis();
+
+    while (fastRead(WAIT_))
+    {
+        if ((millis() - startTime) > BOOTLOAD_TIMEOUT)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// ------------------------------------------------------------------------------
+// Put "value" on the data bus and exit from the wait state (same sequence of the 
+// I/O read cycle in loop())
+// ------------------------------------------------------------------------------
+void ioReadDoneZ80(byte value)
+{
+    DDRA = 0xFF;                              // Configure Z80 data bus D0-D7 (PA0-PA7) as output
+    PORTA = value;                            // Current output on data bus
+    fastWrite(BUSREQ_, LOW);                  // Request for a DMA
+    fastWrite(WAIT_RES_, LOW);                // Now is safe reset WAIT FF (exiting from WAIT state)
+    holdIoReadZ80();                          // Wait until the Z80 latched the data (IO_READ_HOLD_CLK clocks)
+    DDRA = 0x00;                              // Configure Z80 data bus D0-D7 (PA0-PA7) as input with pull-up
+    PORTA = 0xFF;
+    fastWrite(WAIT_RES_, HIGH);               // Now Z80 is in DMA (HiZ), so it's safe set WAIT_RES_ HIGH again
+    fastWrite(BUSREQ_, HIGH);                 // Resume Z80 from DMA
+}
+
+// ------------------------------------------------------------------------------
+// Exit from the wait state of an I/O write cycle
+// ------------------------------------------------------------------------------
+void ioWriteDoneZ80(void)
+{
+    fastWrite(BUSREQ_, LOW);                  // Request for a DMA
+    fastWrite(WAIT_RES_, LOW);                // Reset WAIT FF exiting from WAIT state
+    fastWrite(WAIT_RES_, HIGH);               // Now Z80 is in DMA, so it's safe set WAIT_RES_ HIGH again
+    fastWrite(BUSREQ_, HIGH);                 // Resume Z80 from DMA
+}
+
+// ------------------------------------------------------------------------------
+// Inject a stub (Z80 code held in SRAM) at "stubAddr" with the hand made clock,
+// then run it with the Timer2 clock ("clkMode", see startZ80Clock())
+// ------------------------------------------------------------------------------
+void runStubZ80(word stubAddr, const byte *stub, byte stubSize, byte clkMode)
+{
+    byte  i;
+
+    loadHL(stubAddr);
+    for (i = 0; i < stubSize; i++)
+    {
+        writeByteToRAM(stub[i]);
+    }
+    loadHL(stubAddr);
+    jumpToHL();
+    startZ80Clock(clkMode);
+}
+
+// ------------------------------------------------------------------------------
+// Stop a running stub and go back to the hand made clock: the Timer2 clock is
+// stopped, a pending I/O request is released and the Z80 is reset
+// ------------------------------------------------------------------------------
+void haltZ80(void)
+{
+    stopZ80Clock();
+    if (!fastRead(WAIT_))
+    {
+        ioWriteDoneZ80();                     // Release a pending I/O request
+    }
+    singlePulsesResetZ80();
+}
+
+// ------------------------------------------------------------------------------
+// Load an image into RAM using the loader stub:
+// *  "loadAddr" is the starting address of the image in the Z80 address space;
+// *  "imageSize" is the image size in bytes;
+// *  "image" points to the image in flash (PROGMEM) or in SRAM, or is NULL to read it
+//    from the current position of the file opened on SD;
+// *  "imageType" is IMAGE_RAW, IMAGE_PACKED (LZ packed flash image, see BootLoader.h,
+//    "imageSize" is the unpacked size) or IMAGE_SRAM;
+// *  "clkMode" is the Z80 clock speed mode used to run the stub (see startZ80Clock()).
+// The returned value is 0 if the image is loaded, an SD error code (see printErrSD())
+//  or BOOTLOAD_LEGACY if there is no room for the stub or the stub does not answer.
+//
+// NOTE1: The stub is placed at STUB_LOW_ADDR if the image starts after it, or at the
+//        top of the memory if the image ends before it. The JP eventually injected at
+//        0x0000 is not touched.
+// NOTE2: At the end the Z80 is reset and the stub is cleared (0x00), so the caller can 
+//        still inject instructions or start the Z80 as usual.
+// NOTE3: An image read from SD up to WARMBOOT_CACHE bytes long (if set) is copied into warmImage,
+//        so a warm boot can load it again without the SD.
+// ------------------------------------------------------------------------------
+byte streamImageZ80(word loadAddr, unsigned long imageSize, const byte *image, byte imageType, byte clkMode)
+{
+    byte  stub[sizeof(loaderStub)];
+    byte  sectBuf[512];                   // Current SD sector (or the history of a packed image)
+    LzState lz;
+    word  sectBytes = 0;                  // Bytes read into sectBuf
+    word  sectIndex = 0;                  // Next byte of sectBuf to send
+    word  stubAddr;
+    word  i;
+    word  byteCnt;
+    byte  errcode = 0;
+
+    // Find room for the stub
+    if (!imageSize || (loadAddr + imageSize > 0x10000UL))
+    {
+        return BOOTLOAD_LEGACY;
+    }
+    if (loadAddr >= STUB_LOW_ADDR + sizeof(loaderStub))
+    {
+        stubAddr = STUB_LOW_ADDR;
+    }
+    else if (loadAddr + imageSize <= 0x10000UL - sizeof(loaderStub))
+    {
+        stubAddr = (word)(0x10000UL - sizeof(loaderStub));
+    }
+    else
+    {
+        return BOOTLOAD_LEGACY;
+    }
+
+    // Inject the stub with the hand made clock, then run it with the Timer2 clock
+    memcpy_P(stub, loaderStub, sizeof(loaderStub));
+    stub[STUB_ADDR_OFS]     = lowByte(loadAddr);
+    stub[STUB_ADDR_OFS + 1] = highByte(loadAddr);
+    stub[STUB_SIZE_OFS]     = lowByte((word)imageSize);
+    stub[STUB_SIZE_OFS + 1] = highByte((word)imageSize);
+    if (imageType == IMAGE_PACKED)
+    {
+        openLz(&lz, image, sectBuf);
+    }
+    if (!image)
+    {
+        warmImageSize = 0;                    // The copy is valid only if the whole image is read
+    }
+    runStubZ80(stubAddr, stub, sizeof(stub), clkMode);
+
+    // Serve the STORE OPCODE of the stub, then every EXECUTE READ OPCODE with the next image byte
+    if (waitIoZ80() && !fastRead(WR_) && (PINA == BOOTLOAD_OPCODE))
+    {
+        ioWriteDoneZ80();
+        for (byteCnt = 0; byteCnt < (word)imageSize; byteCnt++)
+        {
+            if (!image && (sectIndex == sectBytes))
+            {
+                errcode = readBlockSD(sectBuf, sizeof(sectBuf), &sectBytes);
+                sectIndex = 0;
+                if (!errcode && !sectBytes)
+                {
+                    errcode = FR_DISK_ERR;        // Unexpected EOF
+                }
+                if (errcode)
+                {
+                    break;
+                }
+            }
+            if (!waitIoZ80() || fastRead(RD_))
+            {
+                errcode = BOOTLOAD_LEGACY;        // The stub is not answering as expected
+                break;
+            }
+            if (!image)
+            {
+#if WARMBOOT_CACHE
+                if (imageSize <= WARMBOOT_CACHE)
+                {
+                    warmImage[byteCnt] = sectBuf[sectIndex];
+                }
+#endif
+                ioReadDoneZ80(sectBuf[sectIndex++]);
+            }
+            else if (imageType == IMAGE_PACKED)
+            {
+                ioReadDoneZ80(nextLz(&lz));
+            }
+            else
+            {
+                ioReadDoneZ80((imageType == IMAGE_SRAM) ? image[byteCnt] : pgm_read_byte(image + byteCnt));
+            }
+        }
+        delayMicroseconds(10);                // Let the Z80 store the last byte and reach the HALT
+#if WARMBOOT_CACHE
+        if (!image && !errcode && (imageSize <= WARMBOOT_CACHE))
+        {
+            warmImageSize = imageSize;
+        }
+#endif
+    }
+    else
+    {
+        errcode = BOOTLOAD_LEGACY;
+    }
+
+    // Back to the hand made clock: reset the Z80 and clear the stub
+    haltZ80();
+    loadHL(stubAddr);
+    for (i = 0; i < sizeof(stub); i++)
+    {
+        writeByteToRAM(0x00);
+    }
+    return errcode;
+}
+
+// ------------------------------------------------------------------------------
+// Look for a boot program embedded in the flash replacing the file "fileName" on SD.
+// Returns 1 if found (copied into "image"), 0 otherwise
+// ------------------------------------------------------------------------------
+byte findFlashImage(const char *fileName, struct FlashImage *image)
+{
+#if FLASH_IMAGES
+    byte  i;
+
+    for (i = 0; i < FLASH_IMAGES; i++)
+    {
+        memcpy_P(image, &flashImageTable[i], sizeof(FlashImage));
+        if (!strcmp(image->name, fileName))
+        {
+            return 1;
+        }
+    }
+#else
+    (void)fileName;                       // No image embedded
+    (void)image;
+#endif
+    return 0;
+}
+
+// ------------------------------------------------------------------------------
+// Unpack a boot program embedded in the flash into RAM at "loadAddr", through the
+//  loader stub if possible (see streamImageZ80()), otherwise byte by byte
+// ------------------------------------------------------------------------------
+void loadFlashImageZ80(word loadAddr, const struct FlashImage *image, byte clkMode)
+{
+    byte    window[LZ_WINDOW];
+    LzState lz;
+    word    i;
+
+    if (streamImageZ80(loadAddr, image->size, image->data, image->packed ? IMAGE_PACKED : IMAGE_RAW, clkMode))
+    {
+        openLz(&lz, image->data, window);
+        loadHL(loadAddr);                     // Set Z80 HL = boot starting address (used as pointer to RAM);
+        for (i = 0; i < image->size; i++)
+        {
+            // Write current data byte into RAM
+            writeByteToRAM(image->packed ? nextLz(&lz) : pgm_read_byte(image->data + i));
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Time (us) taken by the benchmark stub to read its BENCH_BLOCKS * 256 bytes with
+//  INIR. Each I/O read holds the data on the bus for IO_READ_HOLD_CLK Z80 clocks, or
+//  for about 2us as the old code did if "fixedHold" is 1 (see holdIoReadZ80()).
+//  Returns 0 if the stub is not answering.
+// ------------------------------------------------------------------------------
+static unsigned long benchHoldZ80(byte fixedHold, byte clkMode)
+{
+    byte            stub[sizeof(benchStub)];
+    unsigned long   startTime;
+    unsigned long   elapsed = 0;
+    word            byteCnt;
+
+    memcpy_P(stub, benchStub, sizeof(benchStub));
+    runStubZ80(BENCH_STUBADDR, stub, sizeof(stub), clkMode);  // Sets ioReadHold for clkMode too
+    if (fixedHold)
+    {
+        ioReadHold = (2 * (F_CPU / 1000000UL)) / 3;             // Same as delayMicroseconds(2)
+    }
+    if (waitIoZ80() && !fastRead(WR_) && (PINA == BOOTLOAD_OPCODE))
+    {
+        ioWriteDoneZ80();
+        startTime = micros();
+        for (byteCnt = 0; byteCnt < BENCH_BLOCKS * 256U; byteCnt++)
+        {
+            if (!waitIoZ80() || fastRead(RD_))
+            {
+                break;
+            }
+            ioReadDoneZ80(lowByte(byteCnt));
+        }
+        if (byteCnt == BENCH_BLOCKS * 256U)
+        {
+            elapsed = micros() - startTime;
+        }
+    }
+    haltZ80();
+    return elapsed;
+}
+
+// ------------------------------------------------------------------------------
+// Print the INIR throughput (bytes/s) with the old fixed 2us hold of the I/O read
+//  cycle and with the hold computed from the Z80 clock. The Z80 RAM is overwritten,
+//  so it must be called before loading the boot program.
+// ------------------------------------------------------------------------------
+void benchInirZ80(byte clkMode)
+{
+    unsigned long   elapsed;
+    byte            i;
+
+    fastWrite(WAIT_RES_, HIGH);               // Enable the wait states
+    Serial.print(F("IOS: INIR benchmark ("));
+    Serial.print(BENCH_BLOCKS * 256U);
+    Serial.println(F(" bytes)"));
+    for (i = 0; i < 2; i++)
+    {
+        if (!i)
+        {
+            Serial.print(F("  Fixed 2us hold: "));
+        }
+        else
+        {
+            Serial.print(F("  Hold of "));
+            Serial.print(IO_READ_HOLD_CLK);
+            Serial.print(F(" Z80 clocks: "));
+        }
+        elapsed = benchHoldZ80(!i, clkMode);
+        if (elapsed)
+        {
+            Serial.print((BENCH_BLOCKS * 256UL * 1000000UL) / elapsed);
+            Serial.print(F(" bytes/s ("));
+            Serial.print(elapsed);
+            Serial.println(F(" us)"));
+        }
+        else
+        {
+            Serial.println(F("failed"));
+        }
+    }
+}
+
+// end of source file
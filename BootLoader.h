@@ -0,0 +1,75 @@
+/*
+ * BootLoader.h
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ */ 
+
+
+#ifndef BOOTLOADER_H_
+#define BOOTLOADER_H_
+
+#ifdef __cplusplus
+extern "C" {
+    #endif
+
+// ------------------------------------------------------------------------------
+// Definitions
+// ------------------------------------------------------------------------------
+#define BOOTLOAD_OPCODE     0x8B        // I/O read opcode used by the loader stub to receive the image
+#define BOOTLOAD_TIMEOUT    200         // Max wait (ms) for an I/O request of the loader stub
+#define BOOTLOAD_LEGACY     0xFF        // streamImageZ80() result: the image must be loaded byte by byte
+
+#define IMAGE_RAW           0           // streamImageZ80() image: plain, in flash (or on SD if no pointer)
+#define IMAGE_PACKED        1           // streamImageZ80() image: LZ packed, in flash
+#define IMAGE_SRAM          2           // streamImageZ80() image: plain, in SRAM
+
+#ifndef WARMBOOT_CACHE
+#define WARMBOOT_CACHE      0           // Max size of a boot program loaded from SD kept in SRAM for a warm boot
+#endif                                  //  (0 = none, it is read from SD again; the copy takes that much SRAM)
+
+// ------------------------------------------------------------------------------
+// Boot programs embedded in the flash (FlashImages.h, made by tools/bin2lz).
+//  Each image is LZ packed in 8 items groups: a flags byte (LSB first, 1 = literal
+//  byte, 0 = match) followed by the items. A match is two bytes: distance - 1 (bits
+//  0..8, 1..LZ_WINDOW bytes back) and length - LZ_MINMATCH (bits 9..15). An image
+//  that does not get smaller is stored as it is (FlashImage.packed = 0)
+// ------------------------------------------------------------------------------
+#define LZ_WINDOW           512         // History size (bytes) needed to unpack
+#define LZ_MINMATCH         3           // Shortest match
+
+struct FlashImage
+{
+    char        name[13];               // Name (8.3 format) of the file on SD replaced by the image
+    word        size;                   // Unpacked size in bytes
+    const byte  *data;                  // Packed image (PROGMEM)
+    byte        packed;                 // 1 if LZ packed, 0 if stored as it is
+};
+
+// ------------------------------------------------------------------------------
+// Externals
+// ------------------------------------------------------------------------------
+#if WARMBOOT_CACHE
+extern byte     warmImage[WARMBOOT_CACHE];  // Copy of the last boot program streamed from SD
+#endif
+extern word     warmImageSize;              // Size of the copy in warmImage (0 = no copy)
+
+// ------------------------------------------------------------------------------
+// Function Prototypes
+// ------------------------------------------------------------------------------
+byte    streamImageZ80(word loadAddr, unsigned long imageSize, const byte *image, byte imageType, byte clkMode);
+byte    findFlashImage(const char *fileName, struct FlashImage *image);
+void    loadFlashImageZ80(word loadAddr, const struct FlashImage *image, byte clkMode);
+void    runStubZ80(word stubAddr, const byte *stub, byte stubSize, byte clkMode);
+void    haltZ80(void);
+byte    waitIoZ80(void);
+void    ioReadDoneZ80(byte value);
+void    ioWriteDoneZ80(void);
+void    benchInirZ80(byte clkMode);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* BOOTLOADER_H_ */
@@ -0,0 +1,182 @@
+/*
+ * BootTrace.cpp
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * Boot timing. Each phase of setup() leaves a timestamped mark (micros() from the
+ * MCU reset). When the Z80 starts the marks are copied into a .noinit area, so the
+ * trace of the last boot is still there after a reset (not after a power cycle) and
+ * can be printed from the boot menu.
+ * The uTerm reset is handled here too, so that a fast boot can do other work while
+ * the uTerm is in reset or is starting up.
+ */
+
+#include <avr/pgmspace.h>                 // Needed for PROGMEM
+#include "Wire.h"                         // Needed for I2C bus
+#include <EEPROM.h>                       // Needed for internal EEPROM R/W
+#include "PetitFS.h"                      // Light handler for FAT16 and FAT32 filesystem on SD
+#include "DefinitionsFile.h"
+#include "Monitor.h"
+#include "FastPin.h"                      // Compile time pin access (fastWrite(), fastRead())
+#include "BootTrace.h"
+
+// ------------------------------------------------------------------------------
+// Phase names (index = BT_xxx)
+// ------------------------------------------------------------------------------
+const char  btName0[]  PROGMEM = "Pins init, Z80 reset";
+const char  btName1[]  PROGMEM = "uTerm reset";
+const char  btName2[]  PROGMEM = "EEPROM config";
+const char  btName3[]  PROGMEM = "I2C probe";
+const char  btName4[]  PROGMEM = "Banner";
+const char  btName5[]  PROGMEM = "RTC probe";
+const char  btName6[]  PROGMEM = "SD mount";
+const char  btName7[]  PROGMEM = "Boot menu";
+const char  btName8[]  PROGMEM = "Open boot file";
+const char  btName9[]  PROGMEM = "Load image";
+const char  btName10[] PROGMEM = "uTerm ready";
+const char  btName11[] PROGMEM = "Z80 running";
+
+const char * const btNameTable[BT_PHASES] PROGMEM = {
+    btName0, btName1, btName2, btName3, btName4, btName5,
+    btName6, btName7, btName8, btName9, btName10, btName11
+};
+
+#define BT_MAGIC        0x42D7      // Marks a valid trace in the .noinit area
+
+struct BootMark
+{
+    byte            phase;          // BT_xxx
+    unsigned long   time;           // micros() at the end of the phase
+};
+
+struct BootTraceBuf
+{
+    word            magic;          // BT_MAGIC if valid
+    byte            count;          // Number of marks
+    byte            check;          // XOR of all the bytes of the marks
+    BootMark        mark[BT_MAX_MARKS];
+};
+
+static BootTraceBuf     curTrace;                                           // Current boot
+static BootTraceBuf     lastTrace __attribute__ ((section (".noinit")));    // Last completed boot
+
+static unsigned long    uTermTime;  // millis() when the uTerm reset was asserted or released
+static byte             uTermReleased;
+
+// ------------------------------------------------------------------------------
+// XOR of the marks bytes (used to validate the .noinit copy after a power cycle)
+// ------------------------------------------------------------------------------
+static byte checkTrace(const BootTraceBuf *buf)
+{
+    const byte  *p = (const byte *)buf->mark;
+    byte        check = 0;
+
+    for (word i = 0; i < sizeof(buf->mark); i++)
+    {
+        check ^= p[i];
+    }
+    return check;
+}
+
+// ------------------------------------------------------------------------------
+// Record the end of a boot phase (BT_xxx). Marks after the first BT_MAX_MARKS are lost.
+// ------------------------------------------------------------------------------
+void bootTrace(byte phase)
+{
+    if (curTrace.count < BT_MAX_MARKS)
+    {
+        curTrace.mark[curTrace.count].phase = phase;
+        curTrace.mark[curTrace.count].time = micros();
+        curTrace.count++;
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Keep the current trace as the "last boot" trace
+// ------------------------------------------------------------------------------
+void bootTraceDone(void)
+{
+    curTrace.magic = BT_MAGIC;
+    curTrace.check = checkTrace(&curTrace);
+    lastTrace = curTrace;
+}
+
+// ------------------------------------------------------------------------------
+// Print a boot trace (BT_CURRENT or BT_LAST). For each mark are printed the time
+// from the MCU reset and the duration of the phase, both in microseconds.
+// ------------------------------------------------------------------------------
+void printBootTrace(byte which)
+{
+    const BootTraceBuf  *buf = (which == BT_LAST) ? &lastTrace : &curTrace;
+    unsigned long       prevTime = 0;
+    byte                i;
+
+    Serial.print(F("IOS: Boot trace ("));
+    Serial.print((which == BT_LAST) ? F("last boot") : F("this boot"));
+    Serial.println(F(", us from reset)"));
+    if ((which == BT_LAST) && ((buf->magic != BT_MAGIC) || (buf->count > BT_MAX_MARKS) || (buf->check != checkTrace(buf))))
+    {
+        Serial.println(F("     not available"));
+        return;
+    }
+    for (i = 0; i < buf->count; i++)
+    {
+        Serial.print("  ");
+        Serial.print(buf->mark[i].time);
+        Serial.print(" (+");
+        Serial.print(buf->mark[i].time - prevTime);
+        Serial.print(") ");
+        if (buf->mark[i].phase < BT_PHASES)
+        {
+            Serial.println((const __FlashStringHelper *)pgm_read_ptr(&btNameTable[buf->mark[i].phase]));
+        }
+        else
+        {
+            Serial.println("?");
+        }
+        prevTime = buf->mark[i].time;
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Reset the uTerm (A071218-R250119) if present. The reset is released by releaseUTerm()
+// or waitUTerm(), so other work can be done meanwhile.
+// ------------------------------------------------------------------------------
+void startUTermReset(void)
+{
+    fastWrite(MCU_RTS_, LOW);
+    uTermTime = millis();
+    uTermReleased = 0;
+}
+
+// ------------------------------------------------------------------------------
+// Release the uTerm reset, waiting for what remains of the UTERM_RESET_MS pulse
+// ------------------------------------------------------------------------------
+void releaseUTerm(void)
+{
+    if (!uTermReleased)
+    {
+        while ((millis() - uTermTime) < UTERM_RESET_MS);
+        fastWrite(MCU_RTS_, HIGH);
+        uTermTime = millis();
+        uTermReleased = 1;
+        bootTrace(BT_UTERM);
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Wait until the uTerm is ready to receive (releasing its reset if needed)
+// ------------------------------------------------------------------------------
+void waitUTerm(void)
+{
+    releaseUTerm();
+    if (uTermReleased == 1)
+    {
+        while ((millis() - uTermTime) < UTERM_READY_MS);
+        uTermReleased = 2;
+        bootTrace(BT_UTREADY);
+    }
+}
+
+// end of source file
@@ -0,0 +1,59 @@
+/*
+ * BootTrace.h
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ */
+
+
+#ifndef BOOTTRACE_H_
+#define BOOTTRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+    #endif
+
+// ------------------------------------------------------------------------------
+// Definitions
+// ------------------------------------------------------------------------------
+#define BT_PINS         0           // Boot phases recorded by bootTrace()
+#define BT_UTERM        1
+#define BT_EEPROM       2
+#define BT_I2C          3
+#define BT_BANNER       4
+#define BT_RTC          5
+#define BT_MOUNT        6
+#define BT_MENU         7
+#define BT_OPEN         8
+#define BT_LOAD         9
+#define BT_UTREADY      10
+#define BT_RUN          11
+#define BT_PHASES       12
+
+#define BT_MAX_MARKS    16          // Max recorded marks for each boot
+#define BT_CURRENT      0           // printBootTrace() selector: current boot
+#define BT_LAST         1           // printBootTrace() selector: last completed boot (kept across a reset)
+
+#define BOOTCFG_FAST    0x01        // Boot configuration flag (EEPROM): fast boot
+#define BOOTCFG_TRACE   0x02        // Boot configuration flag (EEPROM): print the boot trace at every boot
+#define BOOTCFG_IOLOG   0x04        // Boot configuration flag (EEPROM): I/O sessions log on SD (see IoLog.h)
+
+#define UTERM_RESET_MS  100         // uTerm (A071218-R250119) reset pulse width (ms)
+#define UTERM_READY_MS  500         // Time needed by uTerm after the reset release (ms)
+
+// ------------------------------------------------------------------------------
+// Function Prototypes
+// ------------------------------------------------------------------------------
+void    bootTrace(byte phase);
+void    bootTraceDone(void);
+void    printBootTrace(byte which);
+void    startUTermReset(void);
+void    releaseUTerm(void);
+void    waitUTerm(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* BOOTTRACE_H_ */
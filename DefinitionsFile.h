@@ -18,6 +18,7 @@
 #define   DS3231_RTC    0x68  // DS3231 I2C address
 #define   DS3231_SECRG  0x00  // DS3231 Seconds Register
 #define   DS3231_STATRG 0x0F  // DS3231 Status Register
+#define   RTC_NEEDSET   2     // autoSetRTC() result: RTC found but its date/time must be set
 
 // ------------------------------------------------------------------------------
 //
@@ -34,6 +35,8 @@
 #define   AUTOFN        "AUTOBOOT.BIN"
 #define   Z80DISK       "DSxNyy.DSK"      // Generic Z80 disk name (from DS0N00.DSK to DS9N99.DSK)
 #define   DS_OSNAME     "DSxNAM.DAT"      // File with the OS name for Disk Set "x" (from DS0NAM.DAT to DS9NAM.DAT)
+#define   DS_MAPFILE    "DSKMAP.DAT"      // Map of the contiguous "disk files" (written by tools/mbc2img)
+#define   HIBERNFN      "HIBERN.SNP"      // Hibernation snapshot of the whole RAM (see Hibernate.cpp)
 #define   BASSTRADDR    0x0000            // Starting address for the stand-alone Basic interpreter
 #define   FORSTRADDR    0x0100            // Starting address for the stand-alone Forth interpreter
 #define   CPM22CBASE    0xD200            // CBASE value for CP/M 2.2
@@ -57,5 +60,23 @@
 #define   GPIOA_REG     0x12  // MCP23017 internal register GPIOA  (see datasheet)
 #define   GPIOB_REG     0x13  // MCP23017 internal register GPIOB  (see datasheet)
 
+// ------------------------------------------------------------------------------
+//
+// Virtual I/O opcodes tables (see execIoOpcode())
+//
+// ------------------------------------------------------------------------------
+
+#define   IO_WR_OPCODES 0x17  // Write opcodes 0x00..0x16
+#define   IO_RD_OPCODES 0x12  // Read opcodes 0x80..0x91
+#define   IO_OK         0     // Opcode handler result: data byte done, exit from the wait state
+#define   IO_RESET      1     // Opcode handler result: the Z80 was reset, no wait state to exit from
+
+struct IoOpcode
+{
+    byte    (*handler)(void); // Serves one data byte (ioData, ioByteCnt) and returns IO_OK or IO_RESET
+    word    byteCnt;          // Exchanged bytes: execIoOpcode() ends the opcode after the last one. If 0
+                              //  (variable) the handler sets ioOpcode = 0xFF itself
+};
+
 
 #endif /* DEFINITIONSFILE_H_ */
\ No newline at end of file
@@ -0,0 +1,92 @@
+/*
+ * FastPin.h
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * Compile time pin access. The pin number (see Monitor.h) is a template parameter,
+ * so port register and bit mask are constants and fastWrite()/fastRead() compile to
+ * a single SBI/CBI/SBIS instruction, instead of the table lookups and the SREG save
+ * of digitalWrite()/digitalRead().
+ *
+ * NOTE: Unlike digitalWrite(), fastWrite() does not turn off a PWM output on the pin
+ *       (the Timer2 clock on CLK is disconnected by stopZ80Clock()).
+ */
+
+
+#ifndef FASTPIN_H_
+#define FASTPIN_H_
+
+#include <avr/io.h>
+
+typedef decltype((PORTA)) FastPinReg;   // Reference to an I/O port register
+
+// ------------------------------------------------------------------------------
+// Pin "pinNum" (MightyCore "standard" pinout: 0..7 = PB0..PB7, 8..15 = PD0..PD7,
+//  16..23 = PC0..PC7, 24..31 = PA0..PA7)
+// ------------------------------------------------------------------------------
+template <uint8_t pinNum>
+struct FastPin
+{
+    static_assert(pinNum < 32, "FastPin: not an ATmega1284P pin");
+    enum { mask = 1 << (pinNum & 7) };
+
+    static inline FastPinReg portReg(void)
+    {
+        return (pinNum < 8) ? PORTB : (pinNum < 16) ? PORTD : (pinNum < 24) ? PORTC : PORTA;
+    }
+    static inline FastPinReg ddrReg(void)
+    {
+        return (pinNum < 8) ? DDRB : (pinNum < 16) ? DDRD : (pinNum < 24) ? DDRC : DDRA;
+    }
+    static inline FastPinReg pinReg(void)
+    {
+        return (pinNum < 8) ? PINB : (pinNum < 16) ? PIND : (pinNum < 24) ? PINC : PINA;
+    }
+
+    static inline void high(void)
+    {
+        portReg() |= mask;
+    }
+    static inline void low(void)
+    {
+        portReg() &= ~mask;
+    }
+    static inline void write(uint8_t level)
+    {
+        if (level)
+        {
+            high();
+        }
+        else
+        {
+            low();
+        }
+    }
+    static inline uint8_t read(void)
+    {
+        return (pinReg() & mask) ? HIGH : LOW;
+    }
+    static inline void mode(uint8_t pinMode)    // INPUT, INPUT_PULLUP or OUTPUT (as pinMode())
+    {
+        if (pinMode == OUTPUT)
+        {
+            ddrReg() |= mask;
+        }
+        else
+        {
+            ddrReg() &= ~mask;
+            write(pinMode == INPUT_PULLUP);
+        }
+    }
+};
+
+// ------------------------------------------------------------------------------
+// Drop-in replacements of digitalWrite(), digitalRead() and pinMode() for a constant pin
+// ------------------------------------------------------------------------------
+#define fastWrite(pin, level)   FastPin<pin>::write(level)
+#define fastRead(pin)           FastPin<pin>::read()
+#define fastMode(pin, pinMode)  FastPin<pin>::mode(pinMode)
+
+
+#endif /* FASTPIN_H_ */
@@ -0,0 +1,16 @@
+/*
+ * FlashImages.h
+ *
+ * Generated by tools/bin2lz - do not edit (see "make -C tools flashimages").
+ * Boot programs embedded in the flash, LZ packed or stored as they are (see
+ * BootLoader.h). Included only by BootLoader.cpp.
+ */
+
+
+#ifndef FLASHIMAGES_H_
+#define FLASHIMAGES_H_
+
+#define FLASH_IMAGES    0
+
+
+#endif /* FLASHIMAGES_H_ */
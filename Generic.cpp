@@ -14,7 +14,8 @@
 // enter XXXX
 #include "RealTimeClock.h"
 #include "Generic.h"
-#include "SdCardFunctions.h"
+#include "SDCardFunctions.h"
+#include "FastPin.h"                      // Compile time pin access (fastWrite(), fastRead())
 
 char inChar;  // Input char from serial
 
@@ -40,7 +41,7 @@ char inChar;  // Input char from serial
  {
      if ((Serial.available()) && Z80IntEnFlag)
      {
-         digitalWrite(INT_, LOW);
+         fastWrite(INT_, LOW);
      }
  }
 
@@ -51,7 +52,7 @@ char inChar;  // Input char from serial
  {
      if ((millis() - *timestamp) > 200)
      {
-         digitalWrite(LED_IOS,!digitalRead(LED_IOS));
+         fastWrite(LED_IOS, !fastRead(LED_IOS));
          *timestamp = millis();
      }
  }
@@ -143,20 +144,18 @@ char inChar;  // Input char from serial
 
  // ------------------------------------------------------------------------------
  // Print the current Disk Set number and the OS name, if it is defined.
- // The OS name is inside the file defined in DS_OSNAME
+ // The OS name is taken from the Disk Sets cache (see loadDiskSetsSD()), so the SD
+ //  is not accessed
  // ------------------------------------------------------------------------------
  void printOsName(byte currentDiskSet)
  {
      Serial.print("Disk Set ");
      Serial.print(currentDiskSet);
-     OsName[2] = currentDiskSet + 48;    // Set the Disk Set
-     openSD(OsName);                     // Open file with the OS name
-     readSD(bufferSD, &numReadBytes);    // Read the OS name
-     if (numReadBytes > 0)
+     if ((currentDiskSet < DS_MAXSETS) && diskSetSD[currentDiskSet].osName[0])
      {
          // Print the OS name
          Serial.print(" (");
-         Serial.print((const char *)bufferSD);
+         Serial.print(diskSetSD[currentDiskSet].osName);
          Serial.print(")");
      }
  }
@@ -0,0 +1,374 @@
+/*
+ * Hibernate.cpp
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * Hibernation. The whole 128KB RAM (the three Os Banks of the lower half and the
+ * common upper half) is saved into HIBERNFN together with the bank selection and an
+ * entry address given by the Z80 program (HIBERNATE opcode). The "Resume" boot mode
+ * writes it back and jumps to the entry address, so the OS boot and the program
+ * initialization are skipped.
+ * The RAM is moved by a small stub at the top of the common bank (OTIR to save, INIR
+ * to restore) running with the Timer2 clock; the bytes under the stub are handled
+ * with the hand made clock (readByteFromRAM()/writeByteToRAM()).
+ */
+
+#include <avr/pgmspace.h>                 // Needed for PROGMEM
+#include "Wire.h"                         // Needed for I2C bus
+#include <EEPROM.h>                       // Needed for internal EEPROM R/W
+#include "PetitFS.h"                      // Light handler for FAT16 and FAT32 filesystem on SD
+#include "DefinitionsFile.h"
+#include "Monitor.h"
+#include "FastPin.h"                      // Compile time pin access (fastWrite(), fastRead())
+#include "SDCardFunctions.h"
+#include "BootLoader.h"
+#include "Hibernate.h"
+
+// ------------------------------------------------------------------------------
+// Snapshot stub (Z80 code). For each block IOS gives the high byte of the block
+// address, then 32KB are moved with OTIR (save) or INIR (restore, patched at
+// STUB_XFER_OFS). The stub never ends: IOS stops it after the last block.
+// ------------------------------------------------------------------------------
+const byte  snapStub[] PROGMEM = {
+    0x0E, 0x00,                           // 00 LD   C,0x00        EXECUTE WRITE/READ OPCODE port
+    0x3E, SNAPSHOT_OPCODE,                // 02 LD   A,SNAPSHOT
+    0xD3, 0x01,                           // 04 OUT  (0x01),A      STORE OPCODE
+    0xED, 0x60,                           // 06 IN   H,(C)         High byte of the next block address
+    0x2E, 0x00,                           // 08 LD   L,0x00
+    0x16, 0x80,                           // 0A LD   D,0x80        128 * 256 bytes = 32KB
+    0x06, 0x00,                           // 0C LD   B,0x00
+    0xED, 0xB3,                           // 0E OTIR               Move a 256 bytes block (INIR = ED B2)
+    0x15,                                 // 10 DEC  D
+    0x20, 0xFB,                           // 11 JR   NZ,0x0E
+    0x18, 0xF1                            // 13 JR   0x06
+};
+
+#define STUB_XFER_OFS   0x0F              // Offset of the second byte of OTIR/INIR inside the stub
+#define STUB_OTIR       0xB3
+#define STUB_INIR       0xB2
+#define SNAP_STUB_ADDR  ((word)(0x10000UL - sizeof(snapStub)))  // Stub position (top of the common bank)
+#define SNAP_STUB_OFS   (SNAP_STUB_ADDR - 0x8000)               // Stub offset inside the common block
+
+#define SNAP_HDR_SIZE   29                // Used bytes of the header sector
+
+// ------------------------------------------------------------------------------
+// Select the RAM bank of a block (see the SETBANK opcode). The common block
+// (the last one) is always mapped in the upper half, so nothing is done.
+// ------------------------------------------------------------------------------
+static void setBankSnap(byte block)
+{
+    switch (block)
+    {
+        case 0:                               // Os bank 0
+            fastWrite(BANK0, HIGH);
+            fastWrite(BANK1, LOW);
+            break;
+
+        case 1:                               // Os bank 1
+            fastWrite(BANK0, HIGH);
+            fastWrite(BANK1, HIGH);
+            break;
+
+        case 2:                               // Os bank 2
+            fastWrite(BANK0, LOW);
+            fastWrite(BANK1, HIGH);
+            break;
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Reopen the "disk file" of "diskName" after the snapshot file used its slot, and
+// set the disk state as it was
+// ------------------------------------------------------------------------------
+static void reopenDiskSnap(byte prevErr)
+{
+    byte  errcode;
+
+    selectFileSD(DISKFILE_SD);
+    errcode = openSD(diskName);
+    if (!errcode)
+    {
+        contigDiskSD(((diskName[4] - '0') * 10) + (diskName[5] - '0'));
+    }
+    diskErr = prevErr ? prevErr : errcode;
+}
+
+// ------------------------------------------------------------------------------
+// Select the bank of a block and serve the "block address" request of the stub.
+// Returns 1 if the stub is answering as expected
+// ------------------------------------------------------------------------------
+static byte startBlockSnap(byte block)
+{
+    setBankSnap(block);
+    if (!waitIoZ80() || fastRead(RD_))
+    {
+        return 0;
+    }
+    ioReadDoneZ80((block < (SNAP_BLOCKS - 1)) ? 0x00 : 0x80);
+    return 1;
+}
+
+// ------------------------------------------------------------------------------
+// Save the whole RAM into HIBERNFN. Called while the Z80 waits on the HIBERNATE
+// I/O request:
+// *  "entryAddr" is the address to jump to on resume;
+// *  "clkMode" is the Z80 clock speed mode used to run the stub (see startZ80Clock()).
+// The returned value is 0 if the snapshot is saved, an SD error code (see printErrSD())
+//  or SNAP_NOSTUB.
+//
+// NOTE1: The snapshot file is created if it does not exist, but it is better to
+//        preallocate it (tools/mbc2img hibern), so that no cluster is allocated here.
+// NOTE2: In any case at the end the Z80 is reset, with all the RAM and the bank as
+//        before, and HL and PC = "entryAddr" (clock stopped): the caller starts
+//        the clock, and the program goes on from the entry address.
+// ------------------------------------------------------------------------------
+byte hibernateZ80(word entryAddr, byte clkMode)
+{
+    byte  sectBuf[512];                   // Current SD sector
+    byte  saved[sizeof(snapStub)];        // RAM bytes under the stub
+    byte  stub[sizeof(snapStub)];
+    byte  bankPins;
+    byte  block;
+    byte  value;
+    word  i;
+    byte  errcode;
+
+    // Stop the Z80 and keep the bank selection
+    bankPins = (fastRead(BANK1) << 1) | fastRead(BANK0);
+    haltZ80();
+
+    // Open the snapshot file (created if needed) and invalidate the old snapshot
+    selectFileSD(DISKFILE_SD);
+    errcode = openSD(HIBERNFN);
+    if (errcode == FR_NO_FILE)
+    {
+        errcode = createSD(HIBERNFN);
+    }
+    if (!errcode && (filesysSD.fsize < SNAP_SIZE))
+    {
+        errcode = extendSD(SNAP_SIZE);
+    }
+    if (!errcode)
+    {
+        memset(sectBuf, 0, sizeof(sectBuf));
+        errcode = seekSD(0);
+        if (!errcode)
+        {
+            errcode = writeSectSD(sectBuf);
+        }
+    }
+
+    if (!errcode)
+    {
+        // Keep the RAM under the stub, then run it
+        for (i = 0; i < sizeof(saved); i++)
+        {
+            saved[i] = readByteFromRAM(SNAP_STUB_ADDR + i);
+        }
+        memcpy_P(stub, snapStub, sizeof(snapStub));
+        stub[STUB_XFER_OFS] = STUB_OTIR;
+        runStubZ80(SNAP_STUB_ADDR, stub, sizeof(stub), clkMode);
+
+        // Serve the STORE OPCODE of the stub, then every block
+        if (waitIoZ80() && !fastRead(WR_) && (PINA == SNAPSHOT_OPCODE))
+        {
+            ioWriteDoneZ80();
+            for (block = 0; (block < SNAP_BLOCKS) && !errcode; block++)
+            {
+                if (!startBlockSnap(block))
+                {
+                    errcode = SNAP_NOSTUB;
+                    break;
+                }
+                for (i = 0; i < 0x8000; i++)
+                {
+                    if (!waitIoZ80() || fastRead(WR_))
+                    {
+                        errcode = SNAP_NOSTUB;
+                        break;
+                    }
+                    value = PINA;
+                    ioWriteDoneZ80();
+                    if ((block == (SNAP_BLOCKS - 1)) && (i >= SNAP_STUB_OFS))
+                    {
+                        value = saved[i - SNAP_STUB_OFS];   // The stub itself
+                    }
+                    sectBuf[i & 0x1FF] = value;
+                    if ((i & 0x1FF) == 0x1FF)
+                    {
+                        errcode = writeSectSD(sectBuf);
+                        if (errcode)
+                        {
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        else
+        {
+            errcode = SNAP_NOSTUB;
+        }
+
+        // Back to the hand made clock, and put back the RAM under the stub
+        haltZ80();
+        loadHL(SNAP_STUB_ADDR);
+        for (i = 0; i < sizeof(saved); i++)
+        {
+            writeByteToRAM(saved[i]);
+        }
+    }
+
+    // Write the header, so the snapshot is valid only if it is complete
+    if (!errcode)
+    {
+        memset(sectBuf, 0, sizeof(sectBuf));
+        memcpy(sectBuf, "MBC2SNAP", 8);
+        sectBuf[8]  = SNAP_VERSION;
+        sectBuf[9]  = bankPins;
+        sectBuf[10] = lowByte(entryAddr);
+        sectBuf[11] = highByte(entryAddr);
+        sectBuf[12] = Z80IntEnFlag;
+        sectBuf[13] = diskSet;
+        sectBuf[14] = diskErr;
+        sectBuf[15] = lowByte(trackSel);
+        sectBuf[16] = highByte(trackSel);
+        sectBuf[17] = sectSel;
+        memcpy(&sectBuf[18], diskName, sizeof(diskName));
+        errcode = seekSD(0);
+        if (!errcode)
+        {
+            errcode = writeSectSD(sectBuf);
+        }
+    }
+
+    // Restore the bank and the "disk file", and set the entry address
+    fastWrite(BANK0, bankPins & 0x01);
+    fastWrite(BANK1, (bankPins >> 1) & 0x01);
+    reopenDiskSnap(diskErr);
+    loadHL(entryAddr);
+    jumpToHL();
+    return errcode;
+}
+
+// ------------------------------------------------------------------------------
+// Restore the whole RAM from HIBERNFN (the Z80 must be reset, with the hand made clock):
+// *  "clkMode" is the Z80 clock speed mode used to run the stub (see startZ80Clock()).
+// The returned value is 0 if the snapshot is restored, SNAP_INVALID if there is no
+//  valid snapshot, an SD error code (see printErrSD()) or SNAP_NOSTUB.
+//
+// NOTE: If the returned value is 0, the bank, the Z80 INT_ flag, the Disk Set and the
+//       "disk file" are set as at the hibernation and PC = the entry address (clock
+//       stopped, so the caller must start it without a Z80 reset).
+//       Otherwise the Z80 is reset and the RAM content is undefined.
+// ------------------------------------------------------------------------------
+byte resumeZ80(byte clkMode)
+{
+    byte  sectBuf[512];                   // Current SD sector
+    byte  header[SNAP_HDR_SIZE];
+    byte  saved[sizeof(snapStub)];        // Snapshot bytes under the stub
+    byte  stub[sizeof(snapStub)];
+    word  numBytes;
+    byte  block;
+    byte  value;
+    word  i;
+    byte  errcode;
+
+    // Open the snapshot file and check the header
+    selectFileSD(DISKFILE_SD);
+    errcode = openSD(HIBERNFN);
+    if (!errcode)
+    {
+        errcode = readBlockSD(sectBuf, sizeof(sectBuf), &numBytes);
+    }
+    if (!errcode && ((numBytes < sizeof(sectBuf)) || (filesysSD.fsize < SNAP_SIZE) ||
+        memcmp(sectBuf, "MBC2SNAP", 8) || (sectBuf[8] != SNAP_VERSION)))
+    {
+        errcode = SNAP_INVALID;
+    }
+    if (errcode)
+    {
+        return errcode;
+    }
+    memcpy(header, sectBuf, sizeof(header));
+
+    // Run the stub and serve the STORE OPCODE, then every block
+    memcpy_P(stub, snapStub, sizeof(snapStub));
+    stub[STUB_XFER_OFS] = STUB_INIR;
+    runStubZ80(SNAP_STUB_ADDR, stub, sizeof(stub), clkMode);
+    if (waitIoZ80() && !fastRead(WR_) && (PINA == SNAPSHOT_OPCODE))
+    {
+        ioWriteDoneZ80();
+        for (block = 0; (block < SNAP_BLOCKS) && !errcode; block++)
+        {
+            if (!startBlockSnap(block))
+            {
+                errcode = SNAP_NOSTUB;
+                break;
+            }
+            for (i = 0; i < 0x8000; i++)
+            {
+                if (!(i & 0x1FF))
+                {
+                    errcode = readBlockSD(sectBuf, sizeof(sectBuf), &numBytes);
+                    if (!errcode && (numBytes < sizeof(sectBuf)))
+                    {
+                        errcode = SNAP_INVALID;       // Unexpected EOF
+                    }
+                    if (errcode)
+                    {
+                        break;
+                    }
+                }
+                value = sectBuf[i & 0x1FF];
+                if ((block == (SNAP_BLOCKS - 1)) && (i >= SNAP_STUB_OFS))
+                {
+                    saved[i - SNAP_STUB_OFS] = value; // Do not overwrite the running stub
+                    value = stub[i - SNAP_STUB_OFS];
+                }
+                if (!waitIoZ80() || fastRead(RD_))
+                {
+                    errcode = SNAP_NOSTUB;
+                    break;
+                }
+                ioReadDoneZ80(value);
+            }
+        }
+        if (!errcode && !waitIoZ80())         // The last byte is stored when the stub asks a new block
+        {
+            errcode = SNAP_NOSTUB;
+        }
+    }
+    else
+    {
+        errcode = SNAP_NOSTUB;
+    }
+
+    // Back to the hand made clock
+    haltZ80();
+    if (errcode)
+    {
+        return errcode;
+    }
+
+    // Put the snapshot bytes under the stub, set the saved state and the entry address
+    loadHL(SNAP_STUB_ADDR);
+    for (i = 0; i < sizeof(saved); i++)
+    {
+        writeByteToRAM(saved[i]);
+    }
+    fastWrite(BANK0, header[9] & 0x01);
+    fastWrite(BANK1, (header[9] >> 1) & 0x01);
+    Z80IntEnFlag = header[12];
+    diskSet = header[13];
+    trackSel = header[15] | (header[16] << 8);
+    sectSel = header[17];
+    memcpy(diskName, &header[18], sizeof(diskName));
+    reopenDiskSnap(header[14]);
+    loadHL(header[10] | (header[11] << 8));
+    jumpToHL();
+    return 0;
+}
+
+// end of source file
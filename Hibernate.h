@@ -0,0 +1,45 @@
+/*
+ * Hibernate.h
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ */ 
+
+
+#ifndef HIBERNATE_H_
+#define HIBERNATE_H_
+
+#ifdef __cplusplus
+extern "C" {
+    #endif
+
+// ------------------------------------------------------------------------------
+// Definitions
+// ------------------------------------------------------------------------------
+#define SNAPSHOT_OPCODE     0x8C        // I/O opcode used by the snapshot stub to move the RAM blocks
+#define SNAP_VERSION        1
+#define SNAP_BLOCKS         4           // 32KB blocks: Os Bank 0, 1, 2 (lower half) and common (upper half)
+#define SNAP_SIZE           (512 + (SNAP_BLOCKS * 32768UL)) // Header sector + RAM blocks
+#define SNAP_INVALID        20          // resumeZ80() result: no valid snapshot in HIBERNFN
+#define SNAP_NOSTUB         21          // hibernateZ80()/resumeZ80() result: the stub is not answering
+
+// ------------------------------------------------------------------------------
+// HIBERNFN layout:
+//  sector 0  : header, "MBC2SNAP" + version (1 byte) + BANK1/BANK0 levels (bit 1/bit 0) +
+//              entry address (2 bytes, LSB first) + Z80IntEnFlag + diskSet + diskErr + 
+//              trackSel (2 bytes, LSB first) + sectSel + diskName (11 bytes)
+//  sector 1..: the RAM blocks in the SNAP_BLOCKS order, 64 sectors each
+// ------------------------------------------------------------------------------
+
+// ------------------------------------------------------------------------------
+// Function Prototypes
+// ------------------------------------------------------------------------------
+byte    hibernateZ80(word entryAddr, byte clkMode);
+byte    resumeZ80(byte clkMode);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* HIBERNATE_H_ */
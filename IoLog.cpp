@@ -0,0 +1,301 @@
+/*
+ * IoLog.cpp
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * I/O sessions log (see IoLog.h). The session in progress is kept in ioLogCur by
+ * ioLogStore()/ioLogByte(), called by loop() after the Z80 is released (for the
+ * requests served by the WAIT_ ISR, from the events it queued), and ended into the record buffer being filled at the next STORE OPCODE.
+ * There are two sector buffers: while one is written to SD by ioLogFlush() the
+ * other one is filled. When both are full the records are counted as lost and not
+ * waited for, as the Z80 must not be slowed down by the log.
+ * The sectors are written with writeRawSD(), so the open files are not disturbed;
+ * a sector is never written in the middle of a WRITESECT or FILEWRITE (see there).
+ */
+
+#include <avr/pgmspace.h>                 // Needed for PROGMEM
+#include <avr/interrupt.h>
+#include "Wire.h"                         // Needed for I2C bus
+#include <EEPROM.h>                       // Needed for internal EEPROM R/W
+#include "PetitFS.h"                      // Light handler for FAT16 and FAT32 filesystem on SD
+#include "DefinitionsFile.h"
+#include "SDCardFunctions.h"
+#include "IoProfile.h"
+#include "IoLog.h"
+
+#if IO_LOG
+struct IoLogSect
+{
+    IoLogHead       head;
+    IoLogRec        rec[ILOG_RECS];
+};
+
+typedef char ioLogSectSize[(sizeof(IoLogSect) == 512) ? 1 : -1];    // One sector exactly
+
+byte                    ioLogOn;
+
+static IoLogSect        ioLogBuf[2];    // Sector buffers
+static byte             ioLogFill;      // Buffer being filled
+static byte             ioLogFull[2];   // Set to 1 when a buffer is full, until it is written
+static byte             ioLogDirty;     // Set to 1 when the buffer being filled has records not written yet
+static IoLogRec         ioLogCur;       // Session in progress
+static byte             ioLogCurOn;     // Set to 1 if ioLogCur is valid
+static unsigned long    ioLogLast;      // ioProfNow() at the last data byte of the session in progress
+static unsigned long    ioLogLost;      // Records lost
+static unsigned long    ioLogFirst;     // First sector of IOLOG_FILE on SD
+static unsigned long    ioLogSects;     // Size of IOLOG_FILE (sectors)
+static unsigned long    ioLogTime;      // millis() at the last sector written
+
+// ------------------------------------------------------------------------------
+// The buffer being filled is full: go on with the other one, if it was written
+//  and the log file is not full. Interrupts must be disabled.
+// ------------------------------------------------------------------------------
+static void ioLogNext(void)
+{
+    IoLogSect   *s = &ioLogBuf[ioLogFill];
+    IoLogSect   *n = &ioLogBuf[ioLogFill ^ 1];
+
+    if (ioLogFull[ioLogFill ^ 1] || ((unsigned long)s->head.index + 1 >= ioLogSects))
+    {
+        return;
+    }
+    n->head.index = s->head.index + 1;
+    n->head.recs = 0;
+    ioLogFill ^= 1;
+}
+
+// ------------------------------------------------------------------------------
+// End the session in progress: merge it with the last record if equal (SERIAL TX
+//  only by the number of bytes, summing the data), otherwise add a new record.
+//  Interrupts must be disabled.
+// ------------------------------------------------------------------------------
+static void ioLogEnd(void)
+{
+    IoLogSect       *s = &ioLogBuf[ioLogFill];
+    IoLogRec        *r;
+    unsigned long   t;
+
+    if (!ioLogCurOn || !ioLogCur.bytes)
+    {
+        return;                                 // Nothing exchanged
+    }
+    if (ioLogFull[ioLogFill] || (s->head.recs == ILOG_RECS))
+    {
+        ioLogLost++;                            // Both buffers full, or log file full
+        return;
+    }
+    t = (ioLogLast - ioLogCur.time) >> 4;
+    ioLogCur.duration = (t > 0xFFFF) ? 0xFFFF : t;
+    if (s->head.recs)
+    {
+        r = &s->rec[s->head.recs - 1];
+        if ((r->repeat < 255) && (r->opcode == ioLogCur.opcode) && (r->bytes == ioLogCur.bytes)
+            && ((ioLogCur.opcode == 0x01) || ((r->sum == ioLogCur.sum) && !memcmp(r->param, ioLogCur.param, ILOG_PARAMS))))
+        {
+            r->repeat++;
+            if (ioLogCur.opcode == 0x01)
+            {
+                r->sum += ioLogCur.sum;
+            }
+            t = (unsigned long)r->duration + ioLogCur.duration;
+            r->duration = (t > 0xFFFF) ? 0xFFFF : t;
+            ioLogDirty = 1;
+            return;
+        }
+    }
+    s->rec[s->head.recs++] = ioLogCur;
+    ioLogDirty = 1;
+    if (s->head.recs == ILOG_RECS)
+    {
+        ioLogFull[ioLogFill] = 1;
+        ioLogDirty = 0;
+        ioLogNext();
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Start the log, if IOLOG_FILE is there and contiguous. Called when the Z80 starts
+//  (after startIoProf()); a log already running (warm boot) goes on.
+// ------------------------------------------------------------------------------
+void startIoLog(void)
+{
+    IoLogHead   head;
+    byte        errcode;
+    byte        i;
+
+    if (ioLogOn)
+    {
+        return;
+    }
+    errcode = contigFileSD(IOLOG_FILE, &ioLogFirst, &ioLogSects);
+    if (!errcode && !ioLogSects)
+    {
+        errcode = FR_DENIED;                    // Empty file
+    }
+    if (!errcode)
+    {
+        errcode = readRawSD(&head, ioLogFirst, 0, sizeof(head));
+    }
+    if (errcode)
+    {
+        printErrSD(1, errcode, IOLOG_FILE);
+        Serial.println(F("IOS: I/O log off"));
+        return;
+    }
+    memset(ioLogBuf, 0, sizeof(ioLogBuf));
+    for (i = 0; i < 2; i++)
+    {
+        memcpy(ioLogBuf[i].head.magic, "ILOG", 4);
+        ioLogBuf[i].head.session = memcmp(head.magic, "ILOG", 4) ? 1 : head.session + 1;
+        ioLogBuf[i].head.version = ILOG_VERSION;
+        ioLogBuf[i].head.mhz = F_CPU / 1000000UL;
+    }
+    ioLogFill = 0;
+    ioLogFull[0] = 0;
+    ioLogFull[1] = 0;
+    ioLogDirty = 0;
+    ioLogCurOn = 0;
+    ioLogLost = 0;
+    ioLogTime = millis();
+    ioLogOn = 1;
+    Serial.print(F("IOS: I/O log on "));
+    Serial.print(F(IOLOG_FILE));
+    Serial.print(F(" (session "));
+    Serial.print(ioLogBuf[0].head.session);
+    Serial.print(F(", "));
+    Serial.print(ioLogSects);
+    Serial.println(F(" sectors)"));
+}
+
+// ------------------------------------------------------------------------------
+// STORE OPCODE: end the session in progress and start a new one
+// ------------------------------------------------------------------------------
+void ioLogStore(byte opcode)
+{
+    byte    sreg = SREG;
+
+    cli();
+    ioLogStoreAt(opcode, ioProfNow());
+    SREG = sreg;
+}
+
+// ------------------------------------------------------------------------------
+// STORE OPCODE served at "time" (ioProfNow()), queued by the WAIT_ ISR
+// ------------------------------------------------------------------------------
+void ioLogStoreAt(byte opcode, unsigned long time)
+{
+    byte    sreg = SREG;
+
+    cli();
+    ioLogEnd();
+    memset(&ioLogCur, 0, sizeof(ioLogCur));
+    ioLogCur.time = time;
+    ioLogCur.opcode = opcode;
+    ioLogCur.repeat = 1;
+    ioLogLast = ioLogCur.time;
+    ioLogCurOn = 1;
+    SREG = sreg;
+}
+
+// ------------------------------------------------------------------------------
+// A data byte of the session in progress (written by the Z80 or read by it)
+// ------------------------------------------------------------------------------
+void ioLogByte(byte data)
+{
+    byte    sreg = SREG;
+
+    cli();
+    ioLogByteAt(data, ioProfNow());
+    SREG = sreg;
+}
+
+// ------------------------------------------------------------------------------
+// A data byte exchanged at "time" (ioProfNow()), queued by the WAIT_ ISR
+// ------------------------------------------------------------------------------
+void ioLogByteAt(byte data, unsigned long time)
+{
+    byte    sreg = SREG;
+
+    cli();
+    if (ioLogCur.bytes < ILOG_PARAMS)
+    {
+        ioLogCur.param[ioLogCur.bytes] = data;
+    }
+    if (ioLogCur.bytes < 0xFFFF)
+    {
+        ioLogCur.bytes++;
+    }
+    ioLogCur.sum += data;
+    ioLogLast = time;
+    SREG = sreg;
+}
+
+// ------------------------------------------------------------------------------
+// Write a full buffer, or the one being filled every ILOG_FLUSH_MS if it has new
+//  records. Called by loop() when no I/O request is pending. A write error stops
+//  the log and is returned (0 otherwise), so loop() can print it keeping the WAIT_
+//  ISR away from Serial.
+// A session idle for ILOG_FLUSH_MS is ended first, so the last one before the Z80
+//  stops doing I/O is written too (data bytes coming after that are not logged).
+// ------------------------------------------------------------------------------
+byte ioLogFlush(void)
+{
+    byte    b = ioLogFill ^ 1;                  // The older buffer first
+    byte    errcode;
+
+    cli();
+    if (ioLogCurOn && ((ioProfNow() - ioLogLast) >= ILOG_FLUSH_MS * (F_CPU / 1000UL)))
+    {
+        ioLogEnd();
+        ioLogCurOn = 0;
+    }
+    sei();
+    if (!ioLogFull[b])
+    {
+        b ^= 1;
+        if (!ioLogFull[b] && !(ioLogDirty && ((millis() - ioLogTime) >= ILOG_FLUSH_MS)))
+        {
+            return 0;
+        }
+    }
+    cli();
+    ioLogBuf[b].head.lost = ioLogLost;
+    if (!ioLogFull[b])
+    {
+        ioLogDirty = 0;                         // Records added from now on are written next time
+    }
+    sei();
+    errcode = writeRawSD(&ioLogBuf[b], ioLogFirst + ioLogBuf[b].head.index);
+    if (errcode == FR_NOT_READY)
+    {
+        ioLogDirty = 1;                         // SD busy with a sector write of the Z80: retry later
+        return 0;
+    }
+    if (errcode)
+    {
+        ioLogOn = 0;
+        return errcode;
+    }
+    ioLogTime = millis();
+    cli();
+    if (ioLogFull[b])
+    {
+        ioLogFull[b] = 0;
+        if (ioLogBuf[ioLogFill].head.recs == ILOG_RECS)
+        {
+            ioLogNext();                        // The filled one was waiting for this one
+        }
+    }
+    sei();
+    return 0;
+}
+
+#else
+
+void startIoLog(void)
+{
+    Serial.println(F("IOS: I/O log not available (IO_LOG = 0)"));
+}
+
+#endif
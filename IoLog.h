@@ -0,0 +1,111 @@
+/*
+ * IoLog.h
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * I/O sessions log. When enabled from the boot menu every opcode session of the Z80
+ * (a STORE OPCODE and the data bytes exchanged after it) is recorded with its start
+ * time, duration, first data bytes and a checksum of all the data, and written into
+ * the preallocated contiguous file IOLOG_FILE on SD (see "mbc2img iolog"). The
+ * records are collected in RAM buffers of one sector, and a full buffer is written
+ * by loop() while no I/O request is pending, so the Z80 never waits for the log.
+ * The host tool ioreplay (host/ioreplay.cpp) replays a log against the firmware.
+ *
+ * NOTE: Include it after DefinitionsFile.h and IoProfile.h (ioProfNow()).
+ */
+
+
+#ifndef IOLOG_H_
+#define IOLOG_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef IO_LOG
+#define IO_LOG              IO_TIMEBASE // Set to 0 to compile out the I/O sessions log (compiled in only
+#endif                                  //  with IO_PROFILE or IO_TRACE set, so off by default)
+#if IO_LOG && !IO_TIMEBASE
+#error "IO_LOG needs the Timer1 timebase (IO_PROFILE or IO_TRACE)"
+#endif
+
+// ------------------------------------------------------------------------------
+// IOLOG_FILE layout, one 512 bytes sector after the other:
+//  bytes  0..15 : header (IoLogHead)
+//  bytes 16..511: ILOG_RECS records (IoLogRec), "recs" of them valid
+// A log is the run of sectors from sector 0 with the same "session" and "index"
+//  counting from 0. Each new log (first I/O request after a power on or a reset)
+//  takes the session of the previous one plus 1, so the old sectors after its end
+//  are not read as part of it.
+// ------------------------------------------------------------------------------
+#define IOLOG_FILE          "IOLOG.DAT"
+#define ILOG_VERSION        1
+#define ILOG_RECS           31          // Records per sector
+#define ILOG_PARAMS         4           // Data bytes kept in a record (the first ones of the session)
+#define ILOG_FLUSH_MS       1000        // A partially filled sector is written after this time (ms)
+
+struct IoLogHead
+{
+    char            magic[4];           // "ILOG"
+    uint16_t        session;            // Log number
+    uint16_t        index;              // Sector of the log [0..]
+    uint8_t         recs;               // Valid records in this sector
+    uint8_t         version;            // ILOG_VERSION
+    uint8_t         mhz;                // MCU clock (MHz): time unit of IoLogRec.time
+    uint8_t         reserved;
+    uint32_t        lost;               // Records lost so far (both buffers full or log file full)
+};
+
+struct IoLogRec
+{
+    uint32_t        time;               // ioProfNow() at the STORE OPCODE (MCU cycles, 32 bit wrap around)
+    uint8_t         opcode;             // Stored opcode
+    uint8_t         repeat;             // Equal sessions in a row merged in this record [1..255]
+    uint16_t        bytes;              // Data bytes exchanged (saturated at 0xFFFF)
+    uint8_t         param[ILOG_PARAMS]; // First data bytes (0 if less)
+    uint16_t        sum;                // Sum of all the data bytes (mod 0x10000)
+    uint16_t        duration;           // STORE OPCODE to the last data byte (written by the Z80 or served
+                                        //  to it), 16 MCU cycles units (1us @ 16MHz), of all the merged
+                                        //  sessions (saturated)
+};
+
+#if IO_LOG
+// ------------------------------------------------------------------------------
+// Externals
+// ------------------------------------------------------------------------------
+extern byte             ioLogOn;        // Set to 1 while the sessions are logged
+
+#define IOLOG_START()       startIoLog()
+#define IOLOG_STORE(opcode) { if (ioLogOn) ioLogStore(opcode); }
+#define IOLOG_BYTE(data)    { if (ioLogOn) ioLogByte(data); }
+#define IOLOG_STORE_AT(opcode, time)    { if (ioLogOn) ioLogStoreAt(opcode, time); }
+#define IOLOG_BYTE_AT(data, time)       { if (ioLogOn) ioLogByteAt(data, time); }
+#define IOLOG_FLUSH()       (ioLogOn ? ioLogFlush() : 0)
+#else
+#define IOLOG_START()       startIoLog()
+#define IOLOG_STORE(opcode)
+#define IOLOG_BYTE(data)
+#define IOLOG_STORE_AT(opcode, time)
+#define IOLOG_BYTE_AT(data, time)
+#define IOLOG_FLUSH()       0
+#endif
+
+// ------------------------------------------------------------------------------
+// Function Prototypes
+// ------------------------------------------------------------------------------
+void    startIoLog(void);
+void    ioLogStore(byte opcode);
+void    ioLogByte(byte data);
+void    ioLogStoreAt(byte opcode, unsigned long time);
+void    ioLogByteAt(byte data, unsigned long time);
+byte    ioLogFlush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* IOLOG_H_ */
@@ -0,0 +1,400 @@
+/*
+ * IoProfile.cpp
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * Z80 I/O requests profiler (see IoProfile.h). Timer1 runs free at the MCU clock and
+ * its overflows extend it to 32 bit, so a request is timed with the MCU cycle
+ * resolution (1/16us @ 16MHz) without disturbing the Timer0 of millis()/micros().
+ * The statistics are kept in a .noinit area and cleared when the Z80 starts, so those
+ * of the last run are still there after a reset (not after a power cycle). The same
+ * holds for the I/O events trace, a ring buffer written by loop() after each request
+ * it served and by the WAIT_ ISR after each opcode session it served (not for the
+ * buffered data bytes of READSECT/WRITESECT/FILELOAD, that would fill it at once).
+ * A frozen trace is not cleared when the Z80 starts, so it is kept until printed.
+ */
+
+#include <avr/pgmspace.h>                 // Needed for PROGMEM
+#include <avr/interrupt.h>
+#include "Wire.h"                         // Needed for I2C bus
+#include <EEPROM.h>                       // Needed for internal EEPROM R/W
+#include "PetitFS.h"                      // Light handler for FAT16 and FAT32 filesystem on SD
+#include "DefinitionsFile.h"
+#include "Monitor.h"
+#include "SDCardFunctions.h"
+#include "IoProfile.h"
+
+#if IO_PROFILE
+#define IOP_MAGIC       0x50F1      // Marks valid statistics in the .noinit area
+
+struct IoProfData
+{
+    word            magic;          // IOP_MAGIC if valid
+    IoProfSlot      slot[IOP_SLOTS];
+};
+
+static IoProfData       ioProf __attribute__ ((section (".noinit")));
+
+byte                    ioProfCur = IOP_NONE;
+unsigned long           ioProfStart;
+#endif
+
+#if IO_TRACE
+#define IOT_MAGIC       0x7E4A      // Marks a valid trace in the .noinit area
+
+struct IoTraceBuf
+{
+    word            magic;          // IOT_MAGIC if valid
+    byte            head;           // Next event to write
+    byte            frozen;         // Set to 1 if no events are recorded
+    unsigned long   total;          // Events recorded (also the lost ones)
+    IoEvent         event[IOT_EVENTS];
+};
+
+static IoTraceBuf       ioTraceBuf __attribute__ ((section (".noinit")));
+#endif
+
+#if IO_TIMEBASE
+word                    ioProfHigh;
+
+// ------------------------------------------------------------------------------
+// Timer1 overflow: high word of the 32 bit cycles counter
+// ------------------------------------------------------------------------------
+ISR(TIMER1_OVF_vect)
+{
+    ioProfHigh++;
+}
+#endif
+
+// ------------------------------------------------------------------------------
+// Start the Timer1 timebase (normal mode, no prescaler) and clear the statistics
+// and the I/O events trace (if not frozen). Called when the Z80 starts.
+// ------------------------------------------------------------------------------
+void startIoProf(void)
+{
+#if IO_TIMEBASE
+    cli();
+    TCCR1A = 0;
+    TCCR1B = (1 << CS10);
+    TCCR1C = 0;
+    TCNT1 = 0;
+    TIFR1 = (1 << TOV1);                // Clear a pending overflow
+    TIMSK1 = (1 << TOIE1);
+    ioProfHigh = 0;
+#if IO_PROFILE
+    ioProfCur = IOP_NONE;
+    memset(&ioProf, 0, sizeof(ioProf));
+    ioProf.magic = IOP_MAGIC;
+#endif
+#if IO_TRACE
+    if ((ioTraceBuf.magic != IOT_MAGIC) || (ioTraceBuf.head >= IOT_EVENTS) || !ioTraceBuf.frozen)
+    {
+        memset(&ioTraceBuf, 0, sizeof(ioTraceBuf));
+        ioTraceBuf.magic = IOT_MAGIC;
+    }
+#endif
+    sei();
+#endif
+}
+
+#if IO_PROFILE
+
+// ------------------------------------------------------------------------------
+// Account the request started by IOPROF_START() (called just before the release of
+// the Z80 wait state, with the interrupts disabled)
+// ------------------------------------------------------------------------------
+void ioProfEnd(void)
+{
+    byte    slot = ioProfCur;
+
+    ioProfCur = IOP_NONE;
+    ioProfAdd(slot, ioProfNow() - ioProfStart);
+}
+
+// ------------------------------------------------------------------------------
+// Account a request of "cycles" MCU cycles in "slot" (nothing if IOP_NONE). Used by
+// ioProfEnd() and for the requests served by the WAIT_ ISR, queued as events.
+// ------------------------------------------------------------------------------
+void ioProfAdd(byte slot, unsigned long cycles)
+{
+    IoProfSlot      *s;
+    byte            bucket = 0;
+
+    if (slot >= IOP_SLOTS)
+    {
+        return;
+    }
+    s = &ioProf.slot[slot];
+    if (!s->count || (cycles < s->minCycles))
+    {
+        s->minCycles = cycles;
+    }
+    if (cycles > s->maxCycles)
+    {
+        s->maxCycles = cycles;
+    }
+    s->count++;
+    for (cycles >>= 5; cycles && (bucket < (IOP_BUCKETS - 1)); cycles >>= 1)
+    {
+        bucket++;
+    }
+    if (s->hist[bucket] != 0xFFFF)
+    {
+        s->hist[bucket]++;
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Byte "index" of the statistics as sent by the IOPROFILE opcode (the slots in
+// sequence, every field LSB first)
+// ------------------------------------------------------------------------------
+byte ioProfByte(word index)
+{
+    if (index >= IOP_DATASIZE)
+    {
+        return 0;
+    }
+    return ((const byte *) ioProf.slot)[index];
+}
+
+// ------------------------------------------------------------------------------
+// Print the statistics (of the last run if called from the boot menu). Only the
+// slots with at least one request are printed.
+// ------------------------------------------------------------------------------
+void printIoProf(void)
+{
+    const IoProfSlot    *s;
+    byte                i, j;
+
+    Serial.print(F("IOS: I/O profile of the last run (MCU cycles, "));
+    Serial.print(F_CPU / 1000000UL);
+    Serial.println(F(" = 1us)"));
+    if (ioProf.magic != IOP_MAGIC)
+    {
+        Serial.println(F("     not available"));
+        return;
+    }
+    Serial.println(F("  Request    Count  Min  Max  Histogram (bucket:count, bucket n >= 2^(n+4) cycles)"));
+    for (i = 0; i < IOP_SLOTS; i++)
+    {
+        s = &ioProf.slot[i];
+        if (!s->count)
+        {
+            continue;
+        }
+        Serial.print(F("  "));
+        if (i < IO_WR_OPCODES)
+        {
+            Serial.print(F("Wr 0x"));
+            if (i < 0x10)
+            {
+                Serial.print("0");
+            }
+            Serial.print(i, HEX);
+        }
+        else if (i < IOP_STORE)
+        {
+            Serial.print(F("Rd 0x"));
+            Serial.print(i - IO_WR_OPCODES + 0x80, HEX);
+        }
+        else if (i == IOP_STORE)
+        {
+            Serial.print(F("Store"));
+        }
+        else if (i == IOP_SERIALRX)
+        {
+            Serial.print(F("Ser.Rx"));
+        }
+        else
+        {
+            Serial.print(F("Other"));
+        }
+        Serial.print(F("  "));
+        Serial.print(s->count);
+        Serial.print(F("  "));
+        Serial.print(s->minCycles);
+        Serial.print(F("  "));
+        Serial.print(s->maxCycles);
+        Serial.print(F(" "));
+        for (j = 0; j < IOP_BUCKETS; j++)
+        {
+            if (s->hist[j])
+            {
+                Serial.print(F(" "));
+                Serial.print(j);
+                Serial.print(F(":"));
+                Serial.print(s->hist[j]);
+            }
+        }
+        Serial.println();
+    }
+}
+
+#else
+
+void ioProfEnd(void)
+{
+}
+
+void ioProfAdd(byte slot, unsigned long cycles)
+{
+}
+
+byte ioProfByte(word index)
+{
+    return 0;
+}
+
+void printIoProf(void)
+{
+    Serial.println(F("IOS: I/O profile not available (IO_PROFILE = 0)"));
+}
+
+#endif
+
+#if IO_TRACE
+// ------------------------------------------------------------------------------
+// Record an I/O event (called by loop() after a request was served). The disk
+// selection and the error are taken from the current state.
+// ------------------------------------------------------------------------------
+void ioTrace(byte flags, byte opcode, word byteCnt)
+{
+    unsigned long   time;
+    byte            sreg = SREG;
+
+    cli();                              // ioProfNow() needs it
+    time = ioProfNow();
+    SREG = sreg;
+    ioTraceAt(flags, opcode, byteCnt, time);
+}
+
+// ------------------------------------------------------------------------------
+// Record an I/O event served at "time" (ioProfNow()). Used by ioTrace() and for the
+// requests served by the WAIT_ ISR, queued as events and recorded by loop().
+// ------------------------------------------------------------------------------
+void ioTraceAt(byte flags, byte opcode, word byteCnt, unsigned long time)
+{
+    IoEvent     *e;
+
+    if (ioTraceBuf.frozen)
+    {
+        return;
+    }
+    e = &ioTraceBuf.event[ioTraceBuf.head];
+    e->time = time;
+    e->opcode = opcode;
+    e->flags = flags;
+    e->byteCnt = byteCnt;
+    e->track = trackSel;
+    e->sect = sectSel;
+    e->err = diskErr;
+    ioTraceBuf.head = (ioTraceBuf.head + 1) & (IOT_EVENTS - 1);
+    ioTraceBuf.total++;
+}
+
+// ------------------------------------------------------------------------------
+// Stop (freeze = 1) or restart (freeze = 0) the recording of the I/O events.
+// Returns the previous state.
+// ------------------------------------------------------------------------------
+byte freezeIoTrace(byte freeze)
+{
+    byte    frozen = ioTraceBuf.frozen;
+
+    ioTraceBuf.frozen = freeze;
+    return frozen;
+}
+
+// ------------------------------------------------------------------------------
+// Print the I/O events trace, oldest first. For each event are printed the time
+// from the previous one (us), the request (W/R/I, * if served by the WAIT_ ISR,
+// opcode, STORE and the stored opcode, or RX) with the bytes counter, and the disk
+// track, sector and error after the request.
+// The recording is frozen meanwhile.
+// ------------------------------------------------------------------------------
+void printIoTrace(void)
+{
+    const IoEvent   *e;
+    unsigned long   prevTime;
+    byte            frozen;
+    byte            count, i, idx;
+
+    Serial.println(F("IOS: I/O events trace (oldest first, * = served by the WAIT_ ISR)"));
+    if ((ioTraceBuf.magic != IOT_MAGIC) || (ioTraceBuf.head >= IOT_EVENTS))
+    {
+        Serial.println(F("     not available"));
+        return;
+    }
+    frozen = freezeIoTrace(1);
+    count = (ioTraceBuf.total < IOT_EVENTS) ? ioTraceBuf.total : IOT_EVENTS;
+    idx = (ioTraceBuf.head - count) & (IOT_EVENTS - 1);
+    prevTime = ioTraceBuf.event[idx].time;
+    Serial.print(F("  "));
+    Serial.print(ioTraceBuf.total);
+    Serial.print(F(" events"));
+    if (frozen)
+    {
+        Serial.print(F(" (frozen)"));
+    }
+    Serial.println(F(",  +us  req  opcode  cnt  track  sect  err"));
+    for (i = 0; i < count; i++)
+    {
+        e = &ioTraceBuf.event[idx];
+        Serial.print(F("  +"));
+        Serial.print((e->time - prevTime) / (F_CPU / 1000000UL));
+        Serial.print((e->flags & IOT_INT) ? F("  I") : (e->flags & IOT_READ) ? F("  R") : F("  W"));
+        Serial.print((e->flags & IOT_ISR) ? F("* ") : F("  "));
+        if ((e->flags & IOT_AD0) && (e->flags & IOT_READ))
+        {
+            Serial.print(F("RX"));
+        }
+        else
+        {
+            if (e->flags & IOT_AD0)
+            {
+                Serial.print(F("STORE "));
+            }
+            Serial.print(F("0x"));
+            if (e->opcode < 0x10)
+            {
+                Serial.print("0");
+            }
+            Serial.print(e->opcode, HEX);
+        }
+        Serial.print(F("  "));
+        Serial.print(e->byteCnt);
+        Serial.print(F("  "));
+        Serial.print(e->track);
+        Serial.print(F("  "));
+        Serial.print(e->sect);
+        Serial.print(F("  "));
+        Serial.println(e->err);
+        prevTime = e->time;
+        idx = (idx + 1) & (IOT_EVENTS - 1);
+    }
+    freezeIoTrace(frozen);
+}
+
+#else
+
+void ioTrace(byte flags, byte opcode, word byteCnt)
+{
+}
+
+void ioTraceAt(byte flags, byte opcode, word byteCnt, unsigned long time)
+{
+}
+
+byte freezeIoTrace(byte freeze)
+{
+    return 0;
+}
+
+void printIoTrace(void)
+{
+    Serial.println(F("IOS: I/O events trace not available (IO_TRACE = 0)"));
+}
+
+#endif
+
+// end of source file
@@ -0,0 +1,161 @@
+/*
+ * IoProfile.h
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * Z80 I/O requests profiler. The time from the WAIT_ detection to the release of the
+ * wait state is taken with Timer1 (MCU cycles) for every I/O request and accumulated
+ * per opcode (count, min, max and a log2 histogram). The data are read by the Z80
+ * with the IOPROFILE opcode, and those of the last run are printed by the boot menu.
+ * The requests served by loop() (the slow ones: SD, I2C...) and the opcode sessions
+ * served by the WAIT_ ISR (STORE OPCODE, SERIAL TX/RX, USER LED, TIMER) are also
+ * recorded in a ring buffer of I/O events (the latter by loop(), from the events
+ * queued by the ISR), to see the sequence of operations of the Z80 OS. A short press of the USER key freezes it and prints it (see loop()); a
+ * frozen trace is kept, also across a reset, until the next short press restarts it.
+ *
+ * NOTE: Include it after DefinitionsFile.h (IO_WR_OPCODES, IO_RD_OPCODES).
+ */
+
+
+#ifndef IOPROFILE_H_
+#define IOPROFILE_H_
+
+#include <avr/io.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef IO_PROFILE
+#define IO_PROFILE          0           // Set to 1 to compile in the profiler (1.9KB of .noinit)
+#endif
+#ifndef IO_TRACE
+#define IO_TRACE            0           // Set to 1 to compile in the I/O events trace (776 bytes of .noinit)
+#endif
+#define IO_TIMEBASE         (IO_PROFILE || IO_TRACE)    // Timer1 needed
+
+// ------------------------------------------------------------------------------
+// Profiled I/O requests (slots): the write opcodes, then the read opcodes, then
+// these ones
+// ------------------------------------------------------------------------------
+#define IOP_STORE           (IO_WR_OPCODES + IO_RD_OPCODES) // STORE OPCODE
+#define IOP_SERIALRX        (IOP_STORE + 1)                 // SERIAL RX
+#define IOP_OTHER           (IOP_STORE + 2)                 // "No operation", not defined opcodes, interrupt cycles
+#define IOP_SLOTS           (IOP_STORE + 3)
+#define IOP_NONE            0xFF                            // No request being profiled
+
+#define IOP_BUCKETS         16          // Histogram: bucket 0 counts the requests under 32 cycles, bucket n
+                                        //  those of [2^(n+4), 2^(n+5)) cycles, the last one all the longer ones
+
+struct IoProfSlot
+{
+    unsigned long   count;              // Served requests
+    unsigned long   minCycles;          // Shortest (MCU cycles)
+    unsigned long   maxCycles;          // Longest (MCU cycles)
+    word            hist[IOP_BUCKETS];  // log2 histogram (saturated at 0xFFFF)
+};
+
+#define IOP_DATASIZE        (IO_PROFILE ? IOP_SLOTS * sizeof(struct IoProfSlot) : 0) // IOPROFILE data bytes
+
+// ------------------------------------------------------------------------------
+// I/O events trace
+// ------------------------------------------------------------------------------
+#define IOT_EVENTS          64          // Ring buffer size (events, power of 2)
+
+#define IOT_WRITE           0x00        // IoEvent.flags: I/O write
+#define IOT_READ            0x01        //  I/O read
+#define IOT_INT             0x02        //  interrupt cycle
+#define IOT_ISR             0x40        //  served by the WAIT_ ISR
+#define IOT_AD0             0x80        //  I/O address 0x01 (STORE OPCODE, SERIAL RX)
+
+struct IoEvent
+{
+    unsigned long   time;               // ioProfNow() after the request was served
+    byte            opcode;             // ioOpcode when the request came
+    byte            flags;              // IOT_xxx
+    word            byteCnt;            // ioByteCnt when the request came
+    word            track;              // trackSel after the request
+    byte            sect;               // sectSel after the request
+    byte            err;                // diskErr after the request
+};
+
+#if IO_TIMEBASE
+// ------------------------------------------------------------------------------
+// Externals
+// ------------------------------------------------------------------------------
+extern word             ioProfHigh;     // Timer1 overflows (high word of ioProfNow())
+
+// ------------------------------------------------------------------------------
+// MCU cycles from startIoProf() (32 bit, Timer1 + overflows). Interrupts must be
+// disabled.
+// ------------------------------------------------------------------------------
+static inline unsigned long ioProfNow(void)
+{
+    word    low = TCNT1;
+    word    high = ioProfHigh;
+
+    if ((TIFR1 & (1 << TOV1)) && (low < 0x8000))
+    {
+        high++;                         // Overflow not served yet
+    }
+    return ((unsigned long) high << 16) | low;
+}
+#endif
+
+#if IO_PROFILE
+extern byte             ioProfCur;      // Slot of the request being served (IOP_NONE if none)
+extern unsigned long    ioProfStart;    // ioProfNow() at the WAIT_ detection
+
+// Slot of an EXECUTE WRITE/READ OPCODE request
+static inline byte ioProfSlot(byte opcode)
+{
+    if (opcode < IO_WR_OPCODES)
+    {
+        return opcode;
+    }
+    if ((byte)(opcode - 0x80) < IO_RD_OPCODES)
+    {
+        return IO_WR_OPCODES + opcode - 0x80;
+    }
+    return IOP_OTHER;
+}
+
+#define IOPROF_START(slot)  { ioProfStart = ioProfNow(); ioProfCur = (slot); }
+#define IOPROF_END()        ioProfEnd()
+#define IOPROF_CANCEL()     { ioProfCur = IOP_NONE; }
+#define IOPROF_ADD(slot, cycles)    ioProfAdd(slot, cycles)
+#else
+#define IOPROF_START(slot)
+#define IOPROF_END()
+#define IOPROF_CANCEL()
+#define IOPROF_ADD(slot, cycles)
+#endif
+
+#if IO_TRACE
+#define IOTRACE(flags, opcode, byteCnt)     ioTrace(flags, opcode, byteCnt)
+#define IOTRACE_AT(flags, opcode, byteCnt, time)    ioTraceAt(flags, opcode, byteCnt, time)
+#else
+#define IOTRACE(flags, opcode, byteCnt)     { (void)(opcode); (void)(byteCnt); }
+#define IOTRACE_AT(flags, opcode, byteCnt, time)
+#endif
+
+// ------------------------------------------------------------------------------
+// Function Prototypes
+// ------------------------------------------------------------------------------
+void    startIoProf(void);
+void    ioProfEnd(void);
+void    ioProfAdd(byte slot, unsigned long cycles);
+byte    ioProfByte(word index);
+void    printIoProf(void);
+void    ioTrace(byte flags, byte opcode, word byteCnt);
+void    ioTraceAt(byte flags, byte opcode, word byteCnt, unsigned long time);
+byte    freezeIoTrace(byte freeze);
+void    printIoTrace(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* IOPROFILE_H_ */
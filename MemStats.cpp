@@ -0,0 +1,149 @@
+/*
+ * MemStats.cpp
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * SRAM usage report (see MemStats.h). paintStack() runs in the .init3 section,
+ * after the stack pointer is set and before .data/.bss are initialized and the
+ * constructors (new String...) run, so the whole RAM above the static areas is
+ * painted. The high water mark is found scanning up from the heap top to the
+ * first byte that is not MEM_PAINT (a pushed byte equal to it is missed, so it is
+ * a few bytes optimistic at most).
+ */
+
+#include <avr/pgmspace.h>                 // Needed for PROGMEM
+#include <avr/interrupt.h>
+#include "Wire.h"                         // Needed for I2C bus
+#include "DefinitionsFile.h"
+#include "MemStats.h"
+
+#if MEM_STATS
+static MemReport        memLatch;       // Report sent by the MEMSTATS opcode
+
+#ifdef __AVR__
+struct __freelist
+{
+    size_t              sz;
+    struct __freelist   *nx;
+};
+
+extern char             __data_start, __data_end;
+extern char             __bss_start, __bss_end;
+extern char             __noinit_start, __noinit_end;
+extern char             __heap_start;
+extern char             *__brkval;      // malloc() break (0 = never used)
+extern struct __freelist *__flp;        // malloc() free list
+
+// ------------------------------------------------------------------------------
+// Fill the RAM from the end of the static areas to the stack with MEM_PAINT.
+//  Nothing is on the stack yet, and no register must be saved (naked).
+// ------------------------------------------------------------------------------
+void paintStack(void) __attribute__ ((naked, used, section (".init3")));
+
+void paintStack(void)
+{
+    byte    *p = (byte *) &__heap_start;
+
+    while (p < (byte *) SP)
+    {
+        *p++ = MEM_PAINT;
+    }
+}
+#endif
+#endif
+
+// ------------------------------------------------------------------------------
+// Take the SRAM usage now
+// ------------------------------------------------------------------------------
+void readMemStats(struct MemReport *rep)
+{
+    memset(rep, 0, sizeof(*rep));
+#if MEM_STATS && defined(__AVR__)
+    const struct __freelist *f;
+    char                    *top = __brkval ? __brkval : &__heap_start;
+    char                    *sp = (char *) SP;
+    char                    *p;
+
+    rep->dataSize = &__data_end - &__data_start;
+    rep->bssSize = &__bss_end - &__bss_start;
+    rep->noinitSize = &__noinit_end - &__noinit_start;
+    rep->heapSize = top - &__heap_start;
+    for (f = __flp; f; f = f->nx)
+    {
+        rep->heapFree += f->sz + sizeof(size_t);
+    }
+    p = top;
+    while ((p < sp) && (*p == (char) MEM_PAINT))
+    {
+        p++;                                    // Never used
+    }
+    rep->stackNow = RAMEND - (word) sp;
+    rep->stackMax = RAMEND + 1 - (word) p;
+    rep->freeNow = sp - top;
+    rep->freeMin = p - top;
+#endif
+}
+
+// ------------------------------------------------------------------------------
+// MEMSTATS: take the report sent by memStatsByte() (first data byte)
+// ------------------------------------------------------------------------------
+void latchMemStats(void)
+{
+#if MEM_STATS
+    readMemStats(&memLatch);
+#endif
+}
+
+uint8_t memStatsByte(uint16_t index)
+{
+    if (index >= MEM_DATASIZE)
+    {
+        return 0;
+    }
+#if MEM_STATS
+    return ((const byte *) &memLatch)[index];
+#else
+    return 0;
+#endif
+}
+
+// ------------------------------------------------------------------------------
+// Print the SRAM usage now (the stack high water mark since the reset)
+// ------------------------------------------------------------------------------
+void printMemStats(void)
+{
+#if MEM_STATS
+    MemReport   rep;
+
+    readMemStats(&rep);
+    Serial.print(F("IOS: SRAM usage (bytes of "));
+    Serial.print(RAMEND - RAMSTART + 1);
+    Serial.println(F(")"));
+#ifndef __AVR__
+    Serial.println(F("     not available"));
+    return;
+#endif
+    Serial.print(F("  .data "));
+    Serial.print(rep.dataSize);
+    Serial.print(F(", .bss "));
+    Serial.print(rep.bssSize);
+    Serial.print(F(", .noinit "));
+    Serial.println(rep.noinitSize);
+    Serial.print(F("  Heap "));
+    Serial.print(rep.heapSize);
+    Serial.print(F(" (free list "));
+    Serial.print(rep.heapFree);
+    Serial.println(F(")"));
+    Serial.print(F("  Stack now "));
+    Serial.print(rep.stackNow);
+    Serial.print(F(", max "));
+    Serial.println(rep.stackMax);
+    Serial.print(F("  Free now "));
+    Serial.print(rep.freeNow);
+    Serial.print(F(", never used "));
+    Serial.println(rep.freeMin);
+#else
+    Serial.println(F("IOS: SRAM usage compiled out (MEM_STATS)"));
+#endif
+}
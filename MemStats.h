@@ -0,0 +1,62 @@
+/*
+ * MemStats.h
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * SRAM usage report. The static areas (.data, .bss, .noinit) are taken from the
+ * linker symbols, the heap from the malloc() break and free list (the String
+ * objects of SD_ERROR_RETRY and of the Monitor disassembler live there), and the
+ * stack high water mark from the stack painting: at every reset, before the
+ * variables are initialized, the RAM between the heap and the stack is filled
+ * with MEM_PAINT, so the bytes still holding it were never used. Read by the Z80
+ * with the MEMSTATS opcode and printed by the boot menu.
+ *
+ * NOTE: Only the AVR build has the SRAM layout (all 0 on the host build)
+ */
+
+
+#ifndef MEMSTATS_H_
+#define MEMSTATS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MEM_STATS
+#define MEM_STATS           1           // Set to 0 to compile out the stack painting and the report
+#endif
+
+#define MEM_PAINT           0xA5        // Stack painting value
+
+struct MemReport
+{
+    uint16_t        dataSize;           // .data: initialized variables (string literals not in PROGMEM too)
+    uint16_t        bssSize;            // .bss: zeroed variables
+    uint16_t        noinitSize;         // .noinit: statistics kept across a reset
+    uint16_t        heapSize;           // Heap (0 = malloc() never used)
+    uint16_t        heapFree;           //  of it in the free list
+    uint16_t        stackNow;           // Stack in use now
+    uint16_t        stackMax;           // Stack high water mark since the reset
+    uint16_t        freeNow;            // Free RAM now, between the heap and the stack
+    uint16_t        freeMin;            // Free RAM never used since the reset
+};
+
+#define MEM_DATASIZE        (MEM_STATS ? sizeof(struct MemReport) : 0)  // MEMSTATS data bytes
+
+// ------------------------------------------------------------------------------
+// Function Prototypes
+// ------------------------------------------------------------------------------
+void    readMemStats(struct MemReport *rep);
+void    latchMemStats(void);
+uint8_t memStatsByte(uint16_t index);
+void    printMemStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* MEMSTATS_H_ */
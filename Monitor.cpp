@@ -19,7 +19,10 @@
 #include "PetitFS.h"                      // Light handler for FAT16 and FAT32 filesystem on SD
 #include "integer.h"
 #include "Monitor.h"
+#include "FastPin.h"                      // Compile time pin access (fastWrite(), fastRead())
 #include "Generic.h"
+#include "DefinitionsFile.h"
+#include "IoProfile.h"                    // I/O events trace of the last run
 
 // Used by assemble and disassemble
 const char *table_r[8]        = { "B",  "C",  "D",  "E", "H", "L", "(HL)", "A"};
@@ -46,6 +49,7 @@ const char *sixteenBitValue   = "nn";
 
 
 byte Z80IntEnFlag   = 0;         // Z80 INT_ enable flag (0 = No INT_ used, 1 = INT_ used for I/O)
+byte ioReadHold     = 255;       // _delay_loop_1() count of IO_READ_HOLD_CLK at the current Z80 clock
 
 // Z80 Instruction encoding and decoding - drawn from http://www.z80.info/decoding.htm#cb
 byte X;     // mask %11000000
@@ -60,12 +64,12 @@ enum INSTRUCTION_TYPE { LOAD = 0, BLOCK, ALU, ROTATENSHIFT, BIT, PROGRAMFLOW, IO
 enum ADDRESSING_MODE { IMM = 0, IEX,   MPZ, REL, EXT, IND, REG, IMP, RIN, BAD };
 
 
-typedef struct TOKEN_STRUCT{ char *token;
-                             INSTRUCTION_TYPE type;
-                             ADDRESSING_MODE  mode;
-                             byte cycles; };
+struct TOKEN_STRUCT{ char *token;
+                     INSTRUCTION_TYPE type;
+                     ADDRESSING_MODE  mode;
+                     byte cycles; };
 
-typedef struct LABEL_STRUCT { char *name; word address; LABEL_STRUCT *next;};
+struct LABEL_STRUCT { char *name; word address; LABEL_STRUCT *next;};
 
 // this token list 
 const char *tokens[] = {};
@@ -80,8 +84,8 @@ void pulseClock(byte numPulse)
     for (i = 0; i < numPulse; i++)
     {
         // Send one impulse (1-0) on the CLK output
-        digitalWrite(CLK, HIGH);
-        digitalWrite(CLK, LOW);
+        fastWrite(CLK, HIGH);
+        fastWrite(CLK, LOW);
     }
 }
 
@@ -101,7 +105,7 @@ void writeByteToRAM(byte value)
      // Execute the LD(HL),n instruction (T = 4+3+3). See the Z80 datasheet and manual.
      // After the execution of this instruction the <value> byte is loaded in the memory address pointed by HL.
      pulseClock(1);                      // Execute the T1 cycle of M1 (Opcode Fetch machine cycle)
-     digitalWrite(RAM_CE2, LOW);         // Force the RAM in HiZ (CE2 = LOW)
+     fastWrite(RAM_CE2, LOW);            // Force the RAM in HiZ (CE2 = LOW)
      DDRA = 0xFF;                        // Configure Z80 data bus D0-D7 (PA0-PA7) as output
      PORTA = LD_HL;                      // Write "LD (HL), n" opcode on data bus
      pulseClock(2);                      // Execute T2 and T3 cycles of M1
@@ -114,19 +118,19 @@ void writeByteToRAM(byte value)
      pulseClock(2);                      // Execute the T2 and T3 cycles of the Memory Read machine cycle
      DDRA = 0x00;                        // Configure Z80 data bus D0-D7 (PA0-PA7) as input...
      PORTA = 0xFF;                       // ...with pull-up
-     digitalWrite(RAM_CE2, HIGH);        // Enable the RAM again (CE2 = HIGH)
+     fastWrite(RAM_CE2, HIGH);           // Enable the RAM again (CE2 = HIGH)
      pulseClock(3);                      // Execute all the following Memory Write machine cycle
 
      // Execute the INC(HL) instruction (T = 6). See the Z80 datasheet and manual.
      // After the execution of this instruction HL points to the next memory address.
      pulseClock(1);                      // Execute the T1 cycle of M1 (Opcode Fetch machine cycle)
-     digitalWrite(RAM_CE2, LOW);         // Force the RAM in HiZ (CE2 = LOW)
+     fastWrite(RAM_CE2, LOW);            // Force the RAM in HiZ (CE2 = LOW)
      DDRA = 0xFF;                        // Configure Z80 data bus D0-D7 (PA0-PA7) as output
      PORTA = INC_HL;                     // Write "INC(HL)" opcode on data bus
      pulseClock(2);                      // Execute T2 and T3 cycles of M1
      DDRA = 0x00;                        // Configure Z80 data bus D0-D7 (PA0-PA7) as input...
      PORTA = 0xFF;                       // ...with pull-up
-     digitalWrite(RAM_CE2, HIGH);        // Enable the RAM again (CE2 = HIGH)
+     fastWrite(RAM_CE2, HIGH);           // Enable the RAM again (CE2 = HIGH)
      pulseClock(3);                      // Execute all the remaining T cycles
 }
 
@@ -140,7 +144,7 @@ void loadHL(word value)
     // Execute the LD dd,nn instruction (T = 4+3+3), with dd = HL and nn = value. See the Z80 datasheet and manual.
     // After the execution of this instruction the word "value" (16bit) is loaded into HL.
     pulseClock(1);                      // Execute the T1 cycle of M1 (Opcode Fetch machine cycle)
-    digitalWrite(RAM_CE2, LOW);         // Force the RAM in HiZ (CE2 = LOW)
+    fastWrite(RAM_CE2, LOW);            // Force the RAM in HiZ (CE2 = LOW)
     DDRA  = 0xFF;                       // Configure Z80 data bus D0-D7 (PA0-PA7) as output
     PORTA = LD_HLnn;                    // Write "LD HL, n" opcode on data bus
     pulseClock(2);                      // Execute T2 and T3 cycles of M1
@@ -156,24 +160,81 @@ void loadHL(word value)
     pulseClock(2);                      // Execute the T2 and T3 cycles of the second Memory Read machine cycle
     DDRA  = 0x00;                       // Configure Z80 data bus D0-D7 (PA0-PA7) as input...
     PORTA = 0xFF;                       // ...with pull-up
-    digitalWrite(RAM_CE2, HIGH);        // Enable the RAM again (CE2 = HIGH)
+    fastWrite(RAM_CE2, HIGH);           // Enable the RAM again (CE2 = HIGH)
  }
 
 
+// ------------------------------------------------------------------------------
+// Jump to the address held in HL, using the "JP (HL)" instruction forced on the data bus.
+// After it the Z80 fetches the following opcodes from RAM, starting at that address.
+// In the following "T" are the T-cycles of the Z80 (See the Z80 datasheet).
+// ------------------------------------------------------------------------------
+void jumpToHL(void)
+{
+    // Execute the JP (HL) instruction (T = 4). See the Z80 datasheet and manual.
+    pulseClock(1);                      // Execute the T1 cycle of M1 (Opcode Fetch machine cycle)
+    fastWrite(RAM_CE2, LOW);            // Force the RAM in HiZ (CE2 = LOW)
+    DDRA  = 0xFF;                       // Configure Z80 data bus D0-D7 (PA0-PA7) as output
+    PORTA = JP_HL;                      // Write "JP (HL)" opcode on data bus
+    pulseClock(2);                      // Execute T2 and T3 cycles of M1
+    DDRA  = 0x00;                       // Configure Z80 data bus D0-D7 (PA0-PA7) as input...
+    PORTA = 0xFF;                       // ...with pull-up
+    fastWrite(RAM_CE2, HIGH);           // Enable the RAM again (CE2 = HIGH)
+    pulseClock(1);                      // Execute the T4 cycle of M1
+}
+
+
+// ------------------------------------------------------------------------------
+// Start the Z80 clock generated by Timer2 (registers as per Atmel1284(p)).
+// Z80 clock_freq = (Atmega_clock) / ((OCR2 + 1) * 2), so "clkMode" = 0 gives 8MHz
+// and "clkMode" = 1 gives 4MHz (@ Fosc = 16MHz)
+// ------------------------------------------------------------------------------
+void startZ80Clock(byte clkMode)
+{
+    ASSR &=    ~(1 << AS2);                 // Set Timer2 clock from system clock
+    TCCR2B |=   (1 << CS20);                // Set Timer2 clock to "no prescaling"
+    TCCR2B &= ~((1 << CS21) | (1 << CS22));
+    TCCR2A |=   (1 << WGM21);               // Set Timer2 CTC mode
+    TCCR2A &=  ~(1 << WGM20);
+    TCCR2A |=   (1 << COM2A0);              // Set "toggle OC2 on compare match"
+    TCCR2A &=  ~(1 << COM2A1);
+    OCR2A = clkMode;                        // Set the compare value to toggle OC2 (0 = low or 1 = high)
+    pinMode(CLK, OUTPUT);                   // Set OC2 as output and start to output the clock
+
+    // A Z80 clock is 2 * (OCR2A + 1) MCU cycles. The delay loop takes 3 cycles for each count,
+    //  and about 3 more cycles are spent around it (see holdIoReadZ80())
+    ioReadHold = (IO_READ_HOLD_CLK * 2 * (clkMode + 1) - 1) / 3;
+}
+
+
+// ------------------------------------------------------------------------------
+// Stop the Timer2 Z80 clock and give the CLK pin back to pulseClock() (steady LOW)
+// ------------------------------------------------------------------------------
+void stopZ80Clock(void)
+{
+    TCCR2A &= ~((1 << COM2A0) | (1 << COM2A1));         // Disconnect OC2 from the CLK pin
+    TCCR2B &= ~((1 << CS20) | (1 << CS21) | (1 << CS22)); // Stop Timer2
+    fastWrite(CLK, LOW);
+}
+
+
 // ------------------------------------------------------------------------------
 // Reset the Z80 CPU using single pulses clock
 // ------------------------------------------------------------------------------
 void singlePulsesResetZ80()
 {
-    digitalWrite(RESET_, LOW);          // Set RESET_ active
+    fastWrite(RESET_, LOW);             // Set RESET_ active
     pulseClock(6);                      // Generate twice the needed clock pulses to reset the Z80
-    digitalWrite(RESET_, HIGH);         // Set RESET_ not active
+    fastWrite(RESET_, HIGH);            // Set RESET_ not active
     pulseClock(2);                      // Needed two more clock pulses after RESET_ goes HIGH
 }
 
 
 // ------------------------------------------------------------------------------
-// put the byte pointed to by HL register pair onto the Data Bus
+// Read the byte at "address" from RAM, using the "LD A,(HL)" instruction forced on
+// the data bus after a loadHL(). The byte is sampled on the data bus during the
+// Memory Read machine cycle, while the RAM drives it.
+// In the following "T" are the T-cycles of the Z80 (See the Z80 datasheet).
 // ------------------------------------------------------------------------------
 byte readByteFromRAM( word address )
 {
@@ -181,21 +242,20 @@ byte readByteFromRAM( word address )
 
     loadHL( address );          // set where we're looking
 
-    // Execute the LD A,(HL) instruction (T = 4+3+3). See the Z80 datasheet and manual.
-    // After the execution of this instruction the <value> byte is loaded in the memory address pointed by HL.
+    // Execute the LD A,(HL) instruction (T = 4+3). See the Z80 datasheet and manual.
     pulseClock(1);              // Execute the T1 cycle of M1 (Opcode Fetch machine cycle)
-    digitalWrite(RAM_CE2, LOW); // Force the RAM in HiZ (CE2 = LOW)
+    fastWrite(RAM_CE2, LOW);    // Force the RAM in HiZ (CE2 = LOW)
     DDRA = 0xFF;                // Configure Z80 data bus D0-D7 (PA0-PA7) as output
     PORTA = LD_A_HL;            // Write "LD A,(HL)" opcode on data bus
     pulseClock(2);              // Execute T2 and T3 cycles of M1
     DDRA = 0x00;                // Configure Z80 data bus D0-D7 (PA0-PA7) as input...
     PORTA = 0xFF;               // ...with pull-up
-    pulseClock(2);              // Complete the execution of M1 and execute the T1 cycle of the following
-
-    rtn_val = PORTA;            // see what is currently on the data bus
-    pulseClock(2);              // Complete the execution of M1 and execute the T1 cycle of the following
+    fastWrite(RAM_CE2, HIGH);// Enable the RAM again (CE2 = HIGH)
+    pulseClock(2);              // Complete the execution of M1 and execute the T1 cycle of the Memory Read
+    pulseClock(1);              // Execute the T2 cycle of the Memory Read (now the RAM drives the data bus)
 
-    Serial.printf("Byte data %02X", rtn_val );
+    rtn_val = PINA;             // Read the byte on the data bus
+    pulseClock(1);              // Execute the T3 cycle of the Memory Read
 
     return( rtn_val );
 }
@@ -607,8 +667,10 @@ byte decodeUnprefixed( String *rtnString, uint16_t &address )
  // ------------------------------------------------------------------------------
  // Decode DD or FD prefixed instructions
  // ------------------------------------------------------------------------------
- byte decodeDDFD( String *rtnString, uint16_t address, char *IndexRegister )
+ byte decodeDDFD( String *rtnString, uint16_t address, const char *IndexRegister )
  {
+     byte   instruction_length = 1;
+     uint16_t start = address;
      byte   item;
      char str[16];
 
@@ -617,9 +679,11 @@ byte decodeUnprefixed( String *rtnString, uint16_t &address )
      {
          // recursion
          rtnString = disassemble( address );
+         instruction_length = address - start;
      }
      else if( item == 0xCB )
      {
+         instruction_length = 3;    // CB, d and the opcode
          item = readByteFromRAM(address + 1);
 
          if( X == 1 )
@@ -653,6 +717,7 @@ byte decodeUnprefixed( String *rtnString, uint16_t &address )
          rtnString->replace( "d", str );
          rtnString->replace( "IX", IndexRegister );
      }
+     return( instruction_length );
  }
  
 
@@ -728,6 +793,8 @@ void monitor()
         Serial.print( code->begin());
         delete(code);
     }
+    Serial.print("\n\r");
+    printIoTrace();                       // What the Z80 was doing before the reset
 }
 
 // end of source file Monitor.cpp
\ No newline at end of file
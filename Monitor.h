@@ -9,6 +9,8 @@
 #ifndef MONITOR_H_
 #define MONITOR_H_
 
+#include <util/delay_basic.h>             // Needed for _delay_loop_1()
+
 #ifdef __cplusplus
 extern "C" {
     #endif
@@ -77,12 +79,27 @@ const byte    LD_HLnn      =  0x21;       // Opcode of the Z80 instruction: LD H
 const byte    JP_nn        =  0xC3;       // Opcode of the Z80 instruction: JP nn
 const byte    LD_A_HL      =  0x7E;       // Opcode of the Z80 instruction: LD A,(HL)
 const byte    LD_HL_A      =  0x77;       // Opcode of the Z80 instruction: LD (HL),A
+const byte    JP_HL        =  0xE9;       // Opcode of the Z80 instruction: JP (HL)
+
+// Z80 clocks the data of an I/O read must stay on the bus after WAIT_ goes HIGH: WAIT_ is sampled on a
+//  CLK falling edge (one clock, plus the setup time), then the data are latched on the falling edge of T3
+#define IO_READ_HOLD_CLK    3
 
 
 // ------------------------------------------------------------------------------
 // Externs
 // ------------------------------------------------------------------------------
 extern byte Z80IntEnFlag;
+extern byte ioReadHold;                   // _delay_loop_1() count of IO_READ_HOLD_CLK (set by startZ80Clock())
+
+// ------------------------------------------------------------------------------
+// Keep the data of an I/O read on the bus until the Z80 latched them (call it just
+//  after WAIT_RES_ goes LOW)
+// ------------------------------------------------------------------------------
+static inline void holdIoReadZ80(void)
+{
+    _delay_loop_1(ioReadHold);
+}
 
 // ------------------------------------------------------------------------------
 // Function Prototypes
@@ -90,6 +107,9 @@ extern byte Z80IntEnFlag;
 void    singlePulsesResetZ80();
 void    loadHL(word value);
 void    pulseClock(byte numPulse);
+void    jumpToHL(void);
+void    startZ80Clock(byte clkMode);
+void    stopZ80Clock(void);
 byte    readByteFromRAM( word address );
 word    read16bitFromRAM( word address );
 void    writeByteToRAM(byte value);
@@ -98,7 +118,7 @@ void    setXYZPQ( byte item );
 byte    decodeUnprefixed( String *rtnString, uint16_t &address );
 byte    decodeCB( String *rtnString, uint16_t &address );
 byte    decodeED( String *rtnString, uint16_t &address );
-byte    decodeDDFD( String *rtnString, uint16_t address, char *IndexRegister );
+byte    decodeDDFD( String *rtnString, uint16_t address, const char *IndexRegister );
 String  *disassemble( uint16_t &address );
 byte    assemble( String *instruction, uint16_t address );
 void    monitor();
@@ -26,7 +26,7 @@ extern unsigned long    timeStamp;                  // Timestamp for led blinkin
 // ------------------------------------------------------------------------------
 void readRTC(byte *second, byte *minute, byte *hour, byte *day, byte *month, byte *year, byte *tempC);
 void writeRTC(byte second, byte minute, byte hour, byte day, byte month, byte year);
-byte autoSetRTC();
+byte autoSetRTC(byte quiet);
 void ChangeRTC();
 
 #ifdef __cplusplus
@@ -252,9 +252,11 @@ void ChangeRTC()
  // ------------------------------------------------------------------------------
  // Check if the DS3231 RTC is present and set the date/time at compile date/time if
  // the RTC "Oscillator Stop Flag" is set (= date/time failure).
- // Return value: 0 if RTC not present, 1 if found.
+ // If "quiet" is not 0 nothing is printed and the user is not asked anything (fast boot).
+ // Return value: 0 if RTC not present, 1 if found, RTC_NEEDSET if found with the
+ //  "Oscillator Stop Flag" set and "quiet" not 0 (call it again when the console is ready).
  // ------------------------------------------------------------------------------
- byte autoSetRTC()
+ byte autoSetRTC(byte quiet)
  {
      byte    OscStopFlag;
 
@@ -263,14 +265,17 @@ void ChangeRTC()
      {
          return 0;      // RTC not found
      }
-     Serial.print("IOS: Found RTC DS3231 Module (");
-     printDateTime(1);
-     Serial.println(")");
+     if (!quiet)
+     {
+         Serial.print("IOS: Found RTC DS3231 Module (");
+         printDateTime(1);
+         Serial.println(")");
 
-     // Print the temperaturefrom the RTC sensor
-     Serial.print("IOS: RTC DS3231 temperature sensor: ");
-     Serial.print((int8_t)tempC);
-     Serial.println("C");
+         // Print the temperaturefrom the RTC sensor
+         Serial.print("IOS: RTC DS3231 temperature sensor: ");
+         Serial.print((int8_t)tempC);
+         Serial.println("C");
+     }
      
      // Read the "Oscillator Stop Flag"
      Wire.beginTransmission(DS3231_RTC);
@@ -279,6 +284,10 @@ void ChangeRTC()
      Wire.requestFrom(DS3231_RTC, 1);
      OscStopFlag = Wire.read() & 0x80;               // Read the "Oscillator Stop Flag"
 
+     if (OscStopFlag && quiet)
+     {
+         return RTC_NEEDSET;
+     }
      if (OscStopFlag)
      {
          // RTC oscillator stopped. RTC must be set at compile date/time
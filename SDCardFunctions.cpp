@@ -15,7 +15,8 @@
  // enter XXXX
  #include "RealTimeClock.h"
  #include "Generic.h"
- #include "SdCardFunctions.h"
+ #include "SDCardFunctions.h"
+ #include "SdStats.h"
 
  // SD disk and CP/M support variables
  FATFS         filesysSD;                  // Filesystem object (PetitFS library)
@@ -37,6 +38,68 @@
  byte          numWriBytes;                // Number of written bytes after a writeSD() call
  byte          diskSet;                    // Current "Disk Set"
 
+ // Host files on SD
+ char          hostName[13];               // Name (8.3 format) of the host file to open/create
+ word          hostSect;                   // Current sector (512 bytes) of the host file
+ unsigned long hostSize;                   // New size of the host file (FILESIZE)
+ unsigned long hostTime;                   // millis() at the last FILEWRITE (see syncHostSD())
+ byte          hostErr         = 4;        // FILE* opcodes resulting error code (NOT_OPENED)
+ DIR           hostDir;                    // Directory object used by the DIRENTRY opcode
+
+ // Contiguous "disk files" (see contigDiskSD())
+ unsigned long mapSectSD;                  // First record sector of DSKMAP.DAT (0 = no valid disk map)
+ byte          contigSD[13];               // Disks of the current Disk Set already checked as contiguous (1 bit each)
+
+ // SD layer statistics (see SdStats.h). Kept in a .noinit area as the I/O profile, so the
+ //  boot menu can print those of the last run
+#if SD_STATS
+ #define SDS_MAGIC     0x5D57                // Marks valid statistics in the .noinit area
+
+ struct SdCounters sdCnt __attribute__ ((section (".noinit")));
+ static word   sdCntMagic __attribute__ ((section (".noinit")));
+ unsigned long sdBusyStart;                // micros() at the start of a card wait
+#endif
+
+ // File slots (see selectFileSD())
+ struct FileSlotSD
+ {
+     byte          flag;
+     unsigned long fptr;
+     unsigned long fsize;
+     CLUST         org_clust;
+     CLUST         curr_clust;
+     unsigned long dsect;
+     unsigned long dir_sect;
+     byte          dir_index;
+     CLUST         tail_clust;
+     CLUST         n_clust;
+ };
+ FileSlotSD    fileSlotSD[4];              // Saved state of the files not in use
+ byte          currFileSD      = DISKFILE_SD; // File slot currently loaded into filesysSD
+
+ // Disk Sets cache (see loadDiskSetsSD())
+ struct DiskSetSD diskSetSD[DS_MAXSETS];
+ static unsigned long dsCacheSD;            // Data area sector of the cached volume (0 = cache not loaded)
+ static unsigned long dsCacheIdSD;          // Serial number of the cached volume
+
+ // Built-in loaders of the Disk Sets 0..3 (used when DSxNAM.DAT doesn't give one)
+ const char    dsLoader0[] PROGMEM = CPMFN;
+ const char    dsLoader1[] PROGMEM = QPMFN;
+ const char    dsLoader2[] PROGMEM = CPM3FN;
+ const char    dsLoader3[] PROGMEM = UCSDFN;
+ const char * const dsLoaderTable[] PROGMEM = { dsLoader0, dsLoader1, dsLoader2, dsLoader3 };
+ const word    dsAddrTable[] PROGMEM = { CPMSTRADDR, QPMSTRADDR, CPM3STRADDR, UCSDSTRADDR };
+ #define DS_BUILTIN    (sizeof(dsAddrTable) / sizeof(dsAddrTable[0]))
+
+ static void loadMapSD(FATFS* fatFs);
+ static void loadDiskSetsSD(FATFS* fatFs, byte errcode);
+
+ // Little endian 32 bit value from a byte buffer
+ static unsigned long ldDwordSD(const byte* p)
+ {
+     return ((unsigned long)p[3] << 24) | ((unsigned long)p[2] << 16) | ((word)p[1] << 8) | p[0];
+ }
+
 
 
  // ------------------------------------------------------------------------------
@@ -52,7 +115,137 @@
  // ------------------------------------------------------------------------------
  byte mountSD(FATFS* fatFs)
  {
-     return pf_mount(fatFs);
+     byte  errcode;
+
+     // Any open file (disk or host) is lost
+     fileSlotSD[DISKFILE_SD].flag = 0;
+     fileSlotSD[HOSTFILE_SD].flag = 0;
+     fileSlotSD[BOOTFILE_SD].flag = 0;
+     fileSlotSD[LOGFILE_SD].flag = 0;
+     currFileSD = DISKFILE_SD;
+     hostDir.sect = 0;
+     mapSectSD = 0;
+     memset(contigSD, 0, sizeof(contigSD));
+     errcode = pf_mount(fatFs);
+     if (!errcode) 
+     {
+         loadMapSD(fatFs);
+     }
+     loadDiskSetsSD(fatFs, errcode);
+     return errcode;
+ }
+
+ // ------------------------------------------------------------------------------
+ // Look for the disk map (DSKMAP.DAT) on the just mounted volume and keep the 
+ //  sector of its first record if it is valid (see SDCardFunctions.h for the layout).
+ //  The map must be contiguous too, so any record can be read directly.
+ // ------------------------------------------------------------------------------
+ static void loadMapSD(FATFS* fatFs)
+ {
+     byte  header[10];
+     UINT  numBytes;
+
+     if (pf_open(DS_MAPFILE))
+     {
+         return;                             // No disk map
+     }
+     if (!pf_read(header, sizeof(header), &numBytes) && (numBytes == sizeof(header))
+         && !memcmp(header, "MBC2DMAP", 8) && (header[8] == DSMAP_VERSION) && (header[9] == fatFs->csize)
+         && (fatFs->fsize >= DSMAP_SIZE) && !pf_contig())
+     {
+         mapSectSD = fatFs->database + ((unsigned long)(fatFs->org_clust - 2) * fatFs->csize) + 1;
+     }
+     fatFs->flag = 0;                        // Close the map file
+ }
+
+ // ------------------------------------------------------------------------------
+ // Fill the Disk Sets cache (diskSetSD[]) from the DSxNAM.DAT files of the just
+ //  mounted volume (see SDCardFunctions.h for the layout). 
+ //  The cache is kept if the volume has the same serial number (set when formatted)
+ //  and data area of the cached one, so the mounts done at every boot (and the
+ //  SDMOUNT opcode) read the files only when the SD is changed, also for another
+ //  card formatted in the same way. If the mount failed only the built-in loaders
+ //  are set.
+ //  A single pass on the root directory finds the existing files, so the missing
+ //  ones don't cost a full directory search each.
+ // ------------------------------------------------------------------------------
+ static void loadDiskSetsSD(FATFS* fatFs, byte errcode)
+ {
+     DIR      dirObj;
+     FILINFO  fileInfo;
+     word     foundSets = 0;                 // Bit n = DSnNAM.DAT found
+     byte     i, j, set;
+     UINT     numBytes;
+
+     if (!errcode && dsCacheSD && (dsCacheSD == fatFs->database) && (dsCacheIdSD == fatFs->vol_id))
+     {
+         return;                             // Same volume, cache still valid
+     }
+     memset(diskSetSD, 0, sizeof(diskSetSD));
+     for (set = 0; set < DS_BUILTIN; set++)
+     {
+         strcpy_P(diskSetSD[set].loader, (const char *)pgm_read_ptr(&dsLoaderTable[set]));
+         diskSetSD[set].strAddr = pgm_read_word(&dsAddrTable[set]);
+     }
+     dsCacheSD = 0;
+     if (errcode || pf_opendir(&dirObj, ""))
+     {
+         return;
+     }
+     while (!pf_readdir(&dirObj, &fileInfo) && dirObj.sect && fileInfo.fname[0])
+     {
+         if ((fileInfo.fname[0] == DS_OSNAME[0]) && (fileInfo.fname[1] == DS_OSNAME[1])
+             && (fileInfo.fname[2] >= '0') && (fileInfo.fname[2] <= '9') && !strcmp(fileInfo.fname + 3, DS_OSNAME + 3))
+         {
+             foundSets |= 1 << (fileInfo.fname[2] - '0');
+         }
+     }
+     for (set = 0; set < DS_MAXSETS; set++)
+     {
+         OsName[2] = set + '0';
+         if (!(foundSets & (1 << set)) || pf_open(OsName) || pf_read(bufferSD, sizeof(bufferSD), &numBytes))
+         {
+             continue;
+         }
+         // OS name, up to the first control char
+         for (i = 0; (i < numBytes) && (bufferSD[i] >= ' '); i++)
+         {
+             if (i < DS_NAMELEN)
+             {
+                 diskSetSD[set].osName[i] = bufferSD[i];
+             }
+         }
+         if ((i >= numBytes) || bufferSD[i++])
+         {
+             continue;                       // No loader given
+         }
+         // Optional loader name (0x00 terminated) and its starting address
+         for (j = i; (j < numBytes) && (j < (i + 12)) && (bufferSD[j] > ' '); j++);
+         if ((j > i) && ((j + 2U) < numBytes) && !bufferSD[j])
+         {
+             memcpy(diskSetSD[set].loader, bufferSD + i, j - i);
+             diskSetSD[set].loader[j - i] = 0;
+             diskSetSD[set].strAddr = bufferSD[j + 1] | (bufferSD[j + 2] << 8);
+         }
+     }
+     fatFs->flag = 0;                        // Close the last DSxNAM.DAT
+     dsCacheSD = fatFs->database;
+     dsCacheIdSD = fatFs->vol_id;
+ }
+
+ // ------------------------------------------------------------------------------
+ // Return the next bootable Disk Set (the one with a loader) after "currSet", 
+ //  wrapping around. If there is no other bootable Disk Set "currSet" is returned.
+ // ------------------------------------------------------------------------------
+ byte nextDiskSetSD(byte currSet)
+ {
+     byte  set = currSet;
+
+     do
+     {
+         set = (set + 1) % DS_MAXSETS;
+     } while ((set != currSet) && !diskSetSD[set].loader[0]);
+     return set;
  }
 
  // ------------------------------------------------------------------------------
@@ -91,6 +284,26 @@
      return errcode;
  }
 
+ // ------------------------------------------------------------------------------
+ // Read a block of bytes from the current position of the opened file on SD:
+ // *  "BuffSD" is the pointer to the block buffer;
+ // *  "numBytes" is the number of bytes to read;
+ // *  "numReadBytes" is the pointer to the variable that stores the number of
+ //    read bytes; if < numBytes (including = 0) an EOF was reached.
+ // The returned value is the resulting status (0 = ok, otherwise see printErrSD())
+ //
+ // NOTE: Reading a whole sector (512 bytes) at once needs a single sector transfer
+ //       from the SD instead of one for each "segment"
+ // ------------------------------------------------------------------------------
+ byte readBlockSD(void* buffSD, word numBytes, word* numReadBytes)
+ {
+     UINT  numBytesRead;
+     byte  errcode;
+     errcode = pf_read(buffSD, numBytes, &numBytesRead);
+     *numReadBytes = (word) numBytesRead;
+     return errcode;
+ }
+
  // ------------------------------------------------------------------------------
  // Write one "segment" (32 bytes) starting from the current sector (512 bytes) of the opened file on SD:
  // *  "BuffSD" is the pointer to the segment buffer;
@@ -122,6 +335,29 @@
      return errcode;
  }
 
+ // ------------------------------------------------------------------------------
+ // Write a whole sector (512 bytes) at the current sector of the opened file on SD,
+ //  finalizing the write operation:
+ // *  "BuffSD" is the pointer to the sector buffer.
+ // The returned value is the resulting status (0 = ok, otherwise see printErrSD()).
+ //  An EOF before the end of the sector gives 19 (as WRITESECT).
+ // ------------------------------------------------------------------------------
+ byte writeSectSD(const void* buffSD)
+ {
+     UINT  numBytes;
+     byte  errcode;
+     errcode = pf_write(buffSD, 512, &numBytes);
+     if (!errcode && (numBytes < 512))
+     {
+         errcode = 19;                           // Reached an unexpected EOF
+     }
+     if (!errcode)
+     {
+         errcode = pf_write(0, 0, &numBytes);    // Finalize write operation
+     }
+     return errcode;
+ }
+
  // ------------------------------------------------------------------------------
  // Set the pointer of the current sector for the current opened file on SD:
  // *  "sectNum" is the sector number to set. First sector is 0.
@@ -139,6 +375,295 @@
  }
 
 
+ // ------------------------------------------------------------------------------
+ // Open a file on SD, creating it (empty) if it does not exist:
+ // *  "fileName" is the pointer to the string holding the file name (8.3 format)
+ // The returned value is the resulting status (0 = ok, otherwise see printErrSD())
+ //
+ // NOTE: The root directory is not stretched, so a DENIED error is returned if it 
+ //       is full
+ // ------------------------------------------------------------------------------
+ byte createSD(const char* fileName)
+ {
+     return pf_create(fileName);
+ }
+
+ // ------------------------------------------------------------------------------
+ // Grow the opened file on SD:
+ // *  "fileSize" is the new file size in bytes. A file is never shrunk.
+ // The returned value is the resulting status (0 = ok, otherwise see printErrSD())
+ //
+ // NOTE 1: New clusters are allocated after the last one of the file, so growing a
+ //         file in one go keeps it contiguous when there is enough free space
+ // NOTE 2: A size within the clusters already allocated is only kept in memory
+ //         (nothing is read or written on SD), the directory entry is updated
+ //         by the next new cluster, syncSD() or truncateSD()
+ // ------------------------------------------------------------------------------
+ byte extendSD(unsigned long fileSize)
+ {
+     return pf_extend(fileSize);
+ }
+
+ // ------------------------------------------------------------------------------
+ // Shrink the opened file on SD, freeing the clusters past its new end:
+ // *  "fileSize" is the new file size in bytes. A file is never grown (see extendSD()).
+ // The directory entry is written now. The returned value is the resulting status
+ //  (0 = ok, otherwise see printErrSD())
+ // ------------------------------------------------------------------------------
+ byte truncateSD(unsigned long fileSize)
+ {
+     return pf_truncate(fileSize);
+ }
+
+ // ------------------------------------------------------------------------------
+ // Write the size of the opened file left pending by extendSD(), if any.
+ // The returned value is the resulting status (0 = ok, otherwise see printErrSD())
+ // ------------------------------------------------------------------------------
+ byte syncSD(void)
+ {
+     return pf_sync();
+ }
+
+ // ------------------------------------------------------------------------------
+ // Write the size of the host file left pending by FILEWRITE once no FILEWRITE was
+ //  done for HOST_SYNC_MS, so a file written by the Z80 and never closed (there is
+ //  no such opcode) gets its right size on SD anyway. Called by loop() while no I/O
+ //  request is pending. Errors are stored into "hostErr".
+ //
+ // NOTE: Nothing is done while a write of the open file is not finalized
+ // ------------------------------------------------------------------------------
+ void syncHostSD(void)
+ {
+     byte  prevFile = currFileSD;
+     byte  flag = (currFileSD == HOSTFILE_SD) ? filesysSD.flag : fileSlotSD[HOSTFILE_SD].flag;
+     byte  errcode;
+
+     if (!(flag & FA__DIRTY) || (filesysSD.flag & FA__WIP) || ((millis() - hostTime) < HOST_SYNC_MS))
+     {
+         return;
+     }
+     selectFileSD(HOSTFILE_SD);
+     errcode = syncSD();
+     if (errcode)
+     {
+         hostErr = errcode;
+     }
+     selectFileSD(prevFile);
+ }
+
+ // ------------------------------------------------------------------------------
+ // Select the file used by openSD(), readSD(), writeSD(), seekSD() ... :
+ // *  "fileSlot" is DISKFILE_SD (the "disk file" opened by SELDISK), HOSTFILE_SD
+ //    (the file opened by FILEOPEN), BOOTFILE_SD (the boot program of a warm boot)
+ //    or LOGFILE_SD (the I/O log file, see contigFileSD()).
+ //
+ // NOTE: A write must be finalized before to select another file
+ // ------------------------------------------------------------------------------
+ void selectFileSD(byte fileSlot)
+ {
+     FileSlotSD *slot;
+
+     if (fileSlot == currFileSD) 
+     {
+         return;
+     }
+
+     // Save the current file state...
+     slot = &fileSlotSD[currFileSD];
+     slot->flag       = filesysSD.flag;
+     slot->fptr       = filesysSD.fptr;
+     slot->fsize      = filesysSD.fsize;
+     slot->org_clust  = filesysSD.org_clust;
+     slot->curr_clust = filesysSD.curr_clust;
+     slot->dsect      = filesysSD.dsect;
+     slot->dir_sect   = filesysSD.dir_sect;
+     slot->dir_index  = filesysSD.dir_index;
+     slot->tail_clust = filesysSD.tail_clust;
+     slot->n_clust    = filesysSD.n_clust;
+
+     // ...and load the new one
+     slot = &fileSlotSD[fileSlot];
+     filesysSD.flag       = slot->flag;
+     filesysSD.fptr       = slot->fptr;
+     filesysSD.fsize      = slot->fsize;
+     filesysSD.org_clust  = slot->org_clust;
+     filesysSD.curr_clust = slot->curr_clust;
+     filesysSD.dsect      = slot->dsect;
+     filesysSD.dir_sect   = slot->dir_sect;
+     filesysSD.dir_index  = slot->dir_index;
+     filesysSD.tail_clust = slot->tail_clust;
+     filesysSD.n_clust    = slot->n_clust;
+     currFileSD = fileSlot;
+ }
+
+ // ------------------------------------------------------------------------------
+ // Enable the "no FAT walk" fast path on the "disk file" just opened by SELDISK:
+ // *  "diskNum" is the disk number [0..99] of the current Disk Set.
+ // The file must match its DSKMAP.DAT record (start cluster and size). The first
+ //  time after a mount its cluster chain is also fully checked with pf_contig(),
+ //  so a file changed on a PC after the map was written is never trusted blindly.
+ //  Otherwise nothing is done and the FAT chain is followed as usual.
+ // ------------------------------------------------------------------------------
+ void contigDiskSD(byte diskNum)
+ {
+     byte  mapRec[8];
+     word  recNum = (diskSet * 100) + diskNum;
+     byte  mask = 1 << (diskNum & 7);
+
+     if (!mapSectSD || disk_readp(mapRec, mapSectSD + (recNum >> 5), (recNum & 31) * DSMAP_RECSIZE, sizeof(mapRec)))
+     {
+         return;
+     }
+     if ((ldDwordSD(mapRec) != filesysSD.org_clust) || (ldDwordSD(mapRec + 4) != filesysSD.fsize))
+     {
+         return;                             // Not the file the map was written for
+     }
+     if (contigSD[diskNum >> 3] & mask)
+     {
+         filesysSD.flag |= FA_CONTIG;        // Already checked since the mount
+     }
+     else if (!pf_contig())
+     {
+         contigSD[diskNum >> 3] |= mask;
+     }
+ }
+
+ // ------------------------------------------------------------------------------
+ // Find the sectors of a contiguous file, to read and write it with readRawSD()
+ //  and writeRawSD() without PetitFS (and without disturbing the open files):
+ // *  "fileName" is the file name (8.3 format);
+ // *  "firstSect" and "numSects" are set to its first sector and size in sectors.
+ // The returned value is the resulting status (0 = ok, otherwise see printErrSD()).
+ //  A fragmented file gives 7 (DENIED).
+ // ------------------------------------------------------------------------------
+ byte contigFileSD(const char* fileName, unsigned long* firstSect, unsigned long* numSects)
+ {
+     byte  prevFile = currFileSD;
+     byte  errcode;
+
+     selectFileSD(LOGFILE_SD);
+     errcode = pf_open(fileName);
+     if (!errcode)
+     {
+         errcode = pf_contig();
+     }
+     if (!errcode)
+     {
+         *firstSect = filesysSD.database + ((unsigned long)(filesysSD.org_clust - 2) * filesysSD.csize);
+         *numSects = filesysSD.fsize >> 9;
+     }
+     filesysSD.flag = 0;                         // Close the file, its sectors are used directly
+     selectFileSD(prevFile);
+     return errcode;
+ }
+
+ // ------------------------------------------------------------------------------
+ // Read a part of a sector on SD (see contigFileSD()):
+ // *  "buffSD" is the destination buffer;
+ // *  "sect" is the sector number on the card;
+ // *  "offset" and "numBytes" select the bytes to read (offset + numBytes <= 512).
+ // The returned value is the resulting status (0 = ok, 1 = DISK_ERR)
+ // ------------------------------------------------------------------------------
+ byte readRawSD(void* buffSD, unsigned long sect, word offset, word numBytes)
+ {
+     return disk_readp((BYTE*)buffSD, sect, offset, numBytes) ? FR_DISK_ERR : FR_OK;
+ }
+
+ // ------------------------------------------------------------------------------
+ // Write a whole sector on SD (see contigFileSD()):
+ // *  "buffSD" is the 512 bytes source buffer;
+ // *  "sect" is the sector number on the card.
+ // The returned value is the resulting status (0 = ok, 1 = DISK_ERR, 2 = NOT_READY)
+ //
+ // NOTE: While a pf_write() of the open file is not finalized (a WRITESECT or
+ //       FILEWRITE in the middle of a sector) the card can't be used, so nothing
+ //       is done and 2 (NOT_READY) is returned: retry later
+ // ------------------------------------------------------------------------------
+ byte writeRawSD(const void* buffSD, unsigned long sect)
+ {
+     if (filesysSD.flag & FA__WIP)
+     {
+         return FR_NOT_READY;
+     }
+     if (disk_writep(0, sect) || disk_writep((const BYTE*)buffSD, 512) || disk_writep(0, 0))
+     {
+         return FR_DISK_ERR;
+     }
+     return FR_OK;
+ }
+
+ // ------------------------------------------------------------------------------
+ // Rewind the root directory listing (see readDirSD()).
+ // The returned value is the resulting status (0 = ok, otherwise see printErrSD())
+ // ------------------------------------------------------------------------------
+ byte openDirSD(void)
+ {
+     return pf_opendir(&hostDir, "");
+ }
+
+ // ------------------------------------------------------------------------------
+ // Read the next root directory entry in a 16 bytes record:
+ // *  "dirEntry" is the pointer to the record buffer:
+ //      bytes  0..10: name and extension in FCB format (space padded, no dot);
+ //                    dirEntry[0] = 0 means no more entries
+ //      byte  11    : FAT attributes (0x10 = directory, 0x01 = read only...)
+ //      bytes 12..15: file size in bytes (LSB first)
+ // The returned value is the resulting status (0 = ok, otherwise see printErrSD())
+ // ------------------------------------------------------------------------------
+ byte readDirSD(byte* dirEntry)
+ {
+     FILINFO fileInfo;
+     byte    errcode;
+     byte    i, j;
+
+     memset(dirEntry, 0, 16);
+     errcode = pf_readdir(&hostDir, &fileInfo);
+     if (errcode || !hostDir.sect || !fileInfo.fname[0]) 
+     {
+         return errcode;                     // Error or end of the directory
+     }
+     memset(dirEntry, ' ', 11);
+     for (i = 0, j = 0; fileInfo.fname[i] && (j < 11); i++)
+     {
+         if (fileInfo.fname[i] == '.') 
+         {
+             j = 8;                          // Extension
+         }
+         else 
+         {
+             dirEntry[j++] = fileInfo.fname[i];
+         }
+     }
+     dirEntry[11] = fileInfo.fattrib;
+     dirEntry[12] = fileInfo.fsize;
+     dirEntry[13] = fileInfo.fsize >> 8;
+     dirEntry[14] = fileInfo.fsize >> 16;
+     dirEntry[15] = fileInfo.fsize >> 24;
+     return errcode;
+ }
+
+ // ------------------------------------------------------------------------------
+ // Timestamp used by PetitFS for the created or modified files (FAT format).
+ // The date/time is read from the RTC, if found. Otherwise 1st Jan 2019 00:00:00
+ //  is used.
+ // ------------------------------------------------------------------------------
+ DWORD get_fattime(void)
+ {
+     byte sec, min, hour, mday, mon, yy, temp;
+
+     if (!foundRTC) 
+     {
+         return ((DWORD)(2019 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+     }
+     readRTC(&sec, &min, &hour, &mday, &mon, &yy, &temp);
+     return ((DWORD)(yy + 20) << 25)         // Year from 1980 (RTC year is from 2000)
+          | ((DWORD)mon << 21)
+          | ((DWORD)mday << 16)
+          | ((DWORD)hour << 11)
+          | ((DWORD)min << 5)
+          | (sec >> 1);
+ }
+
  // ------------------------------------------------------------------------------
  // ------------------------------------------------------------------------------
  void printErrSD(byte opType, byte errCode, const char* fileName)
@@ -158,6 +683,7 @@
              case 4: Serial.print("NOT_OPENED"); break;
              case 5: Serial.print("NOT_ENABLED"); break;
              case 6: Serial.print("NO_FILESYSTEM"); break;
+             case 7: Serial.print("DENIED"); break;
              default: Serial.print("UNKNOWN");
          }
          Serial.print(" on ");
@@ -182,4 +708,274 @@
      }
  }
 
+ // ------------------------------------------------------------------------------
+ // SD card benchmark (boot menu). The scratch "disk file" BENCHSD_FILE is read and
+ //  written one sector at a time as READSECT and WRITESECT do (seekSD(), then 16
+ //  segments with readSD()/writeSD()), so the figures are those the Z80 sees.
+ //  It is created and grown the first time and then kept; if it is contiguous the
+ //  FAT is not walked, as for the "disk files" in DSKMAP.DAT.
+ // ------------------------------------------------------------------------------
+ #define BENCHSD_FILE    "BENCH.DSK"
+ #define BENCHSD_SIZE    1024                  // Scratch file size (sectors, 512KB)
+ #define BENCHSD_SEQ     256                   // Sectors of the sequential tests (128KB)
+ #define BENCHSD_RANDOM  128                   // Sectors of the random tests
+
+ static word   benchRndSD;                     // xorshift state of the random tests
+
+ static word nextRndSD(void)
+ {
+     benchRndSD ^= benchRndSD << 7;
+     benchRndSD ^= benchRndSD >> 9;
+     benchRndSD ^= benchRndSD << 8;
+     return benchRndSD;
+ }
+
+ // ------------------------------------------------------------------------------
+ // Read or write (write = 1) one sector of the scratch file. The segments are filled
+ //  with (or checked against) a pattern made from the sector number; *badBytes
+ //  counts the read bytes that don't match it.
+ // The returned value is the resulting status (0 = ok, otherwise see printErrSD())
+ // ------------------------------------------------------------------------------
+ static byte benchSectSD(word sect, byte write, unsigned long* badBytes)
+ {
+     byte  errcode, numBytes, seg, i;
+
+     errcode = seekSD(sect);
+     for (seg = 0; !errcode && (seg < 16); seg++)
+     {
+         if (write)
+         {
+             for (i = 0; i < 32; i++)
+             {
+                 bufferSD[i] = lowByte(sect) ^ highByte(sect) ^ (seg << 5) ^ i;
+             }
+             errcode = writeSD(bufferSD, &numBytes);
+         }
+         else
+         {
+             errcode = readSD(bufferSD, &numBytes);
+             for (i = 0; !errcode && (i < 32); i++)
+             {
+                 if (bufferSD[i] != (byte)(lowByte(sect) ^ highByte(sect) ^ (seg << 5) ^ i))
+                 {
+                     (*badBytes)++;
+                 }
+             }
+         }
+         if (!errcode && (numBytes < 32))
+         {
+             errcode = 19;                       // Reached an unexpected EOF
+         }
+     }
+     if (write && !errcode)
+     {
+         errcode = writeSD(NULL, &numBytes);     // Finalize write operation
+     }
+     return errcode;
+ }
+
+ // ------------------------------------------------------------------------------
+ // Run one test (sequential or random, read or write) and print KB/s and IOPS.
+ // The returned value is the resulting status (0 = ok, otherwise see printErrSD())
+ // ------------------------------------------------------------------------------
+ static byte benchRunSD(const __FlashStringHelper* name, byte rnd, byte write, unsigned long* badBytes)
+ {
+     unsigned long startTime, elapsed;
+     word          sects = rnd ? BENCHSD_RANDOM : BENCHSD_SEQ;
+     word          n;
+     byte          errcode = 0;
+
+     Serial.print(name);
+     benchRndSD = 0xACE1;                      // Same sectors for the random read and write
+     startTime = micros();
+     for (n = 0; !errcode && (n < sects); n++)
+     {
+         errcode = benchSectSD(rnd ? nextRndSD() % BENCHSD_SIZE : n, write, badBytes);
+     }
+     elapsed = micros() - startTime;
+     if (errcode)
+     {
+         Serial.println(F("failed"));
+         return errcode;
+     }
+     Serial.print((sects * 500000UL) / elapsed);    // 0.5KB each sector
+     Serial.print(F(" KB/s, "));
+     Serial.print((sects * 1000000UL) / elapsed);
+     Serial.print(F(" IOPS ("));
+     Serial.print(elapsed / sects);
+     Serial.println(F(" us/sector)"));
+     return 0;
+ }
+
+ // ------------------------------------------------------------------------------
+ // SD card benchmark: sequential write and read, random write and read of 512 bytes
+ //  sectors on the scratch "disk file". The volume is mounted again (the card may
+ //  have been changed) and no "disk file" is left open.
+ // ------------------------------------------------------------------------------
+ void benchSD(void)
+ {
+     unsigned long badBytes = 0;
+     byte          errcode;
+
+     Serial.print(F("IOS: SD card benchmark ("));
+     Serial.print(F(BENCHSD_FILE));
+     Serial.println(F(")"));
+     errCodeSD = mountSD(&filesysSD);
+     errcode = errCodeSD;
+     if (errcode)
+     {
+         printErrSD(0, errcode, NULL);
+         return;
+     }
+     selectFileSD(DISKFILE_SD);
+     errcode = createSD(BENCHSD_FILE);
+     if (!errcode)
+     {
+         errcode = extendSD(BENCHSD_SIZE * 512UL);
+     }
+     if (errcode)
+     {
+         printErrSD(1, errcode, BENCHSD_FILE);
+         filesysSD.flag = 0;
+         return;
+     }
+     if (!pf_contig())                           // As a "disk file" of DSKMAP.DAT (see contigDiskSD())
+     {
+         Serial.println(F("  Contiguous file, no FAT walk"));
+     }
+     else
+     {
+         Serial.println(F("  Fragmented file, FAT walk"));
+     }
+     errcode = benchRunSD(F("  Sequential write: "), 0, 1, &badBytes);
+     if (!errcode)
+     {
+         errcode = benchRunSD(F("  Sequential read:  "), 0, 0, &badBytes);
+     }
+     if (!errcode)
+     {
+         errcode = benchRunSD(F("  Random write:     "), 1, 1, &badBytes);
+     }
+     if (!errcode)
+     {
+         errcode = benchRunSD(F("  Random read:      "), 1, 0, &badBytes);
+     }
+     if (errcode)
+     {
+         printErrSD(2, errcode, BENCHSD_FILE);
+     }
+     else if (badBytes)
+     {
+         Serial.print(F("  Verify failed: "));
+         Serial.print(badBytes);
+         Serial.println(F(" bytes read back wrong"));
+     }
+     filesysSD.flag = 0;                         // No "disk file" opened (see SELDISK)
+ }
+
+ // ------------------------------------------------------------------------------
+ // SD layer statistics (see SdStats.h)
+ // ------------------------------------------------------------------------------
+
+ // ------------------------------------------------------------------------------
+ // Clear the statistics. Called when the Z80 starts and by the SDSTATSCLR opcode.
+ // ------------------------------------------------------------------------------
+ void clearSdStats(void)
+ {
+#if SD_STATS
+     memset(&sdCnt, 0, sizeof(sdCnt));
+     sdCntMagic = SDS_MAGIC;
+#endif
+ }
+
+#if SD_STATS
+ // ------------------------------------------------------------------------------
+ // Account the card wait started with SDSTATS_BUSY_START()
+ // ------------------------------------------------------------------------------
+ void sdStatsBusy(void)
+ {
+     unsigned long busyTime = micros() - sdBusyStart;
+
+     sdCnt.busyTime += busyTime;
+     if (busyTime > sdCnt.busyMax)
+     {
+         sdCnt.busyMax = busyTime;
+     }
+ }
+
+ // ------------------------------------------------------------------------------
+ // Account a READSECT/WRITESECT sector of the track "track" [0..511] in the heatmap
+ // ------------------------------------------------------------------------------
+ void sdStatsTrack(word track)
+ {
+     word  *bucket = &sdCnt.trackHeat[(track >> SDS_TRACKSHIFT) & (SDS_BUCKETS - 1)];
+
+     if (*bucket != 0xFFFF)
+     {
+         (*bucket)++;
+     }
+ }
+#endif
+
+ // ------------------------------------------------------------------------------
+ // Byte "index" of the statistics as sent by the SDSTATS opcode (the SdCounters
+ //  fields in sequence, LSB first)
+ // ------------------------------------------------------------------------------
+ byte sdStatsByte(word index)
+ {
+     if (index >= SDS_DATASIZE)
+     {
+         return 0;
+     }
+#if SD_STATS
+     return ((const byte *) &sdCnt)[index];
+#else
+     return 0;
+#endif
+ }
+
+ // ------------------------------------------------------------------------------
+ // Print the statistics (of the last run if called from the boot menu)
+ // ------------------------------------------------------------------------------
+ void printSdStats(void)
+ {
+#if SD_STATS
+     byte  i;
+
+     Serial.println(F("IOS: SD statistics of the last run"));
+     if (sdCntMagic != SDS_MAGIC)
+     {
+         Serial.println(F("     not available"));
+         return;
+     }
+     Serial.print(F("  CMD17 "));
+     Serial.print(sdCnt.cmd17);
+     Serial.print(F(" ("));
+     Serial.print(sdCnt.readBytes);
+     Serial.print(F(" bytes), CMD24 "));
+     Serial.print(sdCnt.cmd24);
+     Serial.print(F(" ("));
+     Serial.print(sdCnt.writeBytes);
+     Serial.println(F(" bytes)"));
+     Serial.print(F("  Card wait "));
+     Serial.print(sdCnt.busyTime);
+     Serial.print(F("us (max "));
+     Serial.print(sdCnt.busyMax);
+     Serial.println(F("us)"));
+     Serial.print(F("  get_fat "));
+     Serial.print(sdCnt.getFat);
+     Serial.print(F(", pf_lseek cluster hops "));
+     Serial.println(sdCnt.lseekHops);
+     Serial.print(F("  Sectors by track (32 tracks each):"));
+     for (i = 0; i < SDS_BUCKETS; i++)
+     {
+         Serial.print(F(" "));
+         Serial.print(sdCnt.trackHeat[i]);
+     }
+     Serial.println();
+#else
+     Serial.println(F("IOS: SD statistics not available (SD_STATS = 0)"));
+#endif
+ }
+
  // end of source file
\ No newline at end of file
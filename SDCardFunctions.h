@@ -33,7 +33,58 @@ extern byte          diskErr;       // SELDISK, SELSECT, SELTRACK, WRITESECT, RE
 //  error code
 extern byte          numWriBytes;                // Number of written bytes after a writeSD() call
 extern byte          diskSet;                    // Current "Disk Set"
+// Host files on SD (FILE* opcodes)
+extern char          hostName[13];               // Name (8.3 format) of the host file to open/create
+extern word          hostSect;                   // Current sector (512 bytes) of the host file
+extern unsigned long hostSize;                   // New size of the host file (FILESIZE)
+extern unsigned long hostTime;                   // millis() at the last FILEWRITE (see syncHostSD())
+extern byte          hostErr;                    // FILEOPEN, FILESECT, FILEWRITE, FILESIZE, FILEREAD, FILEDIR or
+                                                 //  DIRENTRY resulting error code
+#define HOST_SYNC_MS    1000                     // The host file size is written after this time without FILEWRITE (ms)
+// Contiguous "disk files" (DSKMAP.DAT)
+extern unsigned long mapSectSD;                  // First record sector of DSKMAP.DAT (0 = no valid disk map)
 
+// ------------------------------------------------------------------------------
+// Disk Sets cache. The content of every DSxNAM.DAT is read once when a new volume
+//  is mounted (see loadDiskSetsSD()), so the boot menu never touches the SD.
+//  DSxNAM.DAT layout (all inside the first 32 bytes):
+//    OS name (ASCII), 0x00 [, loader file name (8.3), 0x00, load address (2 bytes, LSB first)]
+//  When the loader is not given the Disk Sets 0..3 use the built-in ones (CP/M 2.2,
+//  QP/M 2.71, CP/M 3.0, UCSD Pascal); other Disk Sets without a loader can't be booted
+// ------------------------------------------------------------------------------
+#define DS_MAXSETS      10                       // Disk Sets [0..9]
+#define DS_NAMELEN      20                       // Max OS name length kept in the cache
+
+struct DiskSetSD
+{
+    char          osName[DS_NAMELEN + 1];        // OS name ("" if DSxNAM.DAT is not found)
+    char          loader[13];                    // Loader file name (8.3 format, "" = not bootable)
+    word          strAddr;                       // Loader starting address
+};
+extern struct DiskSetSD diskSetSD[DS_MAXSETS];
+
+
+// ------------------------------------------------------------------------------
+// File slots. The PetitFS filesystem object holds a single open file, so the
+//  state of the "disk file" (SELDISK), of the host file (FILEOPEN), of the boot
+//  program file read by a warm boot and of the I/O log file (IoLog.cpp) is swapped
+//  in and out of it with selectFileSD()
+// ------------------------------------------------------------------------------
+#define DISKFILE_SD     0                        // Virtual disk file slot
+#define HOSTFILE_SD     1                        // Host file slot
+#define BOOTFILE_SD     2                        // Boot program file slot (warm boot)
+#define LOGFILE_SD      3                        // I/O log file slot (only to find its sectors)
+
+// ------------------------------------------------------------------------------
+// DSKMAP.DAT layout (see tools/mbc2img.cpp):
+//  sector 0  : header, "MBC2DMAP" + version (1 byte) + sectors per cluster (1 byte)
+//  sector 1..: one 16 bytes record for each "disk file" DSsNnn.DSK at index
+//              s * 100 + nn: start cluster (4 bytes, LSB first), file size (4 bytes,
+//              LSB first), 8 bytes reserved (0). An all 0 record means no file
+// ------------------------------------------------------------------------------
+#define DSMAP_VERSION   1
+#define DSMAP_RECSIZE   16                       // Bytes per record
+#define DSMAP_SIZE      (512 + (1000 * DSMAP_RECSIZE)) // Minimum size of a valid map (10 Disk Sets of 100 disks)
 
 // ------------------------------------------------------------------------------
 // Function Prototypes
@@ -41,9 +92,25 @@ extern byte          diskSet;                    // Current "Disk Set"
 byte mountSD(FATFS* fatFs);
 byte openSD(const char* fileName);
 byte readSD(void* buffSD, byte* numReadBytes);
+byte readBlockSD(void* buffSD, word numBytes, word* numReadBytes);
 byte writeSD(void* buffSD, byte* numWrittenBytes);
+byte writeSectSD(const void* buffSD);
 byte seekSD(word sectNum);
+byte createSD(const char* fileName);
+byte extendSD(unsigned long fileSize);
+byte truncateSD(unsigned long fileSize);
+byte syncSD(void);
+void syncHostSD(void);
+void selectFileSD(byte fileSlot);
+void contigDiskSD(byte diskNum);
+byte contigFileSD(const char* fileName, unsigned long* firstSect, unsigned long* numSects);
+byte readRawSD(void* buffSD, unsigned long sect, word offset, word numBytes);
+byte writeRawSD(const void* buffSD, unsigned long sect);
+byte nextDiskSetSD(byte currSet);
+byte openDirSD(void);
+byte readDirSD(byte* dirEntry);
 void printErrSD(byte opType, byte errCode, const char* fileName);
+void benchSD(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,81 @@
+/*
+ * SdStats.h
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * SD layer statistics: the commands sent to the card by avr_mmcp.cpp (CMD17, CMD24),
+ * the data bytes moved, the time spent waiting for the card (read data token, write
+ * busy), the FAT lookups of pff.cpp (get_fat(), pf_lseek() cluster hops) and the
+ * accesses of READSECT/WRITESECT by track. They are read by the Z80 with the SDSTATS
+ * opcode and cleared with SDSTATSCLR, so a CP/M utility can profile a workload, and
+ * those of the last run are printed by the boot menu.
+ */
+
+
+#ifndef SDSTATS_H_
+#define SDSTATS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SD_STATS
+#define SD_STATS            1           // Set to 0 to compile out the SD statistics
+#endif
+
+#define SDS_BUCKETS         16          // Track heatmap buckets
+#define SDS_TRACKSHIFT      5           //  of 32 tracks each (trackSel [0..511])
+
+struct SdCounters
+{
+    uint32_t        cmd17;              // READ_SINGLE_BLOCK commands sent
+    uint32_t        cmd24;              // WRITE_BLOCK commands sent
+    uint32_t        readBytes;          // Data bytes read (what disk_readp() was asked for)
+    uint32_t        writeBytes;         // Data bytes written (without the zero fill)
+    uint32_t        busyTime;           // Total wait for the card (us): data token and write busy
+    uint32_t        busyMax;            // Longest single wait (us)
+    uint32_t        getFat;             // FAT entries read by get_fat()
+    uint32_t        lseekHops;          // Clusters followed by pf_lseek()
+    uint16_t        trackHeat[SDS_BUCKETS]; // READSECT/WRITESECT sectors by track bucket (saturated at 0xFFFF)
+};
+
+#define SDS_DATASIZE        (SD_STATS ? sizeof(struct SdCounters) : 0)  // SDSTATS data bytes
+
+#if SD_STATS
+// ------------------------------------------------------------------------------
+// Externals
+// ------------------------------------------------------------------------------
+extern struct SdCounters    sdCnt;
+extern unsigned long        sdBusyStart;    // micros() at the start of a card wait
+
+#define SDSTATS_INC(field)          { sdCnt.field++; }
+#define SDSTATS_ADD(field, n)       { sdCnt.field += (n); }
+#define SDSTATS_BUSY_START()        { sdBusyStart = micros(); }
+#define SDSTATS_BUSY_END()          sdStatsBusy()
+#define SDSTATS_TRACK(track)        sdStatsTrack(track)
+#else
+#define SDSTATS_INC(field)
+#define SDSTATS_ADD(field, n)
+#define SDSTATS_BUSY_START()
+#define SDSTATS_BUSY_END()
+#define SDSTATS_TRACK(track)
+#endif
+
+// ------------------------------------------------------------------------------
+// Function Prototypes
+// ------------------------------------------------------------------------------
+void    clearSdStats(void);
+void    sdStatsBusy(void);
+void    sdStatsTrack(uint16_t track);
+uint8_t sdStatsByte(uint16_t index);
+void    printSdStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* SDSTATS_H_ */
@@ -93,7 +93,15 @@ Z80-MBC2-ATMEL1284 Forked from S220718-R280819 - new project.  Changed register
                                           // enter XXXX 
 #include "RealTimeClock.h"
 #include "Generic.h"
-#include "SdCardFunctions.h"
+#include "SDCardFunctions.h"
+#include "BootLoader.h"                   // Two stage boot loader (loader stub + streamed image)
+#include "BootTrace.h"                    // Boot phases timing and uTerm reset handling
+#include "Hibernate.h"                    // Save/restore the whole RAM (HIBERNATE opcode and Resume boot mode)
+#include "FastPin.h"                      // Compile time pin access (fastWrite(), fastRead(), fastMode())
+#include "IoProfile.h"                    // Per opcode I/O requests latency (Timer1)
+#include "SdStats.h"                      // SD layer statistics (SDSTATS opcode)
+#include "IoLog.h"                        // I/O sessions log on SD (IOLOG.DAT)
+#include "MemStats.h"                     // SRAM usage and stack high water mark (MEMSTATS opcode)
 
 
 
@@ -108,8 +116,12 @@ const byte    autoexecFlagAddr = 12;      // Internal EEPROM address for AUTOEXE
 const byte    clockModeAddr = 13;         // Internal EEPROM address for the Z80 clock high/low speed switch
                                           //  (1 = low speed, 0 = high speed)
 const byte    diskSetAddr  = 14;          // Internal EEPROM address for the current Disk Set [0..9]
+const byte    bootCfgAddr  = 15;          // Internal EEPROM address for the boot configuration flags
+                                          //  (BOOTCFG_FAST, BOOTCFG_TRACE, BOOTCFG_IOLOG, see BootTrace.h)
 const byte    maxDiskNum   = 99;          // Max number of virtual disks
-const byte    maxDiskSet   = 4;           // Number of configured Disk Sets
+const word    userKeyPoll  = 100;         // USER key poll period (ms) while the Z80 runs
+const byte    warmBootHold = 20;          // USER key polls in a row (2s) needed for a warm boot
+const byte    traceKeyHold = 3;           // USER key polls in a row (0.3s) needed to freeze/print or restart the I/O events trace
 
 // Z80 programs images into flash and related constants
 const word  boot_A_StrAddr = 0xfd10;      // Payload A image starting address (flash)
@@ -170,18 +182,74 @@ byte          ioAddress;                  // Virtual I/O address. Only two possi
 byte          ioData;                     // Data byte used for the I/O operation
 byte          ioOpcode       = 0xFF;      // I/O operation code or Opcode (0xFF means "No Operation")
 word          ioByteCnt;                  // Exchanged bytes counter during an I/O operation
+volatile byte ioPending;                  // Set to 1 if the current I/O request is left by the WAIT_ ISR to loop()
 byte          moduleGPIO     = 0;         // Set to 1 if the module is found, 0 otherwise
 byte          bootMode       = 0;         // Set the program to boot (from flash or SD)
 byte *        BootImage;                  // Pointer to selected flash payload array (image) to boot
+FlashImage    packedImage;                // Boot program embedded in the flash (see findFlashImage())
+byte          packedBoot     = 0;         // Set to 1 if the boot program is loaded from packedImage
 word          BootImageSize  = 0;         // Size of the selected flash payload array (image) to boot
 word          BootStrAddr;                // Starting address of the selected program to boot (from flash or SD)
 
 byte          iCount;                     // Temporary variable (counter)
 byte          clockMode;                  // Z80 clock HI/LO speed selector (0 = 8/10MHz, 1 = 4/5MHz)
+byte          bootCfg;                    // Boot configuration flags (BOOTCFG_FAST, BOOTCFG_TRACE, BOOTCFG_IOLOG)
+byte          fastBoot;                   // Set to 1 if this is a fast boot (no banner, uTerm reset overlapped)
+word          hibernAddr;                 // Entry address of the HIBERNATE opcode
+byte          loadBufSD[512];             // Host file sector buffer of the FILELOAD opcode
+word          loadBytesSD;                // Bytes read into loadBufSD
+word          loadIndexSD;                // Next byte of loadBufSD to send
+word          loadLeftSD;                 // FILELOAD data bytes still to send
+byte          userKeyCnt;                 // USER key polls found the key down in a row (see warmBootHold)
+unsigned long userKeyTime;                // millis() of the last USER key poll
+byte          traceKeyFrozen;             // I/O events trace frozen before the USER key press (see traceKeyHold)
+unsigned long timerMicros;                // micros() latched by the TIMER opcode
+unsigned long timerCycles;                // MCU cycles (Timer1) latched by the TIMER opcode
 byte          LastRxIsEmpty;              // "Last Rx char was empty" flag. Is set when a serial Rx operation was done
                                           // when the Rx buffer was empty
 byte          tempByte;
 
+// Queues between the WAIT_ ISR and loop() (see serviceIsrZ80()), so the ISR never calls Serial
+//  nor the instrumentation. The sizes are powers of 2, and each index is written by one side only.
+#define ISRQ_TX       16                  // SERIAL TX bytes served by the ISR, sent to Serial by loop()
+#define ISRQ_RX       8                   // Received chars taken from Serial by loop(), for SERIAL RX
+#define ISRQ_EV       ((IO_PROFILE || IO_TRACE || IO_LOG) ? 8 : 0)  // Requests served by the ISR
+#define ISRQ_NOTRACE  0xFF                // IsrEvent.trace: not in the I/O events trace
+#define ISRQ_LOGSTORE 1                   // IsrEvent.log: STORE OPCODE
+#define ISRQ_LOGBYTE  2                   //  data byte of the session (0: not logged)
+
+struct IsrEvent
+{
+    unsigned long   start;                // ioProfStart of the request
+    unsigned long   end;                  // ioProfNow() at the release of the Z80
+    byte            slot;                 // ioProfCur of the request
+    byte            trace;                // IOT_xxx flags (ISRQ_NOTRACE if not traced)
+    byte            log;                  // ISRQ_LOGSTORE, ISRQ_LOGBYTE or 0
+    byte            opcode;               // ioOpcode when the request came (the stored one for a STORE OPCODE)
+    byte            data;                 // Data byte exchanged
+    word            byteCnt;              // ioByteCnt when the request came
+};
+
+volatile byte isrTxBuf[ISRQ_TX];
+volatile byte isrTxHead;                  // Written by the ISR
+volatile byte isrTxTail;                  // Written by loop()
+volatile byte isrRxBuf[ISRQ_RX];
+volatile byte isrRxHead;                  // Written by loop()
+volatile byte isrRxTail;                  // Written by the ISR
+#if ISRQ_EV
+IsrEvent      isrEvBuf[ISRQ_EV];
+volatile byte isrEvHead;                  // Written by the ISR
+volatile byte isrEvTail;                  // Written by loop()
+#endif
+
+void loadBootProgram(void);
+void warmBootZ80(void);
+void startIoIntZ80(void);
+void releaseIoZ80(void);
+void serviceIsrZ80(void);
+void flushTxZ80(void);
+int  readRxZ80(void);
+
 // ------------------------------------------------------------------------------
 
 void setup() 
@@ -191,7 +259,7 @@ void setup()
 // ------------------------------------------------------------------------------
     char minBootChar   = '1';        // Minimum allowed ASCII value selection (boot selection)
     char maxSelChar    = '8';        // Maximum allowed ASCII value selection (boot selection)
-    byte maxBootMode   = 4;          // Default maximum allowed value for bootMode [0..4]
+    byte maxBootMode   = 5;          // Default maximum allowed value for bootMode [0..5] (5 = Resume)
     byte bootSelection = 0;          // Flag to enter into the boot mode selection
 
 // ----------------------------------------
@@ -241,14 +309,27 @@ void setup()
     // Initialize CLK (single clock pulses mode) and reset the Z80 CPU
     pinMode(CLK, OUTPUT);                           // Set CLK as output
     singlePulsesResetZ80();                         // Reset the Z80 CPU using single clock pulses
+    bootTrace(BT_PINS);
+
+    // Read the boot configuration. A fast boot is not done if the boot menu is requested
+    bootCfg = EEPROM.read(bootCfgAddr);
+    if (bootCfg > (BOOTCFG_FAST | BOOTCFG_TRACE | BOOTCFG_IOLOG))   // Check if it is a valid value, otherwise set it to 0
+    {
+        EEPROM.update(bootCfgAddr, 0);
+        bootCfg = 0;
+    }
+    fastBoot = (bootCfg & BOOTCFG_FAST) && !bootSelection;
 
-    // Initialize MCU_RTS and MCU_CTS and reset uTerm (A071218-R250119) if present
+    // Initialize MCU_RTS and MCU_CTS and reset uTerm (A071218-R250119) if present.
+    // With a fast boot the uTerm starts while the EEPROM, I2C, RTC and SD are initialized,
+    //  and the console is waited for only before printing something or running the Z80
     pinMode(MCU_CTS_, INPUT_PULLUP);                // Parked (not used)
     pinMode(MCU_RTS_, OUTPUT);
-    digitalWrite(MCU_RTS_, LOW);                    // Reset uTerm (A071218-R250119)
-    delay(100); 
-    digitalWrite(MCU_RTS_, HIGH); 
-    delay(500);
+    startUTermReset();                              // Reset uTerm (A071218-R250119)
+    if (!fastBoot)
+    {
+        waitUTerm();
+    }
 
     // Read the Z80 CPU speed mode
     if (EEPROM.read(clockModeAddr) > 1)             // Check if it is a valid value, otherwise set it to low speed
@@ -260,11 +341,17 @@ void setup()
 
     // Read the stored Disk Set. If not valid set it to 0
     diskSet = EEPROM.read(diskSetAddr);
-    if (diskSet >= maxDiskSet) 
+    if (diskSet >= DS_MAXSETS) 
     {
         EEPROM.update(diskSetAddr, 0);
         diskSet =0;
     }
+    if (EEPROM.read(autoexecFlagAddr) > 1) 
+    {
+        EEPROM.update(autoexecFlagAddr, 0); // Reset AUTOEXEC flag to OFF if invalid
+    }
+    autoexecFlag = EEPROM.read(autoexecFlagAddr);   // Read the previous stored AUTOEXEC flag
+    bootTrace(BT_EEPROM);
 
     // Initialize the EXP_PORT (I2C) and search for "known" optional modules
     Wire.begin();                                   // Wake up I2C bus
@@ -273,50 +360,66 @@ void setup()
     {
         moduleGPIO = 1;// Set to 1 if GPIO Module is found
     }
-    
-    // Print some system information
+    bootTrace(BT_I2C);
     Serial.begin(115200);
-    Serial.println(F("\r\n\nZ80-MBC2 - A040618\r\nIOS - I/O Subsystem - S220718-R280819\r\n"));
 
-    // Print if the input serial buffer is 128 bytes wide (this is needed for xmodem protocol support)
-    if (SERIAL_RX_BUFFER_SIZE >= 128) 
+    if (fastBoot)
     {
-        Serial.println(F("IOS: Found extended serial Rx buffer"));
-    }
-
-    // Print the Z80 clock speed mode
-    Serial.print(F("IOS: Z80 clock set at "));
-    if (clockMode) 
-    {
-        Serial.print(CLOCK_LOW);
+        // Fast boot: only the work needed to run the Z80, without printing anything
+        foundRTC = autoSetRTC(1);                   // Check if RTC is present (quiet)
+        if (foundRTC == RTC_NEEDSET)
+        {
+            waitUTerm();                            // The user must be asked to set the RTC
+            foundRTC = autoSetRTC(0);
+        }
+        bootTrace(BT_RTC);
+        errCodeSD = FR_NOT_READY;                   // The SD is mounted later, only if needed
+        releaseUTerm();
     }
-    else 
+    else
     {
-        Serial.print(CLOCK_HIGH);
-    }
-    Serial.println("MHz");
+        // Print some system information
+        Serial.println(F("\r\n\nZ80-MBC2 - A040618\r\nIOS - I/O Subsystem - S220718-R280819\r\n"));
 
-    // Print RTC and GPIO informations if found
-    foundRTC = autoSetRTC();                        // Check if RTC is present and initialize it as needed
-    if (moduleGPIO) 
-    {
-        Serial.println(F("IOS: Found GPE Option"));
-    }
-    
-    // Print CP/M Autoexec on cold boot status
-    Serial.print(F("IOS: CP/M Autoexec is "));
-    if (EEPROM.read(autoexecFlagAddr) > 1) 
-    {
-        EEPROM.update(autoexecFlagAddr, 0); // Reset AUTOEXEC flag to OFF if invalid
-    }
-    autoexecFlag = EEPROM.read(autoexecFlagAddr);   // Read the previous stored AUTOEXEC flag
-    if (autoexecFlag) 
-    {
-        Serial.println("ON");
-    }
-    else 
-    {
-        Serial.println("OFF");
+        // Print if the input serial buffer is 128 bytes wide (this is needed for xmodem protocol support)
+        if (SERIAL_RX_BUFFER_SIZE >= 128) 
+        {
+            Serial.println(F("IOS: Found extended serial Rx buffer"));
+        }
+
+        // Print the Z80 clock speed mode
+        Serial.print(F("IOS: Z80 clock set at "));
+        if (clockMode) 
+        {
+            Serial.print(CLOCK_LOW);
+        }
+        else 
+        {
+            Serial.print(CLOCK_HIGH);
+        }
+        Serial.println("MHz");
+        bootTrace(BT_BANNER);
+
+        // Print RTC and GPIO informations if found
+        foundRTC = autoSetRTC(0);                   // Check if RTC is present and initialize it as needed
+        bootTrace(BT_RTC);
+        if (moduleGPIO) 
+        {
+            Serial.println(F("IOS: Found GPE Option"));
+        }
+        
+        // Print CP/M Autoexec on cold boot status
+        Serial.print(F("IOS: CP/M Autoexec is "));
+        if (autoexecFlag) 
+        {
+            Serial.println("ON");
+        }
+        else 
+        {
+            Serial.println("OFF");
+        }
+        mountSD(&filesysSD); mountSD(&filesysSD);   // Try to muont the SD volume
+        bootTrace(BT_MOUNT);
     }
     
 // ----------------------------------------
@@ -324,13 +427,13 @@ void setup()
 // ----------------------------------------
 
     // Boot selection and system parameters menu if requested
-    mountSD(&filesysSD); mountSD(&filesysSD);       // Try to muont the SD volume
     bootMode = EEPROM.read(bootModeAddr);           // Read the previous stored boot mode
     
     // Enter in the boot selection menu if USER key was pressed at startup 
     //   or an invalid bootMode code was read from internal EEPROM
     if ((bootSelection == 1 ) || (bootMode > maxBootMode))
     {
+        waitUTerm();                                  // Needed only after a fast boot start
         while (Serial.available() > 0)                // Flush input serial Rx buffer
         {
             Serial.read();
@@ -344,7 +447,8 @@ void setup()
         {
             minBootChar = '0';
             Serial.print(F(" 0: No change ("));
-            Serial.print(bootMode + 1);
+            if (bootMode == 5) Serial.print("H");
+            else Serial.print(bootMode + 1);
             Serial.println(")");
         }
         Serial.println(F(" 1: Basic"));   
@@ -353,6 +457,7 @@ void setup()
         printOsName(diskSet);
         Serial.println(F("\r\n 4: Autoboot"));
         Serial.println(F(" 5: iLoad"));
+        Serial.println(F(" H: Resume from hibernation"));
         Serial.print(F(" 6: Change Z80 clock speed (->"));
         if (clockMode) Serial.print(CLOCK_HIGH);
         else Serial.print(CLOCK_LOW);
@@ -365,7 +470,24 @@ void setup()
         printOsName(diskSet);
         Serial.println();
         Serial.println(" M: Start Monitor" );
-        
+        Serial.print(F(" F: Toggle fast boot (->"));
+        if (!(bootCfg & BOOTCFG_FAST)) Serial.print("ON");
+        else Serial.print("OFF");
+        Serial.println(")");
+        Serial.print(F(" R: Toggle boot trace report (->"));
+        if (!(bootCfg & BOOTCFG_TRACE)) Serial.print("ON");
+        else Serial.print("OFF");
+        Serial.println(")");
+        Serial.println(F(" T: Show boot trace"));
+        Serial.println(F(" B: Z80 I/O read benchmark"));
+        Serial.println(F(" P: Show I/O profile"));
+        Serial.println(F(" S: Show SD statistics"));
+        Serial.println(F(" D: SD card benchmark"));
+        Serial.println(F(" U: Show SRAM usage"));
+        Serial.print(F(" L: Toggle I/O log on SD (->"));
+        if (!(bootCfg & BOOTCFG_IOLOG)) Serial.print("ON");
+        else Serial.print("OFF");
+        Serial.println(")");
 
         // If RTC module is present add a menu choice
         if (foundRTC)
@@ -383,6 +505,7 @@ void setup()
             blinkIOSled(&timeStamp);
             inChar = Serial.read();
             if ( inChar == 'M' ) break;
+            if ((inChar == 'F') || (inChar == 'R') || (inChar == 'T') || (inChar == 'H') || (inChar == 'B') || (inChar == 'P') || (inChar == 'S') || (inChar == 'D') || (inChar == 'L') || (inChar == 'U')) break;
         } while ((inChar < minBootChar) || (inChar > maxSelChar));
         
         Serial.print(inChar);
@@ -407,7 +530,7 @@ void setup()
                 do
                 {
                     // Print the OS name of the next Disk Set
-                    iCount = (iCount + 1) % maxDiskSet;
+                    iCount = nextDiskSetSD(iCount);
                     Serial.print("\r ->");
                     printOsName(iCount);
                     Serial.print(F("                 \r"));
@@ -441,10 +564,66 @@ void setup()
             case 'M':
                 monitor();
                 break;
+
+            case 'F':                                   // Toggle fast boot (effective from the next boot)
+                bootCfg = bootCfg ^ BOOTCFG_FAST;
+                EEPROM.update(bootCfgAddr, bootCfg);      // Save it to the internal EEPROM
+                break;
+
+            case 'R':                                   // Toggle the boot trace report at every boot
+                bootCfg = bootCfg ^ BOOTCFG_TRACE;
+                EEPROM.update(bootCfgAddr, bootCfg);      // Save it to the internal EEPROM
+                break;
+
+            case 'T':                                   // Show the boot trace (last boot and this one)
+                Serial.println();
+                printBootTrace(BT_LAST);
+                printBootTrace(BT_CURRENT);
+                Serial.println();
+                break;
+
+            case 'B':                                   // INIR throughput with the fixed and the calibrated I/O read hold
+                Serial.println();
+                benchInirZ80(clockMode);
+                Serial.println();
+                break;
+
+            case 'P':                                   // Show the I/O requests latency of the last run
+                Serial.println();
+                printIoProf();
+                Serial.println();
+                break;
+
+            case 'S':                                   // Show the SD layer statistics of the last run
+                Serial.println();
+                printSdStats();
+                Serial.println();
+                break;
+
+            case 'D':                                   // SD card throughput (sequential and random sectors)
+                Serial.println();
+                benchSD();
+                Serial.println();
+                break;
+
+            case 'U':                                   // Show the SRAM usage (stack high water mark since the reset)
+                Serial.println();
+                printMemStats();
+                Serial.println();
+                break;
+
+            case 'L':                                   // Toggle the I/O sessions log (effective from the next boot)
+                bootCfg = bootCfg ^ BOOTCFG_IOLOG;
+                EEPROM.update(bootCfgAddr, bootCfg);      // Save it to the internal EEPROM
+                break;
         } // switch
     
         // Save selected boot program if changed
         bootMode = inChar - '1';                      // Calculate bootMode from inChar
+        if (inChar == 'H') 
+        {
+            bootMode = 5;                             // Resume from hibernation
+        }
         if (bootMode <= maxBootMode) 
         {
             EEPROM.update(bootModeAddr, bootMode); // Save to the internal EEPROM if required
@@ -453,20 +632,63 @@ void setup()
         {
             bootMode = EEPROM.read(bootModeAddr);    // Reload boot mode if '0' or > '5' choice selected
         }
+        bootTrace(BT_MENU);
     } // if
 
     // Print current Disk Set and OS name (if OS boot is enabled)
-    if (bootMode == 2)
+    if ((bootMode == 2) && !fastBoot)
     {
         Serial.print(F("IOS: Current "));
         printOsName(diskSet);
         Serial.println();
     }
 
+// ----------------------------------------
+// RESUME FROM HIBERNATION
+// ----------------------------------------
+
+    // Restore the RAM snapshot (see HIBERNATE opcode). If not possible boot the OS of the current Disk Set
+    if (bootMode == 5)
+    {
+        fastWrite(WAIT_RES_, HIGH);                 // Set WAIT_RES_ HIGH (Led LED_0 ON)
+        if (!fastBoot || errCodeSD)
+        {
+            errCodeSD = mountSD(&filesysSD);        // Try to mount the SD volume (a second try if needed)
+            if (errCodeSD)
+            {
+                errCodeSD = mountSD(&filesysSD);
+            }
+        }
+        if (!errCodeSD)
+        {
+            errCodeSD = resumeZ80(clockMode);
+        }
+        if (errCodeSD)
+        {
+            waitUTerm();
+            Serial.print(F("IOS: Resume failed (error "));
+            Serial.print(errCodeSD);
+            Serial.println(F("), booting the OS"));
+            bootMode = 2;
+        }
+    }
+
 // ----------------------------------------
 // Z80 PROGRAM LOAD
 // ----------------------------------------
 
+    // With a fast boot the SD is not mounted yet. An OS needs it anyway (the loader is taken
+    //  from the Disk Sets cache), the other boot programs only if not embedded in the flash
+    if (fastBoot && errCodeSD && (bootMode == 2))
+    {
+        errCodeSD = mountSD(&filesysSD);            // Try to mount the SD volume (a second try if needed)
+        if (errCodeSD)
+        {
+            errCodeSD = mountSD(&filesysSD);
+        }
+        bootTrace(BT_MOUNT);
+    }
+
     // Get the starting address of the program to load and boot, and its size if stored in the flash
     switch (bootMode)
     {
@@ -482,28 +704,18 @@ void setup()
             break;
 
         case 2:                                       // Load an OS from current Disk Set on SD
-            switch (diskSet)
+            // The loader is taken from the Disk Sets cache (built-in for the Disk Sets 0..3,
+            //  or given in DSxNAM.DAT)
+            if (!diskSetSD[diskSet].loader[0])
             {
-                case 0:                               // CP/M 2.2
-                    fileNameSD = CPMFN;
-                    BootStrAddr = CPMSTRADDR;
-                    break;
-
-                case 1:                               // QP/M 2.71
-                    fileNameSD = QPMFN;
-                    BootStrAddr = QPMSTRADDR;
-                    break;
-
-                case 2:                               // CP/M 3.0
-                    fileNameSD = CPM3FN;
-                    BootStrAddr = CPM3STRADDR;
-                    break;
-
-                case 3:                               // UCSD Pascal
-                    fileNameSD = UCSDFN;
-                    BootStrAddr = UCSDSTRADDR;
-                    break;
+                waitUTerm();
+                Serial.print(F("IOS: No loader for "));
+                printOsName(diskSet);
+                Serial.println(F(", using Disk Set 0"));
+                diskSet = 0;
             }
+            fileNameSD = diskSetSD[diskSet].loader;
+            BootStrAddr = diskSetSD[diskSet].strAddr;
             break;
     
             case 3:                                   // Load AUTOBOOT.BIN from SD (load an user executable binary file)
@@ -512,147 +724,46 @@ void setup()
                 break;
     
             case 4:                                   // Load iLoad from flash
-                BootImage = (byte *) pgm_read_word (&flashBootTable[0]); 
+                BootImage = (byte *) pgm_read_ptr(&flashBootTable[0]);
                 BootImageSize = sizeof(boot_A_);
                 BootStrAddr = boot_A_StrAddr;
                 break;
     }
     
-    digitalWrite(WAIT_RES_, HIGH);                  // Set WAIT_RES_ HIGH (Led LED_0 ON)
-  
-    // Load a JP instruction if the boot program starting addr is > 0x0000
-    if (BootStrAddr > 0x0000)                       // Check if the boot program starting addr > 0x0000
+    // A boot program embedded in the flash replaces the same named file on SD (see tools/bin2lz)
+    if (bootMode < 4)
     {
-        // Inject a "JP <BootStrAddr>" instruction to jump at boot starting address
-        loadHL(0x0000);                             // HL = 0x0000 (used as pointer to RAM)
-        writeByteToRAM(JP_nn);                       // Write the JP opcode @ 0x0000;
-        writeByteToRAM(lowByte(BootStrAddr));        // Write LSB to jump @ 0x0001
-        writeByteToRAM(highByte(BootStrAddr));       // Write MSB to jump @ 0x0002
-        //
-        // DEBUG ----------------------------------
-        if (debug)
-        {
-            Serial.print("DEBUG: Injected JP 0x");
-            Serial.println(BootStrAddr, HEX);
-        }
-        // DEBUG END ------------------------------
-        //
+        packedBoot = findFlashImage(fileNameSD, &packedImage);
     }
 
-    // Execute the load of the selected file on SD or image on flash
-    loadHL(BootStrAddr);                            // Set Z80 HL = boot starting address (used as pointer to RAM);
-    //
-    // DEBUG ----------------------------------
-    if (debug)
-    {
-        Serial.print("DEBUG: Flash BootImageSize = ");
-        Serial.println(BootImageSize);
-        Serial.print("DEBUG: BootStrAddr = ");
-        Serial.println(BootStrAddr, HEX);    
-    }
-    // DEBUG END ------------------------------
-    //
+    loadBootProgram();                              // Load the boot program into RAM
     
-    // Load from SD
-    if (bootMode < maxBootMode)
-    {
-        // Mount a volume on SD
-        if (mountSD(&filesysSD))
-        {
-            // Error mounting. Try again
-            errCodeSD = mountSD(&filesysSD);
-            if (errCodeSD)
-            {
-                // Error again. Repeat until error disappears (or the user forces a reset)
-                do
-                {
-                    printErrSD(0, errCodeSD, NULL);
-                    waitKey(SD_ERROR_RETRY);                                // Wait a key to repeat
-                    mountSD(&filesysSD);                      // New double try
-                    errCodeSD = mountSD(&filesysSD);
-                } while (errCodeSD);
-            }
-        }
-
-        // Open the selected file to load
-        errCodeSD = openSD(fileNameSD);
-        if (errCodeSD)
-        {
-            // Error opening the required file. Repeat until error disappears (or the user forces a reset)
-            do
-            {
-                printErrSD(1, errCodeSD, fileNameSD);
-                waitKey(SD_ERROR_RETRY);                                  // Wait a key to repeat
-                errCodeSD = openSD(fileNameSD);
-                if (errCodeSD != 3)
-                {
-                    // Try to do a two mount operations followed by an open
-                    mountSD(&filesysSD);
-                    mountSD(&filesysSD);
-                    errCodeSD = openSD(fileNameSD);
-                }
-            } while (errCodeSD);
-        }
-        
-        // Read the selected file from SD and load it into RAM until an EOF is reached
-        Serial.print("IOS: Loading boot program (");
-        Serial.print(fileNameSD);
-        Serial.print(")...");
-
-        // If an error occurs repeat until error disappears (or the user forces a reset)
-        do
-        {
-            // Read a "segment" of a SD sector and load it into RAM
-            do
-            {
-                errCodeSD = readSD(bufferSD, &numReadBytes);  // Read current "segment" (32 bytes) of the current SD serctor
-                
-                // Load the read "segment" into RAM
-                for (iCount = 0; iCount < numReadBytes; iCount++)
-                {
-                    writeByteToRAM(bufferSD[iCount]);        // Write current data byte into RAM
-                }
-            } while ((numReadBytes == 32) && (!errCodeSD));   // If numReadBytes < 32 -> EOF reached
-            
-            if (errCodeSD)
-            {
-                printErrSD(2, errCodeSD, fileNameSD);
-                waitKey(SD_ERROR_RETRY);                  // Wait a key to repeat
-                seekSD(0);                                // Reset the sector pointer
-            }
-        } while (errCodeSD);
-    }
-    else
+    if (!fastBoot && (bootMode != 5))
     {
-        // Load from flash
-        Serial.print("IOS: Loading boot program...");
-        // Write boot program into external RAM
-        for (word i = 0; i < BootImageSize; i++)
-        {
-            writeByteToRAM(pgm_read_byte(BootImage + i));  // Write current data byte into RAM
-        }
+        Serial.println(" Done");
     }
-    
-    Serial.println(" Done");
 
 // ----------------------------------------
 // Z80 BOOT - Registers as per Atmel1284(p)
 // ----------------------------------------
-    digitalWrite(RESET_, LOW);              // Activate the RESET_ signal
+    waitUTerm();                            // The console must be ready before the Z80 runs (fast boot)
+    if (bootMode != 5)
+    {
+        fastWrite(RESET_, LOW);             // Activate the RESET_ signal (not on resume: PC = entry address)
+    }
 
     // Initialize CLK @ 4/8MHz (@ Fosc = 16MHz). Z80 clock_freq = (Atmega_clock) / ((OCR2 + 1) * 2)
-    ASSR &=    ~(1 << AS2);                 // Set Timer2 clock from system clock
-    TCCR2B |=   (1 << CS20);                // Set Timer2 clock to "no prescaling"
-    TCCR2B &= ~((1 << CS21) | (1 << CS22));
-    TCCR2A |=   (1 << WGM21);               // Set Timer2 CTC mode
-    TCCR2A &=  ~(1 << WGM20);
-    TCCR2A |=   (1 << COM2A0);              // Set "toggle OC2 on compare match"
-    TCCR2A &=  ~(1 << COM2A1);
-    OCR2A = clockMode;                      // Set the compare value to toggle OC2 (0 = low or 1 = high)
-    pinMode(CLK, OUTPUT);                   // Set OC2 as output and start to output the clock
+    startZ80Clock(clockMode);
     
-    Serial.println("IOS: Z80 is running from now");
-    Serial.println();
+    if (!fastBoot)
+    {
+        if (bootMode == 5)
+        {
+            Serial.println("IOS: Z80 resumed from hibernation");
+        }
+        Serial.println("IOS: Z80 is running from now");
+        Serial.println();
+    }
 
     // Flush serial Rx buffer
     while (Serial.available() > 0) 
@@ -662,55 +773,1590 @@ void setup()
 
     // Leave the Z80 CPU running
     delay(1);                                       // Just to be sure...
-    digitalWrite(RESET_, HIGH);                     // Release Z80 from reset and let it run
+    fastWrite(RESET_, HIGH);                        // Release Z80 from reset and let it run
+    bootTrace(BT_RUN);
+    bootTraceDone();
+
+    // Print the boot trace if required (the Z80 waits on its first I/O request until the WAIT_ ISR is on)
+    if (bootCfg & BOOTCFG_TRACE)
+    {
+        printBootTrace(BT_CURRENT);
+        Serial.println();
+    }
+
+    // From now on the Z80 I/O requests are served by the WAIT_ ISR (and by loop() if slow)
+    startIoIntZ80();
 }
 
 // ------------------------------------------------------------------------------
-// Main Processing Loop
+// VIRTUAL I/O OPCODES
+//
+// Each opcode is served by a handler, called by loop() through the ioWrTable/ioRdTable
+//  entry of ioOpcode for every data byte of the opcode (ioData, ioByteCnt). The entry
+//  gives the number of exchanged bytes too: execIoOpcode() ends the opcode (ioOpcode =
+//  0xFF) after its last byte, and only the variable length ones (0) end themselves.
+//  See the opcodes table in loop() for the whole protocol.
 // ------------------------------------------------------------------------------
-void loop() 
+
+// ------------------------------------------------------------------------------
+// Not defined opcodes and the opcodes used only by the boot/resume stubs
+// ------------------------------------------------------------------------------
+byte ioNop(void)
 {
-    if (!digitalRead(WAIT_))
-    { // I/O operation requested
-        if (!digitalRead(WR_))
-        {// I/O WRITE operation requested
-            // ----------------------------------------
-            // VIRTUAL I/O WRITE OPERATIONS ENGINE
-            // ----------------------------------------
-            ioAddress = digitalRead(AD0);               // Read Z80 address bus line AD0 (PC2)
-            ioData = PINA;                              // Read Z80 data bus D0-D7 (PA0-PA7)
-            if (ioAddress)                              // Check the I/O address (only AD0 is checked!)
-            {
-                // .........................................................................................................
-                //
-                // AD0 = 1 (I/O write address = 0x01). STORE OPCODE.
-                //
-                // Store (write) an "I/O operation code" (Opcode) and reset the exchanged bytes counter.
-                //
-                // NOTE 1: An Opcode can be a write or read Opcode, if the I/O operation is read or write.
-                // NOTE 2: the STORE OPCODE operation must always precede an EXECUTE WRITE OPCODE or EXECUTE READ OPCODE 
-                //         operation.
-                // NOTE 3: For multi-byte read opcode (as DATETIME) read sequentially all the data bytes without to send
-                //         a STORE OPCODE operation before each data byte after the first one.
-                // .........................................................................................................
-                //
-                // Currently defined Opcodes for I/O write operations:
-                //
-                //   Opcode     Name            Exchanged bytes
-                // -------------------------------------------------
-                // Opcode 0x00  USER LED        1
-                // Opcode 0x01  SERIAL TX       1
-                // Opcode 0x03  GPIOA Write     1
-                // Opcode 0x04  GPIOB Write     1
-                // Opcode 0x05  IODIRA Write    1
-                // Opcode 0x06  IODIRB Write    1
-                // Opcode 0x07  GPPUA Write     1
-                // Opcode 0x08  GPPUB Write     1
-                // Opcode 0x09  SELDISK         1
-                // Opcode 0x0A  SELTRACK        2
+    return IO_OK;
+}
+
+// ----------------------------------------
+// VIRTUAL I/O WRITE OPCODES
+// ----------------------------------------
+
+// ------------------------------------------------------------------------------
+// USER LED:
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                              x  x  x  x  x  x  x  0    USER Led off
+//                              x  x  x  x  x  x  x  1    USER Led on
+// ------------------------------------------------------------------------------
+byte wrUserLed(void)
+{
+    if (ioData & B00000001)
+    {
+        fastWrite(USER, LOW);
+    }
+    else
+    {
+        fastWrite(USER, HIGH);
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// SERIAL TX:
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    ASCII char to be sent to serial
+// ------------------------------------------------------------------------------
+byte wrSerialTx(void)
+{
+    flushTxZ80();                                   // The bytes queued by the WAIT_ ISR go first
+    Serial.write(ioData);
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// GPIOA Write (GPE Option):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    GPIOA value (see MCP23017 datasheet)
+// ------------------------------------------------------------------------------
+byte wrGpioA(void)
+{
+    if (moduleGPIO)
+    {
+        Wire.beginTransmission(GPIOEXP_ADDR);
+        Wire.write(GPIOA_REG);                // Select GPIOA
+        Wire.write(ioData);                   // Write value
+        Wire.endTransmission();
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// GPIOB Write (GPE Option):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    GPIOB value (see MCP23017 datasheet)
+// ------------------------------------------------------------------------------
+byte wrGpioB(void)
+{
+    if (moduleGPIO)
+    {
+        Wire.beginTransmission(GPIOEXP_ADDR);
+        Wire.write(GPIOB_REG);                // Select GPIOB
+        Wire.write(ioData);                   // Write value
+        Wire.endTransmission();
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// IODIRA Write (GPE Option):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    IODIRA value (see MCP23017 datasheet)
+// ------------------------------------------------------------------------------
+byte wrIodirA(void)
+{
+    if (moduleGPIO)
+    {
+        Wire.beginTransmission(GPIOEXP_ADDR);
+        Wire.write(IODIRA_REG);               // Select IODIRA
+        Wire.write(ioData);                   // Write value
+        Wire.endTransmission();
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// IODIRB Write (GPE Option):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    IODIRB value (see MCP23017 datasheet)
+// ------------------------------------------------------------------------------
+byte wrIodirB(void)
+{
+    if (moduleGPIO)
+    {
+        Wire.beginTransmission(GPIOEXP_ADDR);
+        Wire.write(IODIRB_REG);               // Select IODIRB
+        Wire.write(ioData);                   // Write value
+        Wire.endTransmission();
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// GPPUA Write (GPE Option):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    GPPUA value (see MCP23017 datasheet)
+// ------------------------------------------------------------------------------
+byte wrGppuA(void)
+{
+    if (moduleGPIO)
+    {
+        Wire.beginTransmission(GPIOEXP_ADDR);
+        Wire.write(GPPUA_REG);                // Select GPPUA
+        Wire.write(ioData);                   // Write value
+        Wire.endTransmission();
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// GPPUB Write (GPIO Exp. Mod. ):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    GPPUB value (see MCP23017 datasheet)
+// ------------------------------------------------------------------------------
+byte wrGppuB(void)
+{
+    if (moduleGPIO)
+    {
+        Wire.beginTransmission(GPIOEXP_ADDR);
+        Wire.write(GPPUB_REG);                // Select GPPUB
+        Wire.write(ioData);                   // Write value
+        Wire.endTransmission();
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// DISK EMULATION
+// SELDISK - select the emulated disk number (binary). 100 disks are supported [0..99]:
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    DISK number (binary) [0..99]
+//
+//
+// Opens the "disk file" corresponding to the selected disk number, doing some checks.
+// A "disk file" is a binary file that emulates a disk using a LBA-like logical sector number.
+// Every "disk file" must have a dimension of 8388608 bytes, corresponding to 16384 LBA-like logical sectors
+//  (each sector is 512 bytes long), corresponding to 512 tracks of 32 sectors each (see SELTRACK and
+//  SELSECT opcodes).
+// Errors are stored into "errDisk" (see ERRDISK opcode).
+//
+//
+// ...........................................................................................
+//
+// "Disk file" filename convention:
+//
+// Every "disk file" must follow the syntax "DSsNnn.DSK" where
+//
+//    "s" is the "disk set" and must be in the [0..9] range (always one numeric ASCII character)
+//    "nn" is the "disk number" and must be in the [00..99] range (always two numeric ASCII characters)
+//
+// ...........................................................................................
+//
+//
+// NOTE 1: The maximum disks number may be lower due the limitations of the used OS (e.g. CP/M 2.2 supports
+//         a maximum of 16 disks)
+// NOTE 2: Because SELDISK opens the "disk file" used for disk emulation, before using WRITESECT or READSECT
+//         a SELDISK must be performed at first.
+// NOTE 3: If the "disk file" matches its record in DSKMAP.DAT (written by tools/mbc2img) and its clusters
+//         are consecutive, the sector address is computed without following the FAT chain.
+// ------------------------------------------------------------------------------
+byte wrSelDisk(void)
+{
+    if (ioData <= maxDiskNum)               // Valid disk number
+    {
+        // Set the name of the file to open as virtual disk, and open it
+        diskName[2] = diskSet + 48;           // Set the current Disk Set
+        diskName[4] = (ioData / 10) + 48;     // Set the disk number
+        diskName[5] = ioData - ((ioData / 10) * 10) + 48;
+        selectFileSD(DISKFILE_SD);
+        diskErr = openSD(diskName);           // Open the "disk file" corresponding to the given disk number
+        if (!diskErr)
+        {
+            contigDiskSD(ioData);             // No FAT walk if contiguous (see DSKMAP.DAT)
+        }
+    }
+    else
+    {
+        diskErr = 16;                      // Illegal disk number
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// DISK EMULATION
+// SELTRACK - select the emulated track number (word splitted in 2 bytes in sequence: DATA 0 and DATA 1):
+//
+//                I/O DATA 0:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    Track number (binary) LSB [0..255]
+//
+//                I/O DATA 1:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    Track number (binary) MSB [0..1]
+//
+//
+// Stores the selected track number into "trackSel" for "disk file" access.
+// A "disk file" is a binary file that emulates a disk using a LBA-like logical sector number.
+// The SELTRACK and SELSECT operations convert the legacy track/sector address into a LBA-like logical
+//  sector number used to set the logical sector address inside the "disk file".
+// A control is performed on both current sector and track number for valid values.
+// Errors are stored into "diskErr" (see ERRDISK opcode).
+//
+//
+// NOTE 1: Allowed track numbers are in the range [0..511] (512 tracks)
+// NOTE 2: Before a WRITESECT or READSECT operation at least a SELSECT or a SELTRAK operation
+//         must be performed
+// ------------------------------------------------------------------------------
+byte wrSelTrack(void)
+{
+    if (!ioByteCnt)
+    {
+        // LSB
+        trackSel = ioData;
+    }
+    else
+    {
+        // MSB
+        trackSel = (((word) ioData) << 8) | lowByte(trackSel);
+        if ((trackSel < 512) && (sectSel < 32))
+        {
+            // Sector and track numbers valid
+            diskErr = 0;                      // No errors
+        }
+        else
+        {
+            // Sector or track invalid number
+            if (sectSel < 32)
+            {
+                diskErr = 17;     // Illegal track number
+            }
+            else
+            {
+                diskErr = 18;                  // Illegal sector number
+            }
+        }
+    }
+    ioByteCnt++;
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// DISK EMULATION
+// SELSECT - select the emulated sector number (binary):
+//
+//                  I/O DATA:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    Sector number (binary) [0..31]
+//
+//
+// Stores the selected sector number into "sectSel" for "disk file" access.
+// A "disk file" is a binary file that emulates a disk using a LBA-like logical sector number.
+// The SELTRACK and SELSECT operations convert the legacy track/sector address into a LBA-like logical
+//  sector number used to set the logical sector address inside the "disk file".
+// A control is performed on both current sector and track number for valid values.
+// Errors are stored into "diskErr" (see ERRDISK opcode).
+//
+//
+// NOTE 1: Allowed sector numbers are in the range [0..31] (32 sectors)
+// NOTE 2: Before a WRITESECT or READSECT operation at least a SELSECT or a SELTRAK operation
+//         must be performed
+// ------------------------------------------------------------------------------
+byte wrSelSect(void)
+{
+    sectSel = ioData;
+    if ((trackSel < 512) && (sectSel < 32))
+    {
+        // Sector and track numbers valid
+        diskErr = 0;                        // No errors
+    }
+    else
+    {
+        // Sector or track invalid number
+        if (sectSel < 32)
+        {
+            diskErr = 17;     // Illegal track number
+        }
+        else
+        {
+            diskErr = 18;                  // Illegal sector number
+        }
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// DISK EMULATION
+// WRITESECT - write 512 data bytes sequentially into the current emulated disk/track/sector:
+//
+//                 I/O DATA 0: D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    First Data byte
+//
+//                      |               |
+//                      |               |
+//                      |               |                 <510 Data Bytes>
+//                      |               |
+//
+//               I/O DATA 511: D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    512th Data byte (Last byte)
+//
+//
+// Writes the current sector (512 bytes) of the current track/sector, one data byte each call.
+// All the 512 calls must be always performed sequentially to have a WRITESECT operation correctly done.
+// If an error occurs during the WRITESECT operation, all subsequent write data will be ignored and
+//  the write finalization will not be done.
+// If an error occurs calling any DISK EMULATION opcode (SDMOUNT excluded) immediately before the WRITESECT
+//  opcode call, all the write data will be ignored and the WRITESECT operation will not be performed.
+// Errors are stored into "diskErr" (see ERRDISK opcode).
+//
+// NOTE 1: Before a WRITESECT operation at least a SELTRACK or a SELSECT must be always performed
+// NOTE 2: Remember to open the right "disk file" at first using the SELDISK opcode
+// NOTE 3: The write finalization on SD "disk file" is executed only on the 512th data byte exchange, so be
+//         sure that exactly 512 data bytes are exchanged.
+// ------------------------------------------------------------------------------
+byte wrWriteSect(void)
+{
+    if (!ioByteCnt)
+    {
+        // First byte of 512, so set the right file pointer to the current emulated track/sector first
+        selectFileSD(DISKFILE_SD);
+        if ((trackSel < 512) && (sectSel < 32) && (!diskErr))
+        {
+            // Sector and track numbers valid and no previous error; set the LBA-like logical sector
+            diskErr = seekSD((trackSel << 5) | sectSel);  // Set the starting point inside the "disk file"
+                                              //  generating a 14 bit "disk file" LBA-like
+                                              //  logical sector address created as TTTTTTTTTSSSSS
+            SDSTATS_TRACK(trackSel);
+        }
+    }
+
+    if (!diskErr)
+    {
+        // No previous error (e.g. selecting disk, track or sector)
+        tempByte = ioByteCnt % 32;            // [0..31]
+        bufferSD[tempByte] = ioData;          // Store current exchanged data byte in the buffer array
+        if (tempByte == 31)
+        {
+            // Buffer full. Write all the buffer content (32 bytes) into the "disk file"
+            diskErr = writeSD(bufferSD, &numWriBytes);
+            if (numWriBytes < 32)
+            {
+                diskErr = 19; // Reached an unexpected EOF
+            }
+
+            if (ioByteCnt >= 511)
+            {
+                // Finalize write operation and check result (if no previous error occurred)
+                if (!diskErr)
+                {
+                    diskErr = writeSD(NULL, &numWriBytes);
+                }
+            }
+        }
+    }
+    ioByteCnt++;                            // Increment the counter of the exchanged data bytes
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// BANKED RAM
+// SETBANK - select the Os RAM Bank (binary):
+//
+//                  I/O DATA:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    Os Bank number (binary) [0..2]
+//
+//
+// Set a 32kB RAM bank for the lower half of the Z80 address space (from 0x0000 to 0x7FFF).
+// The upper half (from 0x8000 to 0xFFFF) is the common fixed bank.
+// Allowed Os Bank numbers are from 0 to 2.
+//
+// Please note that there are three kinds of Bank numbers (see the A040618 schematic):
+//
+// * the "Os Bank" number is the bank number managed (known) by the Os;
+// * the "Logical Bank" number is the bank seen by the Atmega32a (through BANK1 and BANK0 address lines);
+// * the "Physical Bank" number is the real bank addressed inside the RAM chip (RAM_A16 and RAM_A15 RAM
+//   address lines).
+//
+// The following tables shows the relations:
+//
+//
+//  Os Bank | Logical Bank |  Z80 Address Bus    |   Physical Bank   |            Notes
+//  number  | BANK1 BANK0  |        A15          |  RAM_A16 RAM_A15  |
+// ------------------------------------------------------------------------------------------------
+//     X    |   X     X    |         1           |     0       1     |  Phy Bank 1 (common fixed)
+//     -    |   0     0    |         0           |     0       1     |  Phy Bank 1 (common fixed)
+//     0    |   0     1    |         0           |     0       0     |  Phy Bank 0 (Logical Bank 1)
+//     2    |   1     0    |         0           |     1       1     |  Phy Bank 3 (Logical Bank 2)
+//     1    |   1     1    |         0           |     1       0     |  Phy Bank 2 (Logical Bank 3)
+//
+//
+//
+//      Physical Bank      |    Logical Bank     |   Physical Bank   |   Physical RAM Addresses
+//          number         |       number        |  RAM_A16 RAM_A15  |
+// ------------------------------------------------------------------------------------------------
+//            0            |         1           |     0       0     |   From 0x00000 to 0x07FFF
+//            1            |         0           |     0       1     |   From 0x08000 to 0x0FFFF
+//            2            |         3           |     1       0     |   From 0x01000 to 0x17FFF
+//            3            |         2           |     1       1     |   From 0x18000 to 0x1FFFF
+//
+//
+// Note that the Logical Bank 0 can't be used as switchable Os Bank bacause it is the common
+//  fixed bank mapped in the upper half of the Z80 address space (from 0x8000 to 0xFFFF).
+//
+//
+// NOTE: If the Os Bank number is greater than 2 no selection is done.
+// ------------------------------------------------------------------------------
+byte wrSetBank(void)
+{
+    switch (ioData)
+    {
+        // Set physical bank 0 (logical bank 1)
+        case 0:                               // Os bank 0
+            fastWrite(BANK0, HIGH);
+            fastWrite(BANK1, LOW);
+            break;
+
+        // Set physical bank 2 (logical bank 3)
+        case 1:                               // Os bank 1
+            fastWrite(BANK0, HIGH);
+            fastWrite(BANK1, HIGH);
+            break;
+
+        // Set physical bank 3 (logical bank 2)
+        case 2:                               // Os bank 2
+            fastWrite(BANK0, LOW);
+            fastWrite(BANK1, HIGH);
+            break;
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HOST FILES
+// FILENAME - set the name of the host file to open with FILEOPEN (ASCII string):
+//
+//                I/O DATA 0:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    First char of the file name
+//
+//                      |               |
+//                      |               |                 <Other chars>
+//                      |               |
+//
+//                I/O DATA n:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                              0  0  0  0  0  0  0  0    String terminator (0x00)
+//
+//
+// A "host file" is a plain file on the SD (FAT16 or FAT32) root directory, so a BIOS or an utility
+//  can move data from/to a PC without to rebuild a "disk file".
+// The file name is in the 8.3 format (e.g. "README.TXT"). Lower case chars are converted to upper
+//  case. After 12 chars the name is terminated anyway.
+// ------------------------------------------------------------------------------
+byte wrFileName(void)
+{
+    if (!ioByteCnt)
+    {
+        hostName[0] = 0;
+    }
+    if ((ioData) && (ioByteCnt < 12))
+    {
+        if ((ioData >= 'a') && (ioData <= 'z'))
+        {
+            ioData = ioData - 32;             // To upper case
+        }
+        hostName[ioByteCnt] = ioData;
+        ioByteCnt++;
+        hostName[ioByteCnt] = 0;
+    }
+    else
+    {
+        ioOpcode = 0xFF;                      // All done. Set ioOpcode = "No operation"
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HOST FILES
+// FILEOPEN - open the host file named with FILENAME:
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                              x  x  x  x  x  x  x  0    Open an existing file
+//                              x  x  x  x  x  x  x  1    Open a file, creating it if not existing
+//
+//
+// The host file sector is set to 0 (see FILESECT). The size of the host file opened before, if
+//  still pending (see FILEWRITE), is written first.
+// Errors are stored into "hostErr" (see FILESTAT opcode).
+//
+// NOTE: Only one host file can be opened. The "disk file" opened with SELDISK stays open.
+// ------------------------------------------------------------------------------
+byte wrFileOpen(void)
+{
+    selectFileSD(HOSTFILE_SD);
+    syncSD();
+    if (ioData & B00000001)
+    {
+        hostErr = createSD(hostName);
+    }
+    else
+    {
+        hostErr = openSD(hostName);
+    }
+    hostSect = 0;
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HOST FILES
+// FILESECT - select the host file sector (word splitted in 2 bytes in sequence: DATA 0 and DATA 1):
+//
+//                I/O DATA 0:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    Sector number (binary) LSB
+//
+//                I/O DATA 1:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    Sector number (binary) MSB
+//
+//
+// Sectors are 512 bytes long, so up to 32MB of a host file can be addressed.
+//
+// NOTE: FILEREAD and FILEWRITE increment the sector number, so FILESECT is needed only for random
+//       access
+// ------------------------------------------------------------------------------
+byte wrFileSect(void)
+{
+    if (!ioByteCnt)
+    {
+        // LSB
+        hostSect = ioData;
+        ioByteCnt++;
+    }
+    else
+    {
+        // MSB
+        hostSect = (((word) ioData) << 8) | lowByte(hostSect);
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HOST FILES
+// FILEWRITE - write 512 data bytes sequentially into the current host file sector:
+//
+//                 I/O DATA 0: D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    First Data byte
+//
+//                      |               |
+//                      |               |
+//                      |               |                 <510 Data Bytes>
+//                      |               |
+//
+//               I/O DATA 511: D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    512th Data byte (Last byte)
+//
+//
+// Writes the current sector (512 bytes) of the host file, one data byte each call, as WRITESECT does.
+// If the sector is past the end of the file, the file is extended up to the end of the sector (the
+//  sectors in between, if any, are allocated but not cleared).
+// After the 512th byte the host file sector is incremented.
+// Errors are stored into "hostErr" (see FILESTAT opcode).
+//
+// NOTE: The directory entry is written only when a cluster is added to the file. The size within
+//       the last cluster is written by FILESIZE, by the next FILEOPEN or after HOST_SYNC_MS without
+//       FILEWRITE (see syncHostSD())
+// ------------------------------------------------------------------------------
+byte wrFileWrite(void)
+{
+    if (!ioByteCnt)
+    {
+        // First byte of 512, so grow the file if needed and set the right file pointer
+        selectFileSD(HOSTFILE_SD);
+        hostErr = extendSD(((unsigned long) hostSect + 1) << 9);
+        if (!hostErr)
+        {
+            hostErr = seekSD(hostSect);
+        }
+    }
+
+    if (!hostErr)
+    {
+        tempByte = ioByteCnt % 32;            // [0..31]
+        bufferSD[tempByte] = ioData;          // Store current exchanged data byte in the buffer array
+        if (tempByte == 31)
+        {
+            // Buffer full. Write all the buffer content (32 bytes) into the host file
+            hostErr = writeSD(bufferSD, &numWriBytes);
+            if (numWriBytes < 32)
+            {
+                hostErr = 19; // Reached an unexpected EOF
+            }
+            if ((ioByteCnt >= 511) && (!hostErr))
+            {
+                hostErr = writeSD(NULL, &numWriBytes);  // Finalize write operation
+            }
+        }
+    }
+    if (ioByteCnt >= 511)
+    {
+        hostSect++;
+        hostTime = millis();
+    }
+    ioByteCnt++;                            // Increment the counter of the exchanged data bytes
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HOST FILES
+// FILESIZE - set the exact size of the host file (double word splitted in 4 bytes in sequence: DATA 0
+//            to DATA 3):
+//
+//                I/O DATA 0:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    File size (bytes) LSB
+//
+//                      |               |
+//                      |               |                 <2 Data Bytes>
+//                      |               |
+//
+//                I/O DATA 3:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    File size (bytes) MSB
+//
+//
+// FILEWRITE writes whole sectors, so a file written with it is a multiple of 512 bytes long. After
+//  the last FILEWRITE, FILESIZE gives the file its exact size: the clusters past the new end are
+//  freed (a larger size extends the file as FILEWRITE does) and the directory entry is written.
+//  The host file sector is not changed.
+// Errors are stored into "hostErr" (see FILESTAT opcode).
+// ------------------------------------------------------------------------------
+byte wrFileSize(void)
+{
+    hostSize = (hostSize >> 8) | ((unsigned long) ioData << 24);
+    if (ioByteCnt >= 3)
+    {
+        selectFileSD(HOSTFILE_SD);
+        hostErr = extendSD(hostSize);
+        if (!hostErr)
+        {
+            hostErr = truncateSD(hostSize);
+        }
+    }
+    ioByteCnt++;
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HOST FILES
+// FILEDIR - rewind the listing of the SD root directory (see DIRENTRY):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                              x  x  x  x  x  x  x  x    Don't care
+//
+//
+// Errors are stored into "hostErr" (see FILESTAT opcode).
+// ------------------------------------------------------------------------------
+byte wrFileDir(void)
+{
+    hostErr = openDirSD();
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HIBERNATION
+// HIBERNATE - save the whole RAM into the snapshot file HIBERNFN (entry address word splitted in
+//             2 bytes in sequence: DATA 0 and DATA 1):
+//
+//                I/O DATA 0:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    Entry address LSB
+//
+//                I/O DATA 1:  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    Entry address MSB
+//
+//
+// After the second byte the whole RAM (128KB: the three Os Banks and the common bank), the current
+//  Os Bank, the current Disk Set and "disk file" are saved, then the Z80 goes on from the entry address.
+// The "Resume" boot mode (boot menu choice H) restores all them and jumps to the entry address too,
+//  so after a power cycle the boot and the initialization of the program are skipped.
+//
+// NOTE 1: The Z80 is reset before jumping to the entry address, so the entry code must set SP, the
+//         interrupt mode and enable the interrupts again. All the other registers are undefined.
+// NOTE 2: The snapshot file is created if needed, but it is better to preallocate it contiguous with
+//         "tools/mbc2img hibern". On errors a message is printed and the old snapshot is not valid
+//         anymore, but the Z80 goes on from the entry address anyway.
+// ------------------------------------------------------------------------------
+byte wrHibernate(void)
+{
+    if (!ioByteCnt)
+    {
+        // LSB
+        hibernAddr = ioData;
+    }
+    else
+    {
+        // MSB
+        hibernAddr = (((word) ioData) << 8) | lowByte(hibernAddr);
+        errCodeSD = hibernateZ80(hibernAddr, clockMode);
+        if (errCodeSD)
+        {
+            Serial.print(F("\r\nIOS: Hibernation failed (error "));
+            Serial.print(errCodeSD);
+            Serial.println(")");
+        }
+
+        // The Z80 was reset, so there is no wait state to exit from: just run it
+        ioOpcode = 0xFF;                      // Ended here, as the WAIT_ ISR may serve a new opcode
+                                              //  as soon as releaseIoZ80() is called
+        startZ80Clock(clockMode);
+        releaseIoZ80();
+        return IO_RESET;
+    }
+    ioByteCnt++;
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// WARM BOOT
+// WARMBOOT - reset the Z80 and load the boot program again, keeping the IOS state:
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                              x  x  x  x  x  x  x  x    Don't care
+//
+//
+// The SD volume stays mounted and the "disk file", the host file and all the caches are kept,
+//  so only the boot program is loaded (from SRAM if it is not larger than WARMBOOT_CACHE bytes, see BootLoader.h).
+//  The RAM is not cleared and the Os Bank 0 is selected. The same is done holding the USER key
+//  down for 2 seconds while the Z80 runs.
+// ------------------------------------------------------------------------------
+byte wrWarmBoot(void)
+{
+    warmBootZ80();
+    return IO_RESET;                               // The Z80 was reset: no wait state to exit from
+}
+
+// ------------------------------------------------------------------------------
+// SDSTATSCLR - clear the SD layer statistics (see SDSTATS opcode):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                              x  x  x  x  x  x  x  x    Don't care
+//
+// ------------------------------------------------------------------------------
+byte wrSdStatsClr(void)
+{
+    clearSdStats();
+    return IO_OK;
+}
+// ----------------------------------------
+// VIRTUAL I/O READ OPCODES
+// ----------------------------------------
+
+// ------------------------------------------------------------------------------
+// USER KEY:
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                              0  0  0  0  0  0  0  0    USER Key not pressed
+//                              0  0  0  0  0  0  0  1    USER Key pressed
+// ------------------------------------------------------------------------------
+byte rdUserKey(void)
+{
+    tempByte = fastRead(USER);            // Save USER led status
+    fastMode(USER, INPUT_PULLUP);         // Read USER Key
+    ioData = !fastRead(USER);
+    fastMode(USER, OUTPUT);
+    fastWrite(USER, tempByte);            // Restore USER led status
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// GPIOA Read (GPE Option):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    GPIOA value (see MCP23017 datasheet)
+//
+// NOTE: a value 0x00 is forced if the GPE Option is not present
+// ------------------------------------------------------------------------------
+byte rdGpioA(void)
+{
+    if (moduleGPIO)
+    {
+        // Set MCP23017 pointer to GPIOA
+        Wire.beginTransmission(GPIOEXP_ADDR);
+        Wire.write(GPIOA_REG);
+        Wire.endTransmission();
+        // Read GPIOA
+        Wire.beginTransmission(GPIOEXP_ADDR);
+        Wire.requestFrom(GPIOEXP_ADDR, 1);
+        ioData = Wire.read();
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// GPIOB Read (GPE Option):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    GPIOB value (see MCP23017 datasheet)
+//
+// NOTE: a value 0x00 is forced if the GPE Option is not present
+// ------------------------------------------------------------------------------
+byte rdGpioB(void)
+{
+    if (moduleGPIO)
+    {
+        // Set MCP23017 pointer to GPIOB
+        Wire.beginTransmission(GPIOEXP_ADDR);
+        Wire.write(GPIOB_REG);
+        Wire.endTransmission();
+        // Read GPIOB
+        Wire.beginTransmission(GPIOEXP_ADDR);
+        Wire.requestFrom(GPIOEXP_ADDR, 1);
+        ioData = Wire.read();
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// SYSFLAGS (Various system flags for the OS):
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                              X  X  X  X  X  X  X  0    AUTOEXEC not enabled
+//                              X  X  X  X  X  X  X  1    AUTOEXEC enabled
+//                              X  X  X  X  X  X  0  X    DS3231 RTC not found
+//                              X  X  X  X  X  X  1  X    DS3231 RTC found
+//                              X  X  X  X  X  0  X  X    Serial RX buffer empty
+//                              X  X  X  X  X  1  X  X    Serial RX char available
+//                              X  X  X  X  0  X  X  X    Previous RX char valid
+//                              X  X  X  X  1  X  X  X    Previous RX char was a "buffer empty" flag
+//
+// NOTE: Currently only D0-D3 are used
+// ------------------------------------------------------------------------------
+byte rdSysFlags(void)
+{
+    ioData = autoexecFlag | (foundRTC << 1) | (((isrRxHead != isrRxTail) || (Serial.available() > 0)) << 2) | ((LastRxIsEmpty > 0) << 3);
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// DATETIME (Read date/time and temperature from the RTC. Binary values):
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                I/O DATA 0   D7 D6 D5 D4 D3 D2 D1 D0    seconds [0..59]     (1st data byte)
+//                I/O DATA 1   D7 D6 D5 D4 D3 D2 D1 D0    minutes [0..59]
+//                I/O DATA 2   D7 D6 D5 D4 D3 D2 D1 D0    hours   [0..23]
+//                I/O DATA 3   D7 D6 D5 D4 D3 D2 D1 D0    day     [1..31]
+//                I/O DATA 4   D7 D6 D5 D4 D3 D2 D1 D0    month   [1..12]
+//                I/O DATA 5   D7 D6 D5 D4 D3 D2 D1 D0    year    [0..99]
+//                I/O DATA 6   D7 D6 D5 D4 D3 D2 D1 D0    tempC   [-128..127] (7th data byte)
+//
+// NOTE 1: If RTC is not found all read values wil be = 0
+// NOTE 2: Overread data (more then 7 bytes read) will be = 0
+// NOTE 3: The temperature (Celsius) is a byte with two complement binary format [-128..127]
+// ------------------------------------------------------------------------------
+byte rdDateTime(void)
+{
+    if (foundRTC)
+    {
+        if (ioByteCnt == 0)
+        {
+            readRTC(&seconds, &minutes, &hours, &day, &month, &year, &tempC); // Read from RTC
+        }
+
+        if (ioByteCnt < 7)
+        {
+            // Send date/time (binary values) to Z80 bus
+            switch (ioByteCnt)
+            {
+                case 0: ioData = seconds; break;
+                case 1: ioData = minutes; break;
+                case 2: ioData = hours; break;
+                case 3: ioData = day; break;
+                case 4: ioData = month; break;
+                case 5: ioData = year; break;
+                case 6: ioData = tempC; break;
+            }
+            ioByteCnt++;
+        }
+    }
+    else
+    {
+        ioOpcode = 0xFF;                 // Nothing to do. Set ioOpcode = "No operation"
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// DISK EMULATION
+// ERRDISK - read the error code after a SELDISK, SELSECT, SELTRACK, WRITESECT, READSECT
+//           or SDMOUNT operation
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    DISK error code (binary)
+//
+//
+// Error codes table:
+//
+//    error code    | description
+// ---------------------------------------------------------------------------------------------------
+//        0         |  No error
+//        1         |  DISK_ERR: the function failed due to a hard error in the disk function,
+//                  |   a wrong FAT structure or an internal error
+//        2         |  NOT_READY: the storage device could not be initialized due to a hard error or
+//                  |   no medium
+//        3         |  NO_FILE: could not find the file
+//        4         |  NOT_OPENED: the file has not been opened
+//        5         |  NOT_ENABLED: the volume has not been mounted
+//        6         |  NO_FILESYSTEM: there is no valid FAT partition on the drive
+//        7         |  DENIED: no free directory entry or disk full (host files only)
+//       16         |  Illegal disk number
+//       17         |  Illegal track number
+//       18         |  Illegal sector number
+//       19         |  Reached an unexpected EOF
+//
+//
+//
+//
+// NOTE 1: ERRDISK code is referred to the previous SELDISK, SELSECT, SELTRACK, WRITESECT or READSECT
+//         operation
+// NOTE 2: Error codes from 0 to 6 come from the PetitFS library implementation
+// NOTE 3: ERRDISK must not be used to read the resulting error code after a SDMOUNT operation
+//         (see the SDMOUNT opcode)
+// ------------------------------------------------------------------------------
+byte rdErrDisk(void)
+{
+    ioData = diskErr;
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// DISK EMULATION
+// READSECT - read 512 data bytes sequentially from the current emulated disk/track/sector:
+//
+//                 I/O DATA:   D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                 I/O DATA 0  D7 D6 D5 D4 D3 D2 D1 D0    First Data byte
+//
+//                      |               |
+//                      |               |
+//                      |               |                 <510 Data Bytes>
+//                      |               |
+//
+//               I/O DATA 127  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    512th Data byte (Last byte)
+//
+//
+// Reads the current sector (512 bytes) of the current track/sector, one data byte each call.
+// All the 512 calls must be always performed sequentially to have a READSECT operation correctly done.
+// If an error occurs during the READSECT operation, all subsequent read data will be = 0.
+// If an error occurs calling any DISK EMULATION opcode (SDMOUNT excluded) immediately before the READSECT
+//  opcode call, all the read data will be will be = 0 and the READSECT operation will not be performed.
+// Errors are stored into "diskErr" (see ERRDISK opcode).
+//
+// NOTE 1: Before a READSECT operation at least a SELTRACK or a SELSECT must be always performed
+// NOTE 2: Remember to open the right "disk file" at first using the SELDISK opcode
+// ------------------------------------------------------------------------------
+byte rdReadSect(void)
+{
+    if (!ioByteCnt)
+    {
+        // First byte of 512, so set the right file pointer to the current emulated track/sector first
+        selectFileSD(DISKFILE_SD);
+        if ((trackSel < 512) && (sectSel < 32) && (!diskErr))
+        {
+            // Sector and track numbers valid and no previous error; set the LBA-like logical sector
+            diskErr = seekSD((trackSel << 5) | sectSel);  // Set the starting point inside the "disk file"
+                                                //  generating a 14 bit "disk file" LBA-like
+                                                //  logical sector address created as TTTTTTTTTSSSSS
+            SDSTATS_TRACK(trackSel);
+        }
+    }
+
+    if (!diskErr)
+    {
+        // No previous error (e.g. selecting disk, track or sector)
+        tempByte = ioByteCnt % 32;          // [0..31]
+        if (!tempByte)
+        {
+            // Read 32 bytes of the current sector on SD in the buffer (every 32 calls, starting with the first)
+            diskErr = readSD(bufferSD, &numReadBytes);
+            if (numReadBytes < 32)
+            {
+                diskErr = 19;    // Reached an unexpected EOF
+            }
+        }
+        if (!diskErr)
+        {
+            ioData = bufferSD[tempByte];// If no errors, exchange current data byte with the CPU
+        }
+    }
+    ioByteCnt++;                          // Increment the counter of the exchanged data bytes
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// DISK EMULATION
+// SDMOUNT - mount a volume on SD, returning an error code (binary):
+//
+//                 I/O DATA 0: D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    error code (binary)
+//
+//
+//
+// NOTE 1: This opcode is "normally" not used. Only needed if using a virtual disk from a custom program
+//         loaded with iLoad or with the Auto-boot mode (e.g. ViDiT). Can be used to handle SD hot-swapping
+// NOTE 2: For error codes explanation see ERRDISK opcode
+// NOTE 3: Only for this disk opcode, the resulting error is read as a data byte without using the
+//         ERRDISK opcode
+// ------------------------------------------------------------------------------
+byte rdSdMount(void)
+{
+    ioData = mountSD(&filesysSD);
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HOST FILES
+// FILEREAD - read 512 data bytes sequentially from the current host file sector:
+//
+//                 I/O DATA:   D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                 I/O DATA 0  D7 D6 D5 D4 D3 D2 D1 D0    First Data byte
+//
+//                      |               |
+//                      |               |
+//                      |               |                 <510 Data Bytes>
+//                      |               |
+//
+//               I/O DATA 511  D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                             D7 D6 D5 D4 D3 D2 D1 D0    512th Data byte (Last byte)
+//
+//
+// Reads the current sector (512 bytes) of the host file, one data byte each call, as READSECT does.
+// Bytes past the end of the file are read as 0x1A (CP/M EOF), so the file size can be found with
+//  FILESTAT.
+// After the 512th byte the host file sector is incremented.
+// Errors are stored into "hostErr" (see FILESTAT opcode).
+// ------------------------------------------------------------------------------
+byte rdFileRead(void)
+{
+    if (!ioByteCnt)
+    {
+        // First byte of 512, so set the right file pointer to the current sector first
+        selectFileSD(HOSTFILE_SD);
+        hostErr = seekSD(hostSect);
+    }
+
+    ioData = 0x1A;
+    if (!hostErr)
+    {
+        tempByte = ioByteCnt % 32;          // [0..31]
+        if (!tempByte)
+        {
+            // Read 32 bytes of the current sector on SD in the buffer (every 32 calls, starting with the first)
+            hostErr = readSD(bufferSD, &numReadBytes);
+        }
+        if ((!hostErr) && (tempByte < numReadBytes))
+        {
+            ioData = bufferSD[tempByte];    // If no errors and not past EOF, exchange current data byte
+        }
+    }
+    if (ioByteCnt >= 511)
+    {
+        hostSect++;
+    }
+    ioByteCnt++;                          // Increment the counter of the exchanged data bytes
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HOST FILES
+// DIRENTRY - read the next entry of the SD root directory (16 bytes):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                I/O DATA 0   D7 D6 D5 D4 D3 D2 D1 D0    1st char of the name    (1st data byte)
+//                    ...
+//                I/O DATA 10  D7 D6 D5 D4 D3 D2 D1 D0    3rd char of the extension
+//                I/O DATA 11  D7 D6 D5 D4 D3 D2 D1 D0    FAT attributes (0x10 = directory)
+//                I/O DATA 12  D7 D6 D5 D4 D3 D2 D1 D0    file size (bytes) LSB
+//                    ...
+//                I/O DATA 15  D7 D6 D5 D4 D3 D2 D1 D0    file size (bytes) MSB   (16th data byte)
+//
+//
+// The name is in the FCB format (8 + 3 chars, space padded, without the dot).
+// When there are no more entries all the 16 bytes are 0.
+// Errors are stored into "hostErr" (see FILESTAT opcode).
+//
+// NOTE: A FILEDIR must be done before the first DIRENTRY
+// ------------------------------------------------------------------------------
+byte rdDirEntry(void)
+{
+    if (!ioByteCnt)
+    {
+        hostErr = readDirSD(bufferSD);
+    }
+    ioData = bufferSD[ioByteCnt];
+    ioByteCnt++;
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HOST FILES
+// FILESTAT - read the error code of the last host file operation and the size of the host file:
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                I/O DATA 0   D7 D6 D5 D4 D3 D2 D1 D0    error code (binary, see ERRDISK)
+//                I/O DATA 1   D7 D6 D5 D4 D3 D2 D1 D0    file size (bytes) LSB
+//                I/O DATA 2   D7 D6 D5 D4 D3 D2 D1 D0    file size (bytes)
+//                I/O DATA 3   D7 D6 D5 D4 D3 D2 D1 D0    file size (bytes)
+//                I/O DATA 4   D7 D6 D5 D4 D3 D2 D1 D0    file size (bytes) MSB
+//
+//
+// NOTE: The file size is 0 if no host file is opened
+// ------------------------------------------------------------------------------
+byte rdFileStat(void)
+{
+    if (!ioByteCnt)
+    {
+        selectFileSD(HOSTFILE_SD);
+        ioData = hostErr;
+    }
+    else if (filesysSD.flag & FA_OPENED)
+    {
+        ioData = filesysSD.fsize >> ((ioByteCnt - 1) << 3);
+    }
+    ioByteCnt++;
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// HOST FILES
+// FILELOAD - open the host file named with FILENAME and read it from the current host file sector
+//            (see FILESECT) to the end, in a single opcode:
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                I/O DATA 0   D7 D6 D5 D4 D3 D2 D1 D0    error code (binary, see ERRDISK)
+//                I/O DATA 1   D7 D6 D5 D4 D3 D2 D1 D0    length (bytes) LSB
+//                I/O DATA 2   D7 D6 D5 D4 D3 D2 D1 D0    length (bytes) MSB
+//                I/O DATA 3   D7 D6 D5 D4 D3 D2 D1 D0    First data byte
+//
+//                      |               |
+//                      |               |                 <length - 2 Data Bytes>
+//                      |               |
+//
+//  I/O DATA length + 2        D7 D6 D5 D4 D3 D2 D1 D0    Last data byte
+//
+//
+// The length is the file size minus the starting sector offset, up to 65535 bytes (0 on errors).
+//  The data bytes follow without any other opcode, so the Z80 receives them where it wants with
+//  INIR (e.g. HL = target address, C = 0x00, B = 0x00 for each 256 bytes block, then B = length LSB,
+//  as the loader stub in BootLoader.cpp does). A whole sector is read from the SD at a time.
+// The host file stays open (FILESECT is not changed). Errors while reading are stored into "hostErr"
+//  (see FILESTAT opcode) and the remaining data bytes are read as 0x1A.
+//
+// NOTE: The Z80 may read less than length bytes: the next opcode ends the FILELOAD
+// ------------------------------------------------------------------------------
+byte rdFileLoad(void)
+{
+    if (!ioByteCnt)
+    {
+        // Open the file and compute the length
+        selectFileSD(HOSTFILE_SD);
+        hostErr = openSD(hostName);
+        loadLeftSD = 0;
+        if (!hostErr && (filesysSD.fsize > ((unsigned long) hostSect << 9)))
+        {
+            hostErr = seekSD(hostSect);
+            if (!hostErr)
+            {
+                loadLeftSD = min(filesysSD.fsize - ((unsigned long) hostSect << 9), 0xFFFFUL);
+            }
+        }
+        loadBytesSD = 0;
+        loadIndexSD = 0;
+        ioData = hostErr;
+    }
+    else if (ioByteCnt == 1)
+    {
+        ioData = lowByte(loadLeftSD);
+    }
+    else if (ioByteCnt == 2)
+    {
+        ioData = highByte(loadLeftSD);
+    }
+    else
+    {
+        if ((loadIndexSD == loadBytesSD) && !hostErr)
+        {
+            // Read the next sector (or what remains of the file)
+            hostErr = readBlockSD(loadBufSD, sizeof(loadBufSD), &loadBytesSD);
+            loadIndexSD = 0;
+            if (!hostErr && !loadBytesSD)
+            {
+                hostErr = 19;               // Reached an unexpected EOF
+            }
+        }
+        ioData = hostErr ? 0x1A : loadBufSD[loadIndexSD++];
+        loadLeftSD--;
+    }
+    if (ioByteCnt < 3)
+    {
+        ioByteCnt++;                        // The data bytes are counted by loadLeftSD
+    }
+    if ((ioByteCnt >= 3) && !loadLeftSD)
+    {
+        ioOpcode = 0xFF;                    // All done. Set ioOpcode = "No operation"
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// IOPROFILE - send the I/O requests latency statistics of the current run (see IoProfile.h):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                I/O DATA 0   D7 D6 D5 D4 D3 D2 D1 D0    number of slots (0 = profiler compiled out)
+//                I/O DATA 1   D7 D6 D5 D4 D3 D2 D1 D0    First byte of slot 0
+//
+//                      |               |
+//                      |               |                 <44 bytes for each slot>
+//                      |               |
+//
+//
+// Each slot is: count (4 bytes), min cycles (4 bytes), max cycles (4 bytes), then the 16 words of the
+//  log2 histogram (see IOP_BUCKETS), all LSB first. The slots are the write opcodes 0x00.., the read
+//  opcodes 0x80.., then STORE OPCODE, SERIAL RX and "other" (see IOP_STORE). Times are MCU cycles.
+// ------------------------------------------------------------------------------
+byte rdIoProfile(void)
+{
+    if (!ioByteCnt)
+    {
+        ioData = IO_PROFILE ? IOP_SLOTS : 0;
+    }
+    else
+    {
+        ioData = ioProfByte(ioByteCnt - 1);
+    }
+    ioByteCnt++;
+    if (ioByteCnt > IOP_DATASIZE)
+    {
+        ioOpcode = 0xFF;                    // All done. Set ioOpcode = "No operation"
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// SDSTATS - send the SD layer statistics since the Z80 start or the last SDSTATSCLR (see SdStats.h):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                I/O DATA 0   D7 D6 D5 D4 D3 D2 D1 D0    data size (0 = statistics compiled out)
+//                I/O DATA 1   D7 D6 D5 D4 D3 D2 D1 D0    First data byte
+//
+//                      |               |
+//                      |               |                 <data size - 1 bytes>
+//                      |               |
+//
+//
+// The data are (all LSB first): CMD17 count, CMD24 count, bytes read, bytes written, total card wait (us),
+//  longest card wait (us), get_fat() calls, pf_lseek() cluster hops (4 bytes each), then the READSECT/
+//  WRITESECT sectors of each 32 tracks bucket (16 words, saturated at 0xFFFF).
+// ------------------------------------------------------------------------------
+byte rdSdStats(void)
+{
+    if (!ioByteCnt)
+    {
+        ioData = SDS_DATASIZE;
+    }
+    else
+    {
+        ioData = sdStatsByte(ioByteCnt - 1);
+    }
+    ioByteCnt++;
+    if (ioByteCnt > SDS_DATASIZE)
+    {
+        ioOpcode = 0xFF;                    // All done. Set ioOpcode = "No operation"
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// TIMER - read the free running microseconds counter and the MCU cycles counter, both latched on the
+//         first byte:
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                I/O DATA 0   D7 D6 D5 D4 D3 D2 D1 D0    microseconds LSB        (1st data byte)
+//                I/O DATA 1   D7 D6 D5 D4 D3 D2 D1 D0    microseconds
+//                I/O DATA 2   D7 D6 D5 D4 D3 D2 D1 D0    microseconds
+//                I/O DATA 3   D7 D6 D5 D4 D3 D2 D1 D0    microseconds MSB
+//                I/O DATA 4   D7 D6 D5 D4 D3 D2 D1 D0    MCU cycles LSB
+//                I/O DATA 5   D7 D6 D5 D4 D3 D2 D1 D0    MCU cycles
+//                I/O DATA 6   D7 D6 D5 D4 D3 D2 D1 D0    MCU cycles
+//                I/O DATA 7   D7 D6 D5 D4 D3 D2 D1 D0    MCU cycles MSB          (8th data byte)
+//
+//
+// The microseconds are those of micros() (4us resolution, wrap around after about 71 minutes). The MCU
+//  cycles (F_CPU, e.g. 16 = 1us) come from the Timer1 timebase started with the Z80 (see IoProfile.h)
+//  and wrap around after about 268s @ 16MHz; they are 0 if it is compiled out (IO_PROFILE = IO_TRACE = 0).
+// A time interval is the difference of two readings (modulo 2^32). The Z80 may read only the first 4
+//  bytes: the next opcode ends the TIMER.
+//
+// NOTE: The first byte is served by the WAIT_ ISR, so the latching delay is always the same
+// ------------------------------------------------------------------------------
+byte rdTimer(void)
+{
+    byte    sreg;
+
+    if (!ioByteCnt)
+    {
+        sreg = SREG;
+        cli();
+        timerMicros = micros();
+#if IO_TIMEBASE
+        timerCycles = ioProfNow();
+#else
+        timerCycles = 0;
+#endif
+        SREG = sreg;
+    }
+    if (ioByteCnt < 4)
+    {
+        ioData = timerMicros >> (ioByteCnt << 3);
+    }
+    else
+    {
+        ioData = timerCycles >> ((ioByteCnt - 4) << 3);
+    }
+    ioByteCnt++;
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// MEMSTATS - send the SRAM usage, taken on the first byte (see MemStats.h):
+//
+//                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+//                            ---------------------------------------------------------
+//                I/O DATA 0   D7 D6 D5 D4 D3 D2 D1 D0    data size (0 = report compiled out)
+//                I/O DATA 1   D7 D6 D5 D4 D3 D2 D1 D0    First data byte
+//
+//                      |               |
+//                      |               |                 <data size - 1 bytes>
+//                      |               |
+//
+//
+// The data are 2 bytes words (LSB first), in bytes: .data, .bss, .noinit, heap, heap free list, stack now,
+//  stack high water mark, free RAM now, free RAM never used since the reset.
+// ------------------------------------------------------------------------------
+byte rdMemStats(void)
+{
+    if (!ioByteCnt)
+    {
+        latchMemStats();
+        ioData = MEM_DATASIZE;
+    }
+    else
+    {
+        ioData = memStatsByte(ioByteCnt - 1);
+    }
+    ioByteCnt++;
+    if (ioByteCnt > MEM_DATASIZE)
+    {
+        ioOpcode = 0xFF;                    // All done. Set ioOpcode = "No operation"
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// Opcodes tables (index = opcode for the write ones, opcode - 0x80 for the read ones)
+// ------------------------------------------------------------------------------
+const IoOpcode ioWrTable[IO_WR_OPCODES] PROGMEM = {
+    { wrUserLed,       1 },   // 0x00 USER LED
+    { wrSerialTx,      1 },   // 0x01 SERIAL TX
+    { ioNop,           1 },   // 0x02 (not used)
+    { wrGpioA,         1 },   // 0x03 GPIOA Write
+    { wrGpioB,         1 },   // 0x04 GPIOB Write
+    { wrIodirA,        1 },   // 0x05 IODIRA Write
+    { wrIodirB,        1 },   // 0x06 IODIRB Write
+    { wrGppuA,         1 },   // 0x07 GPPUA Write
+    { wrGppuB,         1 },   // 0x08 GPPUB Write
+    { wrSelDisk,       1 },   // 0x09 SELDISK
+    { wrSelTrack,      2 },   // 0x0A SELTRACK
+    { wrSelSect,       1 },   // 0x0B SELSECT
+    { wrWriteSect,   512 },   // 0x0C WRITESECT
+    { wrSetBank,       1 },   // 0x0D SETBANK
+    { wrFileName,      0 },   // 0x0E FILENAME
+    { wrFileOpen,      1 },   // 0x0F FILEOPEN
+    { wrFileSect,      2 },   // 0x10 FILESECT
+    { wrFileWrite,   512 },   // 0x11 FILEWRITE
+    { wrFileDir,       1 },   // 0x12 FILEDIR
+    { wrHibernate,     2 },   // 0x13 HIBERNATE
+    { wrWarmBoot,      1 },   // 0x14 WARMBOOT
+    { wrSdStatsClr,    1 },   // 0x15 SDSTATSCLR
+    { wrFileSize,      4 }    // 0x16 FILESIZE
+};
+
+const IoOpcode ioRdTable[IO_RD_OPCODES] PROGMEM = {
+    { rdUserKey,       1 },   // 0x80 USER KEY
+    { rdGpioA,         1 },   // 0x81 GPIOA Read
+    { rdGpioB,         1 },   // 0x82 GPIOB Read
+    { rdSysFlags,      1 },   // 0x83 SYSFLAGS
+    { rdDateTime,      7 },   // 0x84 DATETIME
+    { rdErrDisk,       1 },   // 0x85 ERRDISK
+    { rdReadSect,    512 },   // 0x86 READSECT
+    { rdSdMount,       1 },   // 0x87 SDMOUNT
+    { rdFileRead,    512 },   // 0x88 FILEREAD
+    { rdDirEntry,     16 },   // 0x89 DIRENTRY
+    { rdFileStat,      5 },   // 0x8A FILESTAT
+    { ioNop,           1 },   // 0x8B BOOTLOAD (boot loader stub only)
+    { ioNop,           1 },   // 0x8C SNAPSHOT (hibernate/resume stub only)
+    { rdFileLoad,      0 },   // 0x8D FILELOAD
+    { rdIoProfile,     0 },   // 0x8E IOPROFILE
+    { rdSdStats,       0 },   // 0x8F SDSTATS
+    { rdTimer,         8 },   // 0x90 TIMER
+    { rdMemStats,      0 }    // 0x91 MEMSTATS
+};
+
+// ------------------------------------------------------------------------------
+// Execute the current opcode on one data byte through its table entry (index = opcode
+//  position in the table, out of range = not defined). Returns IO_RESET if the Z80 was
+//  reset by the opcode, so there is no wait state to exit from.
+// ------------------------------------------------------------------------------
+byte execIoOpcode(const IoOpcode *table, byte tableSize, byte index)
+{
+    IoOpcode    entry;
+    byte        last;
+
+    if (index >= tableSize)
+    {
+        ioOpcode = 0xFF;                            // Not defined or "No operation"
+        return IO_OK;
+    }
+    memcpy_P(&entry, &table[index], sizeof(entry));
+    last = (ioByteCnt + 1) == entry.byteCnt;        // Taken first, as the handler counts the byte
+    if (entry.handler() == IO_RESET)
+    {
+        return IO_RESET;
+    }
+    if (last)
+    {
+        ioOpcode = 0xFF;                            // All done. Set ioOpcode = "No operation"
+    }
+    return IO_OK;
+}
+
+// ------------------------------------------------------------------------------
+// Main Processing Loop
+// ------------------------------------------------------------------------------
+void loop() 
+{
+    byte    pending = ioPending;                    // Read first: while set, the WAIT_ ISR queues nothing more
+
+    serviceIsrZ80();                                // Serial and instrumentation of the requests served by the ISR
+    if (pending)
+    { // I/O operation requested (left here by the WAIT_ ISR, see ISR(PCINT1_vect))
+        byte    traceOpcode = ioOpcode;             // Request state for the I/O events trace (see IOTRACE())
+        word    traceByteCnt = ioByteCnt;
+
+        if (!fastRead(WR_))
+        {// I/O WRITE operation requested
+            // ----------------------------------------
+            // VIRTUAL I/O WRITE OPERATIONS ENGINE
+            // ----------------------------------------
+            ioAddress = fastRead(AD0);                  // Read Z80 address bus line AD0 (PC2)
+            ioData = PINA;                              // Read Z80 data bus D0-D7 (PA0-PA7)
+            if (ioAddress)                              // Check the I/O address (only AD0 is checked!)
+            {
+                // .........................................................................................................
+                //
+                // AD0 = 1 (I/O write address = 0x01). STORE OPCODE.
+                //
+                // Store (write) an "I/O operation code" (Opcode) and reset the exchanged bytes counter.
+                //
+                // NOTE 1: An Opcode can be a write or read Opcode, if the I/O operation is read or write.
+                // NOTE 2: the STORE OPCODE operation must always precede an EXECUTE WRITE OPCODE or EXECUTE READ OPCODE 
+                //         operation.
+                // NOTE 3: For multi-byte read opcode (as DATETIME) read sequentially all the data bytes without to send
+                //         a STORE OPCODE operation before each data byte after the first one.
+                // .........................................................................................................
+                //
+                // Currently defined Opcodes for I/O write operations:
+                //
+                //   Opcode     Name            Exchanged bytes
+                // -------------------------------------------------
+                // Opcode 0x00  USER LED        1
+                // Opcode 0x01  SERIAL TX       1
+                // Opcode 0x03  GPIOA Write     1
+                // Opcode 0x04  GPIOB Write     1
+                // Opcode 0x05  IODIRA Write    1
+                // Opcode 0x06  IODIRB Write    1
+                // Opcode 0x07  GPPUA Write     1
+                // Opcode 0x08  GPPUB Write     1
+                // Opcode 0x09  SELDISK         1
+                // Opcode 0x0A  SELTRACK        2
                 // Opcode 0x0B  SELSECT         1  
                 // Opcode 0x0C  WRITESECT       512
                 // Opcode 0x0D  SETBANK         1
+                // Opcode 0x0E  FILENAME        1..13
+                // Opcode 0x0F  FILEOPEN        1
+                // Opcode 0x10  FILESECT        2
+                // Opcode 0x11  FILEWRITE       512
+                // Opcode 0x12  FILEDIR         1
+                // Opcode 0x13  HIBERNATE       2
+                // Opcode 0x14  WARMBOOT        1
+                // Opcode 0x15  SDSTATSCLR      1
+                // Opcode 0x16  FILESIZE        4
                 // Opcode 0xFF  No operation    1
                 //
                 //
@@ -726,6 +2372,16 @@ void loop()
                 // Opcode 0x85  ERRDISK         1
                 // Opcode 0x86  READSECT        512
                 // Opcode 0x87  SDMOUNT         1
+                // Opcode 0x88  FILEREAD        512
+                // Opcode 0x89  DIRENTRY        16
+                // Opcode 0x8A  FILESTAT        5
+                // Opcode 0x8B  BOOTLOAD        (used only at boot by the loader stub, see BootLoader.cpp)
+                // Opcode 0x8C  SNAPSHOT        (used only by the hibernate/resume stub, see Hibernate.cpp)
+                // Opcode 0x8D  FILELOAD        3..65538
+                // Opcode 0x8E  IOPROFILE       1..(1 + 44 * slots)
+                // Opcode 0x8F  SDSTATS         1..(1 + data size)
+                // Opcode 0x90  TIMER           1..8
+                // Opcode 0x91  MEMSTATS        1..(1 + data size)
                 // Opcode 0xFF  No operation    1
                 //
                 // See the following lines for the Opcodes details.
@@ -733,6 +2389,7 @@ void loop()
                 // .........................................................................................................     
                 ioOpcode = ioData;                        // Store the I/O operation code (Opcode)
                 ioByteCnt = 0;                            // Reset the exchanged bytes counter
+                IOLOG_STORE(ioData);
             }
             else
             {
@@ -744,763 +2401,739 @@ void loop()
                 // The code of the I/O write operation (Opcode) must be previously stored with a STORE OPCODE operation.
                 // .........................................................................................................
                 //
-                // Execute the requested I/O WRITE Opcode. The 0xFF value is reserved as "No operation".
-                switch (ioOpcode)
+                // Execute the requested I/O WRITE Opcode (see ioWrTable). The 0xFF value is reserved as "No operation".
+                IOLOG_BYTE(ioData);
+                if (execIoOpcode(ioWrTable, IO_WR_OPCODES, ioOpcode) == IO_RESET)
                 {
-                    // USER LED:      
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                              x  x  x  x  x  x  x  0    USER Led off
-                    //                              x  x  x  x  x  x  x  1    USER Led on
-                    case  0x00:
-                        if (ioData & B00000001)
-                        {
-                            digitalWrite(USER, LOW); 
-                        }
-                        else 
-                        {
-                            digitalWrite(USER, HIGH);
-                        }
-                        break;
-
-                    // SERIAL TX:     
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    ASCII char to be sent to serial
-                    case  0x01:
-                        Serial.write(ioData);
-                        break;
-
-                    // GPIOA Write (GPE Option):
-                    //
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    GPIOA value (see MCP23017 datasheet)
-                    case  0x03:
-                        if (moduleGPIO) 
-                        {
-                            Wire.beginTransmission(GPIOEXP_ADDR);
-                            Wire.write(GPIOA_REG);                // Select GPIOA
-                            Wire.write(ioData);                   // Write value
-                            Wire.endTransmission();
-                        }
-                        break;
-
-                    // GPIOB Write (GPE Option): 
-                    //   
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    GPIOB value (see MCP23017 datasheet)
-                    case  0x04:
-                        if (moduleGPIO) 
-                        {
-                            Wire.beginTransmission(GPIOEXP_ADDR);
-                            Wire.write(GPIOB_REG);                // Select GPIOB
-                            Wire.write(ioData);                   // Write value
-                            Wire.endTransmission();
-                        }
-                        break;
-
-                    // IODIRA Write (GPE Option):
-                    //
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    IODIRA value (see MCP23017 datasheet)
-                    case  0x05:
-                        if (moduleGPIO) 
-                        {
-                            Wire.beginTransmission(GPIOEXP_ADDR);
-                            Wire.write(IODIRA_REG);               // Select IODIRA
-                            Wire.write(ioData);                   // Write value
-                            Wire.endTransmission();
-                        }
-                        break;
-
-                    // IODIRB Write (GPE Option):
-                    //
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    IODIRB value (see MCP23017 datasheet)
-                    case  0x06:
-                        if (moduleGPIO) 
-                        {
-                            Wire.beginTransmission(GPIOEXP_ADDR);
-                            Wire.write(IODIRB_REG);               // Select IODIRB
-                            Wire.write(ioData);                   // Write value
-                            Wire.endTransmission();
-                        }
-                        break;
-
-                    // GPPUA Write (GPE Option):
-                    //
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    GPPUA value (see MCP23017 datasheet)
-                    case  0x07:
-                        if (moduleGPIO) 
-                        {
-                            Wire.beginTransmission(GPIOEXP_ADDR);
-                            Wire.write(GPPUA_REG);                // Select GPPUA
-                            Wire.write(ioData);                   // Write value
-                            Wire.endTransmission();
-                        }
-                        break;
-
-                    // GPPUB Write (GPIO Exp. Mod. ):
-                    //
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    GPPUB value (see MCP23017 datasheet)
-                    case  0x08:
-                        if (moduleGPIO) 
-                        {
-                            Wire.beginTransmission(GPIOEXP_ADDR);
-                            Wire.write(GPPUB_REG);                // Select GPPUB
-                            Wire.write(ioData);                   // Write value
-                            Wire.endTransmission();
-                        }
-                        break;
-
-                    // DISK EMULATION
-                    // SELDISK - select the emulated disk number (binary). 100 disks are supported [0..99]:
-                    //
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    DISK number (binary) [0..99]
-                    //
-                    //
-                    // Opens the "disk file" corresponding to the selected disk number, doing some checks.
-                    // A "disk file" is a binary file that emulates a disk using a LBA-like logical sector number.
-                    // Every "disk file" must have a dimension of 8388608 bytes, corresponding to 16384 LBA-like logical sectors
-                    //  (each sector is 512 bytes long), corresponding to 512 tracks of 32 sectors each (see SELTRACK and 
-                    //  SELSECT opcodes).
-                    // Errors are stored into "errDisk" (see ERRDISK opcode).
-                    //
-                    //
-                    // ...........................................................................................
-                    //
-                    // "Disk file" filename convention:
-                    //
-                    // Every "disk file" must follow the syntax "DSsNnn.DSK" where
-                    //
-                    //    "s" is the "disk set" and must be in the [0..9] range (always one numeric ASCII character)
-                    //    "nn" is the "disk number" and must be in the [00..99] range (always two numeric ASCII characters)
-                    //
-                    // ...........................................................................................
-                    //          
-                    //
-                    // NOTE 1: The maximum disks number may be lower due the limitations of the used OS (e.g. CP/M 2.2 supports
-                    //         a maximum of 16 disks)
-                    // NOTE 2: Because SELDISK opens the "disk file" used for disk emulation, before using WRITESECT or READSECT
-                    //         a SELDISK must be performed at first.
-                    case  0x09:
-                        if (ioData <= maxDiskNum)               // Valid disk number
-                        {
-                            // Set the name of the file to open as virtual disk, and open it
-                            diskName[2] = diskSet + 48;           // Set the current Disk Set
-                            diskName[4] = (ioData / 10) + 48;     // Set the disk number
-                            diskName[5] = ioData - ((ioData / 10) * 10) + 48;
-                            diskErr = openSD(diskName);           // Open the "disk file" corresponding to the given disk number
-                        }
-                        else 
-                        {
-                            diskErr = 16;                      // Illegal disk number
-                        }
-                        break;
-
-                    // DISK EMULATION
-                    // SELTRACK - select the emulated track number (word splitted in 2 bytes in sequence: DATA 0 and DATA 1):
-                    //
-                    //                I/O DATA 0:  D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    Track number (binary) LSB [0..255]
-                    //
-                    //                I/O DATA 1:  D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    Track number (binary) MSB [0..1]
-                    //
-                    //
-                    // Stores the selected track number into "trackSel" for "disk file" access.
-                    // A "disk file" is a binary file that emulates a disk using a LBA-like logical sector number.
-                    // The SELTRACK and SELSECT operations convert the legacy track/sector address into a LBA-like logical 
-                    //  sector number used to set the logical sector address inside the "disk file".
-                    // A control is performed on both current sector and track number for valid values. 
-                    // Errors are stored into "diskErr" (see ERRDISK opcode).
-                    //
-                    //
-                    // NOTE 1: Allowed track numbers are in the range [0..511] (512 tracks)
-                    // NOTE 2: Before a WRITESECT or READSECT operation at least a SELSECT or a SELTRAK operation
-                    //         must be performed
-                    case  0x0A:
-                        if (!ioByteCnt)
-                        {
-                            // LSB
-                            trackSel = ioData;
-                        }
-                        else
-                        {
-                            // MSB
-                            trackSel = (((word) ioData) << 8) | lowByte(trackSel);
-                            if ((trackSel < 512) && (sectSel < 32))
-                            {
-                                // Sector and track numbers valid
-                                diskErr = 0;                      // No errors
-                            }
-                            else
-                            {
-                                // Sector or track invalid number
-                                if (sectSel < 32) 
-                                {
-                                    diskErr = 17;     // Illegal track number
-                                }
-                                else 
-                                {
-                                    diskErr = 18;                  // Illegal sector number
-                                }
-                            }
-                            ioOpcode = 0xFF;                      // All done. Set ioOpcode = "No operation"
-                        }
-                        ioByteCnt++;
-                        break;
-
-                    // DISK EMULATION
-                    // SELSECT - select the emulated sector number (binary):
-                    //
-                    //                  I/O DATA:  D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    Sector number (binary) [0..31]
-                    //
-                    //
-                    // Stores the selected sector number into "sectSel" for "disk file" access.
-                    // A "disk file" is a binary file that emulates a disk using a LBA-like logical sector number.
-                    // The SELTRACK and SELSECT operations convert the legacy track/sector address into a LBA-like logical 
-                    //  sector number used to set the logical sector address inside the "disk file".
-                    // A control is performed on both current sector and track number for valid values. 
-                    // Errors are stored into "diskErr" (see ERRDISK opcode).
-                    //
-                    //
-                    // NOTE 1: Allowed sector numbers are in the range [0..31] (32 sectors)
-                    // NOTE 2: Before a WRITESECT or READSECT operation at least a SELSECT or a SELTRAK operation
-                    //         must be performed
-                    case  0x0B:
-                        sectSel = ioData;
-                        if ((trackSel < 512) && (sectSel < 32))
-                        {
-                            // Sector and track numbers valid
-                            diskErr = 0;                        // No errors
-                        }
-                        else
-                        {
-                            // Sector or track invalid number
-                            if (sectSel < 32) 
-                            {
-                                diskErr = 17;     // Illegal track number
-                            }
-                            else 
-                            {
-                                diskErr = 18;                  // Illegal sector number
-                            }
-                        }
-                        break;
-
-                    // DISK EMULATION
-                    // WRITESECT - write 512 data bytes sequentially into the current emulated disk/track/sector:
-                    //
-                    //                 I/O DATA 0: D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    First Data byte
-                    //
-                    //                      |               |
-                    //                      |               |
-                    //                      |               |                 <510 Data Bytes>
-                    //                      |               |
-                    //
-                    //               I/O DATA 511: D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    512th Data byte (Last byte)
-                    //
-                    //
-                    // Writes the current sector (512 bytes) of the current track/sector, one data byte each call. 
-                    // All the 512 calls must be always performed sequentially to have a WRITESECT operation correctly done. 
-                    // If an error occurs during the WRITESECT operation, all subsequent write data will be ignored and
-                    //  the write finalization will not be done.
-                    // If an error occurs calling any DISK EMULATION opcode (SDMOUNT excluded) immediately before the WRITESECT 
-                    //  opcode call, all the write data will be ignored and the WRITESECT operation will not be performed.
-                    // Errors are stored into "diskErr" (see ERRDISK opcode).
-                    //
-                    // NOTE 1: Before a WRITESECT operation at least a SELTRACK or a SELSECT must be always performed
-                    // NOTE 2: Remember to open the right "disk file" at first using the SELDISK opcode
-                    // NOTE 3: The write finalization on SD "disk file" is executed only on the 512th data byte exchange, so be 
-                    //         sure that exactly 512 data bytes are exchanged.
-                    case  0x0C:
-                        if (!ioByteCnt)
-                        {
-                            // First byte of 512, so set the right file pointer to the current emulated track/sector first
-                            if ((trackSel < 512) && (sectSel < 32) && (!diskErr))
-                            {
-                                // Sector and track numbers valid and no previous error; set the LBA-like logical sector
-                                diskErr = seekSD((trackSel << 5) | sectSel);  // Set the starting point inside the "disk file"
-                                                                  //  generating a 14 bit "disk file" LBA-like 
-                                                                  //  logical sector address created as TTTTTTTTTSSSSS
-                            }
-                        }
-
-                        if (!diskErr)
-                        {
-                            // No previous error (e.g. selecting disk, track or sector)
-                            tempByte = ioByteCnt % 32;            // [0..31]
-                            bufferSD[tempByte] = ioData;          // Store current exchanged data byte in the buffer array
-                            if (tempByte == 31)
-                            {
-                                // Buffer full. Write all the buffer content (32 bytes) into the "disk file"
-                                diskErr = writeSD(bufferSD, &numWriBytes);
-                                if (numWriBytes < 32) 
-                                {
-                                    diskErr = 19; // Reached an unexpected EOF
-                                }
-
-                                if (ioByteCnt >= 511)
-                                {
-                                    // Finalize write operation and check result (if no previous error occurred)
-                                    if (!diskErr) 
-                                    {
-                                        diskErr = writeSD(NULL, &numWriBytes);
-                                    }
-                                    ioOpcode = 0xFF;                  // All done. Set ioOpcode = "No operation"
-                                }
-                            }
-                        }
-                        ioByteCnt++;                            // Increment the counter of the exchanged data bytes
-                        break;
-
-                    // BANKED RAM
-                    // SETBANK - select the Os RAM Bank (binary):
-                    //
-                    //                  I/O DATA:  D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    Os Bank number (binary) [0..2]
-                    //
-                    //
-                    // Set a 32kB RAM bank for the lower half of the Z80 address space (from 0x0000 to 0x7FFF).
-                    // The upper half (from 0x8000 to 0xFFFF) is the common fixed bank.
-                    // Allowed Os Bank numbers are from 0 to 2.
-                    //
-                    // Please note that there are three kinds of Bank numbers (see the A040618 schematic):
-                    //
-                    // * the "Os Bank" number is the bank number managed (known) by the Os;
-                    // * the "Logical Bank" number is the bank seen by the Atmega32a (through BANK1 and BANK0 address lines);
-                    // * the "Physical Bank" number is the real bank addressed inside the RAM chip (RAM_A16 and RAM_A15 RAM 
-                    //   address lines).
-                    //
-                    // The following tables shows the relations:
-                    //
-                    //
-                    //  Os Bank | Logical Bank |  Z80 Address Bus    |   Physical Bank   |            Notes
-                    //  number  | BANK1 BANK0  |        A15          |  RAM_A16 RAM_A15  |
-                    // ------------------------------------------------------------------------------------------------
-                    //     X    |   X     X    |         1           |     0       1     |  Phy Bank 1 (common fixed)
-                    //     -    |   0     0    |         0           |     0       1     |  Phy Bank 1 (common fixed)
-                    //     0    |   0     1    |         0           |     0       0     |  Phy Bank 0 (Logical Bank 1)
-                    //     2    |   1     0    |         0           |     1       1     |  Phy Bank 3 (Logical Bank 2)
-                    //     1    |   1     1    |         0           |     1       0     |  Phy Bank 2 (Logical Bank 3)
-                    //
-                    //
-                    //
-                    //      Physical Bank      |    Logical Bank     |   Physical Bank   |   Physical RAM Addresses
-                    //          number         |       number        |  RAM_A16 RAM_A15  |
-                    // ------------------------------------------------------------------------------------------------
-                    //            0            |         1           |     0       0     |   From 0x00000 to 0x07FFF 
-                    //            1            |         0           |     0       1     |   From 0x08000 to 0x0FFFF
-                    //            2            |         3           |     1       0     |   From 0x01000 to 0x17FFF
-                    //            3            |         2           |     1       1     |   From 0x18000 to 0x1FFFF
-                    //
-                    //
-                    // Note that the Logical Bank 0 can't be used as switchable Os Bank bacause it is the common 
-                    //  fixed bank mapped in the upper half of the Z80 address space (from 0x8000 to 0xFFFF).
-                    //
-                    //
-                    // NOTE: If the Os Bank number is greater than 2 no selection is done.
-                    case  0x0D:
-                        switch (ioData)
-                        {
-                            // Set physical bank 0 (logical bank 1)
-                            case 0:                               // Os bank 0
-                                digitalWrite(BANK0, HIGH);
-                                digitalWrite(BANK1, LOW);
-                                break;
-
-                            // Set physical bank 2 (logical bank 3)
-                            case 1:                               // Os bank 1
-                                digitalWrite(BANK0, HIGH);
-                                digitalWrite(BANK1, HIGH);
-                                break;  
-
-                            // Set physical bank 3 (logical bank 2)
-                            case 2:                               // Os bank 2
-                                digitalWrite(BANK0, LOW);
-                                digitalWrite(BANK1, HIGH);
-                                break;  
-                        }
-                        break;
-
-                } // switch
-                
-                if ((ioOpcode != 0x0A) && (ioOpcode != 0x0C)) 
+                    IOPROF_CANCEL();
+                    IOTRACE(IOT_WRITE, traceOpcode, traceByteCnt);
+                    return;                                 // The Z80 was reset: no wait state to exit from
+                }
+            }
+
+            // Control bus sequence to exit from a wait state (M I/O write cycle)
+            cli();                                      // No WAIT_ ISR until the next I/O request is given back to it
+            fastWrite(BUSREQ_, LOW);                    // Request for a DMA
+            fastWrite(WAIT_RES_, LOW);                  // Reset WAIT FF exiting from WAIT state
+            fastWrite(WAIT_RES_, HIGH);                 // Now Z80 is in DMA, so it's safe set WAIT_RES_ HIGH again
+            fastWrite(BUSREQ_, HIGH);                   // Resume Z80 from DMA
+            IOPROF_END();
+            releaseIoZ80();
+            IOTRACE(ioAddress ? IOT_WRITE | IOT_AD0 : IOT_WRITE, ioAddress ? ioOpcode : traceOpcode, traceByteCnt);
+        }
+        else if (!fastRead(RD_))
+        {
+            // I/O READ operation requested
+
+// ----------------------------------------
+// VIRTUAL I/O READ OPERATIONS ENGINE
+// ----------------------------------------
+            ioAddress = fastRead(AD0);                // Read Z80 address bus line AD0 (PC2)
+            ioData = 0;                               // Clear input data buffer
+            if (ioAddress)                            // Check the I/O address (only AD0 is checked!)
+            {
+                // .........................................................................................................
+                //
+                // AD0 = 1 (I/O read address = 0x01). SERIAL RX.
+                //
+                // Execute a Serial I/O Read operation.
+                // .........................................................................................................
+                //
+                //
+                // SERIAL RX:     
+                //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
+                //                            ---------------------------------------------------------
+                //                             D7 D6 D5 D4 D3 D2 D1 D0    ASCII char read from serial
+                //
+                // NOTE 1: If there is no input char, a value 0xFF is forced as input char.
+                // NOTE 2: The INT_ signal is always reset (set to HIGH) after this I/O operation.
+                // NOTE 3: This is the only I/O that do not require any previous STORE OPCODE operation (for fast polling).
+                // NOTE 4: A "RX buffer empty" flag and a "Last Rx char was empty" flag are available in the SYSFLAG opcode 
+                //         to allow 8 bit I/O.
+                //
+                int rxChar = readRxZ80();             // The chars already taken for the WAIT_ ISR first
+
+                ioData = 0xFF;
+                if (rxChar >= 0)
+                {
+                    ioData = rxChar;
+                    LastRxIsEmpty = 0;                // Reset the "Last Rx char was empty" flag
+                }
+                else 
+                {
+                    LastRxIsEmpty = 1;             // Set the "Last Rx char was empty" flag
+                }
+                fastWrite(INT_, HIGH);
+            }
+            else
+            {
+                // .........................................................................................................
+                //
+                // AD0 = 0 (I/O read address = 0x00). EXECUTE READ OPCODE.
+                //
+                // Execute the previously stored I/O read operation with the current data.
+                // The code of the I/O operation (Opcode) must be previously stored with a STORE OPCODE operation.
+                //
+                // NOTE: For multi-byte read opcode (as DATETIME) read sequentially all the data bytes without to send
+                //       a STORE OPCODE operation before each data byte after the first one.
+                // .........................................................................................................
+                //
+                // Execute the requested I/O READ Opcode (see ioRdTable). The 0xFF value is reserved as "No operation".
+                execIoOpcode(ioRdTable, IO_RD_OPCODES, ioOpcode - 0x80);
+                IOLOG_BYTE(ioData);
+            }
+            
+            DDRA = 0xFF;                              // Configure Z80 data bus D0-D7 (PA0-PA7) as output
+            PORTA = ioData;                           // Current output on data bus
+
+            // Control bus sequence to exit from a wait state (M I/O read cycle)
+            cli();                                    // No WAIT_ ISR until the next I/O request is given back to it
+            fastWrite(BUSREQ_, LOW);                  // Request for a DMA
+            fastWrite(WAIT_RES_, LOW);                // Now is safe reset WAIT FF (exiting from WAIT state)
+            holdIoReadZ80();                          // Wait until the Z80 latched the data (IO_READ_HOLD_CLK clocks)
+            DDRA = 0x00;                              // Configure Z80 data bus D0-D7 (PA0-PA7) as input with pull-up
+            PORTA = 0xFF;
+            fastWrite(WAIT_RES_, HIGH);               // Now Z80 is in DMA (HiZ), so it's safe set WAIT_RES_ HIGH again
+            fastWrite(BUSREQ_, HIGH);                 // Resume Z80 from DMA
+            IOPROF_END();
+            releaseIoZ80();
+            IOTRACE(ioAddress ? IOT_READ | IOT_AD0 : IOT_READ, traceOpcode, traceByteCnt);
+        }
+        else
+        {
+            // INTERRUPT operation setting IORQ_ LOW, so nothing to do
+// ----------------------------------------
+// VIRTUAL INTERRUPT
+// ----------------------------------------
+            // Nothing to do
+            //
+            // DEBUG ----------------------------------
+            if (debug > 2) 
+            {
+                Serial.println();
+                Serial.println("DEBUG: INT operation (nothing to do)");
+            }
+            // DEBUG END ------------------------------
+            //
+
+            // Control bus sequence to exit from a wait state (M interrupt cycle)
+            cli();                                    // No WAIT_ ISR until the next I/O request is given back to it
+            fastWrite(BUSREQ_, LOW);                  // Request for a DMA
+            fastWrite(WAIT_RES_, LOW);                // Reset WAIT FF exiting from WAIT state
+            fastWrite(WAIT_RES_, HIGH);               // Now Z80 is in DMA, so it's safe set WAIT_RES_ HIGH again
+            fastWrite(BUSREQ_, HIGH);                 // Resume Z80 from DMA
+            IOPROF_END();
+            releaseIoZ80();
+            IOTRACE(IOT_INT, traceOpcode, traceByteCnt);
+        }
+    }
+    else if ((millis() - userKeyTime) >= userKeyPoll)
+    {
+        // No I/O request: poll the USER key. Held down for warmBootHold polls means warm boot,
+        //  a short press (traceKeyHold polls at least) freezes the I/O events trace and prints it,
+        //  or restarts it if it was already frozen. The trace is frozen as soon as the press is
+        //  seen, so the events before it (the problem the user is looking at) are kept.
+        userKeyTime = millis();
+        cli();                                        // The WAIT_ ISR may write the USER led meanwhile
+        tempByte = fastRead(USER);                    // Save USER led status
+        fastMode(USER, INPUT_PULLUP);                 // Read USER Key
+        iCount = fastRead(USER);
+        fastMode(USER, OUTPUT); 
+        fastWrite(USER, tempByte);                    // Restore USER led status
+        sei();
+        if (!iCount)
+        {
+            userKeyCnt++;
+            if (userKeyCnt == traceKeyHold)
+            {
+                traceKeyFrozen = freezeIoTrace(1);
+            }
+        }
+        else
+        {
+            if (userKeyCnt >= traceKeyHold)
+            {
+                ioPending = 1;                        // The Z80 waits at its next I/O request, so its output
+                flushTxZ80();                         //  does not mix with this one
+                Serial.println();
+                if (traceKeyFrozen)
+                {
+                    freezeIoTrace(0);
+                    Serial.println(F("IOS: I/O events trace restarted"));
+                }
+                else
+                {
+                    printIoTrace();
+                    Serial.println(F("IOS: I/O events trace frozen (press USER again to restart it)"));
+                }
+                releaseIoZ80();
+            }
+            userKeyCnt = 0;
+        }
+        if (userKeyCnt >= warmBootHold)
+        {
+            userKeyCnt = 0;
+            freezeIoTrace(traceKeyFrozen);            // Not a short press: the trace goes on as it was
+            warmBootZ80();
+        }
+    }
+    else
+    {
+        syncHostSD();                                 // No I/O request: write the host file size if still pending
+        tempByte = IOLOG_FLUSH();                     //  and the I/O log sectors to SD if needed
+        if (tempByte)
+        {
+            ioPending = 1;                            // No SERIAL TX served by the WAIT_ ISR while printing
+            flushTxZ80();
+            printErrSD(3, tempByte, IOLOG_FILE);
+            Serial.println(F("IOS: I/O log off"));
+            releaseIoZ80();
+        }
+    }
+} // end of loop
+
+// ------------------------------------------------------------------------------
+// Load the boot program selected in setup() (bootMode, BootStrAddr, fileNameSD...) 
+//  into RAM, injecting the JP to its starting address if needed. The Z80 is left in
+//  reset, ready to be started.
+// ------------------------------------------------------------------------------
+void loadBootProgram(void)
+{
+    fastWrite(WAIT_RES_, HIGH);                     // Set WAIT_RES_ HIGH (Led LED_0 ON)
+  
+    // Load a JP instruction if the boot program starting addr is > 0x0000
+    if (BootStrAddr > 0x0000)                       // Check if the boot program starting addr > 0x0000
+    {
+        // Inject a "JP <BootStrAddr>" instruction to jump at boot starting address
+        loadHL(0x0000);                             // HL = 0x0000 (used as pointer to RAM)
+        writeByteToRAM(JP_nn);                       // Write the JP opcode @ 0x0000;
+        writeByteToRAM(lowByte(BootStrAddr));        // Write LSB to jump @ 0x0001
+        writeByteToRAM(highByte(BootStrAddr));       // Write MSB to jump @ 0x0002
+        //
+        // DEBUG ----------------------------------
+        if (debug)
+        {
+            Serial.print("DEBUG: Injected JP 0x");
+            Serial.println(BootStrAddr, HEX);
+        }
+        // DEBUG END ------------------------------
+        //
+    }
+
+    // Execute the load of the selected file on SD or image on flash
+    //
+    // DEBUG ----------------------------------
+    if (debug)
+    {
+        Serial.print("DEBUG: Flash BootImageSize = ");
+        Serial.println(BootImageSize);
+        Serial.print("DEBUG: BootStrAddr = ");
+        Serial.println(BootStrAddr, HEX);    
+    }
+    // DEBUG END ------------------------------
+    //
+    
+    // Load from flash a packed boot program (no SD needed)
+    if (packedBoot)
+    {
+        if (!fastBoot)
+        {
+            Serial.print("IOS: Loading boot program (");
+            Serial.print(packedImage.name);
+            Serial.print(", flash)...");
+        }
+        bootTrace(BT_OPEN);
+        loadFlashImageZ80(BootStrAddr, &packedImage, clockMode);
+    }
+#if WARMBOOT_CACHE
+    // Load again the copy of the program read from SD at the previous boot (warm boot only)
+    else if ((bootMode < 4) && warmImageSize)
+    {
+        if (streamImageZ80(BootStrAddr, warmImageSize, warmImage, IMAGE_SRAM, clockMode))
+        {
+            loadHL(BootStrAddr);                    // Set Z80 HL = boot starting address (used as pointer to RAM);
+            for (word i = 0; i < warmImageSize; i++)
+            {
+                writeByteToRAM(warmImage[i]);       // Write current data byte into RAM
+            }
+        }
+    }
+#endif
+    // Load from SD
+    else if (bootMode < 4)
+    {
+        // Mount a volume on SD (already done with a fast boot, if no error occurred)
+        if ((!fastBoot || errCodeSD) && mountSD(&filesysSD))
+        {
+            // Error mounting. Try again
+            errCodeSD = mountSD(&filesysSD);
+            if (errCodeSD)
+            {
+                // Error again. Repeat until error disappears (or the user forces a reset)
+                waitUTerm();
+                do
                 {
-                    ioOpcode = 0xFF;    // All done for the single byte opcodes. 
-                                        //  Set ioOpcode = "No operation"
-                }
+                    printErrSD(0, errCodeSD, NULL);
+                    waitKey(SD_ERROR_RETRY);                                // Wait a key to repeat
+                    mountSD(&filesysSD);                      // New double try
+                    errCodeSD = mountSD(&filesysSD);
+                } while (errCodeSD);
             }
-
-            // Control bus sequence to exit from a wait state (M I/O write cycle)
-            digitalWrite(BUSREQ_, LOW);                 // Request for a DMA
-            digitalWrite(WAIT_RES_, LOW);               // Reset WAIT FF exiting from WAIT state
-            digitalWrite(WAIT_RES_, HIGH);              // Now Z80 is in DMA, so it's safe set WAIT_RES_ HIGH again
-            digitalWrite(BUSREQ_, HIGH);                // Resume Z80 from DMA
         }
-        else if (!digitalRead(RD_))
-        {
-            // I/O READ operation requested
 
-// ----------------------------------------
-// VIRTUAL I/O READ OPERATIONS ENGINE
-// ----------------------------------------
-            ioAddress = digitalRead(AD0);             // Read Z80 address bus line AD0 (PC2)
-            ioData = 0;                               // Clear input data buffer
-            if (ioAddress)                            // Check the I/O address (only AD0 is checked!)
+        // Open the selected file to load
+        selectFileSD(BOOTFILE_SD);
+        errCodeSD = openSD(fileNameSD);
+        if (errCodeSD)
+        {
+            // Error opening the required file. Repeat until error disappears (or the user forces a reset)
+            waitUTerm();
+            do
             {
-                // .........................................................................................................
-                //
-                // AD0 = 1 (I/O read address = 0x01). SERIAL RX.
-                //
-                // Execute a Serial I/O Read operation.
-                // .........................................................................................................
-                //
-                //
-                // SERIAL RX:     
-                //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                //                            ---------------------------------------------------------
-                //                             D7 D6 D5 D4 D3 D2 D1 D0    ASCII char read from serial
-                //
-                // NOTE 1: If there is no input char, a value 0xFF is forced as input char.
-                // NOTE 2: The INT_ signal is always reset (set to HIGH) after this I/O operation.
-                // NOTE 3: This is the only I/O that do not require any previous STORE OPCODE operation (for fast polling).
-                // NOTE 4: A "RX buffer empty" flag and a "Last Rx char was empty" flag are available in the SYSFLAG opcode 
-                //         to allow 8 bit I/O.
-                //
-                ioData = 0xFF;
-                if (Serial.available() > 0)
-                {
-                    ioData = Serial.read();
-                    LastRxIsEmpty = 0;                // Reset the "Last Rx char was empty" flag
-                }
-                else 
+                printErrSD(1, errCodeSD, fileNameSD);
+                waitKey(SD_ERROR_RETRY);                                  // Wait a key to repeat
+                errCodeSD = openSD(fileNameSD);
+                if (errCodeSD != 3)
                 {
-                    LastRxIsEmpty = 1;             // Set the "Last Rx char was empty" flag
+                    // Try to do a two mount operations followed by an open
+                    mountSD(&filesysSD);
+                    mountSD(&filesysSD);
+                    selectFileSD(BOOTFILE_SD);
+                    errCodeSD = openSD(fileNameSD);
                 }
-                digitalWrite(INT_, HIGH);
-            }
-            else
+            } while (errCodeSD);
+        }
+        bootTrace(BT_OPEN);
+        
+        // Read the selected file from SD and load it into RAM until an EOF is reached
+        if (!fastBoot)
+        {
+            Serial.print("IOS: Loading boot program (");
+            Serial.print(fileNameSD);
+            Serial.print(")...");
+        }
+
+        // If an error occurs repeat until error disappears (or the user forces a reset)
+        do
+        {
+            // Stream the file to the Z80 through the loader stub (see BootLoader.cpp)
+            errCodeSD = streamImageZ80(BootStrAddr, filesysSD.fsize, NULL, IMAGE_RAW, clockMode);
+            if (errCodeSD == BOOTLOAD_LEGACY)
             {
-                // .........................................................................................................
-                //
-                // AD0 = 0 (I/O read address = 0x00). EXECUTE READ OPCODE.
-                //
-                // Execute the previously stored I/O read operation with the current data.
-                // The code of the I/O operation (Opcode) must be previously stored with a STORE OPCODE operation.
-                //
-                // NOTE: For multi-byte read opcode (as DATETIME) read sequentially all the data bytes without to send
-                //       a STORE OPCODE operation before each data byte after the first one.
-                // .........................................................................................................
-                //
-                // Execute the requested I/O READ Opcode. The 0xFF value is reserved as "No operation".
-                switch (ioOpcode)
-                {
-                    // USER KEY:      
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                              0  0  0  0  0  0  0  0    USER Key not pressed
-                    //                              0  0  0  0  0  0  0  1    USER Key pressed
-                    case  0x80:
-                        tempByte = digitalRead(USER);         // Save USER led status
-                        pinMode(USER, INPUT_PULLUP);          // Read USER Key
-                        ioData = !digitalRead(USER);
-                        pinMode(USER, OUTPUT); 
-                        digitalWrite(USER, tempByte);         // Restore USER led status
-                        break;
-
-                    // GPIOA Read (GPE Option):
-                    //
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    GPIOA value (see MCP23017 datasheet)
-                    //
-                    // NOTE: a value 0x00 is forced if the GPE Option is not present
-                    case  0x81:
-                        if (moduleGPIO) 
-                        {
-                            // Set MCP23017 pointer to GPIOA
-                            Wire.beginTransmission(GPIOEXP_ADDR);
-                            Wire.write(GPIOA_REG);
-                            Wire.endTransmission();
-                            // Read GPIOA
-                            Wire.beginTransmission(GPIOEXP_ADDR);
-                            Wire.requestFrom(GPIOEXP_ADDR, 1);
-                            ioData = Wire.read();
-                        }
-                        break;
-
-                    // GPIOB Read (GPE Option):
-                    //
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    GPIOB value (see MCP23017 datasheet)
-                    //
-                    // NOTE: a value 0x00 is forced if the GPE Option is not present
-                    case  0x82:
-                        if (moduleGPIO) 
-                        {
-                            // Set MCP23017 pointer to GPIOB
-                            Wire.beginTransmission(GPIOEXP_ADDR);
-                            Wire.write(GPIOB_REG);
-                            Wire.endTransmission();
-                            // Read GPIOB
-                            Wire.beginTransmission(GPIOEXP_ADDR);
-                            Wire.requestFrom(GPIOEXP_ADDR, 1);
-                            ioData = Wire.read();
-                        }
-                        break;
-
-                    // SYSFLAGS (Various system flags for the OS):
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                              X  X  X  X  X  X  X  0    AUTOEXEC not enabled
-                    //                              X  X  X  X  X  X  X  1    AUTOEXEC enabled
-                    //                              X  X  X  X  X  X  0  X    DS3231 RTC not found
-                    //                              X  X  X  X  X  X  1  X    DS3231 RTC found
-                    //                              X  X  X  X  X  0  X  X    Serial RX buffer empty
-                    //                              X  X  X  X  X  1  X  X    Serial RX char available
-                    //                              X  X  X  X  0  X  X  X    Previous RX char valid
-                    //                              X  X  X  X  1  X  X  X    Previous RX char was a "buffer empty" flag
-                    //
-                    // NOTE: Currently only D0-D3 are used
-                    case  0x83:
-                        ioData = autoexecFlag | (foundRTC << 1) | ((Serial.available() > 0) << 2) | ((LastRxIsEmpty > 0) << 3);
-                        break;
-
-                    // DATETIME (Read date/time and temperature from the RTC. Binary values): 
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                I/O DATA 0   D7 D6 D5 D4 D3 D2 D1 D0    seconds [0..59]     (1st data byte)
-                    //                I/O DATA 1   D7 D6 D5 D4 D3 D2 D1 D0    minutes [0..59]
-                    //                I/O DATA 2   D7 D6 D5 D4 D3 D2 D1 D0    hours   [0..23]
-                    //                I/O DATA 3   D7 D6 D5 D4 D3 D2 D1 D0    day     [1..31]
-                    //                I/O DATA 4   D7 D6 D5 D4 D3 D2 D1 D0    month   [1..12]
-                    //                I/O DATA 5   D7 D6 D5 D4 D3 D2 D1 D0    year    [0..99]
-                    //                I/O DATA 6   D7 D6 D5 D4 D3 D2 D1 D0    tempC   [-128..127] (7th data byte)
-                    //
-                    // NOTE 1: If RTC is not found all read values wil be = 0
-                    // NOTE 2: Overread data (more then 7 bytes read) will be = 0
-                    // NOTE 3: The temperature (Celsius) is a byte with two complement binary format [-128..127]
-                    case  0x84:
-                        if (foundRTC)
-                        {
-                            if (ioByteCnt == 0) 
-                            {
-                                readRTC(&seconds, &minutes, &hours, &day, &month, &year, &tempC); // Read from RTC
-                            }
-                            
-                            if (ioByteCnt < 7)
-                            {
-                                // Send date/time (binary values) to Z80 bus
-                                switch (ioByteCnt)
-                                {
-                                    case 0: ioData = seconds; break;
-                                    case 1: ioData = minutes; break;
-                                    case 2: ioData = hours; break;
-                                    case 3: ioData = day; break;
-                                    case 4: ioData = month; break;
-                                    case 5: ioData = year; break;
-                                    case 6: ioData = tempC; break;
-                                }
-                                ioByteCnt++;
-                            }
-                            else 
-                            {
-                                ioOpcode = 0xFF;              // All done. Set ioOpcode = "No operation"
-                            }
-                        }
-                        else 
-                        {
-                            ioOpcode = 0xFF;                 // Nothing to do. Set ioOpcode = "No operation"
-                        }
-                        break;
-
-                    // DISK EMULATION
-                    // ERRDISK - read the error code after a SELDISK, SELSECT, SELTRACK, WRITESECT, READSECT 
-                    //           or SDMOUNT operation
-                    //
-                    //                I/O DATA:    D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    DISK error code (binary)
-                    //
-                    //
-                    // Error codes table:
-                    //
-                    //    error code    | description
-                    // ---------------------------------------------------------------------------------------------------
-                    //        0         |  No error
-                    //        1         |  DISK_ERR: the function failed due to a hard error in the disk function, 
-                    //                  |   a wrong FAT structure or an internal error
-                    //        2         |  NOT_READY: the storage device could not be initialized due to a hard error or 
-                    //                  |   no medium
-                    //        3         |  NO_FILE: could not find the file
-                    //        4         |  NOT_OPENED: the file has not been opened
-                    //        5         |  NOT_ENABLED: the volume has not been mounted
-                    //        6         |  NO_FILESYSTEM: there is no valid FAT partition on the drive
-                    //       16         |  Illegal disk number
-                    //       17         |  Illegal track number
-                    //       18         |  Illegal sector number
-                    //       19         |  Reached an unexpected EOF
-                    //
-                    //
-                    //
-                    //
-                    // NOTE 1: ERRDISK code is referred to the previous SELDISK, SELSECT, SELTRACK, WRITESECT or READSECT
-                    //         operation
-                    // NOTE 2: Error codes from 0 to 6 come from the PetitFS library implementation
-                    // NOTE 3: ERRDISK must not be used to read the resulting error code after a SDMOUNT operation 
-                    //         (see the SDMOUNT opcode)
-                    case  0x85:
-                        ioData = diskErr;
-                        break;
-
-                    // DISK EMULATION
-                    // READSECT - read 512 data bytes sequentially from the current emulated disk/track/sector:
-                    //
-                    //                 I/O DATA:   D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                 I/O DATA 0  D7 D6 D5 D4 D3 D2 D1 D0    First Data byte
-                    //
-                    //                      |               |
-                    //                      |               |
-                    //                      |               |                 <510 Data Bytes>
-                    //                      |               |
-                    //
-                    //               I/O DATA 127  D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    512th Data byte (Last byte)
-                    //
-                    //
-                    // Reads the current sector (512 bytes) of the current track/sector, one data byte each call. 
-                    // All the 512 calls must be always performed sequentially to have a READSECT operation correctly done. 
-                    // If an error occurs during the READSECT operation, all subsequent read data will be = 0.
-                    // If an error occurs calling any DISK EMULATION opcode (SDMOUNT excluded) immediately before the READSECT 
-                    //  opcode call, all the read data will be will be = 0 and the READSECT operation will not be performed.
-                    // Errors are stored into "diskErr" (see ERRDISK opcode).
-                    //
-                    // NOTE 1: Before a READSECT operation at least a SELTRACK or a SELSECT must be always performed
-                    // NOTE 2: Remember to open the right "disk file" at first using the SELDISK opcode
-                    case  0x86:
-                        if (!ioByteCnt)
-                        {
-                            // First byte of 512, so set the right file pointer to the current emulated track/sector first
-                            if ((trackSel < 512) && (sectSel < 32) && (!diskErr))
-                            {
-                                // Sector and track numbers valid and no previous error; set the LBA-like logical sector
-                                diskErr = seekSD((trackSel << 5) | sectSel);  // Set the starting point inside the "disk file"
-                                                                    //  generating a 14 bit "disk file" LBA-like 
-                                                                    //  logical sector address created as TTTTTTTTTSSSSS
-                            }
-                        }
-
-                        if (!diskErr)
-                        {
-                            // No previous error (e.g. selecting disk, track or sector)
-                            tempByte = ioByteCnt % 32;          // [0..31]
-                            if (!tempByte)
-                            {
-                                // Read 32 bytes of the current sector on SD in the buffer (every 32 calls, starting with the first)
-                                diskErr = readSD(bufferSD, &numReadBytes); 
-                                if (numReadBytes < 32) 
-                                {
-                                    diskErr = 19;    // Reached an unexpected EOF
-                                }
-                            }
-                            if (!diskErr) 
-                            {
-                                ioData = bufferSD[tempByte];// If no errors, exchange current data byte with the CPU
-                            }
-                        }
-                        if (ioByteCnt >= 511) 
-                        {
-                            ioOpcode = 0xFF;                    // All done. Set ioOpcode = "No operation"
-                        }
-                        ioByteCnt++;                          // Increment the counter of the exchanged data bytes
-                        break;
-
-                    // DISK EMULATION
-                    // SDMOUNT - mount a volume on SD, returning an error code (binary):
-                    //
-                    //                 I/O DATA 0: D7 D6 D5 D4 D3 D2 D1 D0
-                    //                            ---------------------------------------------------------
-                    //                             D7 D6 D5 D4 D3 D2 D1 D0    error code (binary)
-                    //
-                    //
-                    //
-                    // NOTE 1: This opcode is "normally" not used. Only needed if using a virtual disk from a custom program
-                    //         loaded with iLoad or with the Auto-boot mode (e.g. ViDiT). Can be used to handle SD hot-swapping
-                    // NOTE 2: For error codes explanation see ERRDISK opcode
-                    // NOTE 3: Only for this disk opcode, the resulting error is read as a data byte without using the 
-                    //         ERRDISK opcode
-                    case  0x87:
-                        ioData = mountSD(&filesysSD);
-                        break;          
-                } // switch
+                // Not possible, so load the file byte by byte
+                seekSD(0);
+                loadHL(BootStrAddr);                      // Set Z80 HL = boot starting address (used as pointer to RAM);
                 
-                if ((ioOpcode != 0x84) && (ioOpcode != 0x86)) 
+                // Read a "segment" of a SD sector and load it into RAM
+                do
                 {
-                    ioOpcode = 0xFF;  // All done for the single byte opcodes. 
-                                  //  Set ioOpcode = "No operation"
-                }
+                    errCodeSD = readSD(bufferSD, &numReadBytes);  // Read current "segment" (32 bytes) of the current SD serctor
+                    
+                    // Load the read "segment" into RAM
+                    for (iCount = 0; iCount < numReadBytes; iCount++)
+                    {
+                        writeByteToRAM(bufferSD[iCount]);        // Write current data byte into RAM
+                    }
+                } while ((numReadBytes == 32) && (!errCodeSD));   // If numReadBytes < 32 -> EOF reached
             }
             
-            DDRA = 0xFF;                              // Configure Z80 data bus D0-D7 (PA0-PA7) as output
-            PORTA = ioData;                           // Current output on data bus
+            if (errCodeSD)
+            {
+                waitUTerm();
+                printErrSD(2, errCodeSD, fileNameSD);
+                waitKey(SD_ERROR_RETRY);                  // Wait a key to repeat
+                seekSD(0);                                // Reset the sector pointer
+            }
+        } while (errCodeSD);
+    }
+    else if (bootMode == 4)
+    {
+        // Load from flash
+        if (!fastBoot)
+        {
+            Serial.print("IOS: Loading boot program...");
+        }
+        // Write boot program into external RAM (through the loader stub if possible)
+        if (streamImageZ80(BootStrAddr, BootImageSize, BootImage, IMAGE_RAW, clockMode))
+        {
+            loadHL(BootStrAddr);                    // Set Z80 HL = boot starting address (used as pointer to RAM);
+            for (word i = 0; i < BootImageSize; i++)
+            {
+                writeByteToRAM(pgm_read_byte(BootImage + i));  // Write current data byte into RAM
+            }
+        }
+    }
+    bootTrace(BT_LOAD);
+}
 
-            // Control bus sequence to exit from a wait state (M I/O read cycle)
-            digitalWrite(BUSREQ_, LOW);               // Request for a DMA
-            digitalWrite(WAIT_RES_, LOW);             // Now is safe reset WAIT FF (exiting from WAIT state)
-            delayMicroseconds(2);                     // Wait 2us just to be sure that Z80 read the data and go HiZ
-            DDRA = 0x00;                              // Configure Z80 data bus D0-D7 (PA0-PA7) as input with pull-up
-            PORTA = 0xFF;
-            digitalWrite(WAIT_RES_, HIGH);            // Now Z80 is in DMA (HiZ), so it's safe set WAIT_RES_ HIGH again
-            digitalWrite(BUSREQ_, HIGH);              // Resume Z80 from DMA
+// ------------------------------------------------------------------------------
+// Warm boot (WARMBOOT opcode or USER key held down): only the Z80 is reset and the
+//  boot program is loaded again, from warmImage if kept (WARMBOOT_CACHE), otherwise
+//  from the flash or from SD. The mounted volume, the Disk Sets cache, the "disk
+//  file" and the host file stay as they are, and nothing is asked or printed.
+//  After a resume from hibernation the snapshot is restored again.
+// ------------------------------------------------------------------------------
+void warmBootZ80(void)
+{
+    ioPending = 1;                                  // The WAIT_ ISR must leave the loader stub I/O to loadBootProgram()
+                                                    //  and Serial to this code, until releaseIoZ80()
+    haltZ80();                                      // Stop the Z80 (releasing a pending I/O request)
+    fastWrite(INT_, HIGH);                          // No pending interrupt
+    fastWrite(BANK0, HIGH);                         // Set RAM Logical Bank 1 (Os Bank 0)
+    fastWrite(BANK1, LOW);
+    ioOpcode = 0xFF;                                // A WRITESECT/FILEWRITE... in progress is dropped
+    ioByteCnt = 0;
+    if (filesysSD.flag & FA__WIP)
+    {
+        // The Z80 was stopped in the middle of a sector write: the card stays inside the
+        //  write block until the sector is finalized (the rest of it is padded with 0x00),
+        //  and the sector write can only belong to the file selected now
+        writeSD(NULL, &numWriBytes);
+    }
+    fastBoot = 1;                                   // Load quietly, using the mounted volume
+    errCodeSD = 0;
+    if ((bootMode != 5) || resumeZ80(clockMode))
+    {
+        if (bootMode == 5)
+        {
+            bootMode = 2;                           // Resume failed, boot the OS as setup() does
+            if (!diskSetSD[diskSet].loader[0])
+            {
+                diskSet = 0;
+            }
+            fileNameSD = diskSetSD[diskSet].loader;
+            BootStrAddr = diskSetSD[diskSet].strAddr;
+            packedBoot = findFlashImage(fileNameSD, &packedImage);
+        }
+        loadBootProgram();
+        fastWrite(RESET_, LOW);
+    }
+    startZ80Clock(clockMode);
+    flushTxZ80();                                   // What the Z80 sent before the warm boot first
+    Serial.println(F("\r\nIOS: Z80 warm boot"));
+    delay(1);                                       // Just to be sure...
+    fastWrite(RESET_, HIGH);                        // Release Z80 from reset and let it run
+    releaseIoZ80();
+}
+
+// ------------------------------------------------------------------------------
+// Enable the WAIT_ pin change interrupt (WAIT_ = PB3 = PCINT11). A request already
+//  pending (the Z80 may be waiting since setup()) is left to loop().
+// ------------------------------------------------------------------------------
+void startIoIntZ80(void)
+{
+    ioPending = 1;                                  // Nothing served by the WAIT_ ISR until releaseIoZ80()
+    startIoProf();                                  // Timer1 timebase on, statistics of the last run cleared
+    clearSdStats();
+    if (bootCfg & BOOTCFG_IOLOG)
+    {
+        IOLOG_START();                              // I/O sessions log on, if IOLOG.DAT is there
+    }
+    PCMSK1 |= (1 << PCINT11);
+    PCICR |= (1 << PCIE1);
+    releaseIoZ80();
+}
+
+// ------------------------------------------------------------------------------
+// Give the Z80 I/O requests back to the WAIT_ ISR after loop() served one (or after
+//  a boot/resume that polled WAIT_ itself). Must be called with the Z80 out of the
+//  wait state; if a new request is already there, loop() serves it too, because its
+//  WAIT_ edge may have been ignored by the ISR. Interrupts are enabled on return.
+// ------------------------------------------------------------------------------
+void releaseIoZ80(void)
+{
+    cli();
+    ioPending = !fastRead(WAIT_);
+    sei();
+}
+
+// ------------------------------------------------------------------------------
+// Serve what the WAIT_ ISR left to loop() for the requests it served (called by
+//  loop() before anything else, interrupts enabled):
+//  - send to Serial the SERIAL TX bytes it queued, as long as Serial takes them
+//    without waiting (the rest the next time, or by flushTxZ80());
+//  - take the received chars from Serial for its SERIAL RX, setting INT_ as
+//    serialEvent() does;
+//  - account the events it queued in the I/O profile, trace and log, in order, so
+//    they come before those of the request loop() is going to serve.
+// ------------------------------------------------------------------------------
+void serviceIsrZ80(void)
+{
+#if ISRQ_EV
+    IsrEvent    ev;
+
+#endif
+    while ((isrTxTail != isrTxHead) && (Serial.availableForWrite() > 0))
+    {
+        Serial.write(isrTxBuf[isrTxTail]);
+        isrTxTail = (isrTxTail + 1) & (ISRQ_TX - 1);
+    }
+    while ((((isrRxHead + 1) & (ISRQ_RX - 1)) != isrRxTail) && (Serial.available() > 0))
+    {
+        isrRxBuf[isrRxHead] = Serial.read();
+        isrRxHead = (isrRxHead + 1) & (ISRQ_RX - 1);
+    }
+    cli();
+    if ((isrRxHead != isrRxTail) && Z80IntEnFlag)
+    {
+        fastWrite(INT_, LOW);                       // Reset by the SERIAL RX that reads the char
+    }
+    sei();
+#if ISRQ_EV
+    while (isrEvTail != isrEvHead)
+    {
+        cli();
+        ev = isrEvBuf[isrEvTail];
+        isrEvTail = (isrEvTail + 1) & (ISRQ_EV - 1);
+        sei();
+        IOPROF_ADD(ev.slot, ev.end - ev.start);
+        if (ev.log == ISRQ_LOGSTORE)
+        {
+            IOLOG_STORE_AT(ev.opcode, ev.end);
+        }
+        else if (ev.log == ISRQ_LOGBYTE)
+        {
+            IOLOG_BYTE_AT(ev.data, ev.end);
+        }
+        if (ev.trace != ISRQ_NOTRACE)
+        {
+            IOTRACE_AT(ev.trace, ev.opcode, ev.byteCnt, ev.end);
+        }
+    }
+#endif
+}
+
+// ------------------------------------------------------------------------------
+// Send to Serial all the SERIAL TX bytes queued by the WAIT_ ISR, waiting for room
+//  in the Serial Tx buffer. Called by loop() before its own output, with the ISR
+//  kept away (ioPending set or the Z80 in the wait state).
+// ------------------------------------------------------------------------------
+void flushTxZ80(void)
+{
+    while (isrTxTail != isrTxHead)
+    {
+        Serial.write(isrTxBuf[isrTxTail]);
+        isrTxTail = (isrTxTail + 1) & (ISRQ_TX - 1);
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Next received char for a SERIAL RX served by loop(): the ones taken from Serial
+//  for the WAIT_ ISR first. Returns -1 if none.
+// ------------------------------------------------------------------------------
+int readRxZ80(void)
+{
+    byte    rxChar;
+
+    if (isrRxTail != isrRxHead)
+    {
+        rxChar = isrRxBuf[isrRxTail];
+        isrRxTail = (isrRxTail + 1) & (ISRQ_RX - 1);
+        return rxChar;
+    }
+    if (Serial.available() > 0)
+    {
+        return Serial.read();
+    }
+    return -1;
+}
+
+// ------------------------------------------------------------------------------
+// Queue the event of a request served by the WAIT_ ISR (called by it, after the
+//  release of the Z80). The room was checked before serving it (isrEvFullZ80()).
+// ------------------------------------------------------------------------------
+static inline void isrEventZ80(byte trace, byte log, byte opcode, word byteCnt)
+{
+#if ISRQ_EV
+    IsrEvent    *e = &isrEvBuf[isrEvHead];
+
+    e->end = ioProfNow();
+#if IO_PROFILE
+    e->start = ioProfStart;
+    e->slot = ioProfCur;
+    ioProfCur = IOP_NONE;
+#else
+    e->start = e->end;
+    e->slot = 0xFF;
+#endif
+    e->trace = trace;
+    e->log = log;
+    e->opcode = opcode;
+    e->data = ioData;
+    e->byteCnt = byteCnt;
+    isrEvHead = (isrEvHead + 1) & (ISRQ_EV - 1);
+#else
+    (void)trace; (void)log; (void)opcode; (void)byteCnt;
+#endif
+}
+
+// Set to 1 if there is no room for the event of one more request served by the WAIT_ ISR
+static inline byte isrEvFullZ80(void)
+{
+#if ISRQ_EV
+    return ((isrEvHead + 1) & (ISRQ_EV - 1)) == isrEvTail;
+#else
+    return 0;
+#endif
+}
+
+// ------------------------------------------------------------------------------
+// WAIT_ pin change ISR. When WAIT_ goes LOW the most frequent I/O requests are served
+//  here at once, without the loop() and serialEvent() latency:
+//
+//      STORE OPCODE, SERIAL TX (if there is room in the Tx queue), SERIAL RX, USER LED,
+//      TIMER and the data bytes of READSECT/WRITESECT/FILELOAD that do not need an SD
+//      access.
+//
+//  The run time is bounded: the ISR only does the pin handshake and updates buffer
+//  indexes. There is no loop (holdIoReadZ80() is a fixed IO_READ_HOLD_CLK delay) and
+//  no call into Serial, the profiler, the trace or the log: the SERIAL TX bytes are
+//  queued for loop(), the SERIAL RX chars come from those loop() took from Serial, and
+//  every served request queues an event (its start and release times, data byte...)
+//  that loop() accounts later (see serviceIsrZ80()). The only call is rdTimer() at the
+//  first TIMER byte, that latches micros() and ioProfNow() (constant time).
+//
+//  Any other request (SD, I2C, the interrupt cycle...), and any request when the
+//  events queue is full, is left to loop() setting ioPending: the Z80 stays in the
+//  wait state until loop() serves it (see the opcodes table in loop() for the
+//  details). While ioPending is set the ISR does nothing, so the code that polls
+//  WAIT_ itself (boot loader, hibernate/resume) is not disturbed.
+// ------------------------------------------------------------------------------
+ISR(PCINT1_vect)
+{
+    byte    ad0;                                    // Z80 address bus line AD0
+    byte    opcode = ioOpcode;                      // Request state for its event (see isrEventZ80())
+    word    byteCnt = ioByteCnt;
+    byte    trace = ISRQ_NOTRACE;
+    byte    log = ISRQ_LOGBYTE;
+
+    if (ioPending || fastRead(WAIT_))
+    {
+        return;                                     // WAIT_ released, or the request is left to loop()
+    }
+    if (!fastRead(WR_))
+    {
+        // I/O WRITE operation requested
+        ioData = PINA;                              // Read Z80 data bus D0-D7 (PA0-PA7)
+        ad0 = fastRead(AD0);
+        IOPROF_START(ad0 ? IOP_STORE : ioProfSlot(ioOpcode));
+        if (isrEvFullZ80())
+        {
+            ioPending = 1;                          // No room for its event: loop() empties the queue first
+            return;
+        }
+        else if (ad0)
+        {
+            ioOpcode = ioData;                      // STORE OPCODE
+            ioByteCnt = 0;
+            opcode = ioData;
+            log = ISRQ_LOGSTORE;
+            trace = IOT_WRITE | IOT_AD0 | IOT_ISR;
+        }
+        else if ((ioOpcode == 0x01) && (((isrTxHead + 1) & (ISRQ_TX - 1)) != isrTxTail))
+        {
+            isrTxBuf[isrTxHead] = ioData;           // SERIAL TX, sent to Serial by loop()
+            isrTxHead = (isrTxHead + 1) & (ISRQ_TX - 1);
+            ioOpcode = 0xFF;
+            trace = IOT_WRITE | IOT_ISR;
+        }
+        else if (ioOpcode == 0x00)
+        {
+            fastWrite(USER, !(ioData & B00000001)); // USER LED
+            ioOpcode = 0xFF;
+            trace = IOT_WRITE | IOT_ISR;
+        }
+        else if ((ioOpcode == 0x0C) && ioByteCnt && !diskErr && ((ioByteCnt % 32) != 31))
+        {
+            bufferSD[ioByteCnt % 32] = ioData;      // WRITESECT, the buffer is not full yet
+            ioByteCnt++;
         }
         else
         {
-            // INTERRUPT operation setting IORQ_ LOW, so nothing to do
-// ----------------------------------------
-// VIRTUAL INTERRUPT
-// ----------------------------------------
-            // Nothing to do
-            //
-            // DEBUG ----------------------------------
-            if (debug > 2) 
+            ioPending = 1;
+            return;
+        }
+        fastWrite(BUSREQ_, LOW);                    // Request for a DMA
+        fastWrite(WAIT_RES_, LOW);                  // Reset WAIT FF exiting from WAIT state
+        fastWrite(WAIT_RES_, HIGH);                 // Now Z80 is in DMA, so it's safe set WAIT_RES_ HIGH again
+        fastWrite(BUSREQ_, HIGH);                   // Resume Z80 from DMA
+        isrEventZ80(trace, log, opcode, byteCnt);
+    }
+    else if (!fastRead(RD_))
+    {
+        // I/O READ operation requested
+        ad0 = fastRead(AD0);
+        IOPROF_START(ad0 ? IOP_SERIALRX : ioProfSlot(ioOpcode));
+        if (isrEvFullZ80())
+        {
+            ioPending = 1;                          // No room for its event: loop() empties the queue first
+            return;
+        }
+        else if (ad0)
+        {
+            ioData = 0xFF;                          // SERIAL RX, from the chars loop() took from Serial
+            LastRxIsEmpty = 1;
+            if (isrRxTail != isrRxHead)
             {
-                Serial.println();
-                Serial.println("DEBUG: INT operation (nothing to do)");
+                ioData = isrRxBuf[isrRxTail];
+                isrRxTail = (isrRxTail + 1) & (ISRQ_RX - 1);
+                LastRxIsEmpty = 0;
+                trace = IOT_READ | IOT_AD0 | IOT_ISR;
+            }
+            log = 0;                                // Not an opcode session
+            fastWrite(INT_, HIGH);
+        }
+        else if ((ioOpcode == 0x86) && (ioByteCnt % 32) && !diskErr)
+        {
+            ioData = bufferSD[ioByteCnt % 32];      // READSECT, the bytes already in the buffer
+            if (ioByteCnt >= 511)
+            {
+                ioOpcode = 0xFF;
+            }
+            ioByteCnt++;
+        }
+        else if ((ioOpcode == 0x8D) && (ioByteCnt >= 3) && (loadIndexSD < loadBytesSD) && !hostErr)
+        {
+            ioData = loadBufSD[loadIndexSD++];      // FILELOAD, the bytes already in the buffer
+            loadLeftSD--;
+            if (!loadLeftSD)
+            {
+                ioOpcode = 0xFF;
+            }
+        }
+        else if (ioOpcode == 0x90)
+        {
+            if (!ioByteCnt)
+            {
+                trace = IOT_READ | IOT_ISR;         // TIMER, the session (not the other bytes) traced
+            }
+            rdTimer();
+            if (ioByteCnt >= 8)
+            {
+                ioOpcode = 0xFF;                    // Ended here, not by execIoOpcode()
             }
-            // DEBUG END ------------------------------
-            //
-
-            // Control bus sequence to exit from a wait state (M interrupt cycle)
-            digitalWrite(BUSREQ_, LOW);               // Request for a DMA
-            digitalWrite(WAIT_RES_, LOW);             // Reset WAIT FF exiting from WAIT state
-            digitalWrite(WAIT_RES_, HIGH);            // Now Z80 is in DMA, so it's safe set WAIT_RES_ HIGH again
-            digitalWrite(BUSREQ_, HIGH);              // Resume Z80 from DMA
         }
+        else
+        {
+            ioPending = 1;
+            return;
+        }
+        DDRA = 0xFF;                                // Configure Z80 data bus D0-D7 (PA0-PA7) as output
+        PORTA = ioData;                             // Current output on data bus
+        fastWrite(BUSREQ_, LOW);                    // Request for a DMA
+        fastWrite(WAIT_RES_, LOW);                  // Now is safe reset WAIT FF (exiting from WAIT state)
+        holdIoReadZ80();                            // Wait until the Z80 latched the data (IO_READ_HOLD_CLK clocks)
+        DDRA = 0x00;                                // Configure Z80 data bus D0-D7 (PA0-PA7) as input with pull-up
+        PORTA = 0xFF;
+        fastWrite(WAIT_RES_, HIGH);                 // Now Z80 is in DMA (HiZ), so it's safe set WAIT_RES_ HIGH again
+        fastWrite(BUSREQ_, HIGH);                   // Resume Z80 from DMA
+        isrEventZ80(trace, log, opcode, byteCnt);
     }
-} // end of loop
+    else
+    {
+        IOPROF_START(IOP_OTHER);
+        ioPending = 1;                              // INTERRUPT operation
+    }
+}
 
 // end of source file
@@ -4,6 +4,7 @@
 
 #include "pff.h"
 #include "diskio.h"
+#include "SdStats.h"    /* SD layer statistics (SDSTATS opcode) */
 
 /*-------------------------------------------------------------------------*/
 /* Platform dependent macros and functions needed to be modified           */
@@ -206,18 +207,22 @@ DRESULT disk_readp( BYTE *buff, DWORD sector, UINT offset, UINT count )
     }
 
     res = RES_ERROR;
+    SDSTATS_INC(cmd17);
     if (send_cmd(CMD17, sector) == 0) 
     {   /* READ_SINGLE_BLOCK */
 
         bc = 40000; /* Time counter */
+        SDSTATS_BUSY_START();
         do {                /* Wait for data packet */
             rc = rcv_spi();
         } while (rc == 0xFF && --bc);
+        SDSTATS_BUSY_END();
 
         if (rc == 0xFE) 
         {   /* A data packet arrived */
 
             bc = 512 + 2 - offset - count;  /* Number of trailing bytes to skip */
+            SDSTATS_ADD(readBytes, count);
 
             /* Skip leading bytes */
             while (offset--) rcv_spi();
@@ -277,6 +282,7 @@ DRESULT disk_writep( const BYTE *buff, DWORD sc )
             xmit_spi(*buff++);
             wc--; bc--;
         }
+        SDSTATS_ADD(writeBytes, sc - bc);
         res = RES_OK;
     } 
     else 
@@ -287,6 +293,7 @@ DRESULT disk_writep( const BYTE *buff, DWORD sc )
             {
                 sc *= 512;  /* Convert to byte address if needed */
             }
+            SDSTATS_INC(cmd24);
             if (send_cmd(CMD24, sc) == 0) 
             {           /* WRITE_SINGLE_BLOCK */
                 xmit_spi(0xFF); xmit_spi(0xFE);     /* Data block header */
@@ -300,10 +307,12 @@ DRESULT disk_writep( const BYTE *buff, DWORD sc )
             while (bc--) xmit_spi(0);   /* Fill left bytes and CRC with zeros */
             if ((rcv_spi() & 0x1F) == 0x05) 
             {   /* Receive data resp and wait for end of write process in timeout of 500ms */
+                SDSTATS_BUSY_START();
                 for (bc = 5000; rcv_spi() != 0xFF && bc; bc--)  /* Wait for ready */
                 {
                     dly_100us();
                 }
+                SDSTATS_BUSY_END();
                 if (bc)
                 {
                     res = RES_OK;
@@ -0,0 +1,301 @@
+/*
+ * diskbench.cpp
+ *
+ * Host build: CP/M disk workload benchmark for the IOS SD stack. Each workload is
+ * replayed as the SELDISK/SELTRACK/SELSECT/READSECT/WRITESECT/ERRDISK opcodes a CP/M
+ * BIOS issues (one 512 bytes host sector at a time), through the WAIT_ ISR and loop()
+ * down to openSD()/seekSD()/readSD()/writeSD(), PetitFS and the SD card model.
+ *
+ *   disk_bench [-w WORKLOAD] [-n OPS] [-s SEED] [-S SDCONFIG] IMAGE
+ *
+ * IMAGE needs the Disk Set 0 with the disk files 0 and 1 (see "make sd.img"); their
+ * content is overwritten. The CP/M layout is the one of the IOS CP/M 2.2 BIOS: 512
+ * tracks of 32 sectors, one system track, the directory in the first 32 sectors
+ * of track 1.
+ *
+ * For each workload are printed the sectors moved, the modeled time (total and per
+ * sector), the SD commands (CMD17 split by FAT/directory/data area, CMD24) and the
+ * SPI bytes. SDCONFIG sets the card type and timing of the SD card model (e.g.
+ * "type=sd1,read=200,busy=1000", see sd_config()), so the same workload can be
+ * measured on a slow or byte addressed card.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "hal.h"
+#include "sdcard.h"
+#include "zbus.h"
+
+#define SELDISK         0x09
+#define SELTRACK        0x0A
+#define SELSECT         0x0B
+#define WRITESECT       0x0C
+#define ERRDISK         0x85
+#define READSECT        0x86
+
+#define DIR_TRACK       1
+#define DIR_SECTS       32
+#define DATA_TRACK      2
+#define TRACK_SECTS     32
+#define DISK_TRACKS     512
+
+struct Workload
+{
+    const char  *name;
+    const char  *descr;
+    int         (*run)(long ops);
+    long        defOps;
+};
+
+static byte             curDisk = 0xFF;
+static unsigned long    sectors;
+static unsigned long    diskErrors;
+static unsigned long    randSeed = 1;
+
+// ------------------------------------------------------------------------------
+// BIOS primitives
+// ------------------------------------------------------------------------------
+static int selDisk(byte disk)
+{
+    if (disk == curDisk)
+    {
+        return 0;
+    }
+    curDisk = disk;
+    return (zbus_out(1, SELDISK) || zbus_out(0, disk)) ? -1 : 0;
+}
+
+static int setSect(word track, byte sect)
+{
+    return (zbus_out(1, SELTRACK) || zbus_out(0, lowByte(track)) || zbus_out(0, highByte(track)) ||
+            zbus_out(1, SELSECT) || zbus_out(0, sect)) ? -1 : 0;
+}
+
+static int checkErr(void)
+{
+    int err;
+
+    if (zbus_out(1, ERRDISK) || ((err = zbus_in(0)) < 0))
+    {
+        return -1;
+    }
+    if (err)
+    {
+        diskErrors++;
+    }
+    return 0;
+}
+
+static int readSect(byte disk, word track, byte sect)
+{
+    int i;
+
+    if (selDisk(disk) || setSect(track, sect) || zbus_out(1, READSECT))
+    {
+        return -1;
+    }
+    for (i = 0; i < 512; i++)
+    {
+        if (zbus_in(0) < 0)
+        {
+            return -1;
+        }
+    }
+    sectors++;
+    return checkErr();
+}
+
+static int writeSect(byte disk, word track, byte sect)
+{
+    int i;
+
+    if (selDisk(disk) || setSect(track, sect) || zbus_out(1, WRITESECT))
+    {
+        return -1;
+    }
+    for (i = 0; i < 512; i++)
+    {
+        if (zbus_out(0, (byte)(track + sect + i)))
+        {
+            return -1;
+        }
+    }
+    sectors++;
+    return checkErr();
+}
+
+static unsigned long nextRand(void)
+{
+    randSeed = randSeed * 1103515245UL + 12345UL;
+    return (randSeed >> 16) & 0x7FFF;
+}
+
+// ------------------------------------------------------------------------------
+// Workloads
+// ------------------------------------------------------------------------------
+
+// Load a .COM file: OPS sequential sectors from the first data track
+static int comLoad(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        if (readSect(0, DATA_TRACK + i / TRACK_SECTS, i % TRACK_SECTS))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Directory scans (search first/next): OPS directory sectors, always from the first one
+static int dirScan(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        if (readSect(0, DIR_TRACK, i % DIR_SECTS))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// PIP A:=B: 16 sectors (8KB buffer) read from disk 0 then written to disk 1, for OPS
+// sectors, then the directory entry and its sector read back on disk 1
+static int pipCopy(long ops)
+{
+    long done, i;
+
+    for (done = 0; done < ops; done += 16)
+    {
+        for (i = done; (i < done + 16) && (i < ops); i++)
+        {
+            if (readSect(0, DATA_TRACK + i / TRACK_SECTS, i % TRACK_SECTS))
+            {
+                return -1;
+            }
+        }
+        for (i = done; (i < done + 16) && (i < ops); i++)
+        {
+            if (writeSect(1, DATA_TRACK + i / TRACK_SECTS, i % TRACK_SECTS))
+            {
+                return -1;
+            }
+        }
+    }
+    if (readSect(1, DIR_TRACK, 0) || writeSect(1, DIR_TRACK, 0))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+// Database: OPS random sectors on the data tracks, 3 reads for each write
+static int randomDb(long ops)
+{
+    word    track;
+    byte    sect;
+
+    for (long i = 0; i < ops; i++)
+    {
+        track = DATA_TRACK + nextRand() % (DISK_TRACKS - DATA_TRACK);
+        sect = nextRand() % TRACK_SECTS;
+        if ((nextRand() & 3) ? readSect(0, track, sect) : writeSect(0, track, sect))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static const Workload workloads[] =
+{
+    { "comload", "sequential .COM load",     comLoad,  64 },
+    { "dirscan", "directory scan",           dirScan,  96 },
+    { "pipcopy", "PIP copy disk 0 -> 1",     pipCopy,  64 },
+    { "random",  "random database access",   randomDb, 256 }
+};
+
+#define WORKLOADS   (sizeof(workloads) / sizeof(workloads[0]))
+
+static int runWorkload(const Workload *w, long ops)
+{
+    uint64_t    startCycles = hal_cycles;
+    double      ms;
+
+    sectors = 0;
+    diskErrors = 0;
+    curDisk = 0xFF;
+    memset(&hal_stats, 0, sizeof(hal_stats));
+    sd_reset_stats();
+    if (w->run(ops ? ops : w->defOps))
+    {
+        fprintf(stderr, "disk_bench: %s: the Z80 is still in the wait state\n", w->name);
+        return -1;
+    }
+    ms = (double)(hal_cycles - startCycles) / (F_CPU / 1000.0);
+    printf("%-8s %-24s %6lu %9.1f %8.1f %6lu %5lu %5lu %6lu %6lu %9lu %6lu\n",
+           w->name, w->descr, sectors, ms, sectors ? ms * 1000.0 / sectors : 0.0,
+           sd_stats.cmd[17], sd_stats.areaReads[SD_AREA_FAT], sd_stats.areaReads[SD_AREA_DIR],
+           sd_stats.areaReads[SD_AREA_DATA], sd_stats.cmd[24], hal_stats.spiBytes, diskErrors);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char  *only = NULL;
+    long        ops = 0;
+    unsigned    i;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "w:n:s:S:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'w': only = optarg; break;
+            case 'n': ops = strtol(optarg, NULL, 0); break;
+            case 's': randSeed = strtoul(optarg, NULL, 0); break;
+            case 'S': if (sd_config(optarg)) optind = argc; break;
+            default: optind = argc; break;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "usage: disk_bench [-w WORKLOAD] [-n OPS] [-s SEED] [-S SDCONFIG] IMAGE\n");
+        fprintf(stderr, "workloads:");
+        for (i = 0; i < WORKLOADS; i++)
+        {
+            fprintf(stderr, " %s", workloads[i].name);
+        }
+        fprintf(stderr, "\n");
+        return 2;
+    }
+    if (sd_open(argv[optind]))
+    {
+        fprintf(stderr, "disk_bench: cannot open %s\n", argv[optind]);
+        return 1;
+    }
+    hal_serial_sink = NULL;
+    if (zbus_start_ios(0))
+    {
+        fprintf(stderr, "disk_bench: SD mount error\n");
+        return 1;
+    }
+    printf("workload description              sects    ms tot  us/sect  CMD17   FAT   dir   data  CMD24 SPI bytes  errors\n");
+    for (i = 0; i < WORKLOADS; i++)
+    {
+        if (only && strcmp(only, workloads[i].name))
+        {
+            continue;
+        }
+        if (runWorkload(&workloads[i], ops))
+        {
+            return 1;
+        }
+    }
+    sd_close();
+    return 0;
+}
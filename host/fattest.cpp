@@ -0,0 +1,202 @@
+/*
+ * fattest.cpp
+ *
+ * Host build: check of the PetitFS file allocation (pf_create()/pf_extend()/
+ * pf_truncate()/pf_sync(), through createSD()/extendSD()/truncateSD()/syncSD()) on a
+ * disk that gets full. A file that can not be extended (FR_DENIED) must leave the
+ * volume as it was: no cluster allocated or linked in any FAT copy, the directory
+ * entry not changed.
+ *
+ *   fat_test IMAGE
+ *
+ * IMAGE is an empty volume (see "make test"); the files FILL.DAT and MORE.DAT are
+ * created on it and take all its free space. The steps:
+ *
+ *   1. FILL.DAT (empty) extended by one cluster more than the free ones: DENIED
+ *   2. FILL.DAT extended to half the free space: ok, contiguous
+ *   3. FILL.DAT extended by one cluster more than the free ones: DENIED
+ *   4. FILL.DAT extended to take the whole free space: ok, no free cluster left
+ *   5. MORE.DAT (empty) extended by one byte: DENIED
+ *   6. FILL.DAT (opened again) truncated to one byte: ok, the other clusters freed
+ *   7. FILL.DAT extended within its cluster, then one sector at a time (as FILEWRITE
+ *      does) to 4 clusters: the size within the last cluster is written in the
+ *      directory only by syncSD()
+ *   8. FILL.DAT truncated to 0 bytes: ok, all its clusters freed
+ *
+ * and after each DENIED the image must be the same, byte by byte, as before it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "Arduino.h"
+#include "hal.h"
+#include "sdcard.h"
+#include "zbus.h"
+#include "../PetitFS.h"
+#include "../SDCardFunctions.h"
+
+static const char       *imageName;
+static unsigned         failures;
+
+// ------------------------------------------------------------------------------
+// Image access (the SD card model writes it through at each block)
+// ------------------------------------------------------------------------------
+static int readImage(std::vector<uint8_t> &data)
+{
+    FILE    *f = fopen(imageName, "rb");
+    uint8_t buf[65536];
+    size_t  n;
+
+    data.clear();
+    if (!f)
+    {
+        return -1;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return 0;
+}
+
+static unsigned long fatEntry(const std::vector<uint8_t> &img, unsigned long clst)
+{
+    const uint8_t   *p = &img[filesysSD.fatbase * 512];
+
+    if (filesysSD.fs_type == FS_FAT32)
+    {
+        p += clst * 4;
+        return (p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long)p[3] << 24)) & 0x0FFFFFFF;
+    }
+    p += clst * 2;
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned long freeClusters(void)
+{
+    std::vector<uint8_t>    img;
+    unsigned long           n = 0;
+
+    readImage(img);
+    for (unsigned long clst = 2; clst < filesysSD.n_fatent; clst++)
+    {
+        if (!fatEntry(img, clst))
+        {
+            n++;
+        }
+    }
+    return n;
+}
+
+// ------------------------------------------------------------------------------
+// Steps
+// ------------------------------------------------------------------------------
+// Size in the directory entry of a file ("NAME    EXT", FCB format), -1 if not found
+static long dirSize(const char *fcbName)
+{
+    byte    ent[16];
+
+    if (openDirSD())
+    {
+        return -1;
+    }
+    while (!readDirSD(ent) && ent[0])
+    {
+        if (!memcmp(ent, fcbName, 11))
+        {
+            return ent[12] | (ent[13] << 8) | ((long)ent[14] << 16) | ((long)ent[15] << 24);
+        }
+    }
+    return -1;
+}
+
+static void check(int ok, const char *step)
+{
+    printf("%-56s %s\n", step, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        failures++;
+    }
+}
+
+// Extend the open file to "size" expecting DENIED, with nothing written
+static void extendDenied(unsigned long size, const char *step)
+{
+    std::vector<uint8_t>    before, after;
+    byte                    errcode;
+
+    readImage(before);
+    errcode = extendSD(size);
+    readImage(after);
+    check((errcode == FR_DENIED) && (before == after), step);
+}
+
+static void extendOk(unsigned long size, const char *step)
+{
+    check(!extendSD(size) && (filesysSD.fsize == size), step);
+}
+
+// ------------------------------------------------------------------------------
+// Main
+// ------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    unsigned long   bcs, freeCl, firstSect, numSects, size;
+    byte            errcode = 0;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: fat_test IMAGE\n");
+        return 2;
+    }
+    imageName = argv[1];
+    if (sd_open(imageName))
+    {
+        fprintf(stderr, "fat_test: cannot open %s\n", imageName);
+        return 1;
+    }
+    hal_serial_sink = NULL;
+    if (zbus_start_ios(0))
+    {
+        fprintf(stderr, "fat_test: SD mount error\n");
+        return 1;
+    }
+    bcs = filesysSD.csize * 512UL;
+    freeCl = freeClusters();
+    printf("%s: FAT%s, %lu clusters of %lu bytes, %lu free\n", imageName,
+           (filesysSD.fs_type == FS_FAT32) ? "32" : "16", (unsigned long)filesysSD.n_fatent - 2, bcs, freeCl);
+
+    selectFileSD(HOSTFILE_SD);
+    check(!createSD("FILL.DAT"), "create FILL.DAT");
+    extendDenied((freeCl + 1) * bcs, "1. empty file, one cluster more than free: DENIED");
+    extendOk(freeCl / 2 * bcs, "2. half the free space: ok");
+    check(!contigFileSD("FILL.DAT", &firstSect, &numSects) && (numSects * 512 == freeCl / 2 * bcs), "   contiguous");
+    extendDenied((freeCl + 1) * bcs, "3. one cluster more than free: DENIED");
+    extendOk(freeCl * bcs, "4. the whole free space: ok");
+    check(!freeClusters(), "   no free cluster left");
+    check(!createSD("MORE.DAT"), "create MORE.DAT");
+    extendDenied(1, "5. one byte on a full disk: DENIED");
+    check(!openSD("FILL.DAT") && !truncateSD(1), "6. FILL.DAT truncated to one byte: ok");
+    check((freeClusters() == freeCl - 1) && (dirSize("FILL    DAT") == 1), "   the other clusters freed");
+    for (size = 100; !errcode && (size <= 500); size += 100)
+    {
+        errcode = extendSD(size);
+    }
+    check(!errcode && (filesysSD.fsize == 500) && (dirSize("FILL    DAT") == 1), "7. extended within its cluster: size pending");
+    check(!syncSD() && (dirSize("FILL    DAT") == 500), "   the size written by syncSD()");
+    for (size = 1024; !errcode && (size <= 4 * bcs); size += 512)
+    {
+        errcode = extendSD(size);
+    }
+    check(!errcode && (dirSize("FILL    DAT") == (long)(3 * bcs + 512)), "   one sector at a time to 4 clusters: ok");
+    check(!syncSD() && (dirSize("FILL    DAT") == (long)(4 * bcs)), "   the size written by syncSD()");
+    check(!contigFileSD("FILL.DAT", &firstSect, &numSects) && (freeClusters() == freeCl - 4), "   contiguous");
+    check(!truncateSD(0) && (freeClusters() == freeCl) && !dirSize("FILL    DAT"), "8. truncated to 0 bytes: ok, no cluster left");
+
+    sd_close();
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Arduino.h
+ *
+ * Host build: the Arduino core API used by IOS, implemented by the mock HAL
+ * (hal.cpp) on top of a modeled 16MHz ATmega1284P.
+ */
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "avr/io.h"
+#include "avr/pgmspace.h"
+#include "avr/interrupt.h"
+#include "binary.h"
+#include "WString.h"
+#include "HardwareSerial.h"
+
+#ifndef F_CPU
+    #define F_CPU 16000000UL
+#endif
+
+typedef uint8_t     byte;
+typedef uint16_t    word;
+typedef bool        boolean;
+
+#define HIGH            0x1
+#define LOW             0x0
+#define INPUT           0x0
+#define OUTPUT          0x1
+#define INPUT_PULLUP    0x2
+
+#define lowByte(w)      ((uint8_t)((w) & 0xff))
+#define highByte(w)     ((uint8_t)((w) >> 8))
+#define bitRead(value, bit)     (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit)      ((value) |= (1UL << (bit)))
+#define bitClear(value, bit)    ((value) &= ~(1UL << (bit)))
+
+#ifndef min
+    #define min(a, b)   ((a) < (b) ? (a) : (b))
+    #define max(a, b)   ((a) > (b) ? (a) : (b))
+#endif
+
+// ATmega1284P standard pinout (MightyCore): SPI pins
+static const uint8_t SS   = 4;
+static const uint8_t MOSI = 5;
+static const uint8_t MISO = 6;
+static const uint8_t SCK  = 7;
+
+#define NUM_DIGITAL_PINS    32
+
+// avr-libc <stdlib.h> extensions
+static inline char *ultoa(unsigned long value, char *str, int radix)
+{
+    char tmp[34];
+    int  n = 0;
+    do
+    {
+        unsigned d = (unsigned)(value % radix);
+        tmp[n++] = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+        value /= radix;
+    } while (value);
+    char *p = str;
+    while (n) *p++ = tmp[--n];
+    *p = 0;
+    return str;
+}
+static inline char *ltoa(long value, char *str, int radix)
+{
+    if ((value < 0) && (radix == 10))
+    {
+        *str = '-';
+        ultoa((unsigned long)-value, str + 1, radix);
+        return str;
+    }
+    return ultoa((radix == 10) ? (unsigned long)value : (unsigned long)value & 0xFFFFFFFFUL, str, radix);
+}
+static inline char *itoa(int value, char *str, int radix)
+{
+    if ((value < 0) && (radix == 10)) return ltoa(value, str, radix);
+    return ultoa((unsigned int)value & 0xFFFFU, str, radix);
+}
+static inline char *utoa(unsigned int value, char *str, int radix)
+{
+    return ultoa(value & 0xFFFFU, str, radix);
+}
+
+void            pinMode(uint8_t pin, uint8_t mode);
+void            digitalWrite(uint8_t pin, uint8_t value);
+int             digitalRead(uint8_t pin);
+unsigned long   millis(void);
+unsigned long   micros(void);
+void            delay(unsigned long ms);
+void            delayMicroseconds(unsigned int us);
+void            hal_tick(uint32_t cycles);
+
+#define __builtin_avr_delay_cycles(n)   hal_tick((uint32_t)(n))
+
+void setup(void);
+void loop(void);
+
+#endif /* HOST_ARDUINO_H_ */
@@ -0,0 +1,38 @@
+/*
+ * EEPROM.h
+ *
+ * Host build: 4KB internal EEPROM kept in memory (erased state 0xFF).
+ */
+
+#ifndef HOST_EEPROM_H_
+#define HOST_EEPROM_H_
+
+#include <stdint.h>
+
+#define HAL_EEPROM_SIZE 4096
+
+class EEPROMClass
+{
+public:
+    uint8_t  read(int address)                  { return data[address & (HAL_EEPROM_SIZE - 1)]; }
+    void     write(int address, uint8_t value)  { data[address & (HAL_EEPROM_SIZE - 1)] = value; writes++; }
+    void     update(int address, uint8_t value) { if (read(address) != value) write(address, value); }
+    uint16_t length()                           { return HAL_EEPROM_SIZE; }
+    template <typename T> T &get(int address, T &t)
+    {
+        for (unsigned i = 0; i < sizeof(T); i++) ((uint8_t *)&t)[i] = read(address + i);
+        return t;
+    }
+    template <typename T> const T &put(int address, const T &t)
+    {
+        for (unsigned i = 0; i < sizeof(T); i++) update(address + i, ((const uint8_t *)&t)[i]);
+        return t;
+    }
+
+    uint8_t       data[HAL_EEPROM_SIZE];
+    unsigned long writes;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif /* HOST_EEPROM_H_ */
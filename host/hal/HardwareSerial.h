@@ -0,0 +1,65 @@
+/*
+ * HardwareSerial.h
+ *
+ * Host build: Serial port backed by an input queue fed by the host program and
+ * an output sink (stdout unless the host program installs its own).
+ */
+
+#ifndef HOST_HARDWARESERIAL_H_
+#define HOST_HARDWARESERIAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#ifndef SERIAL_RX_BUFFER_SIZE
+    #define SERIAL_RX_BUFFER_SIZE 128
+#endif
+
+class HardwareSerial
+{
+public:
+    void    begin(unsigned long baud)           { (void)baud; }
+    void    end()                               {}
+    int     available();
+    int     peek();
+    int     read();
+    void    flush()                             {}
+    int     availableForWrite()                 { return SERIAL_RX_BUFFER_SIZE - 1; }
+    size_t  write(uint8_t c);
+    size_t  write(const char *str);
+    size_t  write(const uint8_t *buffer, size_t size);
+    operator bool()                             { return true; }
+
+    size_t  print(const __FlashStringHelper *str) { return write(reinterpret_cast<const char *>(str)); }
+    size_t  print(const String &str)            { return write(str.c_str()); }
+    size_t  print(const char *str)              { return write(str); }
+    size_t  print(char c)                       { return write((uint8_t)c); }
+    size_t  print(unsigned char value, int base = DEC) { return printNumber(value, base); }
+    size_t  print(int value, int base = DEC)    { return printSigned(value, base); }
+    size_t  print(unsigned int value, int base = DEC) { return printNumber(value, base); }
+    size_t  print(long value, int base = DEC)   { return printSigned(value, base); }
+    size_t  print(unsigned long value, int base = DEC) { return printNumber(value, base); }
+    size_t  print(double value, int digits = 2);
+
+    size_t  println()                           { return write("\r\n"); }
+    template <typename T>
+    size_t  println(T value)                    { size_t n = print(value); return n + println(); }
+    template <typename T>
+    size_t  println(T value, int base)          { size_t n = print(value, base); return n + println(); }
+
+    size_t  printf(const char *format, ...);
+
+private:
+    size_t  printNumber(unsigned long value, int base);
+    size_t  printSigned(long value, int base);
+};
+
+extern HardwareSerial Serial;
+
+#endif /* HOST_HARDWARESERIAL_H_ */
@@ -0,0 +1,157 @@
+/*
+ * WString.h
+ *
+ * Host build: the subset of the Arduino String class used by IOS.
+ */
+
+#ifndef HOST_WSTRING_H_
+#define HOST_WSTRING_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+class __FlashStringHelper;
+#define F(string_literal)   (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class String
+{
+public:
+    String(const char *cstr = "")           { init(cstr ? cstr : ""); }
+    String(const String &str)               { init(str.buf); }
+    explicit String(char c)                 { char s[2] = { c, 0 }; init(s); }
+    explicit String(int value, unsigned char base = 10)      { char s[34]; fmt(s, (long)value, base); init(s); }
+    explicit String(unsigned int value, unsigned char base = 10) { char s[34]; fmtu(s, value, base); init(s); }
+    explicit String(long value, unsigned char base = 10)     { char s[34]; fmt(s, value, base); init(s); }
+    explicit String(unsigned long value, unsigned char base = 10) { char s[34]; fmtu(s, value, base); init(s); }
+    ~String()                               { free(buf); }
+
+    String& operator=(const String &rhs)    { if (this != &rhs) { free(buf); init(rhs.buf); } return *this; }
+    String& operator=(const char *cstr)     { free(buf); init(cstr ? cstr : ""); return *this; }
+
+    unsigned int length() const             { return len; }
+    const char  *c_str() const              { return buf; }
+    char        *begin()                    { return buf; }
+    const char  *begin() const              { return buf; }
+    char        *end()                      { return buf + len; }
+    char         operator[](unsigned int i) const { return (i < len) ? buf[i] : 0; }
+    char         charAt(unsigned int i) const     { return (*this)[i]; }
+
+    bool concat(const String &str)          { return concat(str.buf); }
+    bool concat(const char *cstr)
+    {
+        if (!cstr) return false;
+        size_t add = strlen(cstr);
+        buf = (char *)realloc(buf, len + add + 1);
+        memcpy(buf + len, cstr, add + 1);
+        len += (unsigned int)add;
+        return true;
+    }
+    bool concat(char c)                     { char s[2] = { c, 0 }; return concat(s); }
+    bool concat(int value)                  { char s[34]; fmt(s, value, 10); return concat(s); }
+    bool concat(unsigned int value)         { char s[34]; fmtu(s, value, 10); return concat(s); }
+    bool concat(long value)                 { char s[34]; fmt(s, value, 10); return concat(s); }
+    bool concat(unsigned long value)        { char s[34]; fmtu(s, value, 10); return concat(s); }
+    String& operator+=(const String &rhs)   { concat(rhs); return *this; }
+    String& operator+=(const char *cstr)    { concat(cstr); return *this; }
+    String& operator+=(char c)              { concat(c); return *this; }
+
+    bool equals(const String &s) const      { return strcmp(buf, s.buf) == 0; }
+    bool operator==(const String &s) const  { return equals(s); }
+    bool operator!=(const String &s) const  { return !equals(s); }
+
+    int indexOf(const String &s, unsigned int from = 0) const
+    {
+        if (from > len) return -1;
+        const char *found = strstr(buf + from, s.buf);
+        return found ? (int)(found - buf) : -1;
+    }
+    int lastIndexOf(const String &s) const
+    {
+        int pos = -1;
+        if (s.len > len) return -1;
+        for (int i = 0; i <= (int)(len - s.len); i++)
+        {
+            if (!strncmp(buf + i, s.buf, s.len)) pos = i;
+        }
+        return pos;
+    }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        if (from > to) { unsigned int t = from; from = to; to = t; }
+        if (from > len) return String();
+        if (to > len) to = len;
+        String out;
+        free(out.buf);
+        out.buf = (char *)malloc(to - from + 1);
+        memcpy(out.buf, buf + from, to - from);
+        out.buf[to - from] = 0;
+        out.len = to - from;
+        return out;
+    }
+    String substring(unsigned int from) const { return substring(from, len); }
+    void replace(const String &find, const String &repl)
+    {
+        if (!find.len) return;
+        String out;
+        unsigned int i = 0;
+        while (i < len)
+        {
+            if (!strncmp(buf + i, find.buf, find.len))
+            {
+                out.concat(repl);
+                i += find.len;
+            }
+            else
+            {
+                out.concat(buf[i++]);
+            }
+        }
+        *this = out;
+    }
+    long toInt() const                      { return atol(buf); }
+    void toUpperCase()                      { for (unsigned int i = 0; i < len; i++) if (buf[i] >= 'a' && buf[i] <= 'z') buf[i] -= 0x20; }
+    void trim()
+    {
+        unsigned int s = 0, e = len;
+        while (s < e && buf[s] <= ' ') s++;
+        while (e > s && buf[e - 1] <= ' ') e--;
+        *this = substring(s, e);
+    }
+
+private:
+    char         *buf;
+    unsigned int  len;
+
+    void init(const char *cstr)
+    {
+        len = (unsigned int)strlen(cstr);
+        buf = (char *)malloc(len + 1);
+        memcpy(buf, cstr, len + 1);
+    }
+    static void fmtu(char *s, unsigned long value, unsigned char base)
+    {
+        char tmp[34];
+        int  n = 0;
+        if (base < 2) base = 10;
+        do
+        {
+            unsigned d = (unsigned)(value % base);
+            tmp[n++] = (char)(d < 10 ? '0' + d : 'A' + d - 10);
+            value /= base;
+        } while (value);
+        while (n) *s++ = tmp[--n];
+        *s = 0;
+    }
+    static void fmt(char *s, long value, unsigned char base)
+    {
+        if ((value < 0) && (base == 10))
+        {
+            *s++ = '-';
+            value = -value;
+        }
+        fmtu(s, (unsigned long)value, base);
+    }
+};
+
+#endif /* HOST_WSTRING_H_ */
@@ -0,0 +1,37 @@
+/*
+ * Wire.h
+ *
+ * Host build: I2C bus with register-file devices attached by the host program.
+ */
+
+#ifndef HOST_WIRE_H_
+#define HOST_WIRE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Arduino.h"
+
+class TwoWire
+{
+public:
+    void    begin()                             {}
+    void    setClock(uint32_t clock)            { (void)clock; }
+    void    beginTransmission(uint8_t address);
+    void    beginTransmission(int address)      { beginTransmission((uint8_t)address); }
+    size_t  write(uint8_t data);
+    uint8_t endTransmission(uint8_t sendStop = 1);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+    int     available();
+    int     read();
+
+private:
+    uint8_t txAddress;
+    uint8_t txCount;
+    uint8_t rxAddress;
+    uint8_t rxCount;
+};
+
+extern TwoWire Wire;
+
+#endif /* HOST_WIRE_H_ */
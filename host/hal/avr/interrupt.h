@@ -0,0 +1,20 @@
+/*
+ * avr/interrupt.h
+ *
+ * Host build: ISRs become plain functions the board model can call.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#include "avr/io.h"
+
+#define ISR(vector, ...)    extern "C" void vector(void)
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+
+#define cli()   (SREG &= (uint8_t)~_BV(SREG_I))
+#define sei()   (SREG |= _BV(SREG_I))
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
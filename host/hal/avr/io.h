@@ -0,0 +1,204 @@
+/*
+ * avr/io.h
+ *
+ * Host build: ATmega1284P I/O registers used by IOS, mapped onto the mock HAL.
+ * Every register is a small object so that reads and writes can be routed to
+ * the board model (Z80 bus, SD card on SPI, Timer1 time base...).
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+// ------------------------------------------------------------------------------
+// Register identifiers
+// ------------------------------------------------------------------------------
+enum HalRegId
+{
+    HAL_PINA, HAL_DDRA, HAL_PORTA,
+    HAL_PINB, HAL_DDRB, HAL_PORTB,
+    HAL_PINC, HAL_DDRC, HAL_PORTC,
+    HAL_PIND, HAL_DDRD, HAL_PORTD,
+    HAL_SPCR, HAL_SPSR, HAL_SPDR,
+    HAL_TCCR1A, HAL_TCCR1B, HAL_TCCR1C, HAL_TIMSK1, HAL_TIFR1,
+    HAL_TCCR2A, HAL_TCCR2B, HAL_TCNT2, HAL_OCR2A, HAL_OCR2B, HAL_ASSR, HAL_TIMSK2, HAL_TIFR2,
+    HAL_PCICR, HAL_PCIFR, HAL_PCMSK0, HAL_PCMSK1, HAL_PCMSK2, HAL_PCMSK3,
+    HAL_EICRA, HAL_EIMSK, HAL_EIFR,
+    HAL_SREG, HAL_MCUSR, HAL_GPIOR0,
+    HAL_NREGS
+};
+
+uint8_t  hal_reg_read(HalRegId id);
+void     hal_reg_write(HalRegId id, uint8_t value);
+uint16_t hal_reg16_read(int id);
+void     hal_reg16_write(int id, uint16_t value);
+
+// ------------------------------------------------------------------------------
+// 8 bit register
+// ------------------------------------------------------------------------------
+class HalReg8
+{
+public:
+    explicit HalReg8(HalRegId id) : regId(id) {}
+    operator uint8_t() const                { return hal_reg_read(regId); }
+    HalReg8& operator=(uint8_t value)       { hal_reg_write(regId, value); return *this; }
+    HalReg8& operator=(const HalReg8 &reg)  { hal_reg_write(regId, (uint8_t)reg); return *this; }
+    HalReg8& operator|=(int value)          { return *this = (uint8_t)(hal_reg_read(regId) | value); }
+    HalReg8& operator&=(int value)          { return *this = (uint8_t)(hal_reg_read(regId) & value); }
+    HalReg8& operator^=(uint8_t value)      { return *this = (uint8_t)(hal_reg_read(regId) ^ value); }
+private:
+    HalRegId regId;
+};
+
+// ------------------------------------------------------------------------------
+// 16 bit register (Timer1)
+// ------------------------------------------------------------------------------
+enum { HAL_TCNT1, HAL_OCR1A, HAL_OCR1B, HAL_ICR1 };
+
+class HalReg16
+{
+public:
+    explicit HalReg16(int id) : regId(id) {}
+    operator uint16_t() const               { return hal_reg16_read(regId); }
+    HalReg16& operator=(uint16_t value)     { hal_reg16_write(regId, value); return *this; }
+private:
+    int regId;
+};
+
+extern HalReg8 PINA, DDRA, PORTA, PINB, DDRB, PORTB, PINC, DDRC, PORTC, PIND, DDRD, PORTD;
+extern HalReg8 SPCR, SPSR, SPDR;
+extern HalReg8 TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern HalReg8 TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, ASSR, TIMSK2, TIFR2;
+extern HalReg8 PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2, PCMSK3, EICRA, EIMSK, EIFR;
+extern HalReg8 SREG, MCUSR, GPIOR0;
+extern HalReg16 TCNT1, OCR1A, OCR1B, ICR1;
+
+// ------------------------------------------------------------------------------
+// Bit definitions (ATmega1284P datasheet)
+// ------------------------------------------------------------------------------
+#define _BV(bit)    (1 << (bit))
+
+// SPI
+#define SPR0    0
+#define SPR1    1
+#define CPHA    2
+#define CPOL    3
+#define MSTR    4
+#define DORD    5
+#define SPE     6
+#define SPIE    7
+#define SPI2X   0
+#define WCOL    6
+#define SPIF    7
+
+// Timer1
+#define WGM10   0
+#define WGM11   1
+#define COM1B0  4
+#define COM1B1  5
+#define COM1A0  6
+#define COM1A1  7
+#define CS10    0
+#define CS11    1
+#define CS12    2
+#define WGM12   3
+#define WGM13   4
+#define ICES1   6
+#define ICNC1   7
+#define TOIE1   0
+#define OCIE1A  1
+#define OCIE1B  2
+#define ICIE1   5
+#define TOV1    0
+#define OCF1A   1
+#define OCF1B   2
+#define ICF1    5
+
+// Timer2
+#define WGM20   0
+#define WGM21   1
+#define COM2B0  4
+#define COM2B1  5
+#define COM2A0  6
+#define COM2A1  7
+#define CS20    0
+#define CS21    1
+#define CS22    2
+#define WGM22   3
+#define AS2     5
+#define EXCLK   6
+#define TOIE2   0
+#define OCIE2A  1
+
+// Pin change interrupts
+#define PCIE0   0
+#define PCIE1   1
+#define PCIE2   2
+#define PCIE3   3
+#define PCIF0   0
+#define PCIF1   1
+#define PCIF2   2
+#define PCIF3   3
+#define PCINT8  0
+#define PCINT9  1
+#define PCINT10 2
+#define PCINT11 3
+#define PCINT12 4
+
+// External interrupts
+#define INT0    0
+#define INT1    1
+#define INT2    2
+
+// Status register
+#define SREG_I  7
+
+// MCU status register
+#define PORF    0
+#define EXTRF   1
+#define BORF    2
+#define WDRF    3
+
+// Port bits
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+// Memory layout (ATmega1284P: 16KB SRAM from 0x0100)
+#define RAMSTART    0x0100
+#define RAMEND      0x40FF
+
+#define bit_is_set(sfr, bit)    ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit)  (!((sfr) & _BV(bit)))
+
+#endif /* HOST_AVR_IO_H_ */
@@ -0,0 +1,26 @@
+/*
+ * avr/pgmspace.h
+ *
+ * Host build: flash and SRAM share one address space, so the PROGMEM
+ * accessors are plain memory reads.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P                   const char *
+#define PSTR(s)                 (s)
+#define pgm_read_byte(addr)     (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)     (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)    (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr)      (*(void * const *)(addr))
+#define memcpy_P(dst, src, n)   memcpy((dst), (src), (n))
+#define strcpy_P(dst, src)      strcpy((dst), (src))
+#define strlen_P(src)           strlen(src)
+#define strcmp_P(a, b)          strcmp((a), (b))
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
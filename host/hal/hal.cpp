@@ -0,0 +1,566 @@
+/*
+ * hal.cpp
+ *
+ * Host build: mock Arduino HAL for the ATmega1284P used by IOS.
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include "Arduino.h"
+#include "Wire.h"
+#include "EEPROM.h"
+#include "hal.h"
+
+// ------------------------------------------------------------------------------
+// Global state
+// ------------------------------------------------------------------------------
+uint64_t        hal_cycles;
+HalCost         hal_cost        = { 56, 52, 70, 1, 20 };
+uint8_t         hal_out[4];
+uint8_t         hal_ddr[4];
+uint8_t         hal_ext_level[4];
+uint8_t         hal_ext_drive[4];
+HalPortHook     hal_port_hook;
+HalInputHook    hal_input_hook;
+HalSpiHook      hal_spi_hook;
+HalSerialSink   hal_serial_sink;
+HalTickHook     hal_tick_hook;
+HalStats        hal_stats;
+
+HardwareSerial  Serial;
+TwoWire         Wire;
+EEPROMClass     EEPROM;
+
+static uint8_t  regs[HAL_NREGS];
+static uint8_t  spiRx;
+static uint16_t timer1Base;
+static uint64_t timer1Start;
+static uint16_t timer1Ocr[3];
+static uint64_t timer1Ovf;                      // Timer1 overflows already flagged (TOV1 cleared or served)
+
+extern "C" void TIMER1_OVF_vect(void) __attribute__ ((weak));
+
+static uint8_t  serialIn[4096];
+static unsigned serialHead, serialTail;
+
+static HalI2cDevice *i2cDevices[128];
+
+HalReg8 PINA(HAL_PINA), DDRA(HAL_DDRA), PORTA(HAL_PORTA);
+HalReg8 PINB(HAL_PINB), DDRB(HAL_DDRB), PORTB(HAL_PORTB);
+HalReg8 PINC(HAL_PINC), DDRC(HAL_DDRC), PORTC(HAL_PORTC);
+HalReg8 PIND(HAL_PIND), DDRD(HAL_DDRD), PORTD(HAL_PORTD);
+HalReg8 SPCR(HAL_SPCR), SPSR(HAL_SPSR), SPDR(HAL_SPDR);
+HalReg8 TCCR1A(HAL_TCCR1A), TCCR1B(HAL_TCCR1B), TCCR1C(HAL_TCCR1C), TIMSK1(HAL_TIMSK1), TIFR1(HAL_TIFR1);
+HalReg8 TCCR2A(HAL_TCCR2A), TCCR2B(HAL_TCCR2B), TCNT2(HAL_TCNT2), OCR2A(HAL_OCR2A), OCR2B(HAL_OCR2B);
+HalReg8 ASSR(HAL_ASSR), TIMSK2(HAL_TIMSK2), TIFR2(HAL_TIFR2);
+HalReg8 PCICR(HAL_PCICR), PCIFR(HAL_PCIFR), PCMSK0(HAL_PCMSK0), PCMSK1(HAL_PCMSK1), PCMSK2(HAL_PCMSK2), PCMSK3(HAL_PCMSK3);
+HalReg8 EICRA(HAL_EICRA), EIMSK(HAL_EIMSK), EIFR(HAL_EIFR);
+HalReg8 SREG(HAL_SREG), MCUSR(HAL_MCUSR), GPIOR0(HAL_GPIOR0);
+HalReg16 TCNT1(HAL_TCNT1), OCR1A(HAL_OCR1A), OCR1B(HAL_OCR1B), ICR1(HAL_ICR1);
+
+void hal_reset(void)
+{
+    hal_cycles = 0;
+    memset(hal_out, 0, sizeof(hal_out));
+    memset(hal_ddr, 0, sizeof(hal_ddr));
+    memset(regs, 0, sizeof(regs));
+    memset(&hal_stats, 0, sizeof(hal_stats));
+    memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+    EEPROM.writes = 0;
+    timer1Base = 0;
+    timer1Start = 0;
+    timer1Ovf = 0;
+    serialHead = serialTail = 0;
+    regs[HAL_SREG] = _BV(SREG_I);
+    regs[HAL_MCUSR] = _BV(PORF);
+}
+
+static struct HalInit
+{
+    HalInit() { hal_reset(); }
+} halInit;
+
+static uint64_t timer1Overflows(void);
+
+void hal_tick(uint32_t cycles)
+{
+    hal_cycles += cycles;
+    if ((regs[HAL_TIMSK1] & _BV(TOIE1)) && (regs[HAL_SREG] & _BV(SREG_I)) && TIMER1_OVF_vect &&
+        (timer1Overflows() > timer1Ovf))
+    {
+        // Timer1 overflow interrupt (only one if more overflows passed, as TOV1 is a single flag)
+        timer1Ovf = timer1Overflows();
+        regs[HAL_SREG] &= (uint8_t)~_BV(SREG_I);
+        TIMER1_OVF_vect();
+        regs[HAL_SREG] |= _BV(SREG_I);
+    }
+    if (hal_tick_hook)
+    {
+        hal_tick_hook();
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Pins and ports
+// ------------------------------------------------------------------------------
+void hal_pin_to_port(uint8_t pin, uint8_t *port, uint8_t *mask)
+{
+    static const uint8_t portOfBlock[4] = { HAL_PORT_B, HAL_PORT_D, HAL_PORT_C, HAL_PORT_A };
+    *port = portOfBlock[(pin >> 3) & 3];
+    *mask = (uint8_t)(1 << (pin & 7));
+}
+
+static uint8_t portInput(uint8_t port)
+{
+    if (hal_input_hook)
+    {
+        hal_input_hook(port);
+    }
+    // Outputs read back their latch; undriven inputs read their pull-up (PORTx bit)
+    uint8_t ext = (hal_ext_level[port] & hal_ext_drive[port]) | (hal_out[port] & ~hal_ext_drive[port]);
+    return (uint8_t)((hal_out[port] & hal_ddr[port]) | (ext & ~hal_ddr[port]));
+}
+
+uint8_t hal_pin_level(uint8_t pin)
+{
+    uint8_t port, mask;
+    hal_pin_to_port(pin, &port, &mask);
+    return (portInput(port) & mask) ? 1 : 0;
+}
+
+void hal_drive(uint8_t pin, int level)
+{
+    uint8_t port, mask;
+    hal_pin_to_port(pin, &port, &mask);
+    if (level < 0)
+    {
+        hal_ext_drive[port] &= (uint8_t)~mask;
+    }
+    else
+    {
+        hal_ext_drive[port] |= mask;
+        if (level) hal_ext_level[port] |= mask;
+        else hal_ext_level[port] &= (uint8_t)~mask;
+    }
+}
+
+static void setOut(uint8_t port, uint8_t value)
+{
+    uint8_t old = hal_out[port];
+    hal_out[port] = value;
+    if (hal_port_hook)
+    {
+        hal_port_hook(port, old, value);
+    }
+}
+
+static void setDdr(uint8_t port, uint8_t value)
+{
+    hal_ddr[port] = value;
+    if (hal_port_hook)
+    {
+        hal_port_hook(port, hal_out[port], hal_out[port]);
+    }
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    uint8_t port, mask;
+    hal_tick(hal_cost.pinMode);
+    hal_pin_to_port(pin, &port, &mask);
+    if (mode == OUTPUT)
+    {
+        setDdr(port, hal_ddr[port] | mask);
+    }
+    else
+    {
+        setDdr(port, hal_ddr[port] & (uint8_t)~mask);
+        setOut(port, (mode == INPUT_PULLUP) ? (hal_out[port] | mask) : (hal_out[port] & (uint8_t)~mask));
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    uint8_t port, mask;
+    hal_tick(hal_cost.digitalWrite);
+    hal_stats.digitalWrites++;
+    hal_pin_to_port(pin, &port, &mask);
+    setOut(port, value ? (hal_out[port] | mask) : (hal_out[port] & (uint8_t)~mask));
+}
+
+int digitalRead(uint8_t pin)
+{
+    hal_tick(hal_cost.digitalRead);
+    hal_stats.digitalReads++;
+    return hal_pin_level(pin);
+}
+
+// ------------------------------------------------------------------------------
+// Registers
+// ------------------------------------------------------------------------------
+static uint16_t timer1Prescaler(void)
+{
+    static const uint16_t div[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+    return div[regs[HAL_TCCR1B] & 0x07];
+}
+
+// Overflows of TCNT1 since it was last written (TCNT1 or TCCR1B)
+static uint64_t timer1Overflows(void)
+{
+    uint16_t presc = timer1Prescaler();
+
+    if (!presc)
+    {
+        return timer1Ovf;
+    }
+    return (timer1Base + (hal_cycles - timer1Start) / presc) >> 16;
+}
+
+uint8_t hal_reg_read(HalRegId id)
+{
+    hal_tick(hal_cost.regAccess);
+    switch (id)
+    {
+        case HAL_PINA: return portInput(HAL_PORT_A);
+        case HAL_PINB: return portInput(HAL_PORT_B);
+        case HAL_PINC: return portInput(HAL_PORT_C);
+        case HAL_PIND: return portInput(HAL_PORT_D);
+        case HAL_PORTA: return hal_out[HAL_PORT_A];
+        case HAL_PORTB: return hal_out[HAL_PORT_B];
+        case HAL_PORTC: return hal_out[HAL_PORT_C];
+        case HAL_PORTD: return hal_out[HAL_PORT_D];
+        case HAL_DDRA: return hal_ddr[HAL_PORT_A];
+        case HAL_DDRB: return hal_ddr[HAL_PORT_B];
+        case HAL_DDRC: return hal_ddr[HAL_PORT_C];
+        case HAL_DDRD: return hal_ddr[HAL_PORT_D];
+        case HAL_SPDR: return spiRx;
+        case HAL_SPSR: return (uint8_t)(regs[HAL_SPSR] | _BV(SPIF));
+        case HAL_TIFR1: return (uint8_t)(regs[HAL_TIFR1] | ((timer1Overflows() > timer1Ovf) ? _BV(TOV1) : 0));
+        default: return regs[id];
+    }
+}
+
+void hal_reg_write(HalRegId id, uint8_t value)
+{
+    hal_tick(hal_cost.regAccess);
+    switch (id)
+    {
+        // Writing a one to PINx toggles the PORTx bit
+        case HAL_PINA: setOut(HAL_PORT_A, hal_out[HAL_PORT_A] ^ value); break;
+        case HAL_PINB: setOut(HAL_PORT_B, hal_out[HAL_PORT_B] ^ value); break;
+        case HAL_PINC: setOut(HAL_PORT_C, hal_out[HAL_PORT_C] ^ value); break;
+        case HAL_PIND: setOut(HAL_PORT_D, hal_out[HAL_PORT_D] ^ value); break;
+        case HAL_PORTA: setOut(HAL_PORT_A, value); break;
+        case HAL_PORTB: setOut(HAL_PORT_B, value); break;
+        case HAL_PORTC: setOut(HAL_PORT_C, value); break;
+        case HAL_PORTD: setOut(HAL_PORT_D, value); break;
+        case HAL_DDRA: setDdr(HAL_PORT_A, value); break;
+        case HAL_DDRB: setDdr(HAL_PORT_B, value); break;
+        case HAL_DDRC: setDdr(HAL_PORT_C, value); break;
+        case HAL_DDRD: setDdr(HAL_PORT_D, value); break;
+        case HAL_SPDR:
+            {
+                // One byte exchanged on SPI: 8 SCK periods at the current divisor
+                static const uint8_t div[4] = { 4, 16, 64, 128 };
+                uint32_t sckDiv = div[regs[HAL_SPCR] & 0x03];
+                if (regs[HAL_SPSR] & _BV(SPI2X))
+                {
+                    sckDiv /= 2;
+                }
+                hal_tick(8 * sckDiv);
+                hal_stats.spiBytes++;
+                spiRx = hal_spi_hook ? hal_spi_hook(value) : 0xFF;
+            }
+            break;
+        case HAL_TCCR1B:
+            timer1Base = hal_reg16_read(HAL_TCNT1);
+            timer1Start = hal_cycles;
+            timer1Ovf = 0;
+            regs[id] = value;
+            break;
+        case HAL_TIFR1:
+            if (value & _BV(TOV1))
+            {
+                timer1Ovf = timer1Overflows();      // Writing a one clears the flag
+            }
+            break;
+        default:
+            regs[id] = value;
+            break;
+    }
+}
+
+uint8_t hal_reg_peek(int id)
+{
+    return regs[id];
+}
+
+void hal_reg_poke(int id, uint8_t value)
+{
+    regs[id] = value;
+}
+
+uint16_t hal_reg16_read(int id)
+{
+    if (id == HAL_TCNT1)
+    {
+        uint16_t presc = timer1Prescaler();
+        if (!presc)
+        {
+            return timer1Base;
+        }
+        return (uint16_t)(timer1Base + (hal_cycles - timer1Start) / presc);
+    }
+    return timer1Ocr[(id - 1) % 3];
+}
+
+void hal_reg16_write(int id, uint16_t value)
+{
+    if (id == HAL_TCNT1)
+    {
+        timer1Base = value;
+        timer1Start = hal_cycles;
+        timer1Ovf = 0;
+    }
+    else
+    {
+        timer1Ocr[(id - 1) % 3] = value;
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Time
+// ------------------------------------------------------------------------------
+unsigned long millis(void)
+{
+    hal_tick(20);                               // Reading the timer0 counters with interrupts off
+    return (unsigned long)(hal_cycles / (F_CPU / 1000UL));
+}
+
+unsigned long micros(void)
+{
+    hal_tick(20);
+    return (unsigned long)(hal_cycles / (F_CPU / 1000000UL));
+}
+
+void delay(unsigned long ms)
+{
+    hal_tick((uint32_t)(ms * (F_CPU / 1000UL)));
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    hal_tick((uint32_t)(us * (F_CPU / 1000000UL)));
+}
+
+// ------------------------------------------------------------------------------
+// Serial
+// ------------------------------------------------------------------------------
+void hal_serial_feed_byte(uint8_t c)
+{
+    serialIn[serialHead++ % sizeof(serialIn)] = c;
+}
+
+void hal_serial_feed(const char *text)
+{
+    while (*text)
+    {
+        hal_serial_feed_byte((uint8_t)*text++);
+    }
+}
+
+int hal_serial_pending(void)
+{
+    return (int)(serialHead - serialTail);
+}
+
+int HardwareSerial::available()
+{
+    int n = hal_serial_pending();
+    if (n == 0)
+    {
+        hal_tick(hal_cost.serialWrite);         // Polling loops must see time moving
+    }
+    return (n > SERIAL_RX_BUFFER_SIZE - 1) ? SERIAL_RX_BUFFER_SIZE - 1 : n;
+}
+
+int HardwareSerial::peek()
+{
+    return (serialHead == serialTail) ? -1 : serialIn[serialTail % sizeof(serialIn)];
+}
+
+int HardwareSerial::read()
+{
+    if (serialHead == serialTail)
+    {
+        hal_tick(hal_cost.serialWrite);         // Polling loops must see time moving
+        return -1;
+    }
+    return serialIn[serialTail++ % sizeof(serialIn)];
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    hal_tick(hal_cost.serialWrite);
+    hal_stats.serialOut++;
+    if (hal_serial_sink)
+    {
+        hal_serial_sink(c);
+    }
+    else
+    {
+        fputc(c, stdout);
+    }
+    return 1;
+}
+
+size_t HardwareSerial::write(const char *str)
+{
+    size_t n = 0;
+    while (str && *str)
+    {
+        n += write((uint8_t)*str++);
+    }
+    return n;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        write(buffer[i]);
+    }
+    return size;
+}
+
+size_t HardwareSerial::printNumber(unsigned long value, int base)
+{
+    char buf[34];
+    char *p = &buf[sizeof(buf) - 1];
+    *p = 0;
+    if (base < 2)
+    {
+        base = 10;
+    }
+    do
+    {
+        unsigned d = (unsigned)(value % base);
+        *--p = (char)(d < 10 ? '0' + d : 'A' + d - 10);
+        value /= base;
+    } while (value);
+    return write(p);
+}
+
+size_t HardwareSerial::printSigned(long value, int base)
+{
+    if ((value < 0) && (base == DEC))
+    {
+        return write('-') + printNumber((unsigned long)-value, base);
+    }
+    if (base != DEC)
+    {
+        return printNumber((unsigned long)value & 0xFFFFFFFFUL, base);
+    }
+    return printNumber((unsigned long)value, base);
+}
+
+size_t HardwareSerial::print(double value, int digits)
+{
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", digits, value);
+    return write(buf);
+}
+
+size_t HardwareSerial::printf(const char *format, ...)
+{
+    char buf[256];
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(buf, sizeof(buf), format, ap);
+    va_end(ap);
+    return write(buf);
+}
+
+// ------------------------------------------------------------------------------
+// I2C
+// ------------------------------------------------------------------------------
+static uint8_t i2cTx[64];
+static uint8_t i2cRx[64];
+static uint8_t i2cRxPos;
+
+void hal_i2c_attach(uint8_t address, HalI2cDevice *device)
+{
+    i2cDevices[address & 0x7F] = device;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+    txAddress = address;
+    txCount = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+    if (txCount < sizeof(i2cTx))
+    {
+        i2cTx[txCount++] = data;
+    }
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop)
+{
+    (void)sendStop;
+    HalI2cDevice *dev = i2cDevices[txAddress & 0x7F];
+    hal_tick(20UL * (txCount + 1) * 16);        // ~100kHz bus: 9 clocks per byte
+    if (!dev)
+    {
+        return 2;                               // NACK on address
+    }
+    if (txCount)
+    {
+        dev->ptr = i2cTx[0];
+        for (uint8_t i = 1; i < txCount; i++)
+        {
+            dev->regs[dev->ptr++] = i2cTx[i];
+        }
+    }
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity)
+{
+    HalI2cDevice *dev = i2cDevices[address & 0x7F];
+    rxAddress = address;
+    rxCount = 0;
+    i2cRxPos = 0;
+    if (!dev)
+    {
+        return 0;
+    }
+    if (quantity > sizeof(i2cRx))
+    {
+        quantity = sizeof(i2cRx);
+    }
+    hal_tick(20UL * (quantity + 1) * 16);
+    for (uint8_t i = 0; i < quantity; i++)
+    {
+        i2cRx[i] = dev->regs[dev->ptr++];
+    }
+    rxCount = quantity;
+    return quantity;
+}
+
+int TwoWire::available()
+{
+    return rxCount - i2cRxPos;
+}
+
+int TwoWire::read()
+{
+    if (i2cRxPos >= rxCount)
+    {
+        return -1;
+    }
+    return i2cRx[i2cRxPos++];
+}
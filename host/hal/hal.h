@@ -0,0 +1,104 @@
+/*
+ * hal.h
+ *
+ * Host build: interface between the mock Arduino HAL and the board model that
+ * drives it (Z80 bus, SD card, serial console, I2C devices).
+ *
+ * Port indexes are 0 = PORTA, 1 = PORTB, 2 = PORTC, 3 = PORTD. Arduino pin
+ * numbers follow the ATmega1284P "standard" MightyCore pinout used by IOS:
+ * 0..7 = PB0..PB7, 8..15 = PD0..PD7, 16..23 = PC0..PC7, 24..31 = PA0..PA7.
+ */
+
+#ifndef HOST_HAL_H_
+#define HOST_HAL_H_
+
+#include <stdint.h>
+
+#define HAL_PORT_A  0
+#define HAL_PORT_B  1
+#define HAL_PORT_C  2
+#define HAL_PORT_D  3
+
+// ------------------------------------------------------------------------------
+// Modeled time (CPU cycles at F_CPU)
+// ------------------------------------------------------------------------------
+extern uint64_t hal_cycles;
+
+// Cycle cost charged for each core call (roughly what the AVR core costs)
+struct HalCost
+{
+    uint16_t digitalWrite;
+    uint16_t digitalRead;
+    uint16_t pinMode;
+    uint16_t regAccess;
+    uint16_t serialWrite;
+};
+extern HalCost hal_cost;
+
+// ------------------------------------------------------------------------------
+// Pins
+// ------------------------------------------------------------------------------
+extern uint8_t hal_out[4];                      // PORTx output latches
+extern uint8_t hal_ddr[4];                      // DDRx direction registers
+extern uint8_t hal_ext_level[4];                // Levels driven into the MCU from outside
+extern uint8_t hal_ext_drive[4];                // Mask of externally driven bits
+
+void    hal_pin_to_port(uint8_t pin, uint8_t *port, uint8_t *mask);
+uint8_t hal_pin_level(uint8_t pin);             // Current level seen on a pin (either direction)
+void    hal_drive(uint8_t pin, int level);      // Drive (level >= 0) or release (level < 0) a pin
+
+// Called after every PORTx/DDRx change, with the previous and new output latch
+typedef void    (*HalPortHook)(uint8_t port, uint8_t oldOut, uint8_t newOut);
+// Called before every PINx read so the model can update the external levels
+typedef void    (*HalInputHook)(uint8_t port);
+// Called for every byte exchanged on SPI (returns the MISO byte)
+typedef uint8_t (*HalSpiHook)(uint8_t mosi);
+// Called for every byte written to the serial port
+typedef void    (*HalSerialSink)(uint8_t c);
+
+extern HalPortHook      hal_port_hook;
+extern HalInputHook     hal_input_hook;
+extern HalSpiHook       hal_spi_hook;
+extern HalSerialSink    hal_serial_sink;
+
+// Called after every advance of hal_cycles (lets a model run along with the firmware)
+typedef void    (*HalTickHook)(void);
+extern HalTickHook      hal_tick_hook;
+
+// Register access without any cycle charged (for the models, "id" is a HalRegId)
+uint8_t hal_reg_peek(int id);
+void    hal_reg_poke(int id, uint8_t value);
+
+// ------------------------------------------------------------------------------
+// Serial console input
+// ------------------------------------------------------------------------------
+void hal_serial_feed(const char *text);
+void hal_serial_feed_byte(uint8_t c);
+int  hal_serial_pending(void);
+
+// ------------------------------------------------------------------------------
+// I2C register-file devices (MCP23017, DS3231...)
+// ------------------------------------------------------------------------------
+struct HalI2cDevice
+{
+    uint8_t regs[256];
+    uint8_t ptr;
+};
+void hal_i2c_attach(uint8_t address, HalI2cDevice *device);
+
+// ------------------------------------------------------------------------------
+// Statistics
+// ------------------------------------------------------------------------------
+struct HalStats
+{
+    unsigned long digitalWrites;
+    unsigned long digitalReads;
+    unsigned long spiBytes;
+    unsigned long serialOut;
+};
+extern HalStats hal_stats;
+
+// Reset all the MCU state (registers, time, EEPROM erased, statistics)
+void hal_reset(void);
+
+#endif /* HOST_HAL_H_ */
@@ -0,0 +1,19 @@
+/*
+ * util/delay.h
+ *
+ * Host build: busy waits only advance the modeled CPU time.
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+#include "util/delay_basic.h"
+
+#ifndef F_CPU
+    #define F_CPU 16000000UL
+#endif
+
+#define _delay_us(us)   hal_tick((uint32_t)((us) * (F_CPU / 1000000UL)))
+#define _delay_ms(ms)   hal_tick((uint32_t)((ms) * (F_CPU / 1000UL)))
+
+#endif /* HOST_UTIL_DELAY_H_ */
@@ -0,0 +1,17 @@
+/*
+ * util/delay_basic.h
+ *
+ * Host build: busy loops only advance the modeled CPU time.
+ */
+
+#ifndef HOST_UTIL_DELAY_BASIC_H_
+#define HOST_UTIL_DELAY_BASIC_H_
+
+#include <stdint.h>
+
+void hal_tick(uint32_t cycles);
+
+static inline void _delay_loop_1(uint8_t count)  { hal_tick(3UL * (count ? count : 256)); }
+static inline void _delay_loop_2(uint16_t count) { hal_tick(4UL * (count ? count : 65536UL)); }
+
+#endif /* HOST_UTIL_DELAY_BASIC_H_ */
@@ -0,0 +1,256 @@
+/*
+ * ioreplay.cpp
+ *
+ * Host build: replay of an I/O sessions log (IOLOG.DAT, see IoLog.h) against the
+ * IOS firmware. Each logged session is issued again as the Z80 did it, a STORE
+ * OPCODE and its data bytes, through the WAIT_ ISR and loop() down to PetitFS and
+ * the SD card model, so a workload taken on the board can be measured and debugged
+ * on Linux.
+ *
+ *   ioreplay [-S SDCONFIG] [-v] LOG IMAGE
+ *
+ *   -S SDCONFIG    SD card type and timing (e.g. "type=sdsc,read=100", see sd_config())
+ *   -v             print every record
+ *
+ * LOG is the log file copied from the card ("mbc2img get CARD IOLOG.DAT LOG"),
+ * IMAGE the volume the sessions run on (a copy of the card for the same data; it is
+ * written by WRITESECT and FILEWRITE). A write session sends the logged first bytes
+ * and then LOG_FILL bytes, so only the sessions up to ILOG_PARAMS bytes are sent as
+ * they were. A read session checks the sum of the bytes read against the logged one:
+ * a mismatch means the image (or the RTC, timers...) gives other data than the card.
+ * HIBERNATE, WARMBOOT, BOOTLOAD and SNAPSHOT reset the Z80, so they are skipped.
+ *
+ * Reported by opcode: the sessions, the data bytes, the read sum mismatches, the
+ * logged time (STORE OPCODE to the last data byte, Z80 time between the bytes
+ * included) and the modeled time of the replay (no Z80 time between the bytes).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "Arduino.h"
+#include "hal.h"
+#include "sdcard.h"
+#include "zbus.h"
+#include "../DefinitionsFile.h"
+#include "../IoProfile.h"
+#include "../IoLog.h"
+
+#define LOG_FILL        0xE5                    // Write data after the logged first bytes
+#define SERIAL_TX       0x01
+
+struct OpStats
+{
+    unsigned long   sessions;
+    unsigned long   skipped;
+    unsigned long   bytes;
+    unsigned long   mismatches;
+    double          loggedUs;
+    double          replayUs;
+};
+
+static OpStats      opStats[256];
+static uint8_t      verbose;
+
+static void nullSink(uint8_t c)
+{
+}
+
+static int skipOpcode(uint8_t opcode)
+{
+    return (opcode == 0x13) || (opcode == 0x14) || (opcode == 0x8B) || (opcode == 0x8C);
+}
+
+// ------------------------------------------------------------------------------
+// One logged session: 0 = ok, -1 = the Z80 is still in the wait state
+// ------------------------------------------------------------------------------
+static int replaySession(const IoLogRec *r, uint16_t *sum)
+{
+    int         data;
+
+    *sum = 0;
+    if (zbus_out(1, r->opcode))
+    {
+        return -1;
+    }
+    for (unsigned i = 0; i < r->bytes; i++)
+    {
+        if (r->opcode < 0x80)
+        {
+            data = (i < ILOG_PARAMS) ? r->param[i] : LOG_FILL;
+            if (zbus_out(0, (uint8_t)data))
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            data = zbus_in(0);
+            if (data < 0)
+            {
+                return -1;
+            }
+        }
+        *sum += (uint16_t)data;
+    }
+    return 0;
+}
+
+static int replayRecord(const IoLogRec *r, uint8_t mhz)
+{
+    OpStats     *s = &opStats[r->opcode];
+    uint64_t    startCycles = hal_cycles;
+    uint16_t    sum, expected;
+
+    s->loggedUs += r->duration * 16.0 / mhz;
+    if (skipOpcode(r->opcode))
+    {
+        s->skipped += r->repeat;
+        return 0;
+    }
+    expected = (r->opcode == SERIAL_TX) ? (uint16_t)(r->sum / r->repeat) : r->sum;
+    for (unsigned n = 0; n < r->repeat; n++)
+    {
+        if (replaySession(r, &sum))
+        {
+            fprintf(stderr, "ioreplay: opcode 0x%02X: the Z80 is still in the wait state\n", r->opcode);
+            return -1;
+        }
+        s->sessions++;
+        s->bytes += r->bytes;
+        if ((r->opcode >= 0x80) && (sum != expected))
+        {
+            s->mismatches++;
+        }
+    }
+    s->replayUs += (double)(hal_cycles - startCycles) / (F_CPU / 1000000.0);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------
+// Log file
+// ------------------------------------------------------------------------------
+static int readLog(const char *name, std::vector<uint8_t> &data)
+{
+    FILE    *f = fopen(name, "rb");
+    uint8_t buf[4096];
+    size_t  n;
+
+    if (!f)
+    {
+        return -1;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return 0;
+}
+
+static void printRecord(unsigned long index, const IoLogRec *r)
+{
+    printf("%6lu %10u 0x%02X x%-3u %5u %02X %02X %02X %02X  sum %04X %6u\n", index, r->time,
+           r->opcode, r->repeat, r->bytes, r->param[0], r->param[1], r->param[2], r->param[3],
+           r->sum, r->duration);
+}
+
+static void printReport(void)
+{
+    printf("\nopcode sessions  skipped     bytes mismatch  logged ms  replay ms\n");
+    for (unsigned op = 0; op < 256; op++)
+    {
+        const OpStats *s = &opStats[op];
+
+        if (!s->sessions && !s->skipped)
+        {
+            continue;
+        }
+        printf("0x%02X %10lu %8lu %9lu %8lu %10.1f %10.1f\n", op, s->sessions, s->skipped, s->bytes,
+               s->mismatches, s->loggedUs / 1000.0, s->replayUs / 1000.0);
+    }
+    printf("\n");
+    sd_print_stats();
+}
+
+// ------------------------------------------------------------------------------
+// Main
+// ------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    std::vector<uint8_t> log;
+    IoLogHead           head, first;
+    IoLogRec            rec;
+    unsigned long       sects = 0, records = 0, lost = 0;
+    int                 opt;
+
+    while ((opt = getopt(argc, argv, "S:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'S': if (sd_config(optarg)) optind = argc; break;
+            case 'v': verbose = 1; break;
+            default: optind = argc; break;
+        }
+    }
+    if (optind != argc - 2)
+    {
+        fprintf(stderr, "usage: ioreplay [-S SDCONFIG] [-v] LOG IMAGE\n");
+        return 2;
+    }
+    if (readLog(argv[optind], log))
+    {
+        fprintf(stderr, "ioreplay: cannot read %s\n", argv[optind]);
+        return 1;
+    }
+    if (log.size() >= 512)
+    {
+        memcpy(&first, log.data(), sizeof(first));
+    }
+    if ((log.size() < 512) || memcmp(first.magic, "ILOG", 4) || (first.version != ILOG_VERSION) || !first.mhz)
+    {
+        fprintf(stderr, "ioreplay: %s: no I/O log\n", argv[optind]);
+        return 1;
+    }
+    if (sd_open(argv[optind + 1]))
+    {
+        fprintf(stderr, "ioreplay: cannot open %s\n", argv[optind + 1]);
+        return 1;
+    }
+    hal_serial_sink = nullSink;                 // SERIAL TX, as the other opcodes, only counted
+    if (zbus_start_ios(0))
+    {
+        fprintf(stderr, "ioreplay: SD mount error\n");
+        return 1;
+    }
+    sd_reset_stats();
+    for (sects = 0; (sects + 1) * 512 <= log.size(); sects++)
+    {
+        memcpy(&head, &log[sects * 512], sizeof(head));
+        if (memcmp(head.magic, "ILOG", 4) || (head.session != first.session) || (head.index != sects) ||
+            (head.recs > ILOG_RECS))
+        {
+            break;                              // End of the log
+        }
+        lost = head.lost;
+        for (unsigned i = 0; i < head.recs; i++, records++)
+        {
+            memcpy(&rec, &log[sects * 512 + sizeof(IoLogHead) + i * sizeof(IoLogRec)], sizeof(rec));
+            if (verbose)
+            {
+                printRecord(records, &rec);
+            }
+            if (replayRecord(&rec, first.mhz))
+            {
+                sd_close();
+                return 1;
+            }
+        }
+    }
+    printf("session %u: %lu sectors, %lu records, %lu lost\n", first.session, sects, records, lost);
+    printReport();
+    sd_close();
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * main.cpp
+ *
+ * Host build: runs the IOS firmware on Linux against the mock HAL (hal/), with the
+ * SD card model (sdcard.cpp) on an image file and the Z80 I/O handshake driven by
+ * a script (zbus.cpp). The Z80 boot is skipped: IOS starts as setup() leaves it
+ * when the Z80 runs (pins, SD mounted, WAIT_ ISR enabled).
+ *
+ *   ios_host [-d DISKSET] [-S SDCONFIG] IMAGE [SCRIPT]     (no SCRIPT = stdin)
+ *
+ * SDCONFIG sets the SD card model, e.g. "type=sdsc,read=100" (see sd_config()).
+ *
+ * Script lines (numbers are decimal or 0x hex, # starts a comment):
+ *
+ *   out PORT BYTE...       Z80 OUT (PORT), PORT 1 = STORE OPCODE, 0 = EXECUTE WRITE OPCODE
+ *   in PORT [N]            Z80 IN (PORT) N times, the bytes are printed in hex
+ *   wr OPCODE BYTE...      STORE OPCODE then an EXECUTE WRITE OPCODE for each byte
+ *   rd OPCODE N            STORE OPCODE then N EXECUTE READ OPCODE, printed in hex
+ *   fill OPCODE BYTE N     STORE OPCODE then N EXECUTE WRITE OPCODE of BYTE
+ *   serial TEXT            queue TEXT (and a CR) on the serial console input
+ *   stats                  print what happened since the previous stats
+ *
+ * The IOS serial output goes to stdout as is.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "hal.h"
+#include "sdcard.h"
+#include "zbus.h"
+
+static uint64_t statsCycles;
+
+static long num(const char *s)
+{
+    return strtol(s, NULL, 0);
+}
+
+static void printStats(void)
+{
+    printf("\ntime %.3f ms (%llu cycles), Z80 OUT %lu IN %lu (ISR %lu, loop %lu), SPI bytes %lu\n",
+           (double)(hal_cycles - statsCycles) / (F_CPU / 1000.0), (unsigned long long)(hal_cycles - statsCycles),
+           zbus_stats.ioWrites, zbus_stats.ioReads, zbus_stats.isrServed, zbus_stats.loopServed,
+           hal_stats.spiBytes);
+    sd_print_stats();
+    statsCycles = hal_cycles;
+    memset(&zbus_stats, 0, sizeof(zbus_stats));
+    memset(&hal_stats, 0, sizeof(hal_stats));
+    sd_reset_stats();
+}
+
+static int doIn(byte port, long n)
+{
+    int data, i;
+
+    for (i = 0; i < n; i++)
+    {
+        data = zbus_in(port);
+        if (data < 0)
+        {
+            return -1;
+        }
+        printf("%02X%c", data, ((i % 16) == 15) || (i == n - 1) ? '\n' : ' ');
+    }
+    return 0;
+}
+
+static int runLine(char *line, int lineNum)
+{
+    char    *argv[600];
+    int     argc = 0;
+    int     res = 0;
+    int     i;
+    char    *p;
+
+    if ((p = strchr(line, '#')) != NULL)
+    {
+        *p = 0;
+    }
+    if (!strncmp(line, "serial ", 7))
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        hal_serial_feed(line + 7);
+        hal_serial_feed_byte('\r');
+        return 0;
+    }
+    for (p = strtok(line, " \t\r\n"); p && (argc < 600); p = strtok(NULL, " \t\r\n"))
+    {
+        argv[argc++] = p;
+    }
+    if (!argc)
+    {
+        return 0;
+    }
+    if (!strcmp(argv[0], "out") && (argc >= 3))
+    {
+        for (i = 2; (i < argc) && !res; i++)
+        {
+            res = zbus_out((byte)num(argv[1]), (byte)num(argv[i]));
+        }
+    }
+    else if (!strcmp(argv[0], "in") && (argc >= 2))
+    {
+        res = doIn((byte)num(argv[1]), (argc >= 3) ? num(argv[2]) : 1);
+    }
+    else if (!strcmp(argv[0], "wr") && (argc >= 2))
+    {
+        res = zbus_out(1, (byte)num(argv[1]));
+        for (i = 2; (i < argc) && !res; i++)
+        {
+            res = zbus_out(0, (byte)num(argv[i]));
+        }
+    }
+    else if (!strcmp(argv[0], "rd") && (argc >= 3))
+    {
+        res = zbus_out(1, (byte)num(argv[1]));
+        if (!res)
+        {
+            res = doIn(0, num(argv[2]));
+        }
+    }
+    else if (!strcmp(argv[0], "fill") && (argc >= 4))
+    {
+        res = zbus_out(1, (byte)num(argv[1]));
+        for (i = 0; (i < num(argv[3])) && !res; i++)
+        {
+            res = zbus_out(0, (byte)num(argv[2]));
+        }
+    }
+    else if (!strcmp(argv[0], "stats"))
+    {
+        printStats();
+    }
+    else
+    {
+        fprintf(stderr, "line %d: bad command %s\n", lineNum, argv[0]);
+        return -1;
+    }
+    if (res)
+    {
+        fprintf(stderr, "line %d: the Z80 is still in the wait state\n", lineNum);
+    }
+    return res;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE    *script = stdin;
+    char    line[4096];
+    int     lineNum = 0;
+    int     opt;
+    byte    set = 0;
+
+    while ((opt = getopt(argc, argv, "d:S:")) != -1)
+    {
+        if ((opt == 'd') || ((opt == 'S') && !sd_config(optarg)))
+        {
+            if (opt == 'd')
+            {
+                set = (byte)num(optarg);
+            }
+            continue;
+        }
+        optind = argc;                          // Print the usage
+        break;
+    }
+    if ((optind >= argc) || (argc - optind > 2))
+    {
+        fprintf(stderr, "usage: ios_host [-d DISKSET] [-S SDCONFIG] IMAGE [SCRIPT]\n");
+        return 2;
+    }
+    if (sd_open(argv[optind]))
+    {
+        fprintf(stderr, "ios_host: cannot open %s\n", argv[optind]);
+        return 1;
+    }
+    if ((argc - optind == 2) && !(script = fopen(argv[optind + 1], "r")))
+    {
+        fprintf(stderr, "ios_host: cannot open %s\n", argv[optind + 1]);
+        return 1;
+    }
+    if (zbus_start_ios(set))
+    {
+        fprintf(stderr, "ios_host: SD mount error\n");
+        return 1;
+    }
+    printStats();
+    while (fgets(line, sizeof(line), script))
+    {
+        lineNum++;
+        fflush(stdout);
+        if (runLine(line, lineNum))
+        {
+            return 1;
+        }
+    }
+    fflush(stdout);
+    sd_close();
+    return 0;
+}
@@ -0,0 +1,498 @@
+/*
+ * sdcard.cpp
+ *
+ * Host build: SPI mode SD card model (see sdcard.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "sdcard.h"
+
+#define SD_CS_MASK      0x10                    // PB4
+
+#define R1_IDLE         0x01
+#define R1_ILLEGAL      0x04
+#define R1_ADDRESS      0x20
+#define R1_PARAMETER    0x40
+
+SdStats     sd_stats;
+SdTiming    sd_timing   = { 2, 4, 2, 0 };
+uint8_t     sd_type     = SD_TYPE_SDHC;
+
+enum SdState
+{
+    SD_CMD,                                     // Waiting for / receiving a command frame
+    SD_READ_MULTI,                              // CMD18 accepted, sending blocks until CMD12
+    SD_WRITE_TOKEN,                             // CMD24/CMD25 accepted, waiting for a data token
+    SD_WRITE_DATA                               // Receiving the data block and its CRC
+};
+
+static FILE     *image;
+static uint32_t imageSectors;
+static SdState  state;
+static uint8_t  frame[6];
+static uint8_t  frameLen;
+static uint8_t  idle        = 1;
+static uint8_t  appCmd;
+static uint16_t initLeft;                       // ACMD41/CMD1 still to answer "idle"
+static uint32_t readSector;                     // Next block of a CMD17/CMD18
+static uint8_t  readPending;                    // Block queued when the latency is over
+static uint8_t  readEnd;                        // CMD18 past the last sector
+static uint32_t writeSector;
+static uint8_t  writeMulti;
+static uint16_t writeLen;
+static uint8_t  block[514];
+static uint32_t areaStart[4];                   // First sector of each SD_AREA_xxx
+
+static uint8_t  out[600];                       // MISO bytes queued for the host
+static uint16_t outHead, outTail;
+static uint16_t outData     = sizeof(out);      // First queued byte of a data block
+static uint16_t fillLen;                        // Latency/busy bytes sent after the queue
+static uint8_t  fillByte;
+
+static void put(uint8_t b)
+{
+    if (outTail < sizeof(out))
+    {
+        out[outTail++] = b;
+    }
+}
+
+static void fill(uint8_t b, uint16_t n)
+{
+    fillByte = b;
+    fillLen = n;
+}
+
+static void flushOut(void)
+{
+    outHead = outTail = 0;
+    outData = sizeof(out);
+    fillLen = 0;
+    readPending = 0;
+}
+
+static void readSectorData(uint32_t sector, uint8_t *buf)
+{
+    memset(buf, 0, 512);
+    fseek(image, (long)sector * 512, SEEK_SET);
+    if (fread(buf, 1, 512, image) != 512)
+    {
+        sd_stats.errors++;
+    }
+}
+
+static int writeSectorData(uint32_t sector, const uint8_t *buf)
+{
+    if (sector >= imageSectors)
+    {
+        sd_stats.errors++;
+        return -1;
+    }
+    fseek(image, (long)sector * 512, SEEK_SET);
+    fwrite(buf, 1, 512, image);
+    fflush(image);
+    return 0;
+}
+
+// Block number from a command argument (R1 error bits, 0 = ok)
+static uint8_t blockAddress(uint32_t arg, uint32_t *sector)
+{
+    if (sd_type == SD_TYPE_SDHC)
+    {
+        *sector = arg;
+    }
+    else
+    {
+        if (arg & 511)
+        {
+            return R1_ADDRESS;                  // Byte address not aligned to the 512 bytes block
+        }
+        *sector = arg >> 9;
+    }
+    return (*sector < imageSectors) ? 0 : R1_PARAMETER;
+}
+
+// Data token, block and CRC of readSector
+static void queueBlock(void)
+{
+    readPending = 0;
+    if (readSector >= imageSectors)
+    {
+        put(0x08);                              // Data error token: out of range
+        sd_stats.errors++;
+        readEnd = 1;
+        return;
+    }
+    outData = outTail;
+    put(0xFE);
+    readSectorData(readSector, block);
+    for (int i = 0; i < 512; i++)
+    {
+        put(block[i]);
+    }
+    put(0x00); put(0x00);                       // CRC (not checked)
+    sd_stats.blocksRead++;
+    sd_stats.areaReads[(readSector >= areaStart[SD_AREA_DATA]) ? SD_AREA_DATA :
+                       (readSector >= areaStart[SD_AREA_DIR]) ? SD_AREA_DIR :
+                       (readSector >= areaStart[SD_AREA_FAT]) ? SD_AREA_FAT : SD_AREA_BOOT]++;
+    readSector++;
+}
+
+static void startRead(void)
+{
+    readPending = 1;
+    fill(0xFF, sd_timing.readLatency);
+    if (!fillLen)
+    {
+        queueBlock();
+    }
+}
+
+// Next MISO byte: the queue, then the latency/busy fill, then the next CMD18 block
+static uint8_t nextOut(void)
+{
+    uint8_t b;
+
+    if (outHead < outTail)
+    {
+        if (outHead >= outData)
+        {
+            sd_stats.dataBytes++;
+        }
+        b = out[outHead++];
+        if (outHead == outTail)
+        {
+            outHead = outTail = 0;
+            outData = sizeof(out);
+        }
+        return b;
+    }
+    if (fillLen)
+    {
+        fillLen--;
+        sd_stats.waitBytes++;
+        b = fillByte;
+        if (!fillLen && readPending)
+        {
+            queueBlock();
+        }
+        return b;
+    }
+    if ((state == SD_READ_MULTI) && !readEnd)
+    {
+        startRead();
+        return nextOut();
+    }
+    return 0xFF;
+}
+
+// ACMD41 (SD) / CMD1 (MMC): "idle" for initPolls times after CMD0, then ready
+static void sendOpCond(void)
+{
+    if (initLeft)
+    {
+        initLeft--;
+        put(R1_IDLE);
+        return;
+    }
+    idle = 0;
+    put(0x00);
+}
+
+static void command(void)
+{
+    uint8_t  index = frame[0] & 0x3F;
+    uint32_t arg = ((uint32_t)frame[1] << 24) | ((uint32_t)frame[2] << 16) | ((uint32_t)frame[3] << 8) | frame[4];
+    uint8_t  isApp = appCmd;
+    uint8_t  isSd = (sd_type != SD_TYPE_MMC);
+    uint8_t  err;
+
+    appCmd = 0;
+    sd_stats.cmd[index]++;
+    if (state == SD_READ_MULTI)
+    {
+        // A command stops the transmission: the stuff byte, then the response
+        flushOut();
+        state = SD_CMD;
+        put(0xFF);
+        if (index == 12)                        // STOP_TRANSMISSION
+        {
+            put(0x00);
+            fill(0x00, sd_timing.stopBusy);
+            return;
+        }
+    }
+    put(0xFF);                                  // NCR
+    switch (index)
+    {
+        case 0:                                 // GO_IDLE_STATE
+            idle = 1;
+            initLeft = sd_timing.initPolls;
+            put(R1_IDLE);
+            break;
+        case 1:                                 // SEND_OP_COND (MMC)
+            if (isSd)
+            {
+                put(R1_ILLEGAL | idle);
+                break;
+            }
+            sendOpCond();
+            break;
+        case 8:                                 // SEND_IF_COND (R7), SDv2 only
+            if ((sd_type != SD_TYPE_SDHC) && (sd_type != SD_TYPE_SDSC))
+            {
+                put(R1_ILLEGAL | idle);
+                break;
+            }
+            put(idle);
+            put(0x00); put(0x00); put((uint8_t)(arg >> 8)); put((uint8_t)arg);
+            break;
+        case 55:                                // APP_CMD
+            if (!isSd)
+            {
+                put(R1_ILLEGAL | idle);
+                break;
+            }
+            appCmd = 1;
+            put(idle);
+            break;
+        case 41:                                // SEND_OP_COND (ACMD41)
+            if (!isApp)
+            {
+                put(R1_ILLEGAL | idle);
+                break;
+            }
+            sendOpCond();
+            break;
+        case 23:                                // SET_WR_BLK_ERASE_COUNT (ACMD23), SET_BLOCK_COUNT (MMC)
+            put((isApp || !isSd) ? idle : (R1_ILLEGAL | idle));
+            break;
+        case 58:                                // READ_OCR (R3): power up status, CCS
+            put(idle);
+            put((idle ? 0x00 : 0x80) | ((sd_type == SD_TYPE_SDHC) ? 0x40 : 0x00));
+            put(0xFF); put(0x80); put(0x00);
+            break;
+        case 16:                                // SET_BLOCKLEN (512 bytes only)
+            put((arg == 512) ? idle : (R1_PARAMETER | idle));
+            break;
+        case 12:                                // STOP_TRANSMISSION with no CMD18 running
+            put(R1_ILLEGAL | idle);
+            break;
+        case 17:                                // READ_SINGLE_BLOCK
+        case 18:                                // READ_MULTIPLE_BLOCK
+            err = idle ? R1_ILLEGAL : blockAddress(arg, &readSector);
+            if (err)
+            {
+                put(err | idle);
+                sd_stats.errors++;
+                break;
+            }
+            put(0x00);
+            readEnd = 0;
+            if (index == 18)
+            {
+                state = SD_READ_MULTI;
+            }
+            startRead();
+            break;
+        case 24:                                // WRITE_BLOCK
+        case 25:                                // WRITE_MULTIPLE_BLOCK
+            err = idle ? R1_ILLEGAL : blockAddress(arg, &writeSector);
+            if (err)
+            {
+                put(err | idle);
+                sd_stats.errors++;
+                break;
+            }
+            put(0x00);
+            writeMulti = (index == 25);
+            state = SD_WRITE_TOKEN;
+            break;
+        default:
+            put(R1_ILLEGAL | idle);
+            break;
+    }
+}
+
+static uint8_t spiExchange(uint8_t mosi)
+{
+    uint8_t miso;
+    uint8_t sending;
+
+    sd_stats.bytes++;
+    if (hal_out[HAL_PORT_B] & SD_CS_MASK)
+    {
+        // Not selected: the card ignores the clocks (a write busy ends here too, a
+        // CMD18 stays where it is)
+        sd_stats.deselBytes++;
+        frameLen = 0;
+        if (state != SD_READ_MULTI)
+        {
+            flushOut();
+        }
+        return 0xFF;
+    }
+    sending = (outHead < outTail) || fillLen;
+    miso = nextOut();
+    if (sending && (state == SD_CMD))
+    {
+        return miso;                            // The host clocks a response out
+    }
+    switch (state)
+    {
+        case SD_CMD:
+        case SD_READ_MULTI:
+            if (frameLen || ((mosi & 0xC0) == 0x40))
+            {
+                sd_stats.cmdBytes++;
+                frame[frameLen++] = mosi;
+                if (frameLen == sizeof(frame))
+                {
+                    frameLen = 0;
+                    command();
+                }
+            }
+            break;
+        case SD_WRITE_TOKEN:
+            if ((mosi == 0xFE) && !writeMulti)
+            {
+                writeLen = 0;
+                state = SD_WRITE_DATA;
+                sd_stats.dataBytes++;
+            }
+            else if ((mosi == 0xFC) && writeMulti)
+            {
+                writeLen = 0;
+                state = SD_WRITE_DATA;
+                sd_stats.dataBytes++;
+            }
+            else if ((mosi == 0xFD) && writeMulti)
+            {
+                put(0xFF);                      // Stop Tran: one byte, then busy
+                fill(0x00, sd_timing.stopBusy);
+                state = SD_CMD;
+            }
+            else if (mosi != 0xFF)
+            {
+                sd_stats.errors++;
+                state = SD_CMD;
+            }
+            break;
+        case SD_WRITE_DATA:
+            sd_stats.dataBytes++;
+            block[writeLen++] = mosi;
+            if (writeLen == sizeof(block))
+            {
+                put(writeSectorData(writeSector, block) ? 0x0D : 0x05);     // Write error / data accepted
+                fill(0x00, sd_timing.writeBusy);
+                sd_stats.blocksWritten++;
+                writeSector++;
+                state = writeMulti ? SD_WRITE_TOKEN : SD_CMD;
+            }
+            break;
+    }
+    return miso;
+}
+
+int sd_open(const char *path)
+{
+    long size;
+
+    sd_close();
+    image = fopen(path, "r+b");
+    if (!image)
+    {
+        return -1;
+    }
+    fseek(image, 0, SEEK_END);
+    size = ftell(image);
+    imageSectors = (uint32_t)(size / 512);
+    state = SD_CMD;
+    frameLen = 0;
+    idle = 1;
+    appCmd = 0;
+    initLeft = sd_timing.initPolls;
+    flushOut();
+    hal_spi_hook = spiExchange;
+    return 0;
+}
+
+void sd_close(void)
+{
+    if (image)
+    {
+        fclose(image);
+        image = NULL;
+    }
+    hal_spi_hook = NULL;
+}
+
+// Card type and timing, e.g. "type=sdsc,read=100,busy=400"
+int sd_config(const char *spec)
+{
+    static const char *const types[] = { "sdhc", "sdsc", "sd1", "mmc" };
+    char    buf[128];
+    char    *item, *value;
+    long    n;
+    uint8_t i;
+
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    for (item = strtok(buf, ","); item; item = strtok(NULL, ","))
+    {
+        value = strchr(item, '=');
+        if (!value)
+        {
+            return -1;
+        }
+        *value++ = 0;
+        if (!strcmp(item, "type"))
+        {
+            for (i = 0; (i < 4) && strcmp(value, types[i]); i++);
+            if (i == 4)
+            {
+                return -1;
+            }
+            sd_type = i;
+            continue;
+        }
+        n = strtol(value, NULL, 0);
+        if ((n < 0) || (n > 0xFFFF))
+        {
+            return -1;
+        }
+        if (!strcmp(item, "read")) sd_timing.readLatency = (uint16_t)n;
+        else if (!strcmp(item, "busy")) sd_timing.writeBusy = (uint16_t)n;
+        else if (!strcmp(item, "stop")) sd_timing.stopBusy = (uint16_t)n;
+        else if (!strcmp(item, "init")) sd_timing.initPolls = (uint16_t)n;
+        else return -1;
+    }
+    return 0;
+}
+
+// Volume layout used to account the reads by area (all data if not set)
+void sd_set_layout(uint32_t fatStart, uint32_t dirStart, uint32_t dataStart)
+{
+    areaStart[SD_AREA_FAT] = fatStart;
+    areaStart[SD_AREA_DIR] = dirStart;
+    areaStart[SD_AREA_DATA] = dataStart;
+}
+
+void sd_reset_stats(void)
+{
+    memset(&sd_stats, 0, sizeof(sd_stats));
+}
+
+void sd_print_stats(void)
+{
+    printf("SD: CMD17 %lu, CMD18 %lu (blocks FAT %lu, dir %lu, data %lu), CMD24 %lu, CMD25 %lu, CMD55 %lu, other %lu, errors %lu\n",
+           sd_stats.cmd[17], sd_stats.cmd[18], sd_stats.areaReads[SD_AREA_FAT], sd_stats.areaReads[SD_AREA_DIR],
+           sd_stats.areaReads[SD_AREA_DATA], sd_stats.cmd[24], sd_stats.cmd[25], sd_stats.cmd[55],
+           sd_stats.cmd[0] + sd_stats.cmd[1] + sd_stats.cmd[8] + sd_stats.cmd[41] + sd_stats.cmd[58] + sd_stats.cmd[16] +
+           sd_stats.cmd[12] + sd_stats.cmd[23], sd_stats.errors);
+    printf("SD SPI: %lu bytes (command %lu, data %lu, wait %lu, deselected %lu)\n",
+           sd_stats.bytes, sd_stats.cmdBytes, sd_stats.dataBytes, sd_stats.waitBytes, sd_stats.deselBytes);
+}
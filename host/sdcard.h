@@ -0,0 +1,64 @@
+/*
+ * sdcard.h
+ *
+ * Host build: SPI mode SD card model backed by an image file (a FAT16/FAT32 volume as
+ * made by tools/mbc2img). It runs on the hal_spi_hook, one byte for each byte clocked
+ * by the AVR SPI, and answers while the card is selected (SD CS = PB4 low):
+ *
+ *   CMD0, CMD1 (MMC), CMD8, CMD12, CMD16, CMD17, CMD18, CMD24, CMD25, CMD55, CMD58,
+ *   ACMD23, ACMD41
+ *
+ * with the data tokens (0xFE, 0xFC, 0xFD), the data responses and the busy periods
+ * of a real card. The card type (SDHC block addressing, SDSC/SDv1/MMC byte addressing)
+ * and the timing are set with sd_timing/sd_type (or sd_config()) before sd_open().
+ */
+
+#ifndef HOST_SDCARD_H_
+#define HOST_SDCARD_H_
+
+#include <stdint.h>
+
+struct SdStats
+{
+    unsigned long cmd[64];                      // Commands received (by index, ACMDs as their CMD)
+    unsigned long blocksRead;                   // Data blocks sent (CMD17 and CMD18)
+    unsigned long blocksWritten;                // Data blocks written (CMD24 and CMD25)
+    unsigned long errors;                       // Out of range or misaligned addresses, bad tokens
+    unsigned long areaReads[4];                 // Blocks read by volume area (SD_AREA_xxx, see sd_set_layout())
+    unsigned long bytes;                        // Every byte clocked on the SPI
+    unsigned long deselBytes;                   //   with the card not selected
+    unsigned long cmdBytes;                     //   command frames
+    unsigned long dataBytes;                    //   data blocks (token, 512 bytes, CRC) both ways
+    unsigned long waitBytes;                    //   read latency and busy bytes clocked out
+};
+
+#define SD_AREA_BOOT    0                       // Boot sector and reserved sectors
+#define SD_AREA_FAT     1                       // FATs
+#define SD_AREA_DIR     2                       // FAT16 root directory
+#define SD_AREA_DATA    3                       // Clusters (FAT32 directories too)
+extern SdStats sd_stats;
+
+// Card timing, in SPI bytes
+struct SdTiming
+{
+    uint16_t readLatency;                       // 0xFF before each data token of a read
+    uint16_t writeBusy;                         // Busy (0x00) after each data block written
+    uint16_t stopBusy;                          // Busy after CMD12 and after the Stop Tran token
+    uint16_t initPolls;                         // ACMD41/CMD1 answered "idle" before the card is ready
+};
+extern SdTiming sd_timing;
+
+#define SD_TYPE_SDHC    0                       // SDv2, block addressing (CCS = 1)
+#define SD_TYPE_SDSC    1                       // SDv2, byte addressing (CCS = 0)
+#define SD_TYPE_SD1     2                       // SDv1 (no CMD8), byte addressing
+#define SD_TYPE_MMC     3                       // MMCv3 (no CMD8 and ACMD41, CMD1), byte addressing
+extern uint8_t sd_type;
+
+int  sd_open(const char *image);                // Attach the card (0 = ok); hooks hal_spi_hook
+void sd_close(void);
+int  sd_config(const char *spec);               // "type=sdsc,read=N,busy=N,stop=N,init=N" (0 = ok)
+void sd_set_layout(uint32_t fatStart, uint32_t dirStart, uint32_t dataStart);
+void sd_reset_stats(void);
+void sd_print_stats(void);
+
+#endif /* HOST_SDCARD_H_ */
@@ -0,0 +1,9 @@
+/*
+ * sketch.cpp
+ *
+ * Host build: the IOS sketch as a C++ translation unit (the Arduino IDE adds the
+ * Arduino.h include).
+ */
+
+#include "Arduino.h"
+#include "../Z80-MBC2-ATMEL1284.ino"
@@ -0,0 +1,1015 @@
+/*
+ * z80.cpp
+ *
+ * Host build: instruction level Z80 CPU (see z80.h). The timing of each instruction
+ * is built from its machine cycles (4 T opcode fetch, 3 T memory read/write, 4 T
+ * I/O) plus the internal T-states, as in the Zilog Z80 CPU User Manual.
+ */
+
+#include "z80.h"
+
+#define FLAG_C          0x01
+#define FLAG_N          0x02
+#define FLAG_PV         0x04
+#define FLAG_X          0x08
+#define FLAG_H          0x10
+#define FLAG_Y          0x20
+#define FLAG_Z          0x40
+#define FLAG_S          0x80
+
+static uint8_t  sz53[256];                      // S, Z, Y and X flags of a result
+static uint8_t  sz53p[256];                     // The same, plus the parity
+static uint8_t  tablesReady;
+
+static Z80Cpu   *cpu;                           // CPU of the current z80_step()
+static uint16_t *idx;                           // HL, or IX/IY after a DD/FD prefix
+static uint8_t  prefixed;                       // DD/FD prefix seen
+
+static void initTables(void)
+{
+    int     i, bit;
+    uint8_t parity;
+
+    for (i = 0; i < 256; i++)
+    {
+        parity = 0;
+        for (bit = 0; bit < 8; bit++)
+        {
+            parity ^= (i >> bit) & 1;
+        }
+        sz53[i] = (uint8_t)((i & (FLAG_S | FLAG_Y | FLAG_X)) | (i ? 0 : FLAG_Z));
+        sz53p[i] = (uint8_t)(sz53[i] | (parity ? 0 : FLAG_PV));
+    }
+    tablesReady = 1;
+}
+
+// ------------------------------------------------------------------------------
+// Registers
+// ------------------------------------------------------------------------------
+static inline uint8_t getA(void)            { return (uint8_t)(cpu->af >> 8); }
+static inline uint8_t getF(void)            { return (uint8_t)cpu->af; }
+static inline void    setA(uint8_t v)       { cpu->af = (uint16_t)((cpu->af & 0x00FF) | (v << 8)); }
+static inline void    setF(uint8_t v)       { cpu->af = (uint16_t)((cpu->af & 0xFF00) | v); }
+static inline void    setHi(uint16_t *rp, uint8_t v) { *rp = (uint16_t)((*rp & 0x00FF) | (v << 8)); }
+static inline void    setLo(uint16_t *rp, uint8_t v) { *rp = (uint16_t)((*rp & 0xFF00) | v); }
+
+// r = B, C, D, E, H, L, -, A (6 is (HL) and is handled by the caller). "hp" is the
+//  pair used for H and L (HL, or IX/IY for the IXH/IXL/IYH/IYL forms)
+static uint8_t getReg(int r, uint16_t *hp)
+{
+    switch (r)
+    {
+        case 0: return (uint8_t)(cpu->bc >> 8);
+        case 1: return (uint8_t)cpu->bc;
+        case 2: return (uint8_t)(cpu->de >> 8);
+        case 3: return (uint8_t)cpu->de;
+        case 4: return (uint8_t)(*hp >> 8);
+        case 5: return (uint8_t)*hp;
+        default: return getA();
+    }
+}
+
+static void setReg(int r, uint8_t v, uint16_t *hp)
+{
+    switch (r)
+    {
+        case 0: setHi(&cpu->bc, v); break;
+        case 1: setLo(&cpu->bc, v); break;
+        case 2: setHi(&cpu->de, v); break;
+        case 3: setLo(&cpu->de, v); break;
+        case 4: setHi(hp, v); break;
+        case 5: setLo(hp, v); break;
+        case 7: setA(v); break;
+    }
+}
+
+// rp = BC, DE, HL (IX/IY), SP. rp2 = BC, DE, HL (IX/IY), AF
+static uint16_t *regPair(int p)
+{
+    switch (p)
+    {
+        case 0: return &cpu->bc;
+        case 1: return &cpu->de;
+        case 2: return idx;
+        default: return &cpu->sp;
+    }
+}
+
+static uint16_t *regPair2(int p)
+{
+    return (p == 3) ? &cpu->af : regPair(p);
+}
+
+static int cond(int y)
+{
+    static const uint8_t mask[4] = { FLAG_Z, FLAG_C, FLAG_PV, FLAG_S };
+
+    return ((getF() & mask[y >> 1]) != 0) == (y & 1);
+}
+
+// ------------------------------------------------------------------------------
+// Machine cycles
+// ------------------------------------------------------------------------------
+static inline void idle(int n)
+{
+    cpu->t = (uint16_t)(cpu->t + n);
+}
+
+static inline void incR(void)
+{
+    cpu->r = (uint8_t)((cpu->r & 0x80) | ((cpu->r + 1) & 0x7F));
+}
+
+static uint8_t fetchOp(void)
+{
+    uint8_t op = cpu->stall ? 0x00 : cpu->bus->fetch(cpu, cpu->pc, cpu->t);
+
+    cpu->pc++;
+    idle(4);
+    incR();
+    return op;
+}
+
+static uint8_t rd(uint16_t addr)
+{
+    uint8_t v = cpu->stall ? 0xFF : cpu->bus->read(cpu, addr, cpu->t);
+
+    idle(3);
+    return v;
+}
+
+static void wr(uint16_t addr, uint8_t v)
+{
+    if (!cpu->stall)
+    {
+        cpu->bus->write(cpu, addr, v, cpu->t);
+    }
+    idle(3);
+}
+
+static uint8_t ioIn(uint16_t port)
+{
+    uint8_t v = cpu->stall ? 0xFF : cpu->bus->in(cpu, port, cpu->t);
+
+    idle(4);
+    return v;
+}
+
+static void ioOut(uint16_t port, uint8_t v)
+{
+    if (!cpu->stall)
+    {
+        cpu->bus->out(cpu, port, v, cpu->t);
+    }
+    idle(4);
+}
+
+static uint8_t imm8(void)
+{
+    return rd(cpu->pc++);
+}
+
+static uint16_t imm16(void)
+{
+    uint8_t lo = imm8();
+
+    return (uint16_t)(lo | (imm8() << 8));
+}
+
+static uint16_t rd16(uint16_t addr)
+{
+    uint8_t lo = rd(addr);
+
+    return (uint16_t)(lo | (rd((uint16_t)(addr + 1)) << 8));
+}
+
+static void wr16(uint16_t addr, uint16_t v)
+{
+    wr(addr, (uint8_t)v);
+    wr((uint16_t)(addr + 1), (uint8_t)(v >> 8));
+}
+
+static void push(uint16_t v)
+{
+    wr(--cpu->sp, (uint8_t)(v >> 8));
+    wr(--cpu->sp, (uint8_t)v);
+}
+
+static uint16_t pop(void)
+{
+    uint16_t v = rd16(cpu->sp);
+
+    cpu->sp += 2;
+    return v;
+}
+
+// Address of the (HL) operand, or (IX+d)/(IY+d) reading the displacement
+static uint16_t memOperand(void)
+{
+    int8_t d;
+
+    if (!prefixed)
+    {
+        return cpu->hl;
+    }
+    d = (int8_t)imm8();
+    idle(5);
+    return (uint16_t)(*idx + d);
+}
+
+// ------------------------------------------------------------------------------
+// ALU
+// ------------------------------------------------------------------------------
+static void alu(int op, uint8_t v)
+{
+    unsigned    a = getA();
+    unsigned    res;
+    uint8_t     carry = (op == 1 || op == 3) ? (getF() & FLAG_C) : 0;
+
+    switch (op)
+    {
+        case 0:                                 // ADD
+        case 1:                                 // ADC
+            res = a + v + carry;
+            setA((uint8_t)res);
+            setF((uint8_t)(sz53[res & 0xFF] | ((a ^ v ^ res) & FLAG_H) |
+                           ((((a ^ ~v) & (a ^ res)) & 0x80) >> 5) | ((res >> 8) & FLAG_C)));
+            break;
+        case 2:                                 // SUB
+        case 3:                                 // SBC
+        case 7:                                 // CP
+            res = a - v - carry;
+            if (op != 7)
+            {
+                setA((uint8_t)res);
+                setF((uint8_t)(FLAG_N | sz53[res & 0xFF] | ((a ^ v ^ res) & FLAG_H) |
+                               ((((a ^ v) & (a ^ res)) & 0x80) >> 5) | ((res >> 8) & FLAG_C)));
+            }
+            else
+            {
+                setF((uint8_t)(FLAG_N | (sz53[res & 0xFF] & (FLAG_S | FLAG_Z)) | (v & (FLAG_X | FLAG_Y)) |
+                               ((a ^ v ^ res) & FLAG_H) | ((((a ^ v) & (a ^ res)) & 0x80) >> 5) |
+                               ((res >> 8) & FLAG_C)));
+            }
+            break;
+        case 4:                                 // AND
+            setA((uint8_t)(a & v));
+            setF((uint8_t)(sz53p[getA()] | FLAG_H));
+            break;
+        case 5:                                 // XOR
+            setA((uint8_t)(a ^ v));
+            setF(sz53p[getA()]);
+            break;
+        case 6:                                 // OR
+            setA((uint8_t)(a | v));
+            setF(sz53p[getA()]);
+            break;
+    }
+}
+
+static uint8_t inc8(uint8_t v)
+{
+    uint8_t res = (uint8_t)(v + 1);
+
+    setF((uint8_t)((getF() & FLAG_C) | sz53[res] | (((res & 0x0F) == 0) ? FLAG_H : 0) |
+                   ((v == 0x7F) ? FLAG_PV : 0)));
+    return res;
+}
+
+static uint8_t dec8(uint8_t v)
+{
+    uint8_t res = (uint8_t)(v - 1);
+
+    setF((uint8_t)((getF() & FLAG_C) | FLAG_N | sz53[res] | (((v & 0x0F) == 0) ? FLAG_H : 0) |
+                   ((v == 0x80) ? FLAG_PV : 0)));
+    return res;
+}
+
+static void add16(uint16_t *rp, uint16_t v)
+{
+    uint32_t res = (uint32_t)*rp + v;
+
+    setF((uint8_t)((getF() & (FLAG_S | FLAG_Z | FLAG_PV)) | ((res >> 8) & (FLAG_X | FLAG_Y)) |
+                   (((*rp ^ v ^ res) >> 8) & FLAG_H) | ((res >> 16) & FLAG_C)));
+    *rp = (uint16_t)res;
+}
+
+static void adcSbc16(int sub, uint16_t v)
+{
+    uint32_t hl = cpu->hl;
+    uint32_t res = sub ? hl - v - (getF() & FLAG_C) : hl + v + (getF() & FLAG_C);
+    uint32_t ov = sub ? ((hl ^ v) & (hl ^ res)) : (~(hl ^ v) & (hl ^ res));
+
+    setF((uint8_t)((sub ? FLAG_N : 0) | ((res >> 8) & (FLAG_S | FLAG_X | FLAG_Y)) |
+                   ((res & 0xFFFF) ? 0 : FLAG_Z) | (((hl ^ v ^ res) >> 8) & FLAG_H) |
+                   ((ov & 0x8000) >> 13) | ((res >> 16) & FLAG_C)));
+    cpu->hl = (uint16_t)res;
+}
+
+// RLC, RRC, RL, RR, SLA, SRA, SLL, SRR (CB prefix)
+static uint8_t rot(int op, uint8_t v)
+{
+    uint8_t carry;
+
+    switch (op)
+    {
+        case 0:  carry = v >> 7; v = (uint8_t)((v << 1) | carry); break;
+        case 1:  carry = v & 1;  v = (uint8_t)((v >> 1) | (carry << 7)); break;
+        case 2:  carry = v >> 7; v = (uint8_t)((v << 1) | (getF() & FLAG_C)); break;
+        case 3:  carry = v & 1;  v = (uint8_t)((v >> 1) | ((getF() & FLAG_C) << 7)); break;
+        case 4:  carry = v >> 7; v = (uint8_t)(v << 1); break;
+        case 5:  carry = v & 1;  v = (uint8_t)((v >> 1) | (v & 0x80)); break;
+        case 6:  carry = v >> 7; v = (uint8_t)((v << 1) | 1); break;
+        default: carry = v & 1;  v = (uint8_t)(v >> 1); break;
+    }
+    setF((uint8_t)(sz53p[v] | carry));
+    return v;
+}
+
+static void bitTest(int bit, uint8_t v)
+{
+    setF((uint8_t)((getF() & FLAG_C) | FLAG_H | (v & (FLAG_X | FLAG_Y)) |
+                   ((v & (1 << bit)) ? ((bit == 7) ? FLAG_S : 0) : (FLAG_Z | FLAG_PV))));
+}
+
+static void daa(void)
+{
+    uint8_t a = getA();
+    uint8_t f = getF();
+    uint8_t diff = 0;
+    uint8_t carry = 0;
+    uint8_t half;
+    uint8_t res;
+
+    if ((f & FLAG_H) || ((a & 0x0F) > 9))
+    {
+        diff = 0x06;
+    }
+    if ((f & FLAG_C) || (a > 0x99))
+    {
+        diff |= 0x60;
+        carry = FLAG_C;
+    }
+    if (f & FLAG_N)
+    {
+        res = (uint8_t)(a - diff);
+        half = ((f & FLAG_H) && ((a & 0x0F) < 6)) ? FLAG_H : 0;
+    }
+    else
+    {
+        res = (uint8_t)(a + diff);
+        half = ((a & 0x0F) > 9) ? FLAG_H : 0;
+    }
+    setA(res);
+    setF((uint8_t)(sz53p[res] | carry | half | (f & FLAG_N)));
+}
+
+// ------------------------------------------------------------------------------
+// CB prefix (and DD CB d / FD CB d)
+// ------------------------------------------------------------------------------
+static void execCB(uint8_t op)
+{
+    int     x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+    uint8_t v;
+
+    if (z == 6)
+    {
+        v = rd(cpu->hl);
+        idle(1);
+    }
+    else
+    {
+        v = getReg(z, &cpu->hl);
+    }
+    switch (x)
+    {
+        case 0: v = rot(y, v); break;
+        case 1: bitTest(y, v); return;
+        case 2: v = (uint8_t)(v & ~(1 << y)); break;
+        case 3: v = (uint8_t)(v | (1 << y)); break;
+    }
+    if (z == 6)
+    {
+        wr(cpu->hl, v);
+    }
+    else
+    {
+        setReg(z, v, &cpu->hl);
+    }
+}
+
+static void execIndexCB(void)
+{
+    uint16_t addr = (uint16_t)(*idx + (int8_t)imm8());
+    uint8_t  op = imm8();                       // Read as data: no M1, R not incremented
+    int      x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+    uint8_t  v;
+
+    idle(2);
+    v = rd(addr);
+    idle(1);
+    switch (x)
+    {
+        case 0: v = rot(y, v); break;
+        case 1: bitTest(y, v); return;
+        case 2: v = (uint8_t)(v & ~(1 << y)); break;
+        case 3: v = (uint8_t)(v | (1 << y)); break;
+    }
+    wr(addr, v);
+    if (z != 6)
+    {
+        setReg(z, v, &cpu->hl);                 // Undocumented copy into the register
+    }
+}
+
+// ------------------------------------------------------------------------------
+// ED prefix
+// ------------------------------------------------------------------------------
+static void blockOp(int y, int z)
+{
+    int      dir = (y & 1) ? -1 : 1;            // xxD : xxI
+    int      repeat = (y >= 6);                 // xxxR
+    uint8_t  v, b;
+    unsigned k, res, half, n;
+
+    switch (z)
+    {
+        case 0:                                 // LDI, LDD, LDIR, LDDR
+            v = rd(cpu->hl);
+            wr(cpu->de, v);
+            idle(2);
+            cpu->hl = (uint16_t)(cpu->hl + dir);
+            cpu->de = (uint16_t)(cpu->de + dir);
+            cpu->bc--;
+            n = v + getA();
+            setF((uint8_t)((getF() & (FLAG_S | FLAG_Z | FLAG_C)) | (cpu->bc ? FLAG_PV : 0) |
+                           (n & FLAG_X) | ((n << 4) & FLAG_Y)));
+            repeat = repeat && cpu->bc;
+            break;
+        case 1:                                 // CPI, CPD, CPIR, CPDR
+            v = rd(cpu->hl);
+            idle(5);
+            res = (unsigned)(getA() - v);
+            half = (getA() ^ v ^ res) & FLAG_H;
+            n = res - (half ? 1 : 0);
+            cpu->hl = (uint16_t)(cpu->hl + dir);
+            cpu->bc--;
+            setF((uint8_t)((getF() & FLAG_C) | FLAG_N | (sz53[res & 0xFF] & (FLAG_S | FLAG_Z)) | half |
+                           (cpu->bc ? FLAG_PV : 0) | (n & FLAG_X) | ((n << 4) & FLAG_Y)));
+            repeat = repeat && cpu->bc && (res & 0xFF);
+            break;
+        case 2:                                 // INI, IND, INIR, INDR
+            idle(1);
+            v = ioIn(cpu->bc);
+            wr(cpu->hl, v);
+            b = (uint8_t)((cpu->bc >> 8) - 1);
+            setHi(&cpu->bc, b);
+            cpu->hl = (uint16_t)(cpu->hl + dir);
+            k = v + (uint8_t)(cpu->bc + dir);
+            setF((uint8_t)(sz53[b] | ((v & 0x80) ? FLAG_N : 0) | ((k > 255) ? (FLAG_H | FLAG_C) : 0) |
+                           (sz53p[(k & 7) ^ b] & FLAG_PV)));
+            repeat = repeat && b;
+            break;
+        default:                                // OUTI, OUTD, OTIR, OTDR
+            idle(1);
+            v = rd(cpu->hl);
+            b = (uint8_t)((cpu->bc >> 8) - 1);
+            setHi(&cpu->bc, b);
+            ioOut(cpu->bc, v);
+            cpu->hl = (uint16_t)(cpu->hl + dir);
+            k = v + (uint8_t)cpu->hl;
+            setF((uint8_t)(sz53[b] | ((v & 0x80) ? FLAG_N : 0) | ((k > 255) ? (FLAG_H | FLAG_C) : 0) |
+                           (sz53p[(k & 7) ^ b] & FLAG_PV)));
+            repeat = repeat && b;
+            break;
+    }
+    if (repeat)
+    {
+        idle(5);
+        cpu->pc -= 2;
+    }
+}
+
+static void execED(uint8_t op)
+{
+    static const uint8_t imTable[4] = { 0, 0, 1, 2 };
+    int     x = op >> 6, y = (op >> 3) & 7, z = op & 7, p = y >> 1, q = y & 1;
+    uint8_t v;
+    uint16_t nn;
+
+    if (x == 2)
+    {
+        if ((z <= 3) && (y >= 4))
+        {
+            blockOp(y, z);
+        }
+        return;
+    }
+    if (x != 1)
+    {
+        return;                                 // NONI (8 T)
+    }
+    switch (z)
+    {
+        case 0:                                 // IN r,(C)
+            v = ioIn(cpu->bc);
+            setF((uint8_t)((getF() & FLAG_C) | sz53p[v]));
+            if (y != 6)
+            {
+                setReg(y, v, &cpu->hl);
+            }
+            break;
+        case 1:                                 // OUT (C),r
+            ioOut(cpu->bc, (y == 6) ? 0 : getReg(y, &cpu->hl));
+            break;
+        case 2:                                 // SBC HL,rp / ADC HL,rp
+            idle(7);
+            adcSbc16(!q, *regPair(p));
+            break;
+        case 3:                                 // LD (nn),rp / LD rp,(nn)
+            nn = imm16();
+            if (q)
+            {
+                *regPair(p) = rd16(nn);
+            }
+            else
+            {
+                wr16(nn, *regPair(p));
+            }
+            break;
+        case 4:                                 // NEG
+            v = getA();
+            setA(0);
+            alu(2, v);
+            break;
+        case 5:                                 // RETN, RETI
+            cpu->iff1 = cpu->iff2;
+            cpu->pc = pop();
+            break;
+        case 6:                                 // IM 0/1/2
+            cpu->im = imTable[y & 3];
+            break;
+        default:
+            switch (y)
+            {
+                case 0:                         // LD I,A
+                    idle(1);
+                    cpu->i = getA();
+                    break;
+                case 1:                         // LD R,A
+                    idle(1);
+                    cpu->r = getA();
+                    break;
+                case 2:                         // LD A,I
+                case 3:                         // LD A,R
+                    idle(1);
+                    setA((y == 2) ? cpu->i : cpu->r);
+                    setF((uint8_t)((getF() & FLAG_C) | sz53[getA()] | (cpu->iff2 ? FLAG_PV : 0)));
+                    break;
+                case 4:                         // RRD
+                case 5:                         // RLD
+                    v = rd(cpu->hl);
+                    idle(4);
+                    if (y == 4)
+                    {
+                        wr(cpu->hl, (uint8_t)((getA() << 4) | (v >> 4)));
+                        setA((uint8_t)((getA() & 0xF0) | (v & 0x0F)));
+                    }
+                    else
+                    {
+                        wr(cpu->hl, (uint8_t)((v << 4) | (getA() & 0x0F)));
+                        setA((uint8_t)((getA() & 0xF0) | (v >> 4)));
+                    }
+                    setF((uint8_t)((getF() & FLAG_C) | sz53p[getA()]));
+                    break;
+            }
+            break;
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Unprefixed opcodes (and DD/FD ones, through idx and prefixed)
+// ------------------------------------------------------------------------------
+static void execMain(uint8_t op)
+{
+    int      x = op >> 6, y = (op >> 3) & 7, z = op & 7, p = y >> 1, q = y & 1;
+    uint8_t  v, c;
+    uint16_t nn, addr, tmp;
+    int8_t   d;
+
+    switch (x)
+    {
+        case 0:
+            switch (z)
+            {
+                case 0:
+                    switch (y)
+                    {
+                        case 0:                 // NOP
+                            break;
+                        case 1:                 // EX AF,AF'
+                            tmp = cpu->af; cpu->af = cpu->af_; cpu->af_ = tmp;
+                            break;
+                        case 2:                 // DJNZ d
+                            idle(1);
+                            d = (int8_t)imm8();
+                            setHi(&cpu->bc, (uint8_t)((cpu->bc >> 8) - 1));
+                            if (cpu->bc >> 8)
+                            {
+                                idle(5);
+                                cpu->pc = (uint16_t)(cpu->pc + d);
+                            }
+                            break;
+                        case 3:                 // JR d
+                            d = (int8_t)imm8();
+                            idle(5);
+                            cpu->pc = (uint16_t)(cpu->pc + d);
+                            break;
+                        default:                // JR cc,d
+                            d = (int8_t)imm8();
+                            if (cond(y - 4))
+                            {
+                                idle(5);
+                                cpu->pc = (uint16_t)(cpu->pc + d);
+                            }
+                            break;
+                    }
+                    break;
+                case 1:
+                    if (!q)                     // LD rp,nn
+                    {
+                        *regPair(p) = imm16();
+                    }
+                    else                        // ADD HL,rp
+                    {
+                        idle(7);
+                        add16(idx, *regPair(p));
+                    }
+                    break;
+                case 2:
+                    switch (p)
+                    {
+                        case 0:                 // LD (BC),A / LD A,(BC)
+                        case 1:                 // LD (DE),A / LD A,(DE)
+                            addr = p ? cpu->de : cpu->bc;
+                            if (q)
+                            {
+                                setA(rd(addr));
+                            }
+                            else
+                            {
+                                wr(addr, getA());
+                            }
+                            break;
+                        case 2:                 // LD (nn),HL / LD HL,(nn)
+                            nn = imm16();
+                            if (q)
+                            {
+                                *idx = rd16(nn);
+                            }
+                            else
+                            {
+                                wr16(nn, *idx);
+                            }
+                            break;
+                        default:                // LD (nn),A / LD A,(nn)
+                            nn = imm16();
+                            if (q)
+                            {
+                                setA(rd(nn));
+                            }
+                            else
+                            {
+                                wr(nn, getA());
+                            }
+                            break;
+                    }
+                    break;
+                case 3:                         // INC rp / DEC rp
+                    idle(2);
+                    *regPair(p) = (uint16_t)(*regPair(p) + (q ? -1 : 1));
+                    break;
+                case 4:                         // INC r
+                case 5:                         // DEC r
+                    if (y == 6)
+                    {
+                        addr = memOperand();
+                        v = rd(addr);
+                        idle(1);
+                        wr(addr, (z == 4) ? inc8(v) : dec8(v));
+                    }
+                    else
+                    {
+                        v = getReg(y, idx);
+                        setReg(y, (z == 4) ? inc8(v) : dec8(v), idx);
+                    }
+                    break;
+                case 6:                         // LD r,n
+                    if (y == 6)
+                    {
+                        if (prefixed)
+                        {
+                            d = (int8_t)imm8();
+                            v = imm8();
+                            idle(2);
+                            wr((uint16_t)(*idx + d), v);
+                        }
+                        else
+                        {
+                            v = imm8();
+                            wr(cpu->hl, v);
+                        }
+                    }
+                    else
+                    {
+                        setReg(y, imm8(), idx);
+                    }
+                    break;
+                default:
+                    v = getA();
+                    switch (y)
+                    {
+                        case 0:                 // RLCA
+                            v = (uint8_t)((v << 1) | (v >> 7));
+                            setA(v);
+                            setF((uint8_t)((getF() & (FLAG_S | FLAG_Z | FLAG_PV)) | (v & (FLAG_X | FLAG_Y | FLAG_C))));
+                            break;
+                        case 1:                 // RRCA
+                            c = v & 1;
+                            v = (uint8_t)((v >> 1) | (c << 7));
+                            setA(v);
+                            setF((uint8_t)((getF() & (FLAG_S | FLAG_Z | FLAG_PV)) | (v & (FLAG_X | FLAG_Y)) | c));
+                            break;
+                        case 2:                 // RLA
+                            c = v >> 7;
+                            v = (uint8_t)((v << 1) | (getF() & FLAG_C));
+                            setA(v);
+                            setF((uint8_t)((getF() & (FLAG_S | FLAG_Z | FLAG_PV)) | (v & (FLAG_X | FLAG_Y)) | c));
+                            break;
+                        case 3:                 // RRA
+                            c = v & 1;
+                            v = (uint8_t)((v >> 1) | ((getF() & FLAG_C) << 7));
+                            setA(v);
+                            setF((uint8_t)((getF() & (FLAG_S | FLAG_Z | FLAG_PV)) | (v & (FLAG_X | FLAG_Y)) | c));
+                            break;
+                        case 4:                 // DAA
+                            daa();
+                            break;
+                        case 5:                 // CPL
+                            v = (uint8_t)~v;
+                            setA(v);
+                            setF((uint8_t)((getF() & (FLAG_S | FLAG_Z | FLAG_PV | FLAG_C)) | FLAG_H | FLAG_N |
+                                           (v & (FLAG_X | FLAG_Y))));
+                            break;
+                        case 6:                 // SCF
+                            setF((uint8_t)((getF() & (FLAG_S | FLAG_Z | FLAG_PV)) | FLAG_C | (v & (FLAG_X | FLAG_Y))));
+                            break;
+                        default:                // CCF
+                            setF((uint8_t)((getF() & (FLAG_S | FLAG_Z | FLAG_PV)) | ((getF() & FLAG_C) ? FLAG_H : FLAG_C) |
+                                           (v & (FLAG_X | FLAG_Y))));
+                            break;
+                    }
+                    break;
+            }
+            break;
+
+        case 1:
+            if ((y == 6) && (z == 6))           // HALT
+            {
+                cpu->halted = 1;
+            }
+            else if (y == 6)                    // LD (HL),r: H and L are never IXH/IXL here
+            {
+                addr = memOperand();
+                wr(addr, getReg(z, &cpu->hl));
+            }
+            else if (z == 6)                    // LD r,(HL)
+            {
+                addr = memOperand();
+                setReg(y, rd(addr), &cpu->hl);
+            }
+            else                                // LD r,r'
+            {
+                setReg(y, getReg(z, idx), idx);
+            }
+            break;
+
+        case 2:                                 // ALU A,r
+            if (z == 6)
+            {
+                alu(y, rd(memOperand()));
+            }
+            else
+            {
+                alu(y, getReg(z, idx));
+            }
+            break;
+
+        default:
+            switch (z)
+            {
+                case 0:                         // RET cc
+                    idle(1);
+                    if (cond(y))
+                    {
+                        cpu->pc = pop();
+                    }
+                    break;
+                case 1:
+                    if (!q)                     // POP rp2
+                    {
+                        *regPair2(p) = pop();
+                    }
+                    else
+                    {
+                        switch (p)
+                        {
+                            case 0:             // RET
+                                cpu->pc = pop();
+                                break;
+                            case 1:             // EXX
+                                tmp = cpu->bc; cpu->bc = cpu->bc_; cpu->bc_ = tmp;
+                                tmp = cpu->de; cpu->de = cpu->de_; cpu->de_ = tmp;
+                                tmp = cpu->hl; cpu->hl = cpu->hl_; cpu->hl_ = tmp;
+                                break;
+                            case 2:             // JP (HL)
+                                cpu->pc = *idx;
+                                break;
+                            default:            // LD SP,HL
+                                idle(2);
+                                cpu->sp = *idx;
+                                break;
+                        }
+                    }
+                    break;
+                case 2:                         // JP cc,nn
+                    nn = imm16();
+                    if (cond(y))
+                    {
+                        cpu->pc = nn;
+                    }
+                    break;
+                case 3:
+                    switch (y)
+                    {
+                        case 0:                 // JP nn
+                            cpu->pc = imm16();
+                            break;
+                        case 2:                 // OUT (n),A
+                            v = imm8();
+                            ioOut((uint16_t)((getA() << 8) | v), getA());
+                            break;
+                        case 3:                 // IN A,(n)
+                            v = imm8();
+                            setA(ioIn((uint16_t)((getA() << 8) | v)));
+                            break;
+                        case 4:                 // EX (SP),HL
+                            nn = rd16(cpu->sp);
+                            idle(1);
+                            wr((uint16_t)(cpu->sp + 1), (uint8_t)(*idx >> 8));
+                            wr(cpu->sp, (uint8_t)*idx);
+                            idle(2);
+                            *idx = nn;
+                            break;
+                        case 5:                 // EX DE,HL
+                            tmp = cpu->de; cpu->de = cpu->hl; cpu->hl = tmp;
+                            break;
+                        case 6:                 // DI
+                            cpu->iff1 = cpu->iff2 = 0;
+                            break;
+                        case 7:                 // EI
+                            cpu->iff1 = cpu->iff2 = 1;
+                            cpu->eiDelay = 1;
+                            break;
+                    }
+                    break;
+                case 4:                         // CALL cc,nn
+                    nn = imm16();
+                    if (cond(y))
+                    {
+                        idle(1);
+                        push(cpu->pc);
+                        cpu->pc = nn;
+                    }
+                    break;
+                case 5:
+                    if (!q)                     // PUSH rp2
+                    {
+                        idle(1);
+                        push(*regPair2(p));
+                    }
+                    else                        // CALL nn (p = 0, the prefixes are decoded by z80_step())
+                    {
+                        nn = imm16();
+                        idle(1);
+                        push(cpu->pc);
+                        cpu->pc = nn;
+                    }
+                    break;
+                case 6:                         // ALU A,n
+                    alu(y, imm8());
+                    break;
+                default:                        // RST y * 8
+                    idle(1);
+                    push(cpu->pc);
+                    cpu->pc = (uint16_t)(y * 8);
+                    break;
+            }
+            break;
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Interrupt acknowledge (INT_ active, IFF1 set)
+// ------------------------------------------------------------------------------
+static void interrupt(void)
+{
+    uint8_t data;
+
+    cpu->halted = 0;
+    cpu->iff1 = cpu->iff2 = 0;
+    incR();
+    data = cpu->stall ? 0xFF : cpu->bus->inta(cpu, cpu->t);
+    idle(7);                                    // M1 with two automatic wait states, plus one T
+    push(cpu->pc);
+    switch (cpu->im)
+    {
+        case 2:
+            cpu->pc = rd16((uint16_t)((cpu->i << 8) | data));
+            break;
+        case 1:
+            cpu->pc = 0x0038;
+            break;
+        default:
+            cpu->pc = (uint16_t)(data & 0x38);  // An RST instruction is expected on the data bus
+            break;
+    }
+}
+
+void z80_reset(Z80Cpu *target)
+{
+    const Z80Bus *bus = target->bus;
+
+    *target = Z80Cpu();
+    target->bus = bus;
+    target->af = target->sp = 0xFFFF;
+}
+
+uint16_t z80_step(Z80Cpu *target)
+{
+    uint8_t op;
+
+    if (!tablesReady)
+    {
+        initTables();
+    }
+    cpu = target;
+    cpu->t = 0;
+    if (cpu->intLine && cpu->iff1 && !cpu->eiDelay)
+    {
+        interrupt();
+        return cpu->t;
+    }
+    cpu->eiDelay = 0;
+    if (cpu->halted)
+    {
+        if (!cpu->stall)
+        {
+            cpu->bus->fetch(cpu, cpu->pc, 0);   // The fetched byte is ignored (NOP)
+        }
+        idle(4);
+        incR();
+        return cpu->t;
+    }
+    idx = &cpu->hl;
+    prefixed = 0;
+    op = fetchOp();
+    while ((op == 0xDD) || (op == 0xFD))
+    {
+        idx = (op == 0xDD) ? &cpu->ix : &cpu->iy;
+        prefixed = 1;
+        op = fetchOp();
+    }
+    if (op == 0xED)
+    {
+        idx = &cpu->hl;
+        prefixed = 0;
+        execED(fetchOp());
+    }
+    else if (op == 0xCB)
+    {
+        if (prefixed)
+        {
+            execIndexCB();
+        }
+        else
+        {
+            execCB(fetchOp());
+        }
+    }
+    else
+    {
+        execMain(op);
+    }
+    return cpu->t;
+}
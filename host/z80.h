@@ -0,0 +1,50 @@
+/*
+ * z80.h
+ *
+ * Host build: instruction level Z80 CPU (documented instructions, plus the IXH/IXL/
+ * IYH/IYL forms and SLL), used by z80sim to run the Z80 side of the board.
+ *
+ * Every bus access is made through the Z80Bus functions with "t", the T-state of
+ * the instruction where the machine cycle starts (the opcode fetch of a plain
+ * instruction is at t = 0). A bus function can refuse the access setting "stall"
+ * (e.g. an I/O request still in the wait state): from then the instruction goes on
+ * with no writes, and the caller must restore the CPU state saved before z80_step()
+ * and try the whole instruction again later.
+ */
+
+#ifndef HOST_Z80_H_
+#define HOST_Z80_H_
+
+#include <stdint.h>
+
+struct Z80Cpu;
+
+struct Z80Bus
+{
+    uint8_t (*fetch)(Z80Cpu *cpu, uint16_t addr, uint16_t t);              // M1 opcode fetch (4 T)
+    uint8_t (*read)(Z80Cpu *cpu, uint16_t addr, uint16_t t);               // Memory read (3 T)
+    void    (*write)(Z80Cpu *cpu, uint16_t addr, uint8_t data, uint16_t t); // Memory write (3 T)
+    uint8_t (*in)(Z80Cpu *cpu, uint16_t port, uint16_t t);                 // I/O read (4 T)
+    void    (*out)(Z80Cpu *cpu, uint16_t port, uint8_t data, uint16_t t);  // I/O write (4 T)
+    uint8_t (*inta)(Z80Cpu *cpu, uint16_t t);                              // Interrupt acknowledge (data bus)
+};
+
+struct Z80Cpu
+{
+    uint16_t    af, bc, de, hl;
+    uint16_t    af_, bc_, de_, hl_;                 // Alternate registers
+    uint16_t    ix, iy, sp, pc;
+    uint8_t     i, r;
+    uint8_t     iff1, iff2, im;
+    uint8_t     halted;                             // HALT executed (NOPs until an interrupt or a reset)
+    uint8_t     eiDelay;                            // Interrupts not accepted after EI
+    uint8_t     intLine;                            // INT_ active (set by the caller before z80_step())
+    uint8_t     stall;                              // Set by a bus function to abort the instruction
+    uint16_t    t;                                  // T-states of the current instruction
+    const Z80Bus *bus;
+};
+
+void     z80_reset(Z80Cpu *cpu);                    // RESET_: PC = 0, interrupts disabled, IM 0
+uint16_t z80_step(Z80Cpu *cpu);                     // One instruction (or interrupt), returns its T-states
+
+#endif /* HOST_Z80_H_ */
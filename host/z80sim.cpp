@@ -0,0 +1,265 @@
+/*
+ * z80sim.cpp
+ *
+ * Host build: co-simulation of the whole board. The IOS firmware runs from setup()
+ * on the mock HAL, with the SD card model on an image file, and the Z80 side of the
+ * board (zboard.cpp: Z80 CPU, 128KB banked RAM, WAIT FF) runs with the hand made
+ * clock and with the Timer2 clock along with the firmware time (hal_cycles). The
+ * WAIT_ pin change ISR runs when its interrupt is enabled, then loop() as usual.
+ *
+ *   z80sim [-d DISKSET] [-c CLOCKMODE] [-f] [-k KEYS] [-t MS] [-q] [-o] [-S SDCONFIG] IMAGE
+ *
+ *   -d DISKSET     Disk Set to boot (default 0: CPM22.BIN and the DS0Nxx.DSK files)
+ *   -c CLOCKMODE   Z80 clock, 0 = 8MHz (default), 1 = 4MHz (see startZ80Clock())
+ *   -f             fast boot (BOOTCFG_FAST)
+ *   -k KEYS        console input queued when the Z80 starts ("\r" is a CR)
+ *   -t MS          modeled time the Z80 runs after the boot (default 2000)
+ *   -q             no console output (only the report)
+ *   -o             MCU cycles of the I/O requests by IOS opcode (see zboard_print_ops())
+ *   -S SDCONFIG    SD card type and timing (e.g. "type=sdsc,read=100", see sd_config())
+ *
+ * The boot stops at the time limit too, or when the Z80 halts with the interrupts
+ * disabled. Then the time of the boot and of the run is reported, split into Z80
+ * instructions and IOS handshakes (wait state and BUSREQ_ after each I/O request).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "hal.h"
+#include "sdcard.h"
+#include "zboard.h"
+#include "../Monitor.h"
+
+#define SIM_ISR_CYCLES  20                      // Vector, prologue/epilogue and RETI of the WAIT_ ISR
+#define SIM_LOOP_CYCLES 4                       // Call and return of loop()
+#define SIM_BOOT_MS     20000                   // Boot time limit (e.g. loader not found on SD)
+
+void setup(void);                               // IOS (Z80-MBC2-ATMEL1284.ino)
+void loop(void);
+extern "C" void PCINT1_vect(void);
+
+static uint8_t      pcintPending;
+static uint8_t      inIsr, inRun;
+static uint64_t     timeLimit;
+static HalPortHook  nextHook;
+
+// ------------------------------------------------------------------------------
+// The mock HAL as the AVR side of the board
+// ------------------------------------------------------------------------------
+static uint64_t avrCycles(void)
+{
+    return hal_cycles;
+}
+
+static uint8_t avrOut(uint8_t port, uint8_t bit)
+{
+    return (hal_out[port] >> bit) & 0x01;
+}
+
+static uint8_t avrDataBus(void)
+{
+    return (uint8_t)((hal_out[HAL_PORT_A] & hal_ddr[HAL_PORT_A]) | (~hal_ddr[HAL_PORT_A] & 0xFF));
+}
+
+// WAIT_ going LOW is the pin change the WAIT_ ISR runs for
+static void avrDrive(uint8_t pin, int level)
+{
+    hal_drive(pin, level);
+    if ((pin == WAIT_) && !level && (hal_reg_peek(HAL_PCMSK1) & _BV(PCINT11)))
+    {
+        pcintPending = 1;
+    }
+}
+
+static uint8_t avrClockRunning(void)
+{
+    return (hal_reg_peek(HAL_TCCR2B) & 0x07) && (hal_reg_peek(HAL_TCCR2A) & _BV(COM2A0));
+}
+
+static uint32_t avrClockPeriod(void)
+{
+    return 2UL * (hal_reg_peek(HAL_OCR2A) + 1);
+}
+
+static uint8_t avrInIsr(void)
+{
+    return inIsr;
+}
+
+static const ZBoardAvr halAvr =
+{
+    avrCycles, avrOut, avrDataBus, avrDrive, avrClockRunning, avrClockPeriod, avrInIsr
+};
+
+static void portHook(uint8_t port, uint8_t oldOut, uint8_t newOut)
+{
+    zboard_port(port, oldOut, newOut);
+    if (nextHook)
+    {
+        nextHook(port, oldOut, newOut);
+    }
+}
+
+// The WAIT_ pin change interrupt, when enabled (the ISR runs with the interrupts off)
+static void dispatchIsr(void)
+{
+    while (pcintPending && !inIsr && (hal_reg_peek(HAL_SREG) & _BV(SREG_I)) &&
+           (hal_reg_peek(HAL_PCICR) & _BV(PCIE1)) && (hal_reg_peek(HAL_PCMSK1) & _BV(PCINT11)))
+    {
+        pcintPending = 0;
+        inIsr = 1;
+        hal_reg_poke(HAL_SREG, hal_reg_peek(HAL_SREG) & ~_BV(SREG_I));
+        hal_tick(SIM_ISR_CYCLES);
+        PCINT1_vect();
+        hal_reg_poke(HAL_SREG, hal_reg_peek(HAL_SREG) | _BV(SREG_I));
+        inIsr = 0;
+    }
+}
+
+static void printReport(void);
+
+static void tickHook(void)
+{
+    if (inRun)
+    {
+        return;
+    }
+    inRun = 1;
+    zboard_run();
+    inRun = 0;
+    dispatchIsr();
+    if (timeLimit && (hal_cycles >= timeLimit))
+    {
+        fprintf(stderr, "z80sim: the boot did not end in %d ms\n", SIM_BOOT_MS);
+        printReport();
+        exit(1);
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Report
+// ------------------------------------------------------------------------------
+static ZbPhase      bootPhase;
+static uint8_t      opReport;
+
+static void printReport(void)
+{
+    ZbPhase run = zb_phase;
+
+    if (!bootPhase.cycles)
+    {
+        bootPhase = zb_phase;
+        bootPhase.cycles = hal_cycles;
+        memset(&run, 0, sizeof(run));
+    }
+    else
+    {
+        run.cycles = hal_cycles;
+        zboard_phase_sub(&run, &bootPhase);
+    }
+    zboard_print_phases(&bootPhase, &run);
+    printf("SPI bytes %lu, ", hal_stats.spiBytes);
+    sd_print_stats();
+    if (opReport)
+    {
+        zboard_print_ops();
+    }
+}
+
+static void nullSink(uint8_t c)
+{
+}
+
+// ------------------------------------------------------------------------------
+// Main
+// ------------------------------------------------------------------------------
+static void queueKeys(const char *keys)
+{
+    for (; *keys; keys++)
+    {
+        if ((keys[0] == '\\') && (keys[1] == 'r'))
+        {
+            hal_serial_feed_byte('\r');
+            keys++;
+        }
+        else
+        {
+            hal_serial_feed_byte((uint8_t)*keys);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int         diskSet = 0, clockMode = 0, fast = 0, quiet = 0, opt;
+    long        runMs = 2000;
+    const char  *keys = NULL;
+    uint64_t    runEnd;
+
+    while ((opt = getopt(argc, argv, "d:c:fk:t:qoS:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd': diskSet = atoi(optarg); break;
+            case 'c': clockMode = atoi(optarg) ? 1 : 0; break;
+            case 'f': fast = 1; break;
+            case 'k': keys = optarg; break;
+            case 't': runMs = strtol(optarg, NULL, 0); break;
+            case 'q': quiet = 1; break;
+            case 'o': opReport = 1; break;
+            case 'S': if (sd_config(optarg)) optind = argc; break;
+            default: optind = argc; break;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "usage: z80sim [-d DISKSET] [-c CLOCKMODE] [-f] [-k KEYS] [-t MS] [-q] [-o] [-S SDCONFIG] IMAGE\n");
+        return 2;
+    }
+    if (sd_open(argv[optind]))
+    {
+        fprintf(stderr, "z80sim: cannot open %s\n", argv[optind]);
+        return 1;
+    }
+
+    // The EEPROM as left by the boot menu: boot the OS of the Disk Set
+    EEPROM.write(10, 2);                        // bootModeAddr
+    EEPROM.write(12, 0);                        // autoexecFlagAddr
+    EEPROM.write(13, (uint8_t)clockMode);       // clockModeAddr
+    EEPROM.write(14, (uint8_t)diskSet);         // diskSetAddr
+    EEPROM.write(15, fast ? 0x01 : 0x00);       // bootCfgAddr (BOOTCFG_FAST)
+
+    // The Z80 side of the board at power on
+    zboard_init(&halAvr);
+    nextHook = hal_port_hook;
+    hal_port_hook = portHook;
+    hal_tick_hook = tickHook;
+    if (quiet)
+    {
+        hal_serial_sink = nullSink;
+    }
+
+    timeLimit = hal_cycles + SIM_BOOT_MS * (F_CPU / 1000ULL);
+    setup();
+    timeLimit = 0;
+    bootPhase = zb_phase;
+    bootPhase.cycles = hal_cycles;
+
+    if (keys)
+    {
+        queueKeys(keys);
+    }
+    runEnd = hal_cycles + (uint64_t)runMs * (F_CPU / 1000ULL);
+    while ((hal_cycles < runEnd) && !(zb_cpu.halted && !zb_cpu.iff1))
+    {
+        loop();
+        hal_tick(SIM_LOOP_CYCLES);
+    }
+    printReport();
+    sd_close();
+    return 0;
+}
@@ -0,0 +1,490 @@
+/*
+ * zboard.cpp
+ *
+ * Host build: the Z80 side of the board for the co-simulations (see zboard.h).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "Arduino.h"
+#include "hal.h"
+#include "zboard.h"
+#include "../Monitor.h"
+
+#define ZB_DATA0        24                      // Z80 data bus (PA0..PA7)
+#define ZB_LOG          64                      // Hand made clock pulses kept for an instruction
+
+enum ZbIo
+{
+    ZB_IO_IDLE,
+    ZB_IO_WAIT,                                 // I/O request in the wait state
+    ZB_IO_DONE                                  // WAIT FF reset, the instruction can end
+};
+
+// Hand made clock pulse: what the Z80 finds on the bus
+struct ZbPulse
+{
+    uint8_t         ce2;                        // RAM_CE2 level (LOW = RAM in HiZ)
+    uint8_t         data;                       // Data bus driven by IOS
+    uint8_t         sampled;                    // A read sampled at this pulse...
+    uint8_t         value;                      // ...got this value (same on a retry)
+};
+
+Z80Cpu              zb_cpu;
+ZbPhase             zb_phase;
+ZbOpStats           zb_ops[258];
+uint64_t            zb_pulse_first;
+uint64_t            zb_pulse_last;
+
+static const ZBoardAvr *avr;
+static Z80Bus       bus;
+static uint8_t      ram[4][0x8000];             // Physical banks (bank 1 is the common upper half)
+static uint8_t      lowerBank = 1;              // Physical bank at 0x0000-0x7FFF (see wrSetBank())
+
+static uint8_t      ioState = ZB_IO_IDLE;
+static uint8_t      ioUsed;                     // The current instruction took its I/O result
+static uint8_t      ioLatch;
+static uint8_t      waitFF;
+static uint8_t      resetSkip;                  // Clocks after RESET_ release before the first M1
+static uint8_t      inRun;
+static uint16_t     ioOp = 0xFF;                // Opcode of the I/O request (or ZB_OP_RX, ZB_OP_INTA)
+static uint8_t      storedOp = 0xFF;            // Last STORE OPCODE
+static uint64_t     ioStart;                    // MCU cycle of the I/O request
+
+static ZbPulse      pulseLog[ZB_LOG];
+static uint8_t      pulses;                     // Hand made clock pulses of the current instruction
+static int          pendingRead = -1;           // Memory read the Z80 is doing (hand made clock)
+static uint8_t      pulseWrites;                // RAM writes of the current try
+
+static uint64_t     z80Time;                    // MCU cycles the Z80 has run to (Timer2 clock)
+
+// ------------------------------------------------------------------------------
+// Pins
+// ------------------------------------------------------------------------------
+static void driveData(int data)                 // data < 0 releases the bus
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        avr->drive(ZB_DATA0 + i, (data < 0) ? -1 : ((data >> i) & 0x01));
+    }
+}
+
+static void endBusCycle(void)
+{
+    if (pendingRead >= 0)
+    {
+        driveData(-1);
+        avr->drive(MREQ_, 1);
+        avr->drive(RD_, 1);
+        pendingRead = -1;
+    }
+    if (ioUsed)
+    {
+        driveData(-1);
+        avr->drive(RD_, 1);
+        avr->drive(WR_, 1);
+        ioState = ZB_IO_IDLE;
+        ioUsed = 0;
+    }
+}
+
+// RESET_ active: the Z80 is reset and leaves the bus (the WAIT FF is not touched)
+static void resetZ80(void)
+{
+    z80_reset(&zb_cpu);
+    resetSkip = 2;
+    pulses = 0;
+    ioUsed = (ioState != ZB_IO_IDLE);
+    endBusCycle();
+}
+
+// ------------------------------------------------------------------------------
+// Z80 bus
+// ------------------------------------------------------------------------------
+static inline uint8_t *ramByte(uint16_t addr)
+{
+    return (addr & 0x8000) ? &ram[1][addr & 0x7FFF] : &ram[lowerBank][addr];
+}
+
+// Memory read. With the hand made clock the byte is taken at T3 (pulse t + 3): from
+//  IOS if RAM_CE2 was LOW, otherwise from RAM (driven on the data bus meanwhile)
+static uint8_t memRead(Z80Cpu *z, uint16_t addr, uint16_t t)
+{
+    ZbPulse *p;
+
+    if (avr->clockRunning())
+    {
+        return *ramByte(addr);
+    }
+    if (t + 3 >= ZB_LOG)
+    {
+        return 0xFF;
+    }
+    if (pulses < t + 3)
+    {
+        z->stall = 1;
+        if (avr->out(HAL_PORT_B, 2) && (pendingRead < 0))
+        {
+            pendingRead = addr;
+            driveData(*ramByte(addr));
+            avr->drive(MREQ_, 0);
+            avr->drive(RD_, 0);
+        }
+        return 0xFF;
+    }
+    p = &pulseLog[t + 3];
+    if (!p->sampled)
+    {
+        p->value = p->ce2 ? *ramByte(addr) : p->data;
+        p->sampled = 1;
+    }
+    return p->value;
+}
+
+static void memWrite(Z80Cpu *z, uint16_t addr, uint8_t data, uint16_t t)
+{
+    if (avr->clockRunning())
+    {
+        *ramByte(addr) = data;
+        return;
+    }
+    if ((t + 3 >= ZB_LOG) || (pulses < t + 3))
+    {
+        z->stall = 1;
+        return;
+    }
+    if (pulseLog[t + 3].ce2)
+    {
+        *ramByte(addr) = data;                  // Lost if the RAM was in HiZ
+        pulseWrites++;
+    }
+}
+
+// I/O request (dir: 1 = IN, 0 = OUT, -1 = interrupt acknowledge)
+static uint8_t ioRequest(Z80Cpu *z, uint16_t port, int dir, uint8_t data)
+{
+    if (ioState == ZB_IO_DONE)
+    {
+        ioUsed = 1;
+        return ioLatch;
+    }
+    if (ioState == ZB_IO_IDLE)
+    {
+        avr->drive(AD0, port & 0x01);
+        if (dir > 0)
+        {
+            avr->drive(RD_, 0);
+            zb_phase.ioReads++;
+            ioOp = (port & 0x01) ? ZB_OP_RX : storedOp;
+            zb_ops[ioOp].requests++;
+        }
+        else if (!dir)
+        {
+            driveData(data);
+            avr->drive(WR_, 0);
+            zb_phase.ioWrites++;
+            if (port & 0x01)
+            {
+                storedOp = data;
+                zb_ops[data].stores++;
+            }
+            else
+            {
+                zb_ops[storedOp].requests++;
+            }
+            ioOp = storedOp;
+        }
+        else
+        {
+            zb_phase.intAck++;
+            ioOp = ZB_OP_INTA;
+            zb_ops[ioOp].requests++;
+        }
+        ioStart = avr->cycles();
+        if (!avr->out(HAL_PORT_B, 0))
+        {
+            // WAIT_RES_ LOW keeps the WAIT FF reset: no wait state
+            ioLatch = avr->dataBus();
+            ioUsed = 1;
+            ioState = ZB_IO_DONE;
+            zb_phase.loopServed++;
+            return ioLatch;
+        }
+        waitFF = 1;
+        avr->drive(WAIT_, 0);
+        ioState = ZB_IO_WAIT;
+    }
+    z->stall = 1;
+    return 0xFF;
+}
+
+static uint8_t busIn(Z80Cpu *z, uint16_t port, uint16_t t)
+{
+    return ioRequest(z, port, 1, 0);
+}
+
+static void busOut(Z80Cpu *z, uint16_t port, uint8_t data, uint16_t t)
+{
+    ioRequest(z, port, 0, data);
+}
+
+static uint8_t busInta(Z80Cpu *z, uint16_t t)
+{
+    return ioRequest(z, 0, -1, 0);
+}
+
+// WAIT_RES_ falling edge: the WAIT FF is reset, the data bus is latched for an I/O read
+static void waitReset(void)
+{
+    if (!waitFF)
+    {
+        return;
+    }
+    waitFF = 0;
+    ioLatch = avr->dataBus();
+    avr->drive(WAIT_, 1);
+    if (ioState == ZB_IO_WAIT)
+    {
+        ioState = ZB_IO_DONE;
+        zb_ops[ioOp].cycles += avr->cycles() - ioStart;
+        if (avr->inIsr())
+        {
+            zb_phase.isrServed++;
+        }
+        else
+        {
+            zb_phase.loopServed++;
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Hand made clock: one T-state for each CLK rising edge
+// ------------------------------------------------------------------------------
+static void clockPulse(void)
+{
+    Z80Cpu   saved;
+    uint16_t t;
+
+    if (!avr->out(HAL_PORT_C, 6))               // RESET_ active
+    {
+        resetZ80();
+        return;
+    }
+    if (resetSkip)
+    {
+        resetSkip--;
+        return;
+    }
+    zb_pulse_last = avr->cycles();
+    if (!zb_pulse_first)
+    {
+        zb_pulse_first = zb_pulse_last;
+    }
+    if (pulses < ZB_LOG - 1)
+    {
+        pulses++;
+    }
+    pulseLog[pulses].ce2 = avr->out(HAL_PORT_B, 2);
+    pulseLog[pulses].data = avr->dataBus();
+    pulseLog[pulses].sampled = 0;
+
+    // Try the whole instruction again with one more T-state
+    saved = zb_cpu;
+    zb_cpu.intLine = 0;
+    pulseWrites = 0;
+    t = z80_step(&zb_cpu);
+    if (zb_cpu.stall || (t > pulses))
+    {
+        zb_cpu = saved;
+        return;
+    }
+    endBusCycle();
+    zb_phase.pulsed++;
+    zb_phase.injected += pulseWrites;
+    zb_phase.code += t;
+    pulses = 0;
+}
+
+void zboard_port(uint8_t port, uint8_t oldOut, uint8_t newOut)
+{
+    if ((port == HAL_PORT_B) && (oldOut & 0x01) && !(newOut & 0x01))
+    {
+        waitReset();
+    }
+    if (port == HAL_PORT_D)
+    {
+        lowerBank = (uint8_t)(((((newOut >> 3) & 0x01) << 1) | ((newOut >> 4) & 0x01)) ^ 0x01);
+        if (!(oldOut & 0x80) && (newOut & 0x80) && !avr->clockRunning())
+        {
+            clockPulse();
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Timer2 clock: the Z80 runs up to the MCU cycles
+// ------------------------------------------------------------------------------
+void zboard_run(void)
+{
+    uint64_t now = avr->cycles();
+    uint32_t period;
+    uint64_t avail;
+    uint64_t *stalled;
+    Z80Cpu   saved;
+    uint16_t t;
+
+    if (!avr->clockRunning())
+    {
+        z80Time = now;
+        return;
+    }
+    if (inRun)
+    {
+        return;
+    }
+    inRun = 1;
+    period = avr->clockPeriod();
+    while (z80Time + period <= now)
+    {
+        avail = (now - z80Time) / period;
+        stalled = NULL;
+        if (!avr->out(HAL_PORT_C, 6))
+        {
+            resetZ80();
+            stalled = &zb_phase.reset;
+        }
+        else if (ioState == ZB_IO_WAIT)
+        {
+            stalled = &zb_phase.wait;
+        }
+        else if (!avr->out(HAL_PORT_D, 6))
+        {
+            stalled = &zb_phase.busReq;
+        }
+        if (stalled)
+        {
+            *stalled += avail;
+            z80Time += avail * period;
+            break;
+        }
+        if (resetSkip)
+        {
+            resetSkip--;
+            zb_phase.reset++;
+            z80Time += period;
+            continue;
+        }
+        saved = zb_cpu;
+        zb_cpu.intLine = !avr->out(HAL_PORT_B, 1);
+        t = z80_step(&zb_cpu);
+        if (zb_cpu.stall)
+        {
+            zb_cpu = saved;                     // Waiting for IOS, tried again when released
+            continue;
+        }
+        endBusCycle();
+        if (saved.halted && zb_cpu.halted)
+        {
+            zb_phase.halt += t;
+        }
+        else
+        {
+            zb_phase.code += t;
+            zb_phase.instr++;
+        }
+        z80Time += (uint64_t)t * period;
+    }
+    inRun = 0;
+}
+
+void zboard_init(const ZBoardAvr *avrModel)
+{
+    avr = avrModel;
+    bus.fetch = memRead;
+    bus.read = memRead;
+    bus.write = memWrite;
+    bus.in = busIn;
+    bus.out = busOut;
+    bus.inta = busInta;
+    zb_cpu.bus = &bus;
+    z80_reset(&zb_cpu);
+    avr->drive(WAIT_, 1);
+    avr->drive(MREQ_, 1);
+    avr->drive(RD_, 1);
+    avr->drive(WR_, 1);
+    avr->drive(AD0, 0);
+}
+
+// ------------------------------------------------------------------------------
+// Report
+// ------------------------------------------------------------------------------
+void zboard_phase_sub(ZbPhase *p, const ZbPhase *from)
+{
+    p->code -= from->code;
+    p->halt -= from->halt;
+    p->wait -= from->wait;
+    p->busReq -= from->busReq;
+    p->reset -= from->reset;
+    p->instr -= from->instr;
+    p->pulsed -= from->pulsed;
+    p->injected -= from->injected;
+    p->ioReads -= from->ioReads;
+    p->ioWrites -= from->ioWrites;
+    p->intAck -= from->intAck;
+    p->isrServed -= from->isrServed;
+    p->loopServed -= from->loopServed;
+    p->cycles -= from->cycles;
+}
+
+static void printPhase(const char *name, const ZbPhase *p)
+{
+    uint64_t total = p->code + p->halt + p->wait + p->busReq + p->reset;
+    unsigned long ios = p->ioReads + p->ioWrites + p->intAck;
+    double   pct = total ? 100.0 / total : 0.0;
+
+    printf("%-5s %9.2f %11llu %6.1f%% %6.1f%% %6.1f%% %6.1f%% %6.1f%% %8lu %8lu %8lu %7.1f %9lu %7lu\n",
+           name, (double)p->cycles / (F_CPU / 1000.0), (unsigned long long)total,
+           p->code * pct, p->wait * pct, p->busReq * pct, p->halt * pct, p->reset * pct,
+           ios, p->isrServed, p->loopServed, ios ? (double)(p->wait + p->busReq) / ios : 0.0,
+           p->instr, p->pulsed);
+}
+
+void zboard_print_phases(const ZbPhase *boot, const ZbPhase *run)
+{
+    printf("\n\nZ80 clock %.1f MHz, Z80 T-states by activity (wait and BUSREQ_ are the IOS handshakes):\n",
+           F_CPU / 1000000.0 / avr->clockPeriod());
+    printf("phase        ms     T-states   code    wait  busreq    halt   reset   I/O req      ISR     loop  T/req"
+           "     instr  pulsed\n");
+    printPhase("boot", boot);
+    printPhase("run", run);
+}
+
+// MCU cycles of the I/O requests by opcode, and of the hand made clock injection
+void zboard_print_ops(void)
+{
+    const ZbOpStats *s;
+
+    printf("opcode   stores  requests  cycles/req  cycles/store\n");
+    for (int op = 0; op <= ZB_OP_INTA; op++)
+    {
+        s = &zb_ops[op];
+        if (!s->stores && !s->requests)
+        {
+            continue;
+        }
+        if (op >= ZB_OP_RX)
+        {
+            printf((op == ZB_OP_RX) ? "rx     " : "inta   ");
+        }
+        else
+        {
+            printf("0x%02X   ", op);
+        }
+        printf("%8lu  %8lu  %10.1f  %12.1f\n", s->stores, s->requests,
+               (s->stores + s->requests) ? (double)s->cycles / (s->stores + s->requests) : 0.0,
+               s->stores ? (double)s->cycles / s->stores : 0.0);
+    }
+    printf("injected %lu bytes with the hand made clock, %.1f cycles/byte\n", zb_phase.injected,
+           zb_phase.injected ? (double)(zb_pulse_last - zb_pulse_first) / zb_phase.injected : 0.0);
+}
@@ -0,0 +1,78 @@
+/*
+ * zboard.h
+ *
+ * Host build: the Z80 side of the board for the co-simulation (z80sim on the mock
+ * HAL): the Z80 CPU (z80.cpp), the 128KB banked RAM, the WAIT FF and the bus signals
+ * IOS sees. The AVR side is reached only through ZBoardAvr.
+ *
+ * *  with the hand made clock (pulseClock() on CLK) every pulse is one T-state, and
+ *    the opcodes and data IOS forces on the data bus with RAM_CE2 LOW are taken at
+ *    the T-state where the Z80 samples them (loadHL(), writeByteToRAM(), jumpToHL());
+ * *  with the Timer2 clock the Z80 runs along with the MCU cycles at F_CPU /
+ *    (2 * (OCR2A + 1)). An IN/OUT sets the WAIT FF (WAIT_ LOW) and the Z80 stays in
+ *    the wait state until IOS pulses WAIT_RES_ LOW (an I/O read takes the byte on the
+ *    data bus at that time), then until BUSREQ_ is HIGH again.
+ */
+
+#ifndef HOST_ZBOARD_H_
+#define HOST_ZBOARD_H_
+
+#include <stdint.h>
+#include "z80.h"
+
+// The AVR model the Z80 is wired to (ports are HAL_PORT_x, pins the Arduino numbers)
+struct ZBoardAvr
+{
+    uint64_t (*cycles)(void);                   // MCU cycles from the reset
+    uint8_t  (*out)(uint8_t port, uint8_t bit); // Level of an AVR output
+    uint8_t  (*dataBus)(void);                  // PA as the Z80 reads it (released bits read 1)
+    void     (*drive)(uint8_t pin, int level);  // Drive (level >= 0) or release an AVR input
+    uint8_t  (*clockRunning)(void);             // Timer2 clock on CLK (OC2A toggle)
+    uint32_t (*clockPeriod)(void);              // MCU cycles of a T-state with the Timer2 clock
+    uint8_t  (*inIsr)(void);                    // IOS is in the WAIT_ ISR
+};
+
+// Time of the Z80 (in T-states) by what it was doing
+struct ZbPhase
+{
+    uint64_t        code;                       // Executing instructions
+    uint64_t        halt;                       // Halted (NOPs)
+    uint64_t        wait;                       // Wait state of an I/O request
+    uint64_t        busReq;                     // Held by BUSREQ_ after an I/O request
+    uint64_t        reset;                      // RESET_ active
+    unsigned long   instr;                      // Instructions with the Timer2 clock
+    unsigned long   pulsed;                     // Instructions with the hand made clock
+    unsigned long   injected;                   // RAM writes with the hand made clock
+    unsigned long   ioReads;
+    unsigned long   ioWrites;
+    unsigned long   intAck;                     // Interrupt acknowledge cycles
+    unsigned long   isrServed;                  // WAIT FF reset inside the WAIT_ ISR
+    unsigned long   loopServed;                 // WAIT FF reset elsewhere (loop(), boot)
+    uint64_t        cycles;                     // MCU cycles of the phase
+};
+
+// I/O requests by IOS opcode (the last one stored with an OUT to port 1)
+struct ZbOpStats
+{
+    unsigned long   stores;                     // STORE OPCODE with this opcode
+    unsigned long   requests;                   // EXECUTE WRITE/READ OPCODE requests
+    uint64_t        cycles;                     // MCU cycles from WAIT_ LOW to the WAIT FF reset (all of them)
+};
+
+#define ZB_OP_RX        256                     // IN from port 1 (serial Rx)
+#define ZB_OP_INTA      257                     // Interrupt acknowledge
+
+extern Z80Cpu       zb_cpu;
+extern ZbPhase      zb_phase;
+extern ZbOpStats    zb_ops[258];
+extern uint64_t     zb_pulse_first;             // MCU cycle of the first and the last hand made clock pulse
+extern uint64_t     zb_pulse_last;
+
+void zboard_init(const ZBoardAvr *avr);         // Power on (the RAM is not cleared)
+void zboard_port(uint8_t port, uint8_t oldOut, uint8_t newOut);     // After an AVR output change
+void zboard_run(void);                          // Timer2 clock: run the Z80 up to the MCU cycles
+void zboard_phase_sub(ZbPhase *p, const ZbPhase *from);
+void zboard_print_phases(const ZbPhase *boot, const ZbPhase *run);
+void zboard_print_ops(void);
+
+#endif /* HOST_ZBOARD_H_ */
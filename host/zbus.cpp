@@ -0,0 +1,155 @@
+/*
+ * zbus.cpp
+ *
+ * Host build: the Z80 side of the IOS I/O handshake (see zbus.h).
+ */
+
+#include <string.h>
+#include "Arduino.h"
+#include "hal.h"
+#include "sdcard.h"
+#include "zbus.h"
+#include "../PetitFS.h"
+#include "../DefinitionsFile.h"
+#include "../Monitor.h"
+#include "../SDCardFunctions.h"
+
+#define ZB_DATA0        24                      // Z80 data bus (PA0..PA7)
+
+#define ZB_MAX_LOOPS    1000                    // loop() calls before giving up a request
+
+void loop(void);                                // IOS (Z80-MBC2-ATMEL1284.ino)
+void startIoIntZ80(void);
+extern "C" void PCINT1_vect(void);
+
+ZbusStats       zbus_stats;
+
+static uint8_t  readLatch;                      // Data bus when the WAIT FF was reset
+static HalPortHook nextHook;
+
+static void waitFF(uint8_t port, uint8_t oldOut, uint8_t newOut)
+{
+    if ((port == HAL_PORT_B) && (oldOut & 0x01) && !(newOut & 0x01))
+    {
+        readLatch = (uint8_t)((hal_out[HAL_PORT_A] & hal_ddr[HAL_PORT_A]) | (~hal_ddr[HAL_PORT_A] & 0xFF));
+        hal_drive(WAIT_, 1);
+    }
+    if (nextHook)
+    {
+        nextHook(port, oldOut, newOut);
+    }
+}
+
+void zbus_init(void)
+{
+    memset(&zbus_stats, 0, sizeof(zbus_stats));
+    if (hal_port_hook != waitFF)
+    {
+        nextHook = hal_port_hook;
+        hal_port_hook = waitFF;
+    }
+    hal_drive(WAIT_, 1);
+    hal_drive(WR_, 1);
+    hal_drive(RD_, 1);
+}
+
+// One I/O cycle, served like on the board: first the ISR, then loop() if needed
+static int ioCycle(void)
+{
+    int n;
+
+    hal_drive(WAIT_, 0);
+    if ((PCICR & _BV(PCIE1)) && (PCMSK1 & _BV(PCINT11)))
+    {
+        PCINT1_vect();
+    }
+    if (hal_pin_level(WAIT_))
+    {
+        zbus_stats.isrServed++;
+    }
+    else
+    {
+        zbus_stats.loopServed++;
+        for (n = 0; (n < ZB_MAX_LOOPS) && !hal_pin_level(WAIT_); n++)
+        {
+            loop();
+        }
+    }
+    hal_drive(WR_, 1);
+    hal_drive(RD_, 1);
+    return hal_pin_level(WAIT_) ? 0 : -1;
+}
+
+int zbus_out(uint8_t port, uint8_t data)
+{
+    int i, res;
+
+    zbus_stats.ioWrites++;
+    hal_drive(AD0, port & 0x01);
+    for (i = 0; i < 8; i++)
+    {
+        hal_drive(ZB_DATA0 + i, (data >> i) & 0x01);
+    }
+    hal_drive(WR_, 0);
+    res = ioCycle();
+    for (i = 0; i < 8; i++)
+    {
+        hal_drive(ZB_DATA0 + i, -1);
+    }
+    return res;
+}
+
+int zbus_in(uint8_t port)
+{
+    zbus_stats.ioReads++;
+    hal_drive(AD0, port & 0x01);
+    hal_drive(RD_, 0);
+    readLatch = 0xFF;
+    if (ioCycle())
+    {
+        return -1;
+    }
+    return readLatch;
+}
+
+// ------------------------------------------------------------------------------
+// What setup() leaves when the Z80 runs (see setup())
+// ------------------------------------------------------------------------------
+int zbus_start_ios(uint8_t set)
+{
+    byte err;
+
+    pinMode(RESET_, OUTPUT);
+    digitalWrite(RESET_, LOW);
+    pinMode(WAIT_RES_, OUTPUT);
+    digitalWrite(WAIT_RES_, HIGH);
+    pinMode(USER, OUTPUT);
+    digitalWrite(USER, HIGH);
+    pinMode(INT_, OUTPUT);
+    digitalWrite(INT_, HIGH);
+    pinMode(RAM_CE2, OUTPUT);
+    digitalWrite(RAM_CE2, HIGH);
+    pinMode(WAIT_, INPUT);
+    pinMode(BUSREQ_, OUTPUT);
+    digitalWrite(BUSREQ_, HIGH);
+    DDRA = 0x00;
+    PORTA = 0xFF;
+    pinMode(MREQ_, INPUT_PULLUP);
+    pinMode(RD_, INPUT_PULLUP);
+    pinMode(WR_, INPUT_PULLUP);
+    pinMode(AD0, INPUT_PULLUP);
+    zbus_init();
+
+    diskSet = set;
+    err = mountSD(&filesysSD);
+    if (err)
+    {
+        err = mountSD(&filesysSD);
+    }
+    sd_set_layout(filesysSD.fatbase, (filesysSD.fs_type == FS_FAT32) ? filesysSD.database : filesysSD.dirbase,
+                  filesysSD.database);
+    startZ80Clock(0);
+    digitalWrite(RESET_, HIGH);
+    startIoIntZ80();
+    return err;
+}
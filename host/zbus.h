@@ -0,0 +1,30 @@
+/*
+ * zbus.h
+ *
+ * Host build: the Z80 side of the IOS I/O handshake. A Z80 IN/OUT on port 0/1
+ * drives AD0, RD_/WR_ and the data bus, sets the WAIT FF (WAIT_ LOW), and lets the
+ * firmware serve it exactly as on the board: through the WAIT_ pin change ISR and,
+ * if the ISR leaves it, through loop(). The WAIT FF is reset when IOS pulses
+ * WAIT_RES_ LOW; an I/O read takes the byte IOS has on the data bus at that time.
+ */
+
+#ifndef HOST_ZBUS_H_
+#define HOST_ZBUS_H_
+
+#include <stdint.h>
+
+struct ZbusStats
+{
+    unsigned long ioWrites;                     // Z80 OUT cycles
+    unsigned long ioReads;                      // Z80 IN cycles
+    unsigned long isrServed;                    // Served inside ISR(PCINT1_vect)
+    unsigned long loopServed;                   // Left by the ISR to loop()
+};
+extern ZbusStats zbus_stats;
+
+void zbus_init(void);                           // Hooks the WAIT FF on PORTB, WAIT_ HIGH
+int  zbus_start_ios(uint8_t diskSet);           // IOS as setup() leaves it when the Z80 runs (0 = SD mounted)
+int  zbus_out(uint8_t port, uint8_t data);      // Z80 OUT (port), 0 = ok, -1 = still in wait state
+int  zbus_in(uint8_t port);                     // Z80 IN (port), data or -1 = still in wait state
+
+#endif /* HOST_ZBUS_H_ */
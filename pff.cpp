@@ -28,6 +28,7 @@
 
 #include "pff.h"        /* Petit FatFs configurations and declarations */
 #include "diskio.h"     /* Declarations of low level disk I/O functions */
+#include "SdStats.h"    /* SD layer statistics (SDSTATS opcode) */
 
 
 
@@ -55,6 +56,10 @@
 #define _FS_32ONLY 0
 #endif
 
+#if _USE_MKFILE && (_FS_FAT12 || !_USE_WRITE)
+#error _USE_MKFILE needs _USE_WRITE and does not support FAT12.
+#endif
+
 #define ABORT(err)  {fs->flag = 0; return err;}
 
 
@@ -312,6 +317,20 @@
 
 
 
+#if _USE_MKFILE || _USE_CONTIG
+/* Sector window used to modify the FAT and the directory (read-modify-write).
+/  It lives on the stack only while pf_create(), pf_extend(), pf_truncate() or
+/  pf_contig() runs (none of them calls another). */
+
+typedef struct {
+    DWORD   sect;       /* Sector# loaded in buf (0:None) */
+    BYTE    dirty;      /* buf has been modified */
+    BYTE    buf[512];   /* Sector data */
+} WIN;
+#endif
+
+
+
 /*--------------------------------------------------------------------------
 
    Private Functions
@@ -330,6 +349,16 @@ static void mem_set (void* dst, int val, int cnt)
     while (cnt--) *d++ = (char)val;
 }
 
+/* Copy memory to memory */
+#if _USE_MKFILE
+static void mem_cpy (void* dst, const void* src, int cnt) 
+{
+    char *d = (char*)dst;
+    const char *s = (const char *)src;
+    while (cnt--) *d++ = *s++;
+}
+#endif
+
 /* Compare memory to memory */
 static int mem_cmp (const void* dst, const void* src, int cnt) 
 {
@@ -352,6 +381,7 @@ static CLUST get_fat( CLUST clst )
     BYTE buf[4];
     FATFS *fs = FatFs;
 
+    SDSTATS_INC(getFat);
     if (clst < 2 || clst >= fs->n_fatent)   /* Range check */
     {
         return 1;
@@ -411,6 +441,268 @@ static CLUST get_fat( CLUST clst )
 }
 
 
+#if _USE_MKFILE || _USE_CONTIG
+/*-----------------------------------------------------------------------*/
+/* Sector window - Write back the window if it was modified              */
+/*  WIN *win    Pointer to the sector window                             */
+/*-----------------------------------------------------------------------*/
+static FRESULT win_flush( WIN *win )
+{
+    FATFS *fs = FatFs;
+    DWORD sect = win->sect;
+    BYTE n = 1;
+
+    if (win->dirty) 
+    {
+        if (sect >= fs->fatbase && sect < fs->fatbase + fs->fsize_fat)
+        {
+            n = fs->n_fats;             /* A FAT sector is mirrored on every FAT copy */
+        }
+        while (n--) 
+        {
+            if (disk_writep(0, sect) || disk_writep(win->buf, 512) || disk_writep(0, 0))
+            {
+                return FR_DISK_ERR;
+            }
+            sect += fs->fsize_fat;
+        }
+        win->dirty = 0;
+    }
+    return FR_OK;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Sector window - Load a sector in the window                           */
+/*  WIN *win    Pointer to the sector window                             */
+/*  DWORD sect  Sector# to load                                          */
+/*-----------------------------------------------------------------------*/
+static FRESULT win_move( WIN *win, DWORD sect )
+{
+    if (sect != win->sect) 
+    {
+        if (win_flush(win))
+        {
+            return FR_DISK_ERR;
+        }
+        win->sect = 0;
+        if (disk_readp(win->buf, sect, 0, 512))
+        {
+            return FR_DISK_ERR;
+        }
+        win->sect = sect;
+    }
+    return FR_OK;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT access - Read value of a FAT entry through the sector window      */
+/*      1:IO error,                                                      */
+/*   Else:Cluster status                                                 */
+/*  WIN *win    Pointer to the sector window                             */
+/*  CLUST clst  Cluster# to get the link information                     */
+/*-----------------------------------------------------------------------*/
+static CLUST win_get_fat( WIN *win, CLUST clst )
+{
+    FATFS *fs = FatFs;
+
+    if (clst < 2 || clst >= fs->n_fatent)   /* Range check */
+    {
+        return 1;
+    }
+    if (_FS_FAT32 && fs->fs_type == FS_FAT32) 
+    {
+        if (win_move(win, fs->fatbase + clst / 128))
+        {
+            return 1;
+        }
+        return LD_DWORD(win->buf + ((UINT)clst % 128) * 4) & 0x0FFFFFFF;
+    }
+    if (win_move(win, fs->fatbase + clst / 256))
+    {
+        return 1;
+    }
+    return LD_WORD(win->buf + ((UINT)clst % 256) * 2);
+}
+#endif /* _USE_MKFILE || _USE_CONTIG */
+
+
+#if _USE_MKFILE
+
+/*-----------------------------------------------------------------------*/
+/* FAT access - Change value of a FAT entry through the sector window    */
+/*  WIN *win    Pointer to the sector window                             */
+/*  CLUST clst  Cluster# to be changed                                   */
+/*  CLUST val   New value (0x0FFFFFFF: end of chain)                     */
+/*-----------------------------------------------------------------------*/
+static FRESULT win_put_fat( WIN *win, CLUST clst, CLUST val )
+{
+    FATFS *fs = FatFs;
+    BYTE *p;
+
+    if (clst < 2 || clst >= fs->n_fatent)   /* Range check */
+    {
+        return FR_DISK_ERR;
+    }
+    if (_FS_FAT32 && fs->fs_type == FS_FAT32) 
+    {
+        if (win_move(win, fs->fatbase + clst / 128))
+        {
+            return FR_DISK_ERR;
+        }
+        p = win->buf + ((UINT)clst % 128) * 4;
+        val = (val & 0x0FFFFFFF) | (LD_DWORD(p) & 0xF0000000);  /* Keep the reserved bits */
+        ST_DWORD(p, val);
+    }
+    else
+    {
+        if (win_move(win, fs->fatbase + clst / 256))
+        {
+            return FR_DISK_ERR;
+        }
+        p = win->buf + ((UINT)clst % 256) * 2;
+        ST_WORD(p, (WORD)val);
+    }
+    win->dirty = 1;
+    return FR_OK;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT access - Find a free cluster                                      */
+/*  WIN *win    Pointer to the sector window                             */
+/*  CLUST *clst In: cluster# to start after, Out: free cluster#          */
+/*              (the search wraps around the end of the FAT)             */
+/*-----------------------------------------------------------------------*/
+static FRESULT find_free( WIN *win, CLUST *clst )
+{
+    FATFS *fs = FatFs;
+    CLUST ncl = *clst, scan, val;
+
+    for (scan = fs->n_fatent - 2; scan; scan--) 
+    {
+        ncl++;
+        if (ncl < 2 || ncl >= fs->n_fatent)
+        {
+            ncl = 2;
+        }
+        val = win_get_fat(win, ncl);
+        if (val == 1)
+        {
+            return FR_DISK_ERR;
+        }
+        if (val == 0) 
+        {
+            *clst = ncl;
+            return FR_OK;
+        }
+    }
+    return FR_DENIED;   /* Disk full */
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT access - Check that there are enough free clusters                */
+/*  WIN *win    Pointer to the sector window                             */
+/*  CLUST *clst In: cluster# to start after, Out: first free cluster#    */
+/*              (the search wraps around the end of the FAT)             */
+/*  CLUST want  Number of free clusters needed                           */
+/*              (the scan stops as soon as they are found)               */
+/*-----------------------------------------------------------------------*/
+static FRESULT check_free( WIN *win, CLUST *clst, CLUST want )
+{
+    FATFS *fs = FatFs;
+    CLUST ncl = *clst, scan, val, first = 0;
+
+    for (scan = fs->n_fatent - 2; want && scan; scan--) 
+    {
+        ncl++;
+        if (ncl < 2 || ncl >= fs->n_fatent)
+        {
+            ncl = 2;
+        }
+        val = win_get_fat(win, ncl);
+        if (val == 1)
+        {
+            return FR_DISK_ERR;
+        }
+        if (val == 0) 
+        {
+            if (!first)
+            {
+                first = ncl;
+            }
+            want--;
+        }
+    }
+    *clst = first;
+    return want ? FR_DENIED : FR_OK;    /* Disk full */
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Directory access - Write the start cluster, size and time of the open */
+/*  file in its directory entry                                          */
+/*  WIN *win    Pointer to the sector window                             */
+/*-----------------------------------------------------------------------*/
+static FRESULT dir_sync( WIN *win )
+{
+    FATFS *fs = FatFs;
+    BYTE *ent;
+
+    if (win_move(win, fs->dir_sect)) 
+    {
+        return FR_DISK_ERR;
+    }
+    ent = win->buf + fs->dir_index * 32;
+    ST_WORD(ent+DIR_FstClusLO, (WORD)fs->org_clust);
+    if (_FS_FAT32 && fs->fs_type == FS_FAT32) 
+    {
+        ST_WORD(ent+DIR_FstClusHI, (WORD)((DWORD)fs->org_clust >> 16));
+    }
+    ST_DWORD(ent+DIR_FileSize, fs->fsize);
+    ST_DWORD(ent+DIR_WrtTime, get_fattime());
+    win->dirty = 1;
+    if (win_flush(win)) 
+    {
+        return FR_DISK_ERR;
+    }
+    fs->flag &= ~FA__DIRTY;
+    return FR_OK;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT access - Find the last cluster of the open file (once per open)   */
+/*  WIN *win    Pointer to the sector window                             */
+/*-----------------------------------------------------------------------*/
+static FRESULT find_tail( WIN *win )
+{
+    FATFS *fs = FatFs;
+    CLUST clst = fs->org_clust;
+
+    if (fs->tail_clust || !clst)
+    {
+        return FR_OK;                   /* Already known, or an empty file */
+    }
+    fs->n_clust = 0;
+    while (clst < fs->n_fatent) 
+    {
+        fs->tail_clust = clst;
+        fs->n_clust++;
+        clst = win_get_fat(win, clst);
+        if (clst < 2)                   /* I/O error or a broken chain */
+        {
+            fs->tail_clust = 0;
+            return FR_DISK_ERR;
+        }
+    }
+    return FR_OK;
+}
+#endif /* _USE_MKFILE */
+
+
 /*-----------------------------------------------------------------------*/
 /* Get sector# from cluster# / Get cluster field from directory entry    */
 /*      !=0: Sector number,                                              */
@@ -855,7 +1147,7 @@ static BYTE check_fs( BYTE *buf, DWORD sect )
 /*-----------------------------------------------------------------------*/
 FRESULT pf_mount( FATFS *fs )
 {
-    BYTE fmt, buf[36];
+    BYTE fmt, buf[58];                  /* BPB_SecPerClus..BS_VolID32 */
     DWORD bsect, fsize, tsect, mclst;
 
     FatFs = 0;
@@ -907,6 +1199,11 @@ FRESULT pf_mount( FATFS *fs )
         fsize = LD_DWORD(buf+BPB_FATSz32-13);
     }
 
+#if _USE_MKFILE
+    fs->fsize_fat = fsize;
+    fs->n_fats = buf[BPB_NumFATs-13];
+    fs->last_clust = 1;                                 /* Start the free cluster search from the top */
+#endif
     fsize *= buf[BPB_NumFATs-13];                       /* Number of sectors in FAT area */
     fs->fatbase = bsect + LD_WORD(buf+BPB_RsvdSecCnt-13); /* FAT start sector (lba) */
     fs->csize = buf[BPB_SecPerClus-13];                 /* Number of sectors per cluster */
@@ -944,10 +1241,12 @@ FRESULT pf_mount( FATFS *fs )
     if (_FS_32ONLY || (_FS_FAT32 && fmt == FS_FAT32))
     {
         fs->dirbase = LD_DWORD(buf+(BPB_RootClus-13));  /* Root directory start cluster */
+        fs->vol_id = LD_DWORD(buf+(BS_VolID32-13));     /* Volume serial number */
     }
     else
     {
         fs->dirbase = fs->fatbase + fsize;              /* Root directory start sector (lba) */
+        fs->vol_id = LD_DWORD(buf+(BS_VolID-13));
     }
     fs->database = fs->fatbase + fsize + fs->n_rootdir / 16;    /* Data start sector (lba) */
 
@@ -990,12 +1289,377 @@ FRESULT pf_open( const char *path )
     fs->org_clust = get_clust(dir);     /* File start cluster */
     fs->fsize = LD_DWORD(dir+DIR_FileSize); /* File size */
     fs->fptr = 0;                       /* File pointer */
+#if _USE_MKFILE
+    fs->dir_sect = dj.sect;             /* Directory entry location (to update the file size) */
+    fs->dir_index = (BYTE)(dj.index % 16);
+    fs->tail_clust = 0;                 /* The chain is followed by the first pf_extend() */
+    fs->n_clust = 0;
+#endif
     fs->flag = FA_OPENED;
 
     return FR_OK;
 }
 
 
+/*-----------------------------------------------------------------------*/
+/* Open a File, creating it (empty) if it does not exist                 */
+/*  const char *path    Pointer to the file name                         */
+/*                                                                       */
+/*  NOTE: the directory is not stretched, so FR_DENIED is returned when  */
+/*        it has no free entry left                                      */
+/*-----------------------------------------------------------------------*/
+#if _USE_MKFILE
+FRESULT pf_create( const char *path )
+{
+    FRESULT res;
+    DIR dj;
+    BYTE sp[12], dir[32], *ent;
+    DWORD tm;
+    WIN win;
+    FATFS *fs = FatFs;
+
+    if (!fs) 
+    {
+        return FR_NOT_ENABLED;      /* Check file system */
+    }
+
+    fs->flag = 0;
+    dj.fn = sp;
+    res = follow_path(&dj, dir, path);  /* Follow the file path */
+    if (res == FR_OK)
+    {
+        return pf_open(path);       /* Already there, just open it */
+    }
+    if (res != FR_NO_FILE || !sp[11])
+    {
+        return res;                 /* Hard error or a directory in the path is missing */
+    }
+
+    /* Look for an unused or deleted entry in the directory */
+    res = dir_rewind(&dj);
+    while (res == FR_OK) 
+    {
+        if (disk_readp(dir, dj.sect, (dj.index % 16) * 32, 1))
+        {
+            return FR_DISK_ERR;
+        }
+        if (dir[DIR_Name] == 0 || dir[DIR_Name] == 0xE5)
+        {
+            break;
+        }
+        res = dir_next(&dj);
+    }
+    if (res == FR_NO_FILE)
+    {
+        return FR_DENIED;           /* Directory full */
+    }
+    if (res != FR_OK)
+    {
+        return res;
+    }
+
+    /* Write the new directory entry (no cluster, size 0) */
+    win.sect = 0;
+    win.dirty = 0;
+    if (win_move(&win, dj.sect))
+    {
+        return FR_DISK_ERR;
+    }
+    ent = win.buf + (dj.index % 16) * 32;
+    mem_set(ent, 0, 32);
+    mem_cpy(ent, sp, 11);
+    ent[DIR_Attr] = AM_ARC;
+    tm = get_fattime();
+    ST_DWORD(ent+DIR_CrtTime, tm);
+    ST_DWORD(ent+DIR_WrtTime, tm);
+    win.dirty = 1;
+    if (win_flush(&win))
+    {
+        return FR_DISK_ERR;
+    }
+
+    fs->org_clust = 0;
+    fs->fsize = 0;
+    fs->fptr = 0;
+    fs->dir_sect = dj.sect;
+    fs->dir_index = (BYTE)(dj.index % 16);
+    fs->tail_clust = 0;
+    fs->n_clust = 0;
+    fs->flag = FA_OPENED;
+
+    return FR_OK;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Extend the open File                                                  */
+/*  DWORD size  New file size in bytes (never shrinks the file)          */
+/*                                                                       */
+/*  New clusters are searched right after the last one of the file, so   */
+/*  a file extended in one go is contiguous when the disk allows it. The */
+/*  new data area is not cleared and the FAT32 FSInfo free count is not  */
+/*  updated (it is only a hint). The free clusters are counted before    */
+/*  any is taken, so on a full disk (FR_DENIED) nothing is written.      */
+/*  The last cluster of the file is kept, so the chain is followed only  */
+/*  once after pf_open(). A size within the clusters already allocated   */
+/*  is only set in memory: the directory entry is written when a cluster */
+/*  is added or by pf_sync().                                            */
+/*-----------------------------------------------------------------------*/
+FRESULT pf_extend( DWORD size )
+{
+    FRESULT res;
+    CLUST clst, last, ncl, need;
+    DWORD bcs;
+    WIN win;
+    FATFS *fs = FatFs;
+
+    if (!fs) 
+    {
+        return FR_NOT_ENABLED;      /* Check file system */
+    }
+    if (!(fs->flag & FA_OPENED))        /* Check if opened */
+    {
+        return FR_NOT_OPENED;
+    }
+    if (fs->flag & FA__WIP)             /* A sector write must be finalized first */
+    {
+        return FR_DENIED;
+    }
+    if (size <= fs->fsize)
+    {
+        return FR_OK;
+    }
+
+    win.sect = 0;
+    win.dirty = 0;
+    bcs = (DWORD)fs->csize * 512;       /* Cluster size (byte) */
+    need = (CLUST)((size + bcs - 1) / bcs);
+    if (find_tail(&win))
+    {
+        ABORT(FR_DISK_ERR);
+    }
+    if (need <= fs->n_clust) 
+    {
+        fs->fsize = size;               /* No new cluster: the directory entry is written later */
+        fs->flag |= FA__DIRTY;
+        return FR_OK;
+    }
+
+    /* Check the free space first, so nothing is written when the disk is full */
+    clst = fs->tail_clust ? fs->tail_clust : fs->last_clust;
+    res = check_free(&win, &clst, need - fs->n_clust);
+    if (res == FR_DENIED)
+    {
+        return FR_DENIED;               /* Disk full: the file and the FAT are left untouched */
+    }
+    if (res != FR_OK)
+    {
+        ABORT(FR_DISK_ERR);
+    }
+
+    /* Allocate and link the missing clusters, the first one is the free one just found */
+    last = fs->tail_clust;
+    for (ncl = fs->n_clust; ncl < need; ncl++) 
+    {
+        if ((ncl != fs->n_clust && find_free(&win, &clst)) || win_put_fat(&win, clst, 0x0FFFFFFF))
+        {
+            ABORT(FR_DISK_ERR);         /* The free clusters were counted: I/O error */
+        }
+        if (last) 
+        {
+            if (win_put_fat(&win, last, clst))
+            {
+                ABORT(FR_DISK_ERR);
+            }
+        }
+        else 
+        {
+            fs->org_clust = clst;
+        }
+        last = clst;
+    }
+    fs->last_clust = last;
+    fs->tail_clust = last;
+    fs->n_clust = need;
+
+    /* Update start cluster, size and time in the directory entry */
+    fs->fsize = size;
+    fs->flag &= ~FA_CONTIG;             /* New clusters may not follow the old ones */
+    if (dir_sync(&win)) 
+    {
+        ABORT(FR_DISK_ERR);
+    }
+
+    return FR_OK;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Truncate the open File                                                */
+/*  DWORD size  New file size in bytes (never grows the file)            */
+/*                                                                       */
+/*  The clusters past the new end are freed and the directory entry is   */
+/*  written if anything changed (a size left pending by pf_extend() too).*/
+/*  The file pointer is rewound if it was past the new end.              */
+/*-----------------------------------------------------------------------*/
+FRESULT pf_truncate( DWORD size )
+{
+    CLUST clst, next, ncl, keep;
+    DWORD bcs;
+    WIN win;
+    FATFS *fs = FatFs;
+
+    if (!fs) 
+    {
+        return FR_NOT_ENABLED;      /* Check file system */
+    }
+    if (!(fs->flag & FA_OPENED))        /* Check if opened */
+    {
+        return FR_NOT_OPENED;
+    }
+    if (size >= fs->fsize && !(fs->flag & FA__DIRTY))
+    {
+        return FR_OK;                   /* Nothing to change */
+    }
+    if (fs->flag & FA__WIP)             /* A sector write must be finalized first */
+    {
+        return FR_DENIED;
+    }
+
+    win.sect = 0;
+    win.dirty = 0;
+    if (size < fs->fsize) 
+    {
+        bcs = (DWORD)fs->csize * 512;   /* Cluster size (byte) */
+        keep = (CLUST)((size + bcs - 1) / bcs);
+        if (find_tail(&win))
+        {
+            ABORT(FR_DISK_ERR);
+        }
+        if (keep < fs->n_clust) 
+        {
+            /* Find the new last cluster, end the chain there and free the rest */
+            clst = fs->org_clust;
+            for (ncl = 1; ncl < keep; ncl++)
+            {
+                clst = win_get_fat(&win, clst);
+                if (clst < 2 || clst >= fs->n_fatent)
+                {
+                    ABORT(FR_DISK_ERR);
+                }
+            }
+            if (keep) 
+            {
+                next = win_get_fat(&win, clst);
+                if (win_put_fat(&win, clst, 0x0FFFFFFF))
+                {
+                    ABORT(FR_DISK_ERR);
+                }
+                fs->tail_clust = clst;
+            }
+            else 
+            {
+                next = clst;
+                fs->org_clust = 0;
+                fs->tail_clust = 0;
+            }
+            fs->n_clust = keep;
+            while (next >= 2 && next < fs->n_fatent) 
+            {
+                clst = next;
+                next = win_get_fat(&win, clst);
+                if (next == 1 || win_put_fat(&win, clst, 0))
+                {
+                    ABORT(FR_DISK_ERR);
+                }
+            }
+        }
+        fs->fsize = size;
+        if (fs->fptr > size)
+        {
+            fs->fptr = 0;
+        }
+    }
+    if (dir_sync(&win)) 
+    {
+        ABORT(FR_DISK_ERR);
+    }
+
+    return FR_OK;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/* Write the size of the open File left pending by pf_extend()           */
+/*-----------------------------------------------------------------------*/
+FRESULT pf_sync( void )
+{
+    FATFS *fs = FatFs;
+
+    if (!fs) 
+    {
+        return FR_NOT_ENABLED;      /* Check file system */
+    }
+    return pf_truncate(fs->fsize);
+}
+#endif /* _USE_MKFILE */
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Check that the clusters of the open file are consecutive              */
+/*                                                                       */
+/*  On success FA_CONTIG is set, so pf_read(), pf_write() and pf_lseek() */
+/*  compute the cluster# instead of following the FAT chain. FR_DENIED   */
+/*  is returned (and the FAT is still used) for a fragmented file.       */
+/*-----------------------------------------------------------------------*/
+#if _USE_CONTIG
+FRESULT pf_contig( void )
+{
+    WIN win;
+    CLUST clst, last, val;
+    FATFS *fs = FatFs;
+
+    if (!fs) 
+    {
+        return FR_NOT_ENABLED;      /* Check file system */
+    }
+    if (!(fs->flag & FA_OPENED))        /* Check if opened */
+    {
+        return FR_NOT_OPENED;
+    }
+    fs->flag &= ~FA_CONTIG;
+    if (!fs->fsize || fs->org_clust < 2)
+    {
+        return FR_DENIED;
+    }
+    last = fs->org_clust + (CLUST)((fs->fsize - 1) / ((DWORD)fs->csize * 512));
+    if (last < fs->org_clust || last >= fs->n_fatent)
+    {
+        return FR_DENIED;
+    }
+
+    win.sect = 0;
+    win.dirty = 0;
+    for (clst = fs->org_clust; clst < last; clst++) 
+    {                                   /* Each cluster must link to the next one */
+        val = win_get_fat(&win, clst);
+        if (val == 1)
+        {
+            return FR_DISK_ERR;
+        }
+        if (val != clst + 1)
+        {
+            return FR_DENIED;
+        }
+    }
+    fs->flag |= FA_CONTIG;
+
+    return FR_OK;
+}
+#endif
+
+
 /*-----------------------------------------------------------------------*/
 /* Read File                                                             */
 /*  void* buff  Pointer to the read buffer                               */
@@ -1033,6 +1697,10 @@ FRESULT pf_read( void* buff, UINT btr, UINT* br )
                 {
                     clst = fs->org_clust;
                 }
+                else if (_USE_CONTIG && (fs->flag & FA_CONTIG))
+                {
+                    clst = fs->curr_clust + 1;      /* Contiguous file: next cluster follows */
+                }
                 else
                 {
                     clst = get_fat(fs->curr_clust);
@@ -1134,6 +1802,10 @@ FRESULT pf_write( const void* buff, UINT btw, UINT* bw )
                 {
                     clst = fs->org_clust;
                 }
+                else if (_USE_CONTIG && (fs->flag & FA_CONTIG))
+                {
+                    clst = fs->curr_clust + 1;      /* Contiguous file: next cluster follows */
+                }
                 else
                 {
                     clst = get_fat(fs->curr_clust);
@@ -1212,7 +1884,14 @@ FRESULT pf_lseek( DWORD ofs )
     if (ofs > 0) 
     {
         bcs = (DWORD)fs->csize * 512;   /* Cluster size (byte) */
-        if ((ifptr > 0 && ofs - 1) / bcs >= (ifptr - 1) / bcs) 
+        if (_USE_CONTIG && (fs->flag & FA_CONTIG))
+        {                           /* Contiguous file: compute the cluster directly */
+            fs->fptr = ofs;
+            clst = fs->org_clust + (CLUST)((ofs - 1) / bcs);
+            fs->curr_clust = clst;
+            ofs = 0;
+        }
+        else if (ifptr > 0 && (ofs - 1) / bcs >= (ifptr - 1) / bcs) 
         {   /* When seek to same or following cluster, */
             fs->fptr = (ifptr - 1) & ~(bcs - 1);    /* start from the current cluster */
             ofs -= fs->fptr;
@@ -1225,6 +1904,7 @@ FRESULT pf_lseek( DWORD ofs )
         }
         while (ofs > bcs) 
         {               /* Cluster following loop */
+            SDSTATS_INC(lseekHops);
             clst = get_fat(clst);       /* Follow cluster chain */
             if (clst <= 1 || clst >= fs->n_fatent) ABORT(FR_DISK_ERR);
             fs->curr_clust = clst;
@@ -1273,6 +1953,7 @@ FRESULT pf_opendir( DIR *dj, const char *path )
             if (res == FR_OK)
                 res = dir_rewind(dj);           /* Rewind dir */
         }
+        dj->fn = 0;                             /* sp is gone on return */
     }
 
     return res;
@@ -1319,6 +2000,7 @@ FRESULT pf_readdir( DIR *dj, FILINFO *fno )
                 }
             }
         }
+        dj->fn = 0;                     /* sp is gone on return */
     }
 
     return res;
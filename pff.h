@@ -41,17 +41,26 @@ typedef struct {
     BYTE    fs_type;    /* FAT sub type */
     BYTE    flag;       /* File status flags */
     BYTE    csize;      /* Number of sectors per cluster */
-    BYTE    pad1;
+    BYTE    n_fats;     /* Number of FAT copies */
     WORD    n_rootdir;  /* Number of root directory entries (0 on FAT32) */
     CLUST   n_fatent;   /* Number of FAT entries (= number of clusters + 2) */
     DWORD   fatbase;    /* FAT start sector */
+    DWORD   fsize_fat;  /* Number of sectors per FAT */
     DWORD   dirbase;    /* Root directory start sector (Cluster# on FAT32) */
     DWORD   database;   /* Data start sector */
+    DWORD   vol_id;     /* Volume serial number (set when formatted) */
     DWORD   fptr;       /* File R/W pointer */
     DWORD   fsize;      /* File size */
     CLUST   org_clust;  /* File start cluster */
     CLUST   curr_clust; /* File current cluster */
     DWORD   dsect;      /* File current data sector */
+#if _USE_MKFILE
+    CLUST   last_clust; /* Last allocated cluster (free cluster search hint) */
+    CLUST   tail_clust; /* Last cluster of the open file (0: empty file or chain not followed yet) */
+    CLUST   n_clust;    /* Clusters of the open file (valid with tail_clust) */
+    DWORD   dir_sect;   /* Sector holding the directory entry of the file */
+    BYTE    dir_index;  /* Directory entry index in the sector [0..15] */
+#endif
 } FATFS;
 
 
@@ -89,7 +98,8 @@ typedef enum {
     FR_NO_FILE,         /* 3 */
     FR_NOT_OPENED,      /* 4 */
     FR_NOT_ENABLED,     /* 5 */
-    FR_NO_FILESYSTEM    /* 6 */
+    FR_NO_FILESYSTEM,   /* 6 */
+    FR_DENIED           /* 7 */
 } FRESULT;
 
 
@@ -104,6 +114,15 @@ FRESULT pf_write (const void* buff, UINT btw, UINT* bw);    /* Write data to the
 FRESULT pf_lseek (DWORD ofs);                               /* Move file pointer of the open file */
 FRESULT pf_opendir (DIR* dj, const char* path);             /* Open a directory */
 FRESULT pf_readdir (DIR* dj, FILINFO* fno);                 /* Read a directory item from the open directory */
+FRESULT pf_create (const char* path);                       /* Open a file, creating it if it does not exist */
+FRESULT pf_extend (DWORD size);                             /* Grow the open file to the given size */
+FRESULT pf_truncate (DWORD size);                           /* Shrink the open file to the given size */
+FRESULT pf_sync (void);                                     /* Write the pending size of the open file */
+FRESULT pf_contig (void);                                   /* Check the open file for a contiguous cluster chain */
+
+#if _USE_MKFILE
+DWORD get_fattime (void);                                   /* Timestamp for new/changed files (supplied by the user) */
+#endif
 
 
 
@@ -114,7 +133,9 @@ FRESULT pf_readdir (DIR* dj, FILINFO* fno);                 /* Read a directory
 
 #define FA_OPENED   0x01
 #define FA_WPRT     0x02
+#define FA_CONTIG   0x20    /* File clusters are consecutive (set by pf_contig) */
 #define FA__WIP     0x40
+#define FA__DIRTY   0x80    /* Size not written in the directory entry yet (see pf_sync) */
 
 
 /* FAT sub type (FATFS.fs_type) */
@@ -10,9 +10,11 @@
 /---------------------------------------------------------------------------*/
 
 #define _USE_READ   1   /* Enable pf_read() function */
-#define _USE_DIR    0   /* Enable pf_opendir() and pf_readdir() function */
+#define _USE_DIR    1   /* Enable pf_opendir() and pf_readdir() function */
 #define _USE_LSEEK  1   /* Enable pf_lseek() function */
 #define _USE_WRITE  1   /* Enable pf_write() function */
+#define _USE_MKFILE 1   /* Enable pf_create(), pf_extend(), pf_truncate() and pf_sync() (needs _USE_WRITE) */
+#define _USE_CONTIG 1   /* Enable pf_contig() function (no FAT walk on contiguous files) */
 
 #define _FS_FAT12   0   /* Enable FAT12 */
 #define _FS_FAT16   1   /* Enable FAT16 */
@@ -0,0 +1,321 @@
+/*
+ * bin2lz.cpp
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * Host (Linux) tool embedding Z80 boot programs (.BIN files) into the IOS flash.
+ * Each file is LZ packed (or stored as it is if packing does not make it smaller)
+ * and written as a PROGMEM array into FlashImages.h, with a table (flashImageTable)
+ * used by findFlashImage(). At boot a program found in the table is unpacked on the
+ * fly into the Z80 RAM, so the SD is not needed.
+ * All the files are checked and packed first, and FlashImages.h is written through
+ * a temporary file, so an error never leaves a truncated one.
+ *
+ * Usage: bin2lz [-o FlashImages.h] [FILE.BIN...]
+ *        (no files writes an empty table)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------------------------
+// Definitions (must match the firmware, see BootLoader.h)
+// ------------------------------------------------------------------------------
+#define LZ_WINDOW       512             // History size
+#define LZ_MINMATCH     3               // Shortest match
+#define LZ_MAXMATCH     (LZ_MINMATCH + 127) // Longest match (7 bits length)
+#define MAX_IMAGE       65536           // Z80 address space
+#define MAX_FLASHDATA   57344UL         // pgm_read_byte() reaches only the first 64KB of flash,
+                                        //  and the IOS code needs some room there too
+
+typedef std::vector<uint8_t> Bytes;
+
+struct Image
+{
+    std::string name;                   // SD file name replaced by the image
+    size_t      size;                   // Unpacked size
+    Bytes       data;                   // Packed bytes, or the file itself if not packed
+    int         packed;                 // 1 if LZ packed
+};
+
+// ------------------------------------------------------------------------------
+// Helpers
+// ------------------------------------------------------------------------------
+static void fatal(const char *format, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "bin2lz: ");
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static Bytes readHostFile(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    Bytes data;
+    uint8_t buf[65536];
+    size_t  n;
+
+    if (!f)
+    {
+        fatal("cannot open %s", path);
+    }
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return data;
+}
+
+// The SD file name (8.3, upper case) replaced by the image
+static std::string imageName(const char *path)
+{
+    const char  *base = strrchr(path, '/');
+    std::string name;
+
+    for (base = base ? base + 1 : path; *base; base++)
+    {
+        name += (char)toupper((unsigned char)*base);
+    }
+    size_t dot = name.find('.');
+    if (name.empty() || (name.size() > 12) || ((dot == std::string::npos) ? (name.size() > 8)
+        : ((dot < 1) || (dot > 8) || (name.size() - dot - 1 > 3))))
+    {
+        fatal("%s: not an 8.3 file name", path);
+    }
+    return name;
+}
+
+// ------------------------------------------------------------------------------
+// LZ packing (format in BootLoader.h). Greedy longest match, brute force search
+// ------------------------------------------------------------------------------
+static Bytes packLz(const Bytes &src)
+{
+    Bytes    out;
+    size_t   pos = 0, flagPos = 0;
+    int      items = 8;
+
+    while (pos < src.size())
+    {
+        size_t bestLen = 0, bestDist = 0;
+        size_t dist, len;
+
+        for (dist = 1; (dist <= LZ_WINDOW) && (dist <= pos); dist++)
+        {
+            for (len = 0; (len < LZ_MAXMATCH) && (pos + len < src.size())
+                && (src[pos + len] == src[pos + len - dist]); len++);
+            if (len > bestLen)
+            {
+                bestLen = len;
+                bestDist = dist;
+            }
+        }
+        if (items == 8)
+        {
+            flagPos = out.size();
+            out.push_back(0);
+            items = 0;
+        }
+        if (bestLen >= LZ_MINMATCH)
+        {
+            out.push_back((uint8_t)(bestDist - 1));
+            out.push_back((uint8_t)((((bestDist - 1) >> 8) & 0x01) | ((bestLen - LZ_MINMATCH) << 1)));
+            pos += bestLen;
+        }
+        else
+        {
+            out[flagPos] |= 1 << items;
+            out.push_back(src[pos++]);
+        }
+        items++;
+    }
+    return out;
+}
+
+// Same as nextLz() in BootLoader.cpp, used to check the packed image
+static Bytes unpackLz(const Bytes &packed, size_t size)
+{
+    Bytes    out;
+    uint8_t  window[LZ_WINDOW];
+    size_t   src = 0;
+    unsigned flags = 0, flagCnt = 0, dist = 0, len = 0;
+
+    while (out.size() < size)
+    {
+        uint8_t value;
+
+        if (!len)
+        {
+            if (!flagCnt)
+            {
+                flags = packed.at(src++);
+                flagCnt = 8;
+            }
+            flagCnt--;
+            if (!(flags & 0x01))
+            {
+                dist = packed.at(src) + 1 + ((packed.at(src + 1) & 0x01) << 8);
+                len = (packed.at(src + 1) >> 1) + LZ_MINMATCH;
+                src += 2;
+            }
+            flags >>= 1;
+        }
+        if (len)
+        {
+            value = window[(out.size() - dist) & (LZ_WINDOW - 1)];
+            len--;
+        }
+        else
+        {
+            value = packed.at(src++);
+        }
+        window[out.size() & (LZ_WINDOW - 1)] = value;
+        out.push_back(value);
+    }
+    return out;
+}
+
+static void usage(void)
+{
+    printf(
+        "usage: bin2lz [-o OUTPUT] [FILE.BIN...]\n"
+        "  pack the Z80 boot programs into OUTPUT (default FlashImages.h) for the IOS\n"
+        "  firmware. At boot a program found there replaces the same named file on SD.\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    const char  *outPath = "FlashImages.h";
+    std::string tmpPath;
+    std::vector<Image> images;
+    unsigned long total = 0;
+    FILE        *f;
+    int         i, first = 1;
+    size_t      j;
+
+    if ((argc >= 2) && !strcmp(argv[1], "-o"))
+    {
+        if (argc < 3)
+        {
+            usage();
+        }
+        outPath = argv[2];
+        first = 3;
+    }
+    for (i = first; i < argc; i++)
+    {
+        if (argv[i][0] == '-')
+        {
+            usage();
+        }
+    }
+
+    // Check and pack all the files before writing anything
+    for (i = first; i < argc; i++)
+    {
+        Bytes  data = readHostFile(argv[i]);
+        Image  image;
+
+        image.name = imageName(argv[i]);
+        for (j = 0; j < images.size(); j++)
+        {
+            if (images[j].name == image.name)
+            {
+                fatal("%s: given twice", image.name.c_str());
+            }
+        }
+        if (data.empty() || (data.size() >= MAX_IMAGE))
+        {
+            fatal("%s: size must be in [1..%d]", argv[i], MAX_IMAGE - 1);
+        }
+        image.size = data.size();
+        image.data = packLz(data);
+        image.packed = 1;
+        if (unpackLz(image.data, data.size()) != data)
+        {
+            fatal("%s: packing check failed", argv[i]);
+        }
+        if (image.data.size() >= data.size())
+        {
+            image.data = data;                  // Does not compress: stored as it is
+            image.packed = 0;
+        }
+        total += image.data.size();
+        printf("%-12s %6zu -> %6zu bytes%s\n", image.name.c_str(), image.size, image.data.size(),
+            image.packed ? "" : " (stored)");
+        images.push_back(image);
+    }
+    if (total > MAX_FLASHDATA)
+    {
+        fatal("packed images too large (%lu bytes, %lu max)", total, MAX_FLASHDATA);
+    }
+
+    // Write a temporary file, then replace the output with it
+    tmpPath = std::string(outPath) + ".tmp";
+    f = fopen(tmpPath.c_str(), "w");
+    if (!f)
+    {
+        fatal("cannot create %s", tmpPath.c_str());
+    }
+    fprintf(f,
+        "/*\n"
+        " * FlashImages.h\n"
+        " *\n"
+        " * Generated by tools/bin2lz - do not edit (see \"make -C tools flashimages\").\n"
+        " * Boot programs embedded in the flash, LZ packed or stored as they are (see\n"
+        " * BootLoader.h). Included only by BootLoader.cpp.\n"
+        " */\n"
+        "\n"
+        "\n"
+        "#ifndef FLASHIMAGES_H_\n"
+        "#define FLASHIMAGES_H_\n"
+        "\n"
+        "#define FLASH_IMAGES    %zu\n", images.size());
+    for (i = 0; i < (int)images.size(); i++)
+    {
+        const Image &image = images[i];
+
+        fprintf(f, "\nconst byte  flashImage%d[] PROGMEM = {     // %s: %zu -> %zu bytes%s", i,
+            image.name.c_str(), image.size, image.data.size(), image.packed ? "" : " (stored)");
+        for (j = 0; j < image.data.size(); j++)
+        {
+            fprintf(f, "%s0x%02X%s", (j % 16) ? " " : "\n    ", image.data[j],
+                (j + 1 < image.data.size()) ? "," : " };\n");
+        }
+    }
+    if (!images.empty())
+    {
+        fprintf(f, "\nconst FlashImage flashImageTable[FLASH_IMAGES] PROGMEM = {\n");
+        for (j = 0; j < images.size(); j++)
+        {
+            fprintf(f, "    { \"%s\", %zu, flashImage%zu, %d }%s\n", images[j].name.c_str(), images[j].size, j,
+                images[j].packed, (j + 1 < images.size()) ? "," : "");
+        }
+        fprintf(f, "};\n");
+    }
+    fprintf(f, "\n\n#endif /* FLASHIMAGES_H_ */\n");
+    if (ferror(f) | fclose(f))
+    {
+        remove(tmpPath.c_str());
+        fatal("cannot write %s", tmpPath.c_str());
+    }
+    if (rename(tmpPath.c_str(), outPath))
+    {
+        remove(tmpPath.c_str());
+        fatal("cannot replace %s", outPath);
+    }
+    return 0;
+}
@@ -0,0 +1,1242 @@
+/*
+ * mbc2img.cpp
+ *
+ * Created: 18/10/2026
+ *  Author: SupremeSpod
+ *
+ * Host (Linux) tool preparing FAT16/FAT32 volumes for the IOS firmware. It works
+ * on an image file (or directly on a card device, e.g. /dev/sdX) and never
+ * fragments a file: every file is written to a single run of free clusters.
+ *
+ * After each change the disk map (DSKMAP.DAT) is rewritten. It records the start
+ * cluster and the size of every contiguous "disk file" DSsNnn.DSK, so at SELDISK
+ * time IOS can use the "no FAT walk" fast path (see contigDiskSD() and pf_contig()).
+ *
+ * Usage: see usage() below.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------------------------
+// Definitions (must match the firmware, see DefinitionsFile.h and SDCardFunctions.h)
+// ------------------------------------------------------------------------------
+#define SECT_SIZE       512
+#define DISK_SIZE       8388608UL       // "Disk file" size: 512 tracks * 32 sectors * 512 bytes
+#define DISK_FILL       0xE5            // CP/M empty directory/data byte
+#define MAX_DISKSET     10              // Disk Sets [0..9]
+#define MAX_DISKNUM     100             // Disks per Disk Set [0..99]
+#define DSMAP_NAME      "DSKMAP.DAT"
+#define DSMAP_VERSION   1
+#define DSMAP_RECSIZE   16
+#define DSMAP_SIZE      (SECT_SIZE + (MAX_DISKSET * MAX_DISKNUM * DSMAP_RECSIZE))
+#define SNAP_NAME       "HIBERN.SNP"    // Hibernation snapshot (see Hibernate.h)
+#define SNAP_SIZE       (SECT_SIZE + (4 * 32768UL))
+#define IOLOG_NAME      "IOLOG.DAT"     // I/O sessions log (see IoLog.h)
+#define IOLOG_KB        1024            // Default I/O log size (KB)
+
+#define FAT16_MINCLST   4085            // Less clusters than this is FAT12 (not supported by IOS)
+#define FAT32_MINCLST   65525           // From this number of clusters the volume is FAT32
+#define FAT32_MAXCLST   0x0FFFFFF5
+
+typedef std::vector<uint8_t> Bytes;
+
+// ------------------------------------------------------------------------------
+// Helpers
+// ------------------------------------------------------------------------------
+static void fatal(const char *format, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "mbc2img: ");
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static uint16_t ld16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ld32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void st16(uint8_t *p, uint16_t val)
+{
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+}
+
+static void st32(uint8_t *p, uint32_t val)
+{
+    st16(p, (uint16_t)val);
+    st16(p + 2, (uint16_t)(val >> 16));
+}
+
+// Current local time in FAT format (date in the high word)
+static uint32_t fatTime(void)
+{
+    time_t     now = time(NULL);
+    struct tm *tm = localtime(&now);
+
+    return ((uint32_t)(tm->tm_year - 80) << 25) | ((uint32_t)(tm->tm_mon + 1) << 21)
+         | ((uint32_t)tm->tm_mday << 16) | ((uint32_t)tm->tm_hour << 11)
+         | ((uint32_t)tm->tm_min << 5) | ((uint32_t)tm->tm_sec >> 1);
+}
+
+// Convert a file name to the 11 chars directory format ("NAME    EXT"), false if not a valid 8.3 name
+static bool toName83(const char *name, char *name83)
+{
+    const char *base = strrchr(name, '/');
+    int         i = 0, limit = 8;
+    char        c;
+
+    name = base ? base + 1 : name;
+    memset(name83, ' ', 11);
+    for (; *name; name++)
+    {
+        c = (char)toupper((unsigned char)*name);
+        if (c == '.')
+        {
+            if ((limit == 11) || !i)
+            {
+                return false;                   // Two dots or no name
+            }
+            i = 8;
+            limit = 11;
+            continue;
+        }
+        if ((i >= limit) || (c <= ' ') || strchr("\"*+,/:;<=>?[\\]|", c))
+        {
+            return false;
+        }
+        name83[i++] = c;
+    }
+    return name83[0] != ' ';
+}
+
+// Printable "NAME.EXT" from the directory format
+static std::string fromName83(const uint8_t *name83)
+{
+    std::string name;
+    int         i;
+
+    for (i = 0; (i < 8) && (name83[i] != ' '); i++)
+    {
+        name += (char)name83[i];
+    }
+    if (name83[8] != ' ')
+    {
+        name += '.';
+        for (i = 8; (i < 11) && (name83[i] != ' '); i++)
+        {
+            name += (char)name83[i];
+        }
+    }
+    return name;
+}
+
+// Disk Set and disk number of a "disk file" DSsNnn.DSK (false if the name does not match)
+static bool isDiskFile(const uint8_t *name83, int *set, int *disk)
+{
+    if (memcmp(name83, "DS", 2) || (name83[3] != 'N') || memcmp(name83 + 6, "  DSK", 5)
+        || !isdigit(name83[2]) || !isdigit(name83[4]) || !isdigit(name83[5]))
+    {
+        return false;
+    }
+    *set = name83[2] - '0';
+    *disk = ((name83[4] - '0') * 10) + (name83[5] - '0');
+    return true;
+}
+
+static Bytes readHostFile(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    Bytes data;
+    uint8_t buf[65536];
+    size_t  n;
+
+    if (!f)
+    {
+        fatal("cannot open %s", path);
+    }
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return data;
+}
+
+// ------------------------------------------------------------------------------
+// FAT volume (the whole FAT is kept in memory)
+// ------------------------------------------------------------------------------
+struct DirSlot
+{
+    uint64_t pos;                               // Byte offset of the entry in the volume
+    uint8_t  ent[32];
+};
+
+class Volume
+{
+public:
+    Volume() : file(NULL), base(0), fatDirty(false) {}
+    ~Volume()                                   { if (file) fclose(file); }
+
+    void     open(const char *path);
+    void     close(void);
+
+    // Cluster chains
+    bool     isFat32(void) const                { return fat32; }
+    uint32_t clusters(void) const               { return nEnt - 2; }
+    uint32_t clusterBytes(void) const           { return spc * SECT_SIZE; }
+    uint8_t  sectPerClust(void) const           { return spc; }
+    uint32_t getFat(uint32_t clst) const        { return fat[clst] & (fat32 ? 0x0FFFFFFF : 0xFFFF); }
+    void     putFat(uint32_t clst, uint32_t val);
+    bool     isEoc(uint32_t val) const          { return val >= (fat32 ? 0x0FFFFFF8U : 0xFFF8U); }
+    uint32_t eoc(void) const                    { return fat32 ? 0x0FFFFFFF : 0xFFFF; }
+    uint32_t freeClusters(void) const;
+    uint32_t allocRun(uint32_t count) const;
+    void     freeChain(uint32_t clst);
+    bool     isContiguous(uint32_t clst, uint32_t count) const;
+    bool     fatCopiesEqual(void);
+
+    // Data
+    void     readClusters(uint32_t clst, uint32_t count, uint8_t *buf);
+    void     writeClusters(uint32_t clst, const Bytes &data);
+
+    // Root directory
+    std::vector<DirSlot> readRoot(void);
+    void     writeSlot(const DirSlot &slot);
+    int      findEntry(const std::vector<DirSlot> &root, const char *name83);
+    void     growRoot(void);
+
+private:
+    FILE     *file;
+    uint64_t  base;                             // Byte offset of the volume (partition) on the image
+    bool      fat32;
+    uint8_t   spc;                              // Sectors per cluster
+    uint8_t   nFats;
+    uint16_t  rootEnt;                          // Root directory entries (0 on FAT32)
+    uint32_t  fatSz;                            // Sectors per FAT
+    uint32_t  fatSect, rootSect, dataSect;      // Start sectors (volume relative)
+    uint32_t  rootClust;                        // FAT32 root directory cluster
+    uint32_t  fsInfo;                           // FAT32 FSInfo sector
+    uint32_t  nEnt;                             // Number of FAT entries (clusters + 2)
+    std::vector<uint32_t> fat;
+    bool      fatDirty;
+
+    void     io(uint64_t pos, void *buf, size_t len, bool write);
+    void     readSect(uint32_t sect, void *buf, uint32_t count)   { io((uint64_t)sect * SECT_SIZE, buf, count * SECT_SIZE, false); }
+    void     writeSect(uint32_t sect, const void *buf, uint32_t count) { io((uint64_t)sect * SECT_SIZE, (void *)buf, count * SECT_SIZE, true); }
+    uint32_t clust2sect(uint32_t clst) const    { return dataSect + (clst - 2) * spc; }
+    void     flushFat(void);
+};
+
+void Volume::io(uint64_t pos, void *buf, size_t len, bool write)
+{
+    if (fseeko(file, (off_t)(base + pos), SEEK_SET))
+    {
+        fatal("seek error at %llu", (unsigned long long)(base + pos));
+    }
+    if ((write ? fwrite(buf, 1, len, file) : fread(buf, 1, len, file)) != len)
+    {
+        fatal("%s error at %llu", write ? "write" : "read", (unsigned long long)(base + pos));
+    }
+}
+
+// Boot record check, the same one done by pf_mount() (0: FAT boot record, 1: not a FAT boot record, 2: no boot record)
+static int checkFs(const uint8_t *sect)
+{
+    if (ld16(sect + 510) != 0xAA55)
+    {
+        return 2;
+    }
+    if (!memcmp(sect + 54, "FAT", 3) || !memcmp(sect + 82, "FAT32", 5))
+    {
+        return 0;
+    }
+    return 1;
+}
+
+void Volume::open(const char *path)
+{
+    uint8_t  bs[SECT_SIZE];
+    uint32_t totSec, rsv, i;
+    Bytes    buf;
+
+    file = fopen(path, "r+b");
+    if (!file)
+    {
+        fatal("cannot open %s", path);
+    }
+
+    // Search the FAT volume: SFD (no partition table) or the first partition
+    base = 0;
+    readSect(0, bs, 1);
+    if (checkFs(bs) == 1)
+    {
+        if (bs[446 + 4])
+        {
+            base = (uint64_t)ld32(bs + 446 + 8) * SECT_SIZE;
+            readSect(0, bs, 1);
+        }
+    }
+    if (checkFs(bs))
+    {
+        fatal("%s: no FAT volume found", path);
+    }
+    if (ld16(bs + 11) != SECT_SIZE)
+    {
+        fatal("%s: only 512 bytes sectors are supported", path);
+    }
+
+    spc = bs[13];
+    rsv = ld16(bs + 14);
+    nFats = bs[16];
+    rootEnt = ld16(bs + 17);
+    totSec = ld16(bs + 19) ? ld16(bs + 19) : ld32(bs + 32);
+    fatSz = ld16(bs + 22) ? ld16(bs + 22) : ld32(bs + 36);
+    fatSect = rsv;
+    rootSect = fatSect + nFats * fatSz;
+    dataSect = rootSect + (rootEnt * 32 + SECT_SIZE - 1) / SECT_SIZE;
+    nEnt = (totSec - dataSect) / spc + 2;
+    if (nEnt - 2 < FAT16_MINCLST)
+    {
+        fatal("%s: FAT12 volume (not supported by IOS)", path);
+    }
+    fat32 = (nEnt - 2) >= FAT32_MINCLST;
+    rootClust = fat32 ? ld32(bs + 44) : 0;
+    fsInfo = fat32 ? ld16(bs + 48) : 0;
+
+    // Load the first FAT copy
+    buf.resize((size_t)fatSz * SECT_SIZE);
+    readSect(fatSect, &buf[0], fatSz);
+    fat.resize(nEnt);
+    for (i = 0; i < nEnt; i++)
+    {
+        fat[i] = fat32 ? ld32(&buf[i * 4]) : ld16(&buf[i * 2]);
+    }
+}
+
+void Volume::close(void)
+{
+    flushFat();
+    if (fclose(file))
+    {
+        fatal("close error");
+    }
+    file = NULL;
+}
+
+void Volume::putFat(uint32_t clst, uint32_t val)
+{
+    if ((clst < 2) || (clst >= nEnt))
+    {
+        fatal("internal error: cluster %u out of range", clst);
+    }
+    fat[clst] = fat32 ? ((fat[clst] & 0xF0000000) | (val & 0x0FFFFFFF)) : (val & 0xFFFF);
+    fatDirty = true;
+}
+
+// Write the FAT to every copy (and update the FAT32 FSInfo sector)
+void Volume::flushFat(void)
+{
+    Bytes    buf((size_t)fatSz * SECT_SIZE, 0);
+    uint8_t  info[SECT_SIZE];
+    uint32_t i;
+
+    if (!fatDirty)
+    {
+        return;
+    }
+    for (i = 0; i < nEnt; i++)
+    {
+        if (fat32)
+        {
+            st32(&buf[i * 4], fat[i]);
+        }
+        else
+        {
+            st16(&buf[i * 2], (uint16_t)fat[i]);
+        }
+    }
+    for (i = 0; i < nFats; i++)
+    {
+        writeSect(fatSect + i * fatSz, &buf[0], fatSz);
+    }
+    if (fat32 && fsInfo)
+    {
+        readSect(fsInfo, info, 1);
+        if ((ld32(info) == 0x41615252) && (ld32(info + 484) == 0x61417272))
+        {
+            st32(info + 488, freeClusters());
+            st32(info + 492, 0xFFFFFFFF);       // No next free cluster hint
+            writeSect(fsInfo, info, 1);
+        }
+    }
+    fatDirty = false;
+}
+
+uint32_t Volume::freeClusters(void) const
+{
+    uint32_t clst, count = 0;
+
+    for (clst = 2; clst < nEnt; clst++)
+    {
+        count += !getFat(clst);
+    }
+    return count;
+}
+
+// First run of "count" free clusters (0: not found)
+uint32_t Volume::allocRun(uint32_t count) const
+{
+    uint32_t clst, run = 0;
+
+    for (clst = 2; clst < nEnt; clst++)
+    {
+        run = getFat(clst) ? 0 : run + 1;
+        if (run == count)
+        {
+            return clst - count + 1;
+        }
+    }
+    return 0;
+}
+
+void Volume::freeChain(uint32_t clst)
+{
+    uint32_t next;
+
+    while ((clst >= 2) && (clst < nEnt))
+    {
+        next = getFat(clst);
+        putFat(clst, 0);
+        if (isEoc(next))
+        {
+            break;
+        }
+        clst = next;
+    }
+}
+
+// True if the "count" clusters from "clst" are linked one after the other
+bool Volume::isContiguous(uint32_t clst, uint32_t count) const
+{
+    if ((clst < 2) || (count == 0) || (clst + count > nEnt))
+    {
+        return false;
+    }
+    for (; count > 1; clst++, count--)
+    {
+        if (getFat(clst) != clst + 1)
+        {
+            return false;
+        }
+    }
+    return getFat(clst) != 0;
+}
+
+bool Volume::fatCopiesEqual(void)
+{
+    Bytes    first((size_t)fatSz * SECT_SIZE), other(first.size());
+    uint32_t i;
+
+    flushFat();
+    readSect(fatSect, &first[0], fatSz);
+    for (i = 1; i < nFats; i++)
+    {
+        readSect(fatSect + i * fatSz, &other[0], fatSz);
+        if (first != other)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Volume::readClusters(uint32_t clst, uint32_t count, uint8_t *buf)
+{
+    readSect(clust2sect(clst), buf, count * spc);
+}
+
+// Write "data" from "clst" on (the tail of the last cluster is cleared)
+void Volume::writeClusters(uint32_t clst, const Bytes &data)
+{
+    uint32_t count = (uint32_t)((data.size() + clusterBytes() - 1) / clusterBytes());
+    Bytes    tail(clusterBytes(), 0);
+    size_t   full = (data.size() / clusterBytes()) * clusterBytes();
+
+    if (full)
+    {
+        writeSect(clust2sect(clst), &data[0], (uint32_t)(full / SECT_SIZE));
+    }
+    if (full < data.size())
+    {
+        memcpy(&tail[0], &data[full], data.size() - full);
+        writeSect(clust2sect(clst + count - 1), &tail[0], spc);
+    }
+}
+
+std::vector<DirSlot> Volume::readRoot(void)
+{
+    std::vector<DirSlot> root;
+    Bytes    buf;
+    uint32_t clst, i;
+    uint64_t pos;
+    DirSlot  slot;
+
+    if (!fat32)
+    {
+        buf.resize(rootEnt * 32);
+        io((uint64_t)rootSect * SECT_SIZE, &buf[0], buf.size(), false);
+        for (i = 0; i < rootEnt; i++)
+        {
+            slot.pos = (uint64_t)rootSect * SECT_SIZE + i * 32;
+            memcpy(slot.ent, &buf[i * 32], 32);
+            root.push_back(slot);
+        }
+        return root;
+    }
+    buf.resize(clusterBytes());
+    for (clst = rootClust; (clst >= 2) && (clst < nEnt); clst = getFat(clst))
+    {
+        pos = (uint64_t)clust2sect(clst) * SECT_SIZE;
+        io(pos, &buf[0], buf.size(), false);
+        for (i = 0; i < clusterBytes() / 32; i++)
+        {
+            slot.pos = pos + i * 32;
+            memcpy(slot.ent, &buf[i * 32], 32);
+            root.push_back(slot);
+        }
+        if (root.size() > 65536)
+        {
+            fatal("root directory chain is looped");
+        }
+    }
+    return root;
+}
+
+void Volume::writeSlot(const DirSlot &slot)
+{
+    io(slot.pos, (void *)slot.ent, 32, true);
+}
+
+// Index of the file entry with the given name (-1: not found)
+int Volume::findEntry(const std::vector<DirSlot> &root, const char *name83)
+{
+    size_t i;
+
+    for (i = 0; i < root.size(); i++)
+    {
+        const uint8_t *ent = root[i].ent;
+        if (!ent[0])
+        {
+            break;                              // End of the directory
+        }
+        if ((ent[0] != 0xE5) && !(ent[11] & 0x08) && !memcmp(ent, name83, 11))
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Add a cluster to the FAT32 root directory
+void Volume::growRoot(void)
+{
+    uint32_t last = rootClust, clst = allocRun(1);
+    Bytes    empty(clusterBytes(), 0);
+
+    if (!fat32)
+    {
+        fatal("root directory full");
+    }
+    if (!clst)
+    {
+        fatal("volume full");
+    }
+    while (!isEoc(getFat(last)))
+    {
+        last = getFat(last);
+    }
+    writeClusters(clst, empty);
+    putFat(clst, eoc());
+    putFat(last, clst);
+}
+
+// ------------------------------------------------------------------------------
+// File operations
+// ------------------------------------------------------------------------------
+
+// Write a file (replacing any existing one) in a single run of clusters
+static uint32_t putFile(Volume &vol, const char *name, const Bytes &data)
+{
+    char     name83[11];
+    uint32_t count, start = 0, i, tm;
+    int      index;
+    std::vector<DirSlot> root = vol.readRoot();
+
+    if (!toName83(name, name83))
+    {
+        fatal("%s: not a valid 8.3 file name", name);
+    }
+    if (data.size() > 0xFFFFFFFFUL)
+    {
+        fatal("%s: file too big", name);
+    }
+
+    // Free the clusters of the file being replaced, or get a free directory entry
+    index = vol.findEntry(root, name83);
+    if (index >= 0)
+    {
+        vol.freeChain(ld16(root[index].ent + 26) | ((uint32_t)ld16(root[index].ent + 20) << 16));
+    }
+    else
+    {
+        for (;;)
+        {
+            for (i = 0; i < root.size(); i++)
+            {
+                if (!root[i].ent[0] || (root[i].ent[0] == 0xE5))
+                {
+                    break;
+                }
+            }
+            if (i < root.size())
+            {
+                break;
+            }
+            vol.growRoot();
+            root = vol.readRoot();
+        }
+        index = (int)i;
+        memset(root[index].ent, 0, 32);
+        memcpy(root[index].ent, name83, 11);
+    }
+
+    // Allocate and write the data
+    count = (uint32_t)((data.size() + vol.clusterBytes() - 1) / vol.clusterBytes());
+    if (count)
+    {
+        start = vol.allocRun(count);
+        if (!start)
+        {
+            fatal("%s: no run of %u free clusters left", name, count);
+        }
+        vol.writeClusters(start, data);
+        for (i = 0; i < count - 1; i++)
+        {
+            vol.putFat(start + i, start + i + 1);
+        }
+        vol.putFat(start + count - 1, vol.eoc());
+    }
+
+    // Update the directory entry
+    uint8_t *ent = root[index].ent;
+    tm = fatTime();
+    ent[11] = 0x20;                             // Archive
+    st32(ent + 14, tm);                         // Creation time and date
+    st16(ent + 18, (uint16_t)(tm >> 16));       // Last access date
+    st16(ent + 20, (uint16_t)(start >> 16));
+    st32(ent + 22, tm);                         // Write time and date
+    st16(ent + 26, (uint16_t)start);
+    st32(ent + 28, (uint32_t)data.size());
+    vol.writeSlot(root[index]);
+    return start;
+}
+
+static Bytes getFile(Volume &vol, const DirSlot &slot)
+{
+    uint32_t size = ld32(slot.ent + 28);
+    uint32_t clst = ld16(slot.ent + 26) | ((uint32_t)ld16(slot.ent + 20) << 16);
+    Bytes    data, buf(vol.clusterBytes());
+
+    while (data.size() < size)
+    {
+        if ((clst < 2) || (clst >= vol.clusters() + 2))
+        {
+            fatal("%s: broken cluster chain", fromName83(slot.ent).c_str());
+        }
+        vol.readClusters(clst, 1, &buf[0]);
+        data.insert(data.end(), buf.begin(), buf.end());
+        clst = vol.getFat(clst);
+    }
+    data.resize(size);
+    return data;
+}
+
+// Start cluster and size of a file entry, and if its clusters are consecutive
+static bool entryContiguous(const Volume &vol, const uint8_t *ent, uint32_t *start, uint32_t *size)
+{
+    *start = ld16(ent + 26) | ((uint32_t)ld16(ent + 20) << 16);
+    *size = ld32(ent + 28);
+    return *size && vol.isContiguous(*start, (uint32_t)((*size + vol.clusterBytes() - 1) / vol.clusterBytes()));
+}
+
+// Rewrite DSKMAP.DAT with the contiguous "disk files" found in the root directory
+static void writeMap(Volume &vol, bool verbose)
+{
+    Bytes    map(DSMAP_SIZE, 0);
+    uint32_t start, size;
+    int      set, disk, mapped = 0;
+    size_t   i;
+    std::vector<DirSlot> root = vol.readRoot();
+
+    memcpy(&map[0], "MBC2DMAP", 8);
+    map[8] = DSMAP_VERSION;
+    map[9] = vol.sectPerClust();
+    for (i = 0; (i < root.size()) && root[i].ent[0]; i++)
+    {
+        const uint8_t *ent = root[i].ent;
+        if ((ent[0] == 0xE5) || (ent[11] & 0x18) || !isDiskFile(ent, &set, &disk))
+        {
+            continue;
+        }
+        if (!entryContiguous(vol, ent, &start, &size))
+        {
+            fprintf(stderr, "mbc2img: warning: %s is fragmented (not mapped, see \"defrag\")\n", fromName83(ent).c_str());
+            continue;
+        }
+        uint8_t *rec = &map[SECT_SIZE + (set * MAX_DISKNUM + disk) * DSMAP_RECSIZE];
+        st32(rec, start);
+        st32(rec + 4, size);
+        mapped++;
+    }
+    putFile(vol, DSMAP_NAME, map);
+    if (verbose)
+    {
+        printf("%s: %d disk file(s) mapped\n", DSMAP_NAME, mapped);
+    }
+}
+
+// ------------------------------------------------------------------------------
+// Format
+// ------------------------------------------------------------------------------
+
+// FAT size (sectors) and number of clusters for the given layout (0 clusters: does not fit)
+static uint32_t fatLayout(uint32_t totSec, uint32_t rsv, uint32_t rootSecs, uint32_t spc, bool fat32, uint32_t *fatSz)
+{
+    uint32_t size = 1, need, clusters = 0;
+
+    for (;;)
+    {
+        if (rsv + 2 * size + rootSecs >= totSec)
+        {
+            return 0;
+        }
+        clusters = (totSec - rsv - 2 * size - rootSecs) / spc;
+        need = ((clusters + 2) * (fat32 ? 4 : 2) + SECT_SIZE - 1) / SECT_SIZE;
+        if (need <= size)
+        {
+            break;
+        }
+        size = need;
+    }
+    *fatSz = size;
+    return clusters;
+}
+
+static void formatImage(const char *path, uint32_t sizeMB, bool fat32, const char *label)
+{
+    static const uint8_t fat32Spc[] = { 8, 4, 2, 1, 16, 32, 64 };   // Prefer 4KB clusters on FAT32
+    uint32_t totSec = sizeMB * 2048, rsv, rootSecs, spc = 0, fatSz = 0, clusters = 0, sect, i;
+    uint8_t  bs[SECT_SIZE], sect0[SECT_SIZE];
+    char     volLabel[12];
+    struct stat st;
+    FILE    *f;
+
+    if (!sizeMB || (sizeMB > 2097151))
+    {
+        fatal("invalid size %u MB", sizeMB);
+    }
+
+    // Pick the cluster size
+    rsv = fat32 ? 32 : 4;
+    rootSecs = fat32 ? 0 : 32;                  // 512 root entries on FAT16
+    if (fat32)
+    {
+        for (i = 0; i < sizeof(fat32Spc); i++)
+        {
+            clusters = fatLayout(totSec, rsv, rootSecs, fat32Spc[i], true, &fatSz);
+            if ((clusters >= FAT32_MINCLST) && (clusters <= FAT32_MAXCLST))
+            {
+                spc = fat32Spc[i];
+                break;
+            }
+        }
+        if (!spc)
+        {
+            fatal("%u MB does not fit a FAT32 volume (33 MB at least)", sizeMB);
+        }
+    }
+    else
+    {
+        for (spc = 1; spc <= 64; spc *= 2)
+        {
+            clusters = fatLayout(totSec, rsv, rootSecs, spc, false, &fatSz);
+            if (clusters < FAT32_MINCLST)
+            {
+                break;
+            }
+        }
+        if ((spc > 64) || (clusters < FAT16_MINCLST))
+        {
+            fatal("%u MB does not fit a FAT16 volume (3 MB to 2 GB)", sizeMB);
+        }
+    }
+
+    // Create the image (a device is used as it is, but it must be large enough)
+    if (!stat(path, &st) && !S_ISREG(st.st_mode))
+    {
+        f = fopen(path, "r+b");
+        if (f && (fseeko(f, 0, SEEK_END) || (ftello(f) < (off_t)totSec * SECT_SIZE)))
+        {
+            fatal("%s is smaller than %u MB", path, sizeMB);
+        }
+    }
+    else
+    {
+        f = fopen(path, "w+b");
+        if (f && ftruncate(fileno(f), (off_t)totSec * SECT_SIZE))
+        {
+            fatal("cannot resize %s", path);
+        }
+    }
+    if (!f)
+    {
+        fatal("cannot create %s", path);
+    }
+
+    // Boot sector
+    memset(bs, 0, sizeof(bs));
+    memcpy(bs, "\xEB\x58\x90" "MBC2IMG ", 11);
+    st16(bs + 11, SECT_SIZE);
+    bs[13] = (uint8_t)spc;
+    st16(bs + 14, (uint16_t)rsv);
+    bs[16] = 2;                                 // FAT copies
+    st16(bs + 17, fat32 ? 0 : 512);             // Root directory entries
+    if (totSec < 65536)
+    {
+        st16(bs + 19, (uint16_t)totSec);
+    }
+    else
+    {
+        st32(bs + 32, totSec);
+    }
+    bs[21] = 0xF8;                              // Media: fixed disk
+    st16(bs + 24, 63);                          // Sectors per track
+    st16(bs + 26, 255);                         // Heads
+    snprintf(volLabel, sizeof(volLabel), "%-11.11s", label ? label : "Z80-MBC2");
+    for (i = 0; i < 11; i++)
+    {
+        volLabel[i] = (char)toupper((unsigned char)volLabel[i]);
+    }
+    uint8_t *ext = bs + (fat32 ? 64 : 36);      // Extended BPB
+    if (fat32)
+    {
+        st32(bs + 36, fatSz);
+        st32(bs + 44, 2);                       // Root directory cluster
+        st16(bs + 48, 1);                       // FSInfo sector
+        st16(bs + 50, 6);                       // Backup boot sector
+    }
+    else
+    {
+        st16(bs + 22, (uint16_t)fatSz);
+    }
+    ext[0] = 0x80;                              // Drive number
+    ext[2] = 0x29;                              // Extended boot signature
+    st32(ext + 3, (uint32_t)time(NULL));        // Volume serial number
+    memcpy(ext + 7, volLabel, 11);
+    memcpy(ext + 18, fat32 ? "FAT32   " : "FAT16   ", 8);
+    st16(bs + 510, 0xAA55);
+
+    // Clear the system area (reserved sectors, FATs, root directory or first cluster)
+    memset(sect0, 0, sizeof(sect0));
+    for (sect = 0; sect < rsv + 2 * fatSz + (fat32 ? spc : rootSecs); sect++)
+    {
+        if (fseeko(f, (off_t)sect * SECT_SIZE, SEEK_SET) || (fwrite(sect0, 1, SECT_SIZE, f) != SECT_SIZE))
+        {
+            fatal("write error on %s", path);
+        }
+    }
+    if (fseeko(f, 0, SEEK_SET) || (fwrite(bs, 1, SECT_SIZE, f) != SECT_SIZE)
+        || (fat32 && (fseeko(f, 6 * SECT_SIZE, SEEK_SET) || (fwrite(bs, 1, SECT_SIZE, f) != SECT_SIZE))))
+    {
+        fatal("write error on %s", path);
+    }
+    if (fat32)
+    {
+        memset(sect0, 0, sizeof(sect0));
+        st32(sect0, 0x41615252);                // FSInfo signatures
+        st32(sect0 + 484, 0x61417272);
+        st32(sect0 + 488, clusters - 1);        // Free clusters (the root directory uses one)
+        st32(sect0 + 492, 3);                   // Next free cluster
+        st16(sect0 + 510, 0xAA55);
+        if (fseeko(f, SECT_SIZE, SEEK_SET) || (fwrite(sect0, 1, SECT_SIZE, f) != SECT_SIZE)
+            || fseeko(f, 7 * SECT_SIZE, SEEK_SET) || (fwrite(sect0, 1, SECT_SIZE, f) != SECT_SIZE))
+        {
+            fatal("write error on %s", path);
+        }
+    }
+
+    // First FAT entries on both copies (media byte, end of chain, FAT32 root directory)
+    memset(sect0, 0, sizeof(sect0));
+    if (fat32)
+    {
+        st32(sect0, 0x0FFFFFF8);
+        st32(sect0 + 4, 0x0FFFFFFF);
+        st32(sect0 + 8, 0x0FFFFFFF);
+    }
+    else
+    {
+        st16(sect0, 0xFFF8);
+        st16(sect0 + 2, 0xFFFF);
+    }
+    for (i = 0; i < 2; i++)
+    {
+        if (fseeko(f, (off_t)(rsv + i * fatSz) * SECT_SIZE, SEEK_SET) || (fwrite(sect0, 1, SECT_SIZE, f) != SECT_SIZE))
+        {
+            fatal("write error on %s", path);
+        }
+    }
+    if (fclose(f))
+    {
+        fatal("write error on %s", path);
+    }
+    printf("%s: FAT%d, %u MB, %u clusters of %u bytes\n", path, fat32 ? 32 : 16, sizeMB, clusters, spc * SECT_SIZE);
+}
+
+// ------------------------------------------------------------------------------
+// Commands
+// ------------------------------------------------------------------------------
+
+// Create (or replace) a Disk Set: DSsNAM.DAT and "disks" DSsN00.DSK... filled with 0xE5,
+//  or taken from the same named files in "srcDir" if there.
+//  "osName" may be "NAME:LOADER:ADDR" to give the loader file and its starting address
+//  (stored after the OS name, see SDCardFunctions.h); otherwise IOS uses the built-in
+//  loader of the Disk Sets 0..3
+static void makeDiskSet(Volume &vol, int set, const char *osName, int disks, const char *srcDir)
+{
+    char        name[16], path[4096];
+    const char *loader = strchr(osName, ':');
+    Bytes       data, nameData(osName, loader ? loader : osName + strlen(osName));
+    int         disk;
+
+    if ((set < 0) || (set >= MAX_DISKSET))
+    {
+        fatal("Disk Set must be in [0..%d]", MAX_DISKSET - 1);
+    }
+    if ((disks < 1) || (disks > MAX_DISKNUM))
+    {
+        fatal("number of disks must be in [1..%d]", MAX_DISKNUM);
+    }
+    nameData.push_back(0);
+    if (loader)
+    {
+        const char   *addr = strchr(loader + 1, ':');
+        char         *end;
+        unsigned long strAddr = addr ? strtoul(addr + 1, &end, 0) : 0;
+
+        if (!addr || (addr == loader + 1) || (addr - loader - 1 > 12) || !addr[1] || *end || (strAddr > 0xFFFF))
+        {
+            fatal("loader must be given as NAME:LOADER:ADDR (8.3 name, 16 bit address)");
+        }
+        nameData.insert(nameData.end(), loader + 1, addr);
+        nameData.push_back(0);
+        nameData.push_back((uint8_t)strAddr);
+        nameData.push_back((uint8_t)(strAddr >> 8));
+    }
+    if (nameData.size() > 32)
+    {
+        fatal("OS name and loader too long (32 bytes max)");
+    }
+    snprintf(name, sizeof(name), "DS%dNAM.DAT", set);
+    putFile(vol, name, nameData);
+
+    for (disk = 0; disk < disks; disk++)
+    {
+        snprintf(name, sizeof(name), "DS%dN%02d.DSK", set, disk);
+        data.assign(DISK_SIZE, DISK_FILL);
+        if (srcDir)
+        {
+            snprintf(path, sizeof(path), "%s/%s", srcDir, name);
+            if (access(path, R_OK))
+            {
+                snprintf(path, sizeof(path), "%s/ds%dn%02d.dsk", srcDir, set, disk);
+            }
+            if (!access(path, R_OK))
+            {
+                Bytes src = readHostFile(path);
+                if (src.size() > DISK_SIZE)
+                {
+                    fatal("%s: larger than %lu bytes", path, DISK_SIZE);
+                }
+                memcpy(&data[0], &src[0], src.size());
+            }
+        }
+        printf("%s: cluster %u\n", name, putFile(vol, name, data));
+    }
+}
+
+// Rewrite the fragmented "disk files" in a single run of clusters each
+static void defrag(Volume &vol)
+{
+    std::vector<DirSlot> root = vol.readRoot();
+    uint32_t start, size;
+    int      set, disk;
+    size_t   i;
+
+    for (i = 0; (i < root.size()) && root[i].ent[0]; i++)
+    {
+        const uint8_t *ent = root[i].ent;
+        if ((ent[0] == 0xE5) || (ent[11] & 0x18) || !isDiskFile(ent, &set, &disk)
+            || !ld32(ent + 28) || entryContiguous(vol, ent, &start, &size))
+        {
+            continue;
+        }
+        std::string name = fromName83(ent);
+        Bytes data = getFile(vol, root[i]);
+        printf("%s: moved to cluster %u\n", name.c_str(), putFile(vol, name.c_str(), data));
+    }
+}
+
+// Check the "disk files" against the FAT and the disk map (returns the number of problems)
+static int verify(Volume &vol)
+{
+    std::vector<DirSlot> root = vol.readRoot();
+    Bytes    map;
+    uint32_t start, size;
+    int      set, disk, problems = 0, index;
+    bool     contig;
+    size_t   i;
+    char     name83[11];
+
+    if (!vol.fatCopiesEqual())
+    {
+        printf("FAT copies differ\n");
+        problems++;
+    }
+    toName83(DSMAP_NAME, name83);
+    index = vol.findEntry(root, name83);
+    if (index >= 0)
+    {
+        map = getFile(vol, root[index]);
+        if (!entryContiguous(vol, root[index].ent, &start, &size))
+        {
+            printf("%s: fragmented\n", DSMAP_NAME);
+            problems++;
+        }
+    }
+    if ((map.size() < DSMAP_SIZE) || memcmp(&map[0], "MBC2DMAP", 8) || (map[8] != DSMAP_VERSION)
+        || (map[9] != vol.sectPerClust()))
+    {
+        printf("%s: missing or not valid\n", DSMAP_NAME);
+        map.clear();
+        problems++;
+    }
+
+    for (i = 0; (i < root.size()) && root[i].ent[0]; i++)
+    {
+        const uint8_t *ent = root[i].ent;
+        if ((ent[0] == 0xE5) || (ent[11] & 0x18) || !isDiskFile(ent, &set, &disk))
+        {
+            continue;
+        }
+        contig = entryContiguous(vol, ent, &start, &size);
+        printf("%-12s cluster %-8u %s", fromName83(ent).c_str(), start, contig ? "contiguous" : "FRAGMENTED");
+        if (!contig)
+        {
+            problems++;
+        }
+        if (size != DISK_SIZE)
+        {
+            printf(", size %u (not %lu)", size, DISK_SIZE);
+            problems++;
+        }
+        if (!map.empty())
+        {
+            const uint8_t *rec = &map[SECT_SIZE + (set * MAX_DISKNUM + disk) * DSMAP_RECSIZE];
+            if (contig && ((ld32(rec) != start) || (ld32(rec + 4) != size)))
+            {
+                printf(", map out of date");
+                problems++;
+            }
+        }
+        printf("\n");
+    }
+    printf("%d problem(s)\n", problems);
+    return problems;
+}
+
+static void list(Volume &vol)
+{
+    std::vector<DirSlot> root = vol.readRoot();
+    uint32_t start, size;
+    size_t   i;
+
+    for (i = 0; (i < root.size()) && root[i].ent[0]; i++)
+    {
+        const uint8_t *ent = root[i].ent;
+        if ((ent[0] == 0xE5) || (ent[11] & 0x08))
+        {
+            continue;
+        }
+        bool contig = entryContiguous(vol, ent, &start, &size);
+        printf("%-12s %10u  cluster %-8u %s\n", fromName83(ent).c_str(), size, start,
+            (ent[11] & 0x10) ? "<DIR>" : (!size ? "" : (contig ? "contiguous" : "fragmented")));
+    }
+    printf("FAT%d, %u clusters of %u bytes, %u free\n", vol.isFat32() ? 32 : 16, vol.clusters(),
+        vol.clusterBytes(), vol.freeClusters());
+}
+
+static void usage(void)
+{
+    printf(
+        "usage: mbc2img format IMAGE SIZE_MB [fat16|fat32] [LABEL]\n"
+        "                                     create an empty volume (no partition table)\n"
+        "       mbc2img diskset IMAGE SET OSNAME[:LOADER:ADDR] [DISKS [SRCDIR]]\n"
+        "                                     create Disk Set SET: DSsNAM.DAT and DISKS (default 16)\n"
+        "                                     disk files DSsNnn.DSK, E5 filled or from SRCDIR\n"
+        "                                     (LOADER at ADDR is booted, default for SET 0..3 only)\n"
+        "       mbc2img put IMAGE FILE [NAME] copy a host file (replacing any with the same name)\n"
+        "       mbc2img get IMAGE NAME FILE   copy a file to the host\n"
+        "       mbc2img defrag IMAGE          make every fragmented disk file contiguous\n"
+        "       mbc2img map IMAGE             rewrite the disk map (%s)\n"
+        "       mbc2img verify IMAGE          check the disk files and the disk map\n"
+        "       mbc2img ls IMAGE              list the root directory\n"
+        "       mbc2img hibern IMAGE          preallocate the hibernation snapshot (%s)\n"
+        "       mbc2img iolog IMAGE [SIZE_KB] preallocate the I/O sessions log (%s, default %uKB)\n"
+        "\n"
+        "IMAGE is a file or a device holding a FAT16/FAT32 volume (SFD or first partition).\n"
+        "Every file is written in a single run of clusters and the disk map is rewritten\n"
+        "after each change, so IOS can access the disk files without walking the FAT.\n",
+        DSMAP_NAME, SNAP_NAME, IOLOG_NAME, IOLOG_KB);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    Volume      vol;
+    std::string cmd = (argc >= 3) ? argv[1] : "";
+    int         problems;
+
+    if (cmd == "format" && (argc >= 4) && (argc <= 6))
+    {
+        bool fat32 = (argc >= 5) && !strcmp(argv[4], "fat32");
+        if ((argc >= 5) && !fat32 && strcmp(argv[4], "fat16"))
+        {
+            usage();
+        }
+        formatImage(argv[2], (uint32_t)strtoul(argv[3], NULL, 0), fat32, (argc == 6) ? argv[5] : NULL);
+        vol.open(argv[2]);
+        writeMap(vol, false);
+        vol.close();
+        return 0;
+    }
+    if (cmd == "diskset" && (argc >= 5) && (argc <= 7))
+    {
+        vol.open(argv[2]);
+        makeDiskSet(vol, atoi(argv[3]), argv[4], (argc >= 6) ? atoi(argv[5]) : 16, (argc == 7) ? argv[6] : NULL);
+        writeMap(vol, true);
+        vol.close();
+        return 0;
+    }
+    if (cmd == "put" && (argc >= 4) && (argc <= 5))
+    {
+        vol.open(argv[2]);
+        printf("cluster %u\n", putFile(vol, (argc == 5) ? argv[4] : argv[3], readHostFile(argv[3])));
+        writeMap(vol, true);
+        vol.close();
+        return 0;
+    }
+    if (cmd == "get" && (argc == 5))
+    {
+        char  name83[11];
+        FILE *f;
+
+        vol.open(argv[2]);
+        std::vector<DirSlot> root = vol.readRoot();
+        int index = toName83(argv[3], name83) ? vol.findEntry(root, name83) : -1;
+        if (index < 0)
+        {
+            fatal("%s: not found", argv[3]);
+        }
+        Bytes data = getFile(vol, root[index]);
+        f = fopen(argv[4], "wb");
+        if (!f || (fwrite(data.data(), 1, data.size(), f) != data.size()) || fclose(f))
+        {
+            fatal("cannot write %s", argv[4]);
+        }
+        return 0;
+    }
+    if (cmd == "defrag" && (argc == 3))
+    {
+        vol.open(argv[2]);
+        defrag(vol);
+        writeMap(vol, true);
+        vol.close();
+        return 0;
+    }
+    if (cmd == "map" && (argc == 3))
+    {
+        vol.open(argv[2]);
+        writeMap(vol, true);
+        vol.close();
+        return 0;
+    }
+    if (cmd == "verify" && (argc == 3))
+    {
+        vol.open(argv[2]);
+        problems = verify(vol);
+        vol.close();
+        return problems ? 1 : 0;
+    }
+    if (cmd == "hibern" && (argc == 3))
+    {
+        // An empty (invalid) snapshot: IOS only overwrites it, without allocating clusters
+        vol.open(argv[2]);
+        printf("%s: cluster %u\n", SNAP_NAME, putFile(vol, SNAP_NAME, Bytes(SNAP_SIZE, 0)));
+        writeMap(vol, false);
+        vol.close();
+        return 0;
+    }
+    if (cmd == "iolog" && (argc >= 3) && (argc <= 4))
+    {
+        // An empty log: IOS writes its sectors directly, so it must be contiguous
+        uint32_t kb = (argc == 4) ? (uint32_t)strtoul(argv[3], NULL, 0) : IOLOG_KB;
+        if (!kb)
+        {
+            usage();
+        }
+        vol.open(argv[2]);
+        printf("%s: cluster %u\n", IOLOG_NAME, putFile(vol, IOLOG_NAME, Bytes(kb * 1024UL, 0)));
+        writeMap(vol, false);
+        vol.close();
+        return 0;
+    }
+    if (cmd == "ls" && (argc == 3))
+    {
+        vol.open(argv[2]);
+        list(vol);
+        vol.close();
+        return 0;
+    }
+    usage();
+    return 2;
+}